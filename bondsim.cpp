@@ -0,0 +1,853 @@
+/*
+ * Copyright (c)2019 ZeroTier, Inc.
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file in the project's root directory.
+ *
+ * Change Date: 2025-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2.0 of the Apache License.
+ */
+/****/
+
+/*
+ * Offline multipath simulator for bonding policies
+ *
+ * Two Nodes are connected by N simulated links, each with its own latency,
+ * jitter, loss, bandwidth and failure schedule. Time is virtual and all wire,
+ * state and frame callbacks are served from memory, so a run is reproducible
+ * for a given seed and does not depend on the speed of the host.
+ *
+ * Node B is the only root of a private planet and so needs no controller or
+ * Internet access. Both nodes join a network whose configuration is injected
+ * directly instead of being fetched from a controller. Once bonds have formed,
+ * node A sends UDP frames over several flows to node B and each policy is
+ * scored on goodput, failover time, reorder rate and CPU per packet.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <queue>
+#include <algorithm>
+
+#include "node/Constants.hpp"
+#include "node/InetAddress.hpp"
+#include "node/Utils.hpp"
+#include "node/Identity.hpp"
+#include "node/Buffer.hpp"
+#include "node/MAC.hpp"
+#include "node/World.hpp"
+#include "node/C25519.hpp"
+#include "node/NetworkConfig.hpp"
+#include "node/Network.hpp"
+#include "node/Node.hpp"
+#include "node/Bond.hpp"
+#include "node/BondController.hpp"
+#include "node/Switch.hpp"
+
+#include "osdep/OSUtils.hpp"
+#include "osdep/Phy.hpp"
+
+#ifdef __WINDOWS__
+#include <tchar.h>
+#endif
+
+using namespace ZeroTier;
+
+//////////////////////////////////////////////////////////////////////////////
+
+#define ZT_BONDSIM_NETWORK_ID 0xdeadbeef01000001ULL
+#define ZT_BONDSIM_PLANET_ID 0x62736d0000000001ULL
+#define ZT_BONDSIM_PORT 9993
+
+// Time allowed for peers to find each other and form bonds before traffic starts (ms)
+#define ZT_BONDSIM_WARMUP 15000
+
+// Time allowed after traffic stops for frames still in flight (ms)
+#define ZT_BONDSIM_DRAIN 3000
+
+// Width of the bins used to find the end of a failover (ms)
+#define ZT_BONDSIM_FAILOVER_BIN 50
+
+// A bin delivering less than this share of its frames is still failing over
+#define ZT_BONDSIM_FAILOVER_THRESHOLD 0.9
+
+// Offset of our own header in each UDP payload
+#define ZT_BONDSIM_IP_HEADER_LENGTH 28
+
+/**
+ * A simulated link and its failure schedule
+ */
+struct SimLink
+{
+	SimLink() : latency(10),jitter(0),loss(0.0),mbps(100.0),queue(50)
+	{
+		for(int n=0;n<2;++n) {
+			busyUntil[n] = 0;
+			lastArrival[n] = 0;
+			packets[n] = 0;
+			drops[n] = 0;
+			sock[n] = (PhySocket *)0;
+		}
+	}
+
+	double latency;  // one-way delay (ms)
+	double jitter;   // extra delay chosen uniformly in [0,jitter] (ms)
+	double loss;     // chance of a packet being lost (0..1)
+	double mbps;     // bandwidth (megabits per second)
+	double queue;    // longest queue before tail drop (ms)
+	std::vector< std::pair<double,double> > down; // outages relative to start of traffic (ms)
+
+	// Per-run state, indexed by sending node
+	int64_t busyUntil[2]; // (us)
+	int64_t lastArrival[2]; // (us) jitter does not reorder packets on one link
+	uint64_t packets[2];
+	uint64_t drops[2];
+	PhySocket *sock[2];
+	InetAddress addr[2];
+
+	inline bool isDown(const double t) const
+	{
+		for(std::vector< std::pair<double,double> >::const_iterator d(down.begin());d!=down.end();++d) {
+			if ((t >= d->first)&&(t < d->second))
+				return true;
+		}
+		return false;
+	}
+};
+
+/**
+ * A packet on a simulated link
+ */
+struct SimPacket
+{
+	int64_t at;     // delivery time (us)
+	uint64_t order; // tie breaker so equal times keep their send order
+	int to;         // receiving node
+	unsigned int link;
+	std::string data;
+};
+
+struct SimPacketLater
+{
+	inline bool operator()(const SimPacket *a,const SimPacket *b) const
+	{
+		return ((a->at > b->at)||((a->at == b->at)&&(a->order > b->order)));
+	}
+};
+
+/**
+ * Results of one policy's run
+ */
+struct SimResult
+{
+	std::string policy;
+	bool bonded;
+	uint64_t sent;
+	uint64_t delivered;
+	uint64_t reordered;
+	uint64_t wirePackets;
+	double goodput;     // Mbit/s
+	double failover;    // ms
+	double latency50;   // ms
+	double latency99;   // ms
+	double cpuPerPacket; // us
+	std::vector<uint64_t> linkPackets;
+};
+
+struct SimPhyHandlers
+{
+	inline void phyOnDatagram(PhySocket *sock,void **uptr,const struct sockaddr *localAddr,const struct sockaddr *from,void *data,unsigned long len) {}
+	inline void phyOnTcpConnect(PhySocket *sock,void **uptr,bool success) {}
+	inline void phyOnTcpAccept(PhySocket *sockL,PhySocket *sockN,void **uptrL,void **uptrN,const struct sockaddr *from) {}
+	inline void phyOnTcpClose(PhySocket *sock,void **uptr) {}
+	inline void phyOnTcpData(PhySocket *sock,void **uptr,void *data,unsigned long len) {}
+	inline void phyOnTcpWritable(PhySocket *sock,void **uptr) {}
+#ifdef __UNIX_LIKE__
+	inline void phyOnUnixAccept(PhySocket *sockL,PhySocket *sockN,void **uptrL,void **uptrN) {}
+	inline void phyOnUnixClose(PhySocket *sock,void **uptr) {}
+	inline void phyOnUnixData(PhySocket *sock,void **uptr,void *data,unsigned long len) {}
+	inline void phyOnUnixWritable(PhySocket *sock,void **uptr) {}
+#endif // __UNIX_LIKE__
+	inline void phyOnFileDescriptorActivity(PhySocket *sock,void **uptr,bool readable,bool writable) {}
+};
+
+class Simulation;
+
+/**
+ * One of the two simulated nodes
+ */
+struct SimNode
+{
+	Simulation *sim;
+	int index;
+	Node *node;
+	int64_t deadline; // next background task deadline (ms)
+	std::map< std::pair<int,uint64_t>,std::string > state;
+};
+
+static void SnodeStatePutFunction(ZT_Node *node,void *uptr,void *tptr,enum ZT_StateObjectType type,const uint64_t id[2],const void *data,int len);
+static int SnodeStateGetFunction(ZT_Node *node,void *uptr,void *tptr,enum ZT_StateObjectType type,const uint64_t id[2],void *data,unsigned int maxlen);
+static int SnodeWirePacketSendFunction(ZT_Node *node,void *uptr,void *tptr,int64_t localSocket,const struct sockaddr_storage *addr,const void *data,unsigned int len,unsigned int ttl);
+static void SnodeVirtualNetworkFrameFunction(ZT_Node *node,void *uptr,void *tptr,uint64_t nwid,void **nuptr,uint64_t sourceMac,uint64_t destMac,unsigned int etherType,unsigned int vlanId,const void *data,unsigned int len);
+static int SnodeVirtualNetworkConfigFunction(ZT_Node *node,void *uptr,void *tptr,uint64_t nwid,void **nuptr,enum ZT_VirtualNetworkConfigOperation op,const ZT_VirtualNetworkConfig *nwconf);
+static void SnodeEventCallback(ZT_Node *node,void *uptr,void *tptr,enum ZT_Event event,const void *metaData);
+
+/**
+ * Runs two nodes over a set of links for one bonding policy
+ */
+class Simulation
+{
+public:
+	Simulation(const std::vector<SimLink> &links,const std::vector<PhySocket *> &socks,const Identity ids[2],const std::string &planet,uint64_t seed) :
+		_links(links),
+		_now(0),
+		_order(0),
+		_rng(seed ? seed : 1),
+		_trafficStart(0),
+		_recording(false),
+		_wirePackets(0)
+	{
+		for(int n=0;n<2;++n) {
+			_nodes[n].sim = this;
+			_nodes[n].index = n;
+			_nodes[n].node = (Node *)0;
+			_nodes[n].deadline = 0;
+			char tmp[1024];
+			_nodes[n].state[std::pair<int,uint64_t>((int)ZT_STATE_OBJECT_IDENTITY_SECRET,0)] = ids[n].toString(true,tmp);
+			_nodes[n].state[std::pair<int,uint64_t>((int)ZT_STATE_OBJECT_PLANET,0)] = planet;
+		}
+		for(unsigned int i=0;i<(unsigned int)_links.size();++i) {
+			for(int n=0;n<2;++n) {
+				_links[i].busyUntil[n] = 0;
+				_links[i].lastArrival[n] = 0;
+				_links[i].packets[n] = 0;
+				_links[i].drops[n] = 0;
+				_links[i].sock[n] = socks[(i * 2) + n];
+				_links[i].addr[n].fromString(_addrString(i,n).c_str());
+			}
+		}
+	}
+
+	~Simulation()
+	{
+		while (!_wire.empty()) {
+			delete _wire.top();
+			_wire.pop();
+		}
+		for(int n=0;n<2;++n)
+			delete _nodes[n].node;
+	}
+
+	/**
+	 * Run one policy
+	 *
+	 * @param policy Bonding policy code
+	 * @param duration Traffic duration (ms)
+	 * @param mbps Offered load (Mbit/s)
+	 * @param flows Number of UDP flows
+	 * @param frameSize Size of each IPv4 frame in bytes
+	 * @param resequence Enable resequencing on the sender's bond
+	 * @param fec Enable parity on the sender's bond
+	 * @param probe Enable capacity probing on the sender's bond
+	 * @param liveness Liveness interval on the sender's bond, 0 to disable (ms)
+	 * @param pace Enable pacing on the sender's bond
+	 * @param burst Number of frames sent back to back at a time
+	 */
+	SimResult run(uint8_t policy,int64_t duration,double mbps,unsigned int flows,unsigned int frameSize,bool resequence,bool fec,bool probe,int liveness,bool pace,unsigned int burst)
+	{
+		SimResult r;
+		r.policy = BondController::getPolicyStrByCode(policy);
+		r.bonded = false;
+
+		ZT_Node_Callbacks cb;
+		memset(&cb,0,sizeof(cb));
+		cb.version = 0;
+		cb.statePutFunction = SnodeStatePutFunction;
+		cb.stateGetFunction = SnodeStateGetFunction;
+		cb.wirePacketSendFunction = SnodeWirePacketSendFunction;
+		cb.virtualNetworkFrameFunction = SnodeVirtualNetworkFrameFunction;
+		cb.virtualNetworkConfigFunction = SnodeVirtualNetworkConfigFunction;
+		cb.eventCallback = SnodeEventCallback;
+
+		_now = 1000000000; // arbitrary but far from zero, since some timers treat zero as never
+		for(int n=0;n<2;++n) {
+			_nodes[n].node = new Node(&(_nodes[n]),(void *)0,&cb,_ms());
+			_nodes[n].node->bondController()->setBondingLayerDefaultPolicy(policy);
+			_nodes[n].deadline = _ms();
+		}
+		for(int n=0;n<2;++n)
+			_join(n);
+
+		// Let the nodes find each other over every link and form bonds
+		_runUntil(_now + ((int64_t)ZT_BONDSIM_WARMUP * 1000));
+
+		const Address b(_nodes[1].node->address());
+		SharedPtr<Bond> bond(_nodes[0].node->bondController()->getBondByPeerId((int64_t)b.toInt()));
+		if (bond) {
+			r.bonded = true;
+			bond->setResequencing(resequence);
+			bond->setFec(fec);
+			bond->setCapacityProbing(probe);
+			bond->setLiveness(liveness,ZT_BOND_LIVENESS_DEFAULT_MULTIPLIER);
+			bond->setPacing(pace);
+		}
+
+		// Generate traffic
+		const MAC from(_nodes[0].node->identity().address(),ZT_BONDSIM_NETWORK_ID);
+		const MAC to(b,ZT_BONDSIM_NETWORK_ID);
+		const int64_t interval = std::max((int64_t)1,(int64_t)(((double)frameSize * 8.0) / mbps));
+		const uint64_t frames = (uint64_t)((duration * 1000) / interval);
+		_sentAt.assign(frames,0);
+		_receivedAt.assign(frames,-1);
+		_flowHighest.assign(flows,-1);
+		_reordered = 0;
+		_delivered = 0;
+		_latencies.clear();
+		for(unsigned int i=0;i<(unsigned int)_links.size();++i)
+			_links[i].packets[0] = 0;
+		_wirePackets = 0;
+		_trafficStart = _now;
+		_recording = true;
+
+		std::vector<uint8_t> frame(std::max(frameSize,(unsigned int)(ZT_BONDSIM_IP_HEADER_LENGTH + 16)),0);
+		const clock_t cpuStart = clock();
+		for(uint64_t k=0;k<frames;++k) {
+			_runUntil(_trafficStart + ((int64_t)(k - (k % burst)) * interval));
+			const unsigned int flow = (unsigned int)(k % flows);
+			const int32_t flowSeq = (int32_t)(k / flows);
+			_buildFrame(frame,flow,flowSeq,(uint32_t)k);
+			_sentAt[k] = _now;
+			_nodes[0].node->processVirtualNetworkFrame((void *)0,_ms(),ZT_BONDSIM_NETWORK_ID,from.toInt(),to.toInt(),ZT_ETHERTYPE_IPV4,0,frame.data(),(unsigned int)frame.size(),&(_nodes[0].deadline));
+		}
+		_runUntil(_trafficStart + (duration * 1000) + ((int64_t)ZT_BONDSIM_DRAIN * 1000));
+		const double cpu = ((double)(clock() - cpuStart) * 1000000.0) / (double)CLOCKS_PER_SEC;
+		_recording = false;
+
+		r.sent = frames;
+		r.delivered = _delivered;
+		r.reordered = _reordered;
+		r.wirePackets = _wirePackets;
+		r.goodput = (duration > 0) ? (((double)_delivered * (double)frameSize * 8.0) / ((double)duration * 1000.0)) : 0.0;
+		r.failover = _failover(duration);
+		std::sort(_latencies.begin(),_latencies.end());
+		r.latency50 = _latencies.empty() ? 0.0 : (double)_latencies[_latencies.size() / 2] / 1000.0;
+		r.latency99 = _latencies.empty() ? 0.0 : (double)_latencies[(_latencies.size() * 99) / 100] / 1000.0;
+		r.cpuPerPacket = (_wirePackets) ? (cpu / (double)_wirePackets) : 0.0;
+		for(unsigned int i=0;i<(unsigned int)_links.size();++i)
+			r.linkPackets.push_back(_links[i].packets[0]);
+
+		while (!_wire.empty()) {
+			delete _wire.top();
+			_wire.pop();
+		}
+		for(int n=0;n<2;++n) {
+			delete _nodes[n].node;
+			_nodes[n].node = (Node *)0;
+		}
+		return r;
+	}
+
+	inline void statePut(SimNode &n,int type,const uint64_t id[2],const void *data,int len)
+	{
+		const std::pair<int,uint64_t> k(type,id[0]);
+		if (len < 0)
+			n.state.erase(k);
+		else n.state[k].assign(reinterpret_cast<const char *>(data),(unsigned long)len);
+	}
+
+	inline int stateGet(SimNode &n,int type,const uint64_t id[2],void *data,unsigned int maxlen)
+	{
+		std::map< std::pair<int,uint64_t>,std::string >::const_iterator s(n.state.find(std::pair<int,uint64_t>(type,((type == (int)ZT_STATE_OBJECT_IDENTITY_SECRET)||(type == (int)ZT_STATE_OBJECT_PLANET)) ? 0 : id[0])));
+		if ((s == n.state.end())||(s->second.length() > maxlen))
+			return -1;
+		memcpy(data,s->second.data(),s->second.length());
+		return (int)s->second.length();
+	}
+
+	/**
+	 * Put a packet from a node onto the links it would go out on
+	 *
+	 * A packet without a local socket goes out on every link, as it would from
+	 * the service through each of its bound sockets.
+	 */
+	inline int wireSend(SimNode &n,int64_t localSocket,const InetAddress &to,const void *data,unsigned int len)
+	{
+		int sent = -1;
+		for(unsigned int i=0;i<(unsigned int)_links.size();++i) {
+			SimLink &l = _links[i];
+			if (localSocket == -1) {
+				if (to.ss_family != AF_INET)
+					continue;
+			} else if ((localSocket != (int64_t)((uintptr_t)l.sock[n.index]))||(!to.ipsEqual(l.addr[n.index ^ 1]))) {
+				continue;
+			}
+			_transmit(n.index,i,data,len);
+			sent = 0;
+		}
+		return sent;
+	}
+
+	inline void frameReceived(SimNode &n,const void *data,unsigned int len)
+	{
+		if ((n.index != 1)||(!_recording)||(len < (ZT_BONDSIM_IP_HEADER_LENGTH + 16)))
+			return;
+		const uint8_t *p = reinterpret_cast<const uint8_t *>(data) + ZT_BONDSIM_IP_HEADER_LENGTH;
+		const uint32_t magic = Utils::ntoh(*reinterpret_cast<const uint32_t *>(p));
+		const uint32_t flow = Utils::ntoh(*reinterpret_cast<const uint32_t *>(p + 4));
+		const int32_t flowSeq = (int32_t)Utils::ntoh(*reinterpret_cast<const uint32_t *>(p + 8));
+		const uint32_t k = Utils::ntoh(*reinterpret_cast<const uint32_t *>(p + 12));
+		if ((magic != 0x62736d31)||(k >= _receivedAt.size())||(flow >= _flowHighest.size())||(_receivedAt[k] >= 0))
+			return;
+		_receivedAt[k] = _now;
+		++_delivered;
+		_latencies.push_back(_now - _sentAt[k]);
+		if (flowSeq < _flowHighest[flow])
+			++_reordered;
+		else _flowHighest[flow] = flowSeq;
+	}
+
+private:
+	inline int64_t _ms() const { return _now / 1000; }
+
+	inline double _random()
+	{
+		// xorshift64*
+		_rng ^= _rng >> 12;
+		_rng ^= _rng << 25;
+		_rng ^= _rng >> 27;
+		return (double)((_rng * 0x2545f4914f6cdd1dULL) >> 11) / 9007199254740992.0;
+	}
+
+	static inline std::string _addrString(unsigned int link,int n)
+	{
+		char tmp[64];
+		OSUtils::ztsnprintf(tmp,sizeof(tmp),"10.%u.0.%d/%d",link,n + 1,ZT_BONDSIM_PORT);
+		return std::string(tmp);
+	}
+
+	inline void _transmit(int from,unsigned int link,const void *data,unsigned int len)
+	{
+		SimLink &l = _links[link];
+		++_wirePackets;
+		const double t = (double)(_now - _trafficStart) / 1000.0;
+		if ((_recording)&&(l.isDown(t))) {
+			++l.drops[from];
+			return;
+		}
+		const int64_t start = std::max(_now,l.busyUntil[from]);
+		if ((double)(start - _now) > (l.queue * 1000.0)) {
+			++l.drops[from];
+			return;
+		}
+		l.busyUntil[from] = start + (int64_t)(((double)len * 8.0) / l.mbps);
+		++l.packets[from];
+		if (_random() < l.loss) {
+			++l.drops[from];
+			return;
+		}
+		SimPacket *p = new SimPacket();
+		p->at = std::max(l.lastArrival[from],l.busyUntil[from] + (int64_t)((l.latency + (l.jitter * _random())) * 1000.0));
+		l.lastArrival[from] = p->at;
+		p->order = _order++;
+		p->to = from ^ 1;
+		p->link = link;
+		p->data.assign(reinterpret_cast<const char *>(data),len);
+		_wire.push(p);
+	}
+
+	// Advance virtual time to t, delivering packets and running background tasks as they come due
+	inline void _runUntil(const int64_t t)
+	{
+		for(;;) {
+			int64_t next = t;
+			int which = -1;
+			for(int n=0;n<2;++n) {
+				const int64_t d = _nodes[n].deadline * 1000;
+				if (d < next) {
+					next = d;
+					which = n;
+				}
+			}
+			if ((!_wire.empty())&&(_wire.top()->at <= next)) {
+				SimPacket *p = _wire.top();
+				_wire.pop();
+				_now = std::max(_now,p->at);
+				const SimLink &l = _links[p->link];
+				_nodes[p->to].node->processWirePacket((void *)0,_ms(),(int64_t)((uintptr_t)l.sock[p->to]),reinterpret_cast<const struct sockaddr_storage *>(&(l.addr[p->to ^ 1])),p->data.data(),(unsigned int)p->data.length(),&(_nodes[p->to].deadline));
+				delete p;
+			} else if (which >= 0) {
+				_now = std::max(_now,next);
+				_nodes[which].node->processBackgroundTasks((void *)0,_ms(),&(_nodes[which].deadline));
+				if ((_nodes[which].deadline * 1000) <= _now)
+					_nodes[which].deadline = _ms() + 1;
+			} else {
+				_now = std::max(_now,t);
+				return;
+			}
+		}
+	}
+
+	// Join the simulated network and give it a configuration as if a controller had sent one
+	inline void _join(const int n)
+	{
+		Node *const node = _nodes[n].node;
+		node->join(ZT_BONDSIM_NETWORK_ID,(void *)0,(void *)0);
+		SharedPtr<Network> network(node->network(ZT_BONDSIM_NETWORK_ID));
+		if (!network)
+			return;
+		NetworkConfig *const nc = new NetworkConfig();
+		nc->networkId = ZT_BONDSIM_NETWORK_ID;
+		nc->timestamp = _ms();
+		nc->credentialTimeMaxDelta = ZT_NETWORKCONFIG_DEFAULT_CREDENTIAL_TIME_MAX_MAX_DELTA;
+		nc->revision = 1;
+		nc->issuedTo = node->identity().address();
+		nc->flags = ZT_NETWORKCONFIG_FLAG_ENABLE_BROADCAST;
+		nc->mtu = ZT_DEFAULT_MTU;
+		nc->multicastLimit = 32;
+		nc->type = ZT_NETWORK_TYPE_PUBLIC;
+		Utils::scopy(nc->name,sizeof(nc->name),"bondsim");
+		nc->ruleCount = 1;
+		nc->rules[0].t = ZT_NETWORK_RULE_ACTION_ACCEPT;
+		network->setConfiguration((void *)0,*nc,false);
+		delete nc;
+	}
+
+	inline void _buildFrame(std::vector<uint8_t> &frame,const unsigned int flow,const int32_t flowSeq,const uint32_t k) const
+	{
+		uint8_t *const f = frame.data();
+		const unsigned int len = (unsigned int)frame.size();
+		memset(f,0,ZT_BONDSIM_IP_HEADER_LENGTH);
+		f[0] = 0x45;
+		f[2] = (uint8_t)(len >> 8);
+		f[3] = (uint8_t)len;
+		f[8] = 64;   // TTL
+		f[9] = 0x11; // UDP
+		f[12] = 10; f[13] = 255; f[14] = 0; f[15] = 1;
+		f[16] = 10; f[17] = 255; f[18] = 0; f[19] = 2;
+		const uint16_t srcPort = (uint16_t)(10000 + flow);
+		const uint16_t dstPort = 5201;
+		f[20] = (uint8_t)(srcPort >> 8); f[21] = (uint8_t)srcPort;
+		f[22] = (uint8_t)(dstPort >> 8); f[23] = (uint8_t)dstPort;
+		f[24] = (uint8_t)((len - 20) >> 8); f[25] = (uint8_t)(len - 20);
+		uint8_t *const p = f + ZT_BONDSIM_IP_HEADER_LENGTH;
+		const uint32_t h[4] = { Utils::hton((uint32_t)0x62736d31),Utils::hton((uint32_t)flow),Utils::hton((uint32_t)flowSeq),Utils::hton(k) };
+		memcpy(p,h,sizeof(h));
+	}
+
+	// Longest time after a link went down during which frames sent were not reliably delivered (ms)
+	inline double _failover(const int64_t duration) const
+	{
+		double worst = 0.0;
+		for(unsigned int i=0;i<(unsigned int)_links.size();++i) {
+			for(std::vector< std::pair<double,double> >::const_iterator d(_links[i].down.begin());d!=_links[i].down.end();++d) {
+				if (d->first >= (double)duration)
+					continue;
+				const int64_t start = _trafficStart + (int64_t)(d->first * 1000.0);
+				const int64_t end = _trafficStart + (int64_t)(std::min(d->second,(double)duration) * 1000.0);
+				int64_t lastBad = -1;
+				for(int64_t bin=start;bin<end;bin+=ZT_BONDSIM_FAILOVER_BIN * 1000) {
+					uint64_t sent = 0,ok = 0;
+					for(uint64_t k=0;k<_sentAt.size();++k) {
+						if ((_sentAt[k] >= bin)&&(_sentAt[k] < (bin + (ZT_BONDSIM_FAILOVER_BIN * 1000)))) {
+							++sent;
+							if (_receivedAt[k] >= 0)
+								++ok;
+						}
+					}
+					if ((sent)&&((double)ok < ((double)sent * ZT_BONDSIM_FAILOVER_THRESHOLD)))
+						lastBad = bin + (ZT_BONDSIM_FAILOVER_BIN * 1000);
+				}
+				if (lastBad >= 0)
+					worst = std::max(worst,(double)(lastBad - start) / 1000.0);
+			}
+		}
+		return worst;
+	}
+
+	std::vector<SimLink> _links;
+	SimNode _nodes[2];
+	std::priority_queue< SimPacket *,std::vector<SimPacket *>,SimPacketLater > _wire;
+	int64_t _now; // virtual time (us)
+	uint64_t _order;
+	uint64_t _rng;
+
+	int64_t _trafficStart;
+	bool _recording;
+	uint64_t _wirePackets;
+	std::vector<int64_t> _sentAt;
+	std::vector<int64_t> _receivedAt;
+	std::vector<int32_t> _flowHighest;
+	std::vector<int64_t> _latencies;
+	uint64_t _delivered;
+	uint64_t _reordered;
+};
+
+static void SnodeStatePutFunction(ZT_Node *node,void *uptr,void *tptr,enum ZT_StateObjectType type,const uint64_t id[2],const void *data,int len)
+{
+	SimNode *const n = reinterpret_cast<SimNode *>(uptr);
+	n->sim->statePut(*n,(int)type,id,data,len);
+}
+
+static int SnodeStateGetFunction(ZT_Node *node,void *uptr,void *tptr,enum ZT_StateObjectType type,const uint64_t id[2],void *data,unsigned int maxlen)
+{
+	SimNode *const n = reinterpret_cast<SimNode *>(uptr);
+	return n->sim->stateGet(*n,(int)type,id,data,maxlen);
+}
+
+static int SnodeWirePacketSendFunction(ZT_Node *node,void *uptr,void *tptr,int64_t localSocket,const struct sockaddr_storage *addr,const void *data,unsigned int len,unsigned int ttl)
+{
+	SimNode *const n = reinterpret_cast<SimNode *>(uptr);
+	return n->sim->wireSend(*n,localSocket,*(reinterpret_cast<const InetAddress *>(addr)),data,len);
+}
+
+static void SnodeVirtualNetworkFrameFunction(ZT_Node *node,void *uptr,void *tptr,uint64_t nwid,void **nuptr,uint64_t sourceMac,uint64_t destMac,unsigned int etherType,unsigned int vlanId,const void *data,unsigned int len)
+{
+	SimNode *const n = reinterpret_cast<SimNode *>(uptr);
+	if (etherType == ZT_ETHERTYPE_IPV4)
+		n->sim->frameReceived(*n,data,len);
+}
+
+static int SnodeVirtualNetworkConfigFunction(ZT_Node *node,void *uptr,void *tptr,uint64_t nwid,void **nuptr,enum ZT_VirtualNetworkConfigOperation op,const ZT_VirtualNetworkConfig *nwconf)
+{
+	return 0;
+}
+
+static void SnodeEventCallback(ZT_Node *node,void *uptr,void *tptr,enum ZT_Event event,const void *metaData)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+static void printHelp(const char *cn)
+{
+	printf("Usage: %s [-options]" ZT_EOL_S,cn);
+	printf(ZT_EOL_S "Options:" ZT_EOL_S);
+	printf("  -h                - Display this help" ZT_EOL_S);
+	printf("  -l <link>         - Add a link (repeat for each link, default: 10/1/0/100/10-15 30/5/0.5/50)" ZT_EOL_S);
+	printf("                      latency ms/jitter ms/loss %%/Mbit/s[/down s-up s[,...]]" ZT_EOL_S);
+	printf("  -p <policy>       - Simulate a policy (repeatable, default: active-backup balance-xor balance-aware balance-rr)" ZT_EOL_S);
+	printf("  -t <seconds>      - Traffic duration (default: 30)" ZT_EOL_S);
+	printf("  -r <Mbit/s>       - Offered load (default: 20)" ZT_EOL_S);
+	printf("  -f <flows>        - Number of UDP flows (default: 8)" ZT_EOL_S);
+	printf("  -s <bytes>        - Frame size (default: 1200)" ZT_EOL_S);
+	printf("  -S <seed>         - Random seed (default: 1)" ZT_EOL_S);
+	printf("  -R                - Resequence striped frames on the receiving bond" ZT_EOL_S);
+	printf("  -F                - Protect frames with parity" ZT_EOL_S);
+	printf("  -C                - Probe link capacity for allocation" ZT_EOL_S);
+	printf("  -L <ms>           - Monitor link liveness at this interval (default: off)" ZT_EOL_S);
+	printf("  -P                - Pace frames onto links at their probed capacity (use with -C)" ZT_EOL_S);
+	printf("  -b <frames>       - Send frames in back to back bursts of this many (default: 1)" ZT_EOL_S);
+}
+
+static bool parseLink(const char *s,SimLink &l)
+{
+	std::vector<std::string> f(OSUtils::split(s,"/","",""));
+	if (f.size() < 4)
+		return false;
+	l.latency = strtod(f[0].c_str(),(char **)0);
+	l.jitter = strtod(f[1].c_str(),(char **)0);
+	l.loss = strtod(f[2].c_str(),(char **)0) / 100.0;
+	l.mbps = strtod(f[3].c_str(),(char **)0);
+	if ((l.latency < 0.0)||(l.jitter < 0.0)||(l.loss < 0.0)||(l.loss > 1.0)||(l.mbps <= 0.0))
+		return false;
+	if (f.size() > 4) {
+		std::vector<std::string> outages(OSUtils::split(f[4].c_str(),",","",""));
+		for(std::vector<std::string>::const_iterator o(outages.begin());o!=outages.end();++o) {
+			std::vector<std::string> t(OSUtils::split(o->c_str(),"-","",""));
+			if (t.size() != 2)
+				return false;
+			const double down = strtod(t[0].c_str(),(char **)0) * 1000.0;
+			const double up = strtod(t[1].c_str(),(char **)0) * 1000.0;
+			if ((down < 0.0)||(up <= down))
+				return false;
+			l.down.push_back(std::pair<double,double>(down,up));
+		}
+	}
+	return true;
+}
+
+#ifdef __WINDOWS__
+int __cdecl _tmain(int argc, _TCHAR* argv[])
+#else
+int main(int argc,char **argv)
+#endif
+{
+#ifdef __WINDOWS__
+	WSADATA wsaData;
+	WSAStartup(MAKEWORD(2,2),&wsaData);
+#endif
+
+	std::vector<SimLink> links;
+	std::vector<uint8_t> policies;
+	int64_t duration = 30000;
+	double mbps = 20.0;
+	unsigned int flows = 8;
+	unsigned int frameSize = 1200;
+	uint64_t seed = 1;
+	bool resequence = false;
+	bool fec = false;
+	bool probe = false;
+	int liveness = 0;
+	bool pace = false;
+	unsigned int burst = 1;
+
+	for(int i=1;i<argc;++i) {
+		const std::string a(argv[i]);
+		const bool hasArg = ((i + 1) < argc);
+		if ((a == "-l")&&(hasArg)) {
+			SimLink l;
+			if (!parseLink(argv[++i],l)) {
+				fprintf(stderr,"%s: invalid link: %s" ZT_EOL_S,argv[0],argv[i]);
+				return 1;
+			}
+			links.push_back(l);
+		} else if ((a == "-p")&&(hasArg)) {
+			const int p = BondController::getPolicyCodeByStr(argv[++i]);
+			if (p == ZT_BONDING_POLICY_NONE) {
+				fprintf(stderr,"%s: unknown policy: %s" ZT_EOL_S,argv[0],argv[i]);
+				return 1;
+			}
+			policies.push_back((uint8_t)p);
+		} else if ((a == "-t")&&(hasArg)) {
+			duration = (int64_t)(strtod(argv[++i],(char **)0) * 1000.0);
+		} else if ((a == "-r")&&(hasArg)) {
+			mbps = strtod(argv[++i],(char **)0);
+		} else if ((a == "-f")&&(hasArg)) {
+			flows = (unsigned int)Utils::strToUInt(argv[++i]);
+		} else if ((a == "-s")&&(hasArg)) {
+			frameSize = (unsigned int)Utils::strToUInt(argv[++i]);
+		} else if ((a == "-S")&&(hasArg)) {
+			seed = Utils::strToU64(argv[++i]);
+		} else if (a == "-R") {
+			resequence = true;
+		} else if (a == "-F") {
+			fec = true;
+		} else if (a == "-C") {
+			probe = true;
+		} else if ((a == "-L")&&(hasArg)) {
+			liveness = (int)strtol(argv[++i],(char **)0,10);
+		} else if (a == "-P") {
+			pace = true;
+		} else if ((a == "-b")&&(hasArg)) {
+			burst = std::max((unsigned int)Utils::strToUInt(argv[++i]),1U);
+		} else {
+			printHelp(argv[0]);
+			return ((a == "-h") ? 0 : 1);
+		}
+	}
+
+	if (links.empty()) {
+		SimLink l;
+		parseLink("10/1/0/100/10-15",l);
+		links.push_back(l);
+		l = SimLink();
+		parseLink("30/5/0.5/50",l);
+		links.push_back(l);
+	}
+	if (policies.empty()) {
+		policies.push_back(ZT_BONDING_POLICY_ACTIVE_BACKUP);
+		policies.push_back(ZT_BONDING_POLICY_BALANCE_XOR);
+		policies.push_back(ZT_BONDING_POLICY_BALANCE_AWARE);
+		policies.push_back(ZT_BONDING_POLICY_BALANCE_RR);
+	}
+	if ((duration <= 0)||(mbps <= 0.0)||(flows == 0)||(frameSize < (ZT_BONDSIM_IP_HEADER_LENGTH + 16))||(frameSize > ZT_MAX_MTU)||(links.size() > 250)) {
+		printHelp(argv[0]);
+		return 1;
+	}
+
+	// The bonding layer names links by the interface of their local socket, so
+	// each end of each link gets a real (but unused) socket with its own name.
+	SimPhyHandlers handlers;
+	Phy<SimPhyHandlers *> phy(&handlers,false,true);
+	std::vector<PhySocket *> socks;
+	for(unsigned int i=0;i<(unsigned int)links.size();++i) {
+		for(int n=0;n<2;++n) {
+			InetAddress bindAddr("127.0.0.1/0");
+			PhySocket *s = phy.udpBind(reinterpret_cast<const struct sockaddr *>(&bindAddr));
+			if (!s) {
+				fprintf(stderr,"%s: unable to create socket for link %u" ZT_EOL_S,argv[0],i);
+				return 1;
+			}
+			char ifname[16];
+			memset(ifname,0,sizeof(ifname));
+			OSUtils::ztsnprintf(ifname,sizeof(ifname),"sim%u",i);
+			phy.setIfName(s,ifname,sizeof(ifname));
+			socks.push_back(s);
+		}
+	}
+
+	printf("Generating identities..." ZT_EOL_S);
+	Identity ids[2];
+	for(int n=0;n<2;++n)
+		ids[n].generate();
+
+	// A private planet with node B as its only root, reachable at its end of every link
+	std::string planet;
+	{
+		World::Root root;
+		root.identity = ids[1];
+		for(unsigned int i=0;i<(unsigned int)links.size();++i) {
+			char tmp[64];
+			OSUtils::ztsnprintf(tmp,sizeof(tmp),"10.%u.0.2/%d",i,ZT_BONDSIM_PORT);
+			root.stableEndpoints.push_back(InetAddress(tmp));
+		}
+		std::vector<World::Root> roots;
+		roots.push_back(root);
+		const C25519::Pair signingKey(C25519::generate());
+		const World w(World::make(World::TYPE_PLANET,ZT_BONDSIM_PLANET_ID,1,signingKey.pub,roots,signingKey));
+		Buffer<ZT_WORLD_MAX_SERIALIZED_LENGTH> tmp;
+		w.serialize(tmp,false);
+		planet.assign(reinterpret_cast<const char *>(tmp.data()),tmp.size());
+	}
+
+	printf("Links:" ZT_EOL_S);
+	for(unsigned int i=0;i<(unsigned int)links.size();++i) {
+		printf("  sim%u: %.1fms +%.1fms jitter, %.2f%% loss, %.1f Mbit/s",i,links[i].latency,links[i].jitter,links[i].loss * 100.0,links[i].mbps);
+		for(std::vector< std::pair<double,double> >::const_iterator d(links[i].down.begin());d!=links[i].down.end();++d)
+			printf(", down %.1fs-%.1fs",d->first / 1000.0,d->second / 1000.0);
+		printf(ZT_EOL_S);
+	}
+	printf("Traffic: %.1f Mbit/s for %.1fs over %u flows of %u byte frames%s%s%s",mbps,(double)duration / 1000.0,flows,frameSize,resequence ? ", resequenced" : "",fec ? ", with parity" : "",probe ? ", probing capacity" : "");
+	if (liveness > 0)
+		printf(", liveness every %dms",liveness);
+	if (burst > 1)
+		printf(", in bursts of %u",burst);
+	if (pace)
+		printf(", paced");
+	printf(ZT_EOL_S ZT_EOL_S);
+
+	printf("%-14s %10s %9s %9s %10s %9s %9s %10s  %s" ZT_EOL_S,"policy","goodput","delivered","reordered","failover","lat p50","lat p99","cpu/pkt","link share");
+	for(std::vector<uint8_t>::const_iterator p(policies.begin());p!=policies.end();++p) {
+		Simulation sim(links,socks,ids,planet,seed);
+		const SimResult r(sim.run(*p,duration,mbps,flows,frameSize,resequence,fec,probe,liveness,pace,burst));
+		if (!r.bonded) {
+			printf("%-14s (no bond formed)" ZT_EOL_S,r.policy.c_str());
+			continue;
+		}
+		uint64_t total = 0;
+		for(unsigned int i=0;i<(unsigned int)r.linkPackets.size();++i)
+			total += r.linkPackets[i];
+		printf("%-14s %5.2fMbit/s %8.2f%% %8.2f%% %8.0fms %7.1fms %7.1fms %8.1fus ",
+			r.policy.c_str(),
+			r.goodput,
+			(r.sent) ? (((double)r.delivered * 100.0) / (double)r.sent) : 0.0,
+			(r.delivered) ? (((double)r.reordered * 100.0) / (double)r.delivered) : 0.0,
+			r.failover,
+			r.latency50,
+			r.latency99,
+			r.cpuPerPacket);
+		for(unsigned int i=0;i<(unsigned int)r.linkPackets.size();++i)
+			printf(" %.0f%%",(total) ? (((double)r.linkPackets[i] * 100.0) / (double)total) : 0.0);
+		printf(ZT_EOL_S);
+	}
+
+	return 0;
+}
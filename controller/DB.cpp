@@ -22,6 +22,54 @@ using json = nlohmann::json;
 
 namespace ZeroTier {
 
+static void _allocateIpv4(std::map<uint32_t,uint32_t> &ranges,const uint32_t ip)
+{
+	auto next = ranges.upper_bound(ip);
+	if (next != ranges.begin()) {
+		auto prev = next;
+		--prev;
+		if (prev->second >= ip)
+			return;
+		if ((prev->second + 1) == ip) {
+			prev->second = ip;
+			if ((next != ranges.end())&&(next->first == (ip + 1))) {
+				prev->second = next->second;
+				ranges.erase(next);
+			}
+			return;
+		}
+	}
+	if ((next != ranges.end())&&(next->first == (ip + 1))) {
+		const uint32_t last = next->second;
+		ranges.erase(next);
+		ranges[ip] = last;
+		return;
+	}
+	ranges[ip] = ip;
+}
+
+static void _releaseIpv4(std::map<uint32_t,uint32_t> &ranges,const uint32_t ip)
+{
+	auto r = ranges.upper_bound(ip);
+	if (r == ranges.begin())
+		return;
+	--r;
+	if (r->second < ip)
+		return;
+	const uint32_t first = r->first;
+	const uint32_t last = r->second;
+	ranges.erase(r);
+	if (first < ip)
+		ranges[first] = ip - 1;
+	if (ip < last)
+		ranges[ip + 1] = last;
+}
+
+static inline uint32_t _ipv4ToInt(const InetAddress &ip)
+{
+	return Utils::ntoh((uint32_t)(reinterpret_cast<const struct sockaddr_in *>(&ip)->sin_addr.s_addr));
+}
+
 void DB::initNetwork(nlohmann::json &network)
 {
 	if (!network.count("private")) network["private"] = true;
@@ -29,6 +77,8 @@ void DB::initNetwork(nlohmann::json &network)
 	if (!network.count("name")) network["name"] = "";
 	if (!network.count("multicastLimit")) network["multicastLimit"] = (uint64_t)32;
 	if (!network.count("enableBroadcast")) network["enableBroadcast"] = true;
+	if (!network.count("multicastTree")) network["multicastTree"] = false;
+	if (!network.count("qos")) network["qos"] = false;
 	if (!network.count("v4AssignMode")) network["v4AssignMode"] = {{"zt",false}};
 	if (!network.count("v6AssignMode")) network["v6AssignMode"] = {{"rfc4193",false},{"zt",false},{"6plane",false}};
 	if (!network.count("authTokens")) network["authTokens"] = {{}};
@@ -94,7 +144,366 @@ void DB::cleanMember(nlohmann::json &member)
 	member.erase("lastRequestMetaData");
 }
 
-DB::DB() {}
+bool DB::parseRule(json &r,ZT_VirtualNetworkRule &rule)
+{
+	if (!r.is_object())
+		return false;
+
+	const std::string t(OSUtils::jsonString(r["type"],""));
+	memset(&rule,0,sizeof(ZT_VirtualNetworkRule));
+
+	if (OSUtils::jsonBool(r["not"],false))
+		rule.t = 0x80;
+	else rule.t = 0x00;
+	if (OSUtils::jsonBool(r["or"],false))
+		rule.t |= 0x40;
+
+	bool tag = false;
+	if (t == "ACTION_DROP") {
+		rule.t |= ZT_NETWORK_RULE_ACTION_DROP;
+		return true;
+	} else if (t == "ACTION_ACCEPT") {
+		rule.t |= ZT_NETWORK_RULE_ACTION_ACCEPT;
+		return true;
+	} else if (t == "ACTION_TEE") {
+		rule.t |= ZT_NETWORK_RULE_ACTION_TEE;
+		rule.v.fwd.address = Utils::hexStrToU64(OSUtils::jsonString(r["address"],"0").c_str()) & 0xffffffffffULL;
+		rule.v.fwd.flags = (uint32_t)(OSUtils::jsonInt(r["flags"],0ULL) & 0xffffffffULL);
+		rule.v.fwd.length = (uint16_t)(OSUtils::jsonInt(r["length"],0ULL) & 0xffffULL);
+		return true;
+	} else if (t == "ACTION_WATCH") {
+		rule.t |= ZT_NETWORK_RULE_ACTION_WATCH;
+		rule.v.fwd.address = Utils::hexStrToU64(OSUtils::jsonString(r["address"],"0").c_str()) & 0xffffffffffULL;
+		rule.v.fwd.flags = (uint32_t)(OSUtils::jsonInt(r["flags"],0ULL) & 0xffffffffULL);
+		rule.v.fwd.length = (uint16_t)(OSUtils::jsonInt(r["length"],0ULL) & 0xffffULL);
+		return true;
+	} else if (t == "ACTION_REDIRECT") {
+		rule.t |= ZT_NETWORK_RULE_ACTION_REDIRECT;
+		rule.v.fwd.address = Utils::hexStrToU64(OSUtils::jsonString(r["address"],"0").c_str()) & 0xffffffffffULL;
+		rule.v.fwd.flags = (uint32_t)(OSUtils::jsonInt(r["flags"],0ULL) & 0xffffffffULL);
+		return true;
+	} else if (t == "ACTION_BREAK") {
+		rule.t |= ZT_NETWORK_RULE_ACTION_BREAK;
+		return true;
+	} else if (t == "MATCH_SOURCE_ZEROTIER_ADDRESS") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_SOURCE_ZEROTIER_ADDRESS;
+		rule.v.zt = Utils::hexStrToU64(OSUtils::jsonString(r["zt"],"0").c_str()) & 0xffffffffffULL;
+		return true;
+	} else if (t == "MATCH_DEST_ZEROTIER_ADDRESS") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_DEST_ZEROTIER_ADDRESS;
+		rule.v.zt = Utils::hexStrToU64(OSUtils::jsonString(r["zt"],"0").c_str()) & 0xffffffffffULL;
+		return true;
+	} else if (t == "MATCH_VLAN_ID") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_VLAN_ID;
+		rule.v.vlanId = (uint16_t)(OSUtils::jsonInt(r["vlanId"],0ULL) & 0xffffULL);
+		return true;
+	} else if (t == "MATCH_VLAN_PCP") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_VLAN_PCP;
+		rule.v.vlanPcp = (uint8_t)(OSUtils::jsonInt(r["vlanPcp"],0ULL) & 0xffULL);
+		return true;
+	} else if (t == "MATCH_VLAN_DEI") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_VLAN_DEI;
+		rule.v.vlanDei = (uint8_t)(OSUtils::jsonInt(r["vlanDei"],0ULL) & 0xffULL);
+		return true;
+	} else if (t == "MATCH_MAC_SOURCE") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_MAC_SOURCE;
+		const std::string mac(OSUtils::jsonString(r["mac"],"0"));
+		Utils::unhex(mac.c_str(),(unsigned int)mac.length(),rule.v.mac,6);
+		return true;
+	} else if (t == "MATCH_MAC_DEST") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_MAC_DEST;
+		const std::string mac(OSUtils::jsonString(r["mac"],"0"));
+		Utils::unhex(mac.c_str(),(unsigned int)mac.length(),rule.v.mac,6);
+		return true;
+	} else if (t == "MATCH_IPV4_SOURCE") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_IPV4_SOURCE;
+		InetAddress ip(OSUtils::jsonString(r["ip"],"0.0.0.0").c_str());
+		rule.v.ipv4.ip = reinterpret_cast<struct sockaddr_in *>(&ip)->sin_addr.s_addr;
+		rule.v.ipv4.mask = Utils::ntoh(reinterpret_cast<struct sockaddr_in *>(&ip)->sin_port) & 0xff;
+		if (rule.v.ipv4.mask > 32) rule.v.ipv4.mask = 32;
+		return true;
+	} else if (t == "MATCH_IPV4_DEST") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_IPV4_DEST;
+		InetAddress ip(OSUtils::jsonString(r["ip"],"0.0.0.0").c_str());
+		rule.v.ipv4.ip = reinterpret_cast<struct sockaddr_in *>(&ip)->sin_addr.s_addr;
+		rule.v.ipv4.mask = Utils::ntoh(reinterpret_cast<struct sockaddr_in *>(&ip)->sin_port) & 0xff;
+		if (rule.v.ipv4.mask > 32) rule.v.ipv4.mask = 32;
+		return true;
+	} else if (t == "MATCH_IPV6_SOURCE") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_IPV6_SOURCE;
+		InetAddress ip(OSUtils::jsonString(r["ip"],"::0").c_str());
+		memcpy(rule.v.ipv6.ip,reinterpret_cast<struct sockaddr_in6 *>(&ip)->sin6_addr.s6_addr,16);
+		rule.v.ipv6.mask = Utils::ntoh(reinterpret_cast<struct sockaddr_in6 *>(&ip)->sin6_port) & 0xff;
+		if (rule.v.ipv6.mask > 128) rule.v.ipv6.mask = 128;
+		return true;
+	} else if (t == "MATCH_IPV6_DEST") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_IPV6_DEST;
+		InetAddress ip(OSUtils::jsonString(r["ip"],"::0").c_str());
+		memcpy(rule.v.ipv6.ip,reinterpret_cast<struct sockaddr_in6 *>(&ip)->sin6_addr.s6_addr,16);
+		rule.v.ipv6.mask = Utils::ntoh(reinterpret_cast<struct sockaddr_in6 *>(&ip)->sin6_port) & 0xff;
+		if (rule.v.ipv6.mask > 128) rule.v.ipv6.mask = 128;
+		return true;
+	} else if (t == "MATCH_IP_TOS") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_IP_TOS;
+		rule.v.ipTos.mask = (uint8_t)(OSUtils::jsonInt(r["mask"],0ULL) & 0xffULL);
+		rule.v.ipTos.value[0] = (uint8_t)(OSUtils::jsonInt(r["start"],0ULL) & 0xffULL);
+		rule.v.ipTos.value[1] = (uint8_t)(OSUtils::jsonInt(r["end"],0ULL) & 0xffULL);
+		return true;
+	} else if (t == "MATCH_IP_PROTOCOL") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_IP_PROTOCOL;
+		rule.v.ipProtocol = (uint8_t)(OSUtils::jsonInt(r["ipProtocol"],0ULL) & 0xffULL);
+		return true;
+	} else if (t == "MATCH_ETHERTYPE") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_ETHERTYPE;
+		rule.v.etherType = (uint16_t)(OSUtils::jsonInt(r["etherType"],0ULL) & 0xffffULL);
+		return true;
+	} else if (t == "MATCH_ICMP") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_ICMP;
+		rule.v.icmp.type = (uint8_t)(OSUtils::jsonInt(r["icmpType"],0ULL) & 0xffULL);
+		json &code = r["icmpCode"];
+		if (code.is_null()) {
+			rule.v.icmp.code = 0;
+			rule.v.icmp.flags = 0x00;
+		} else {
+			rule.v.icmp.code = (uint8_t)(OSUtils::jsonInt(code,0ULL) & 0xffULL);
+			rule.v.icmp.flags = 0x01;
+		}
+		return true;
+	} else if (t == "MATCH_IP_SOURCE_PORT_RANGE") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_IP_SOURCE_PORT_RANGE;
+		rule.v.port[0] = (uint16_t)(OSUtils::jsonInt(r["start"],0ULL) & 0xffffULL);
+		rule.v.port[1] = (uint16_t)(OSUtils::jsonInt(r["end"],(uint64_t)rule.v.port[0]) & 0xffffULL);
+		return true;
+	} else if (t == "MATCH_IP_DEST_PORT_RANGE") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_IP_DEST_PORT_RANGE;
+		rule.v.port[0] = (uint16_t)(OSUtils::jsonInt(r["start"],0ULL) & 0xffffULL);
+		rule.v.port[1] = (uint16_t)(OSUtils::jsonInt(r["end"],(uint64_t)rule.v.port[0]) & 0xffffULL);
+		return true;
+	} else if (t == "MATCH_CHARACTERISTICS") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_CHARACTERISTICS;
+		if (r.count("mask")) {
+			json &v = r["mask"];
+			if (v.is_number()) {
+				rule.v.characteristics = v;
+			} else {
+				std::string tmp = v;
+				rule.v.characteristics = Utils::hexStrToU64(tmp.c_str());
+			}
+		}
+		return true;
+	} else if (t == "MATCH_FRAME_SIZE_RANGE") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_FRAME_SIZE_RANGE;
+		rule.v.frameSize[0] = (uint16_t)(OSUtils::jsonInt(r["start"],0ULL) & 0xffffULL);
+		rule.v.frameSize[1] = (uint16_t)(OSUtils::jsonInt(r["end"],(uint64_t)rule.v.frameSize[0]) & 0xffffULL);
+		return true;
+	} else if (t == "MATCH_RANDOM") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_RANDOM;
+		rule.v.randomProbability = (uint32_t)(OSUtils::jsonInt(r["probability"],0ULL) & 0xffffffffULL);
+		return true;
+	} else if (t == "MATCH_TAGS_DIFFERENCE") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_TAGS_DIFFERENCE;
+		tag = true;
+	} else if (t == "MATCH_TAGS_BITWISE_AND") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_TAGS_BITWISE_AND;
+		tag = true;
+	} else if (t == "MATCH_TAGS_BITWISE_OR") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_TAGS_BITWISE_OR;
+		tag = true;
+	} else if (t == "MATCH_TAGS_BITWISE_XOR") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_TAGS_BITWISE_XOR;
+		tag = true;
+	} else if (t == "MATCH_TAGS_EQUAL") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_TAGS_EQUAL;
+		tag = true;
+	} else if (t == "MATCH_TAG_SENDER") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_TAG_SENDER;
+		tag = true;
+	} else if (t == "MATCH_TAG_RECEIVER") {
+		rule.t |= ZT_NETWORK_RULE_MATCH_TAG_RECEIVER;
+		tag = true;
+	} else if (t == "INTEGER_RANGE") {
+		json &s = r["start"];
+		if (s.is_string()) {
+			std::string tmp = s;
+			rule.v.intRange.start = Utils::hexStrToU64(tmp.c_str());
+		} else {
+			rule.v.intRange.start = OSUtils::jsonInt(s,0ULL);
+		}
+		json &e = r["end"];
+		if (e.is_string()) {
+			std::string tmp = e;
+			rule.v.intRange.end = (uint32_t)(Utils::hexStrToU64(tmp.c_str()) - rule.v.intRange.start);
+		} else {
+			rule.v.intRange.end = (uint32_t)(OSUtils::jsonInt(e,0ULL) - rule.v.intRange.start);
+		}
+		rule.v.intRange.idx = (uint16_t)OSUtils::jsonInt(r["idx"],0ULL);
+		rule.v.intRange.format = (OSUtils::jsonBool(r["little"],false)) ? 0x80 : 0x00;
+		rule.v.intRange.format |= (uint8_t)((OSUtils::jsonInt(r["bits"],1ULL) - 1) & 63);
+	}
+
+	if (tag) {
+		rule.v.tag.id = (uint32_t)(OSUtils::jsonInt(r["id"],0ULL) & 0xffffffffULL);
+		rule.v.tag.value = (uint32_t)(OSUtils::jsonInt(r["value"],0ULL) & 0xffffffffULL);
+		return true;
+	}
+
+	return false;
+}
+
+std::shared_ptr<const DB::NetworkTemplate> DB::compileNetwork(const nlohmann::json &networkJson)
+{
+	json network(networkJson); // lookups below may add empty keys, so work on a copy
+	std::shared_ptr<NetworkTemplate> nt(new NetworkTemplate());
+
+	nt->networkId = Utils::hexStrToU64(OSUtils::jsonString(network["id"],"0").c_str());
+	nt->type = OSUtils::jsonBool(network["private"],true) ? ZT_NETWORK_TYPE_PRIVATE : ZT_NETWORK_TYPE_PUBLIC;
+	nt->revision = OSUtils::jsonInt(network["revision"],0ULL);
+	if (OSUtils::jsonBool(network["enableBroadcast"],true)) nt->flags |= ZT_NETWORKCONFIG_FLAG_ENABLE_BROADCAST;
+	if (OSUtils::jsonBool(network["multicastTree"],false)) nt->flags |= ZT_NETWORKCONFIG_FLAG_MULTICAST_TREE;
+	if (OSUtils::jsonBool(network["qos"],false)) nt->flags |= ZT_NETWORKCONFIG_FLAG_QOS;
+	nt->name = OSUtils::jsonString(network["name"],"").substr(0,ZT_MAX_NETWORK_SHORT_NAME_LENGTH);
+	nt->mtu = std::max(std::min((unsigned int)OSUtils::jsonInt(network["mtu"],ZT_DEFAULT_MTU),(unsigned int)ZT_MAX_MTU),(unsigned int)ZT_MIN_MTU);
+	nt->multicastLimit = (unsigned int)OSUtils::jsonInt(network["multicastLimit"],32ULL);
+
+	const std::string rtt(OSUtils::jsonString(network["remoteTraceTarget"],""));
+	if (rtt.length() == 10)
+		nt->remoteTraceTarget = Address(Utils::hexStrToU64(rtt.c_str()));
+	nt->remoteTraceLevel = (Trace::Level)OSUtils::jsonInt(network["remoteTraceLevel"],0ULL);
+
+	json &authTokens = network["authTokens"];
+	if (authTokens.is_object()) {
+		for(auto t=authTokens.begin();t!=authTokens.end();++t) {
+			if (t.value().is_number())
+				nt->authTokens[t.key()] = t.value().get<int64_t>();
+		}
+	}
+
+	json &rules = network["rules"];
+	if (rules.is_array()) {
+		ZT_VirtualNetworkRule rule;
+		for(unsigned long i=0;i<rules.size();++i) {
+			if (nt->rules.size() >= ZT_MAX_NETWORK_RULES)
+				break;
+			if (parseRule(rules[i],rule))
+				nt->rules.push_back(rule);
+		}
+	}
+
+	json &capabilities = network["capabilities"];
+	if (capabilities.is_array()) {
+		for(unsigned long i=0;i<capabilities.size();++i) {
+			json &cap = capabilities[i];
+			if (cap.is_object()) {
+				const uint32_t id = (uint32_t)(OSUtils::jsonInt(cap["id"],0ULL) & 0xffffffffULL);
+				std::vector<ZT_VirtualNetworkRule> &caprules = nt->capabilities[id];
+				caprules.clear();
+				json &caprj = cap["rules"];
+				if (caprj.is_array()) {
+					ZT_VirtualNetworkRule rule;
+					for(unsigned long j=0;j<caprj.size();++j) {
+						if (caprules.size() >= ZT_MAX_CAPABILITY_RULES)
+							break;
+						if (parseRule(caprj[j],rule))
+							caprules.push_back(rule);
+					}
+				}
+				if (OSUtils::jsonBool(cap["default"],false))
+					nt->defaultCapabilities.push_back(id);
+			}
+		}
+	}
+
+	json &tags = network["tags"];
+	if (tags.is_array()) {
+		for(unsigned long i=0;i<tags.size();++i) {
+			json &t = tags[i];
+			if (t.is_object()) {
+				json &dfl = t["default"];
+				if (dfl.is_number())
+					nt->defaultTags.push_back(std::pair<uint32_t,uint32_t>((uint32_t)(OSUtils::jsonInt(t["id"],0) & 0xffffffffULL),(uint32_t)(OSUtils::jsonInt(dfl,0) & 0xffffffffULL)));
+			}
+		}
+	}
+
+	json &routes = network["routes"];
+	if (routes.is_array()) {
+		for(unsigned long i=0;i<routes.size();++i) {
+			if (nt->routes.size() >= ZT_MAX_NETWORK_ROUTES)
+				break;
+			json &route = routes[i];
+			json &target = route["target"];
+			json &via = route["via"];
+			if (target.is_string()) {
+				const InetAddress t(target.get<std::string>().c_str());
+				InetAddress v;
+				if (via.is_string()) v.fromString(via.get<std::string>().c_str());
+				if ((t.ss_family == AF_INET)||(t.ss_family == AF_INET6)) {
+					ZT_VirtualNetworkRoute r;
+					memset(&r,0,sizeof(r));
+					*(reinterpret_cast<InetAddress *>(&(r.target))) = t;
+					if (v.ss_family == t.ss_family)
+						*(reinterpret_cast<InetAddress *>(&(r.via))) = v;
+					nt->routes.push_back(r);
+				}
+			}
+		}
+	}
+
+	json &v4AssignMode = network["v4AssignMode"];
+	if (v4AssignMode.is_object())
+		nt->v4AssignZt = OSUtils::jsonBool(v4AssignMode["zt"],false);
+	json &v6AssignMode = network["v6AssignMode"];
+	if (v6AssignMode.is_object()) {
+		nt->v6AssignZt = OSUtils::jsonBool(v6AssignMode["zt"],false);
+		nt->v6AssignRfc4193 = OSUtils::jsonBool(v6AssignMode["rfc4193"],false);
+		nt->v6Assign6plane = OSUtils::jsonBool(v6AssignMode["6plane"],false);
+	}
+
+	json &ipAssignmentPools = network["ipAssignmentPools"];
+	if (ipAssignmentPools.is_array()) {
+		for(unsigned long p=0;p<ipAssignmentPools.size();++p) {
+			json &pool = ipAssignmentPools[p];
+			if (pool.is_object())
+				nt->ipAssignmentPools.push_back(std::pair<InetAddress,InetAddress>(InetAddress(OSUtils::jsonString(pool["ipRangeStart"],"").c_str()),InetAddress(OSUtils::jsonString(pool["ipRangeEnd"],"").c_str())));
+		}
+	}
+
+	json &dns = network["dns"];
+	if (dns.is_object()) {
+		nt->dnsDomain = OSUtils::jsonString(dns["domain"],"");
+		json &addrArray = dns["servers"];
+		if (addrArray.is_array()) {
+			for(unsigned int j=0;((j<addrArray.size())&&(j<ZT_MAX_DNS_SERVERS));++j)
+				nt->dnsServers.push_back(InetAddress(OSUtils::jsonString(addrArray[j],"").c_str()));
+		}
+	}
+
+	return nt;
+}
+
+void DB::NetworkTemplate::fill(NetworkConfig &nc) const
+{
+	nc.networkId = networkId;
+	nc.revision = revision;
+	nc.flags = flags;
+	nc.type = type;
+	nc.mtu = mtu;
+	nc.multicastLimit = multicastLimit;
+	nc.remoteTraceTarget = remoteTraceTarget;
+	nc.remoteTraceLevel = remoteTraceLevel;
+	Utils::scopy(nc.name,sizeof(nc.name),name.c_str());
+	nc.ruleCount = (unsigned int)rules.size();
+	if (nc.ruleCount)
+		memcpy(nc.rules,rules.data(),sizeof(ZT_VirtualNetworkRule) * nc.ruleCount);
+	nc.routeCount = (unsigned int)routes.size();
+	if (nc.routeCount)
+		memcpy(nc.routes,routes.data(),sizeof(ZT_VirtualNetworkRoute) * nc.routeCount);
+	Utils::scopy(nc.dns.domain,sizeof(nc.dns.domain),dnsDomain.c_str());
+	for(unsigned int j=0;j<(unsigned int)dnsServers.size();++j)
+		*(reinterpret_cast<InetAddress *>(&(nc.dns.server_addr[j]))) = dnsServers[j];
+}
+
+DB::DB() : _changeSeq(0) {}
 DB::~DB() {}
 
 bool DB::get(const uint64_t networkId,nlohmann::json &network)
@@ -160,6 +569,31 @@ bool DB::get(const uint64_t networkId,nlohmann::json &network,const uint64_t mem
 	return true;
 }
 
+bool DB::get(const uint64_t networkId,std::shared_ptr<const NetworkTemplate> &network,const uint64_t memberId,nlohmann::json &member,NetworkSummaryInfo &info)
+{
+	waitForReady();
+	std::shared_ptr<_Network> nw;
+	{
+		std::lock_guard<std::mutex> l(_networks_l);
+		auto nwi = _networks.find(networkId);
+		if (nwi == _networks.end())
+			return false;
+		nw = nwi->second;
+	}
+	{
+		std::lock_guard<std::mutex> l2(nw->lock);
+		if (!nw->compiled)
+			nw->compiled = compileNetwork(nw->config);
+		network = nw->compiled;
+		_fillSummaryInfo(nw,info);
+		auto m = nw->members.find(memberId);
+		if (m == nw->members.end())
+			return false;
+		member = m->second;
+	}
+	return true;
+}
+
 bool DB::get(const uint64_t networkId,nlohmann::json &network,std::vector<nlohmann::json> &members)
 {
 	waitForReady();
@@ -180,6 +614,33 @@ bool DB::get(const uint64_t networkId,nlohmann::json &network,std::vector<nlohma
 	return true;
 }
 
+bool DB::memberPage(const uint64_t networkId,const uint64_t after,const unsigned long limit,const MemberFilter &filter,std::vector<nlohmann::json> &members,bool &more)
+{
+	waitForReady();
+	more = false;
+	std::shared_ptr<_Network> nw;
+	{
+		std::lock_guard<std::mutex> l(_networks_l);
+		auto nwi = _networks.find(networkId);
+		if (nwi == _networks.end())
+			return false;
+		nw = nwi->second;
+	}
+	unsigned long count = 0;
+	std::lock_guard<std::mutex> l2(nw->lock);
+	for(auto m=nw->members.upper_bound(after);m!=nw->members.end();++m) {
+		if ((filter)&&(!filter(m->second)))
+			continue;
+		if (count >= limit) {
+			more = true;
+			break;
+		}
+		members.push_back(m->second);
+		++count;
+	}
+	return true;
+}
+
 void DB::networks(std::set<uint64_t> &networks)
 {
 	waitForReady();
@@ -188,6 +649,64 @@ void DB::networks(std::set<uint64_t> &networks)
 		networks.insert(n->first);
 }
 
+uint32_t DB::nextFreeIpv4(const uint64_t networkId,const uint32_t first,const uint32_t last)
+{
+	std::shared_ptr<_Network> nw;
+	{
+		std::lock_guard<std::mutex> l(_networks_l);
+		auto nwi = _networks.find(networkId);
+		if (nwi == _networks.end())
+			return 0;
+		nw = nwi->second;
+	}
+	std::lock_guard<std::mutex> l2(nw->lock);
+	uint32_t ip = first;
+	auto r = nw->allocatedIpv4Ranges.upper_bound(ip);
+	if (r != nw->allocatedIpv4Ranges.begin()) {
+		--r;
+		if (r->second >= ip) {
+			// Runs are merged, so the address right after one is always free
+			if (r->second >= last)
+				return 0;
+			ip = r->second + 1;
+		}
+	}
+	return (ip <= last) ? ip : 0;
+}
+
+bool DB::claimIp(const uint64_t networkId,const InetAddress &ip)
+{
+	std::shared_ptr<_Network> nw;
+	{
+		std::lock_guard<std::mutex> l(_networks_l);
+		auto nwi = _networks.find(networkId);
+		if (nwi == _networks.end())
+			return false;
+		nw = nwi->second;
+	}
+	std::lock_guard<std::mutex> l2(nw->lock);
+	if (!nw->allocatedIps.insert(ip).second)
+		return false;
+	if (ip.ss_family == AF_INET)
+		_allocateIpv4(nw->allocatedIpv4Ranges,_ipv4ToInt(ip));
+	return true;
+}
+
+void DB::releaseIp(const uint64_t networkId,const InetAddress &ip)
+{
+	std::shared_ptr<_Network> nw;
+	{
+		std::lock_guard<std::mutex> l(_networks_l);
+		auto nwi = _networks.find(networkId);
+		if (nwi == _networks.end())
+			return;
+		nw = nwi->second;
+	}
+	std::lock_guard<std::mutex> l2(nw->lock);
+	if ((nw->allocatedIps.erase(ip))&&(ip.ss_family == AF_INET))
+		_releaseIpv4(nw->allocatedIpv4Ranges,_ipv4ToInt(ip));
+}
+
 void DB::_memberChanged(nlohmann::json &old,nlohmann::json &memberConfig,bool notifyListeners)
 {
 	uint64_t memberId = 0;
@@ -222,6 +741,8 @@ void DB::_memberChanged(nlohmann::json &old,nlohmann::json &memberConfig,bool no
 							InetAddress ipa(ips.c_str());
 							ipa.setPort(0);
 							nw->allocatedIps.erase(ipa);
+							if (ipa.ss_family == AF_INET)
+								_releaseIpv4(nw->allocatedIpv4Ranges,_ipv4ToInt(ipa));
 						}
 					}
 				}
@@ -261,6 +782,8 @@ void DB::_memberChanged(nlohmann::json &old,nlohmann::json &memberConfig,bool no
 						InetAddress ipa(ips.c_str());
 						ipa.setPort(0);
 						nw->allocatedIps.insert(ipa);
+						if (ipa.ss_family == AF_INET)
+							_allocateIpv4(nw->allocatedIpv4Ranges,_ipv4ToInt(ipa));
 					}
 				}
 			}
@@ -295,6 +818,9 @@ void DB::_memberChanged(nlohmann::json &old,nlohmann::json &memberConfig,bool no
 		}
 	}
 
+	if ((networkId)&&(memberId))
+		_logChange(networkId,memberId);
+
 	if ((notifyListeners)&&((wasAuth)&&(!isAuth)&&(networkId)&&(memberId))) {
 		std::lock_guard<std::mutex> ll(_changeListeners_l);
 		for(auto i=_changeListeners.begin();i!=_changeListeners.end();++i) {
@@ -318,9 +844,15 @@ void DB::_networkChanged(nlohmann::json &old,nlohmann::json &networkConfig,bool
 				nw = nw2;
 			}
 			{
+				// A compiled template is dropped when the revision moves and
+				// rebuilt by the next config request (see get()).
+				auto rev = networkConfig.find("revision");
 				std::lock_guard<std::mutex> l2(nw->lock);
 				nw->config = networkConfig;
+				if ((nw->compiled)&&(nw->compiled->revision != ((rev != networkConfig.end()) ? OSUtils::jsonInt(*rev,0ULL) : 0ULL)))
+					nw->compiled.reset();
 			}
+			_logChange(networkId,0);
 			if (notifyListeners) {
 				std::lock_guard<std::mutex> ll(_changeListeners_l);
 				for(auto i=_changeListeners.begin();i!=_changeListeners.end();++i) {
@@ -332,20 +864,44 @@ void DB::_networkChanged(nlohmann::json &old,nlohmann::json &networkConfig,bool
 		const std::string ids = old["id"];
 		const uint64_t networkId = Utils::hexStrToU64(ids.c_str());
 		if (networkId) {
-			std::lock_guard<std::mutex> l(_networks_l);
-			_networks.erase(networkId);
+			{
+				std::lock_guard<std::mutex> l(_networks_l);
+				_networks.erase(networkId);
+			}
+			_logChange(networkId,0);
 		}
 	}
 }
 
+bool DB::changesSince(uint64_t &seq,std::vector< std::pair<uint64_t,uint64_t> > &changes)
+{
+	std::lock_guard<std::mutex> l(_changeLog_l);
+	if ((!seq)||(seq > _changeSeq)||((_changeSeq - seq) > ZT_DB_CHANGE_LOG_SIZE)) {
+		seq = _changeSeq;
+		return false;
+	}
+	while (seq < _changeSeq)
+		changes.push_back(_changeLog[(unsigned long)(seq++ % ZT_DB_CHANGE_LOG_SIZE)]);
+	return true;
+}
+
+void DB::_logChange(const uint64_t networkId,const uint64_t memberId)
+{
+	std::lock_guard<std::mutex> l(_changeLog_l);
+	const std::pair<uint64_t,uint64_t> k(networkId,memberId);
+	if (_changeLog.size() < ZT_DB_CHANGE_LOG_SIZE) {
+		_changeLog.push_back(k);
+	} else {
+		_changeLog[(unsigned long)(_changeSeq % ZT_DB_CHANGE_LOG_SIZE)] = k;
+	}
+	++_changeSeq;
+}
+
 void DB::_fillSummaryInfo(const std::shared_ptr<_Network> &nw,NetworkSummaryInfo &info)
 {
 	for(auto ab=nw->activeBridgeMembers.begin();ab!=nw->activeBridgeMembers.end();++ab)
 		info.activeBridges.push_back(Address(*ab));
 	std::sort(info.activeBridges.begin(),info.activeBridges.end());
-	for(auto ip=nw->allocatedIps.begin();ip!=nw->allocatedIps.end();++ip)
-		info.allocatedIps.push_back(*ip);
-	std::sort(info.allocatedIps.begin(),info.allocatedIps.end());
 	info.authorizedMemberCount = (unsigned long)nw->authorizedMembers.size();
 	info.totalMemberCount = (unsigned long)nw->members.size();
 	info.mostRecentDeauthTime = nw->mostRecentDeauthTime;
@@ -19,10 +19,12 @@
 #include "../node/Constants.hpp"
 #include "../node/Identity.hpp"
 #include "../node/InetAddress.hpp"
+#include "../node/NetworkConfig.hpp"
 #include "../osdep/OSUtils.hpp"
 #include "../osdep/BlockingQueue.hpp"
 
 #include <memory>
+#include <functional>
 #include <string>
 #include <thread>
 #include <unordered_map>
@@ -31,9 +33,13 @@
 #include <atomic>
 #include <mutex>
 #include <set>
+#include <map>
 
 #include "../ext/json/json.hpp"
 
+// Number of recent network and member changes each DB remembers for incremental mirroring
+#define ZT_DB_CHANGE_LOG_SIZE 65536
+
 namespace ZeroTier
 {
 
@@ -57,16 +63,94 @@ public:
 	{
 		NetworkSummaryInfo() : authorizedMemberCount(0),totalMemberCount(0),mostRecentDeauthTime(0) {}
 		std::vector<Address> activeBridges;
-		std::vector<InetAddress> allocatedIps;
 		unsigned long authorizedMemberCount;
 		unsigned long totalMemberCount;
 		int64_t mostRecentDeauthTime;
 	};
 
+	/**
+	 * Network-wide part of a network config, compiled from JSON once per network revision
+	 *
+	 * Rules, routes, DNS and the other network-wide fields are held in vectors
+	 * sized to what the network actually uses. Requests fill a NetworkConfig
+	 * from it and overlay the member's own tags, capabilities, addresses and
+	 * credentials instead of re-reading the JSON. Templates are compiled on a
+	 * network's first config request, not when it is loaded, and are immutable
+	 * once published so they can be shared between requests.
+	 */
+	struct NetworkTemplate
+	{
+		NetworkTemplate() :
+			networkId(0),
+			revision(0),
+			flags(0),
+			type(ZT_NETWORK_TYPE_PRIVATE),
+			mtu(ZT_DEFAULT_MTU),
+			multicastLimit(0),
+			remoteTraceLevel(Trace::LEVEL_NORMAL),
+			v4AssignZt(false),
+			v6AssignZt(false),
+			v6AssignRfc4193(false),
+			v6Assign6plane(false) {}
+
+		/**
+		 * Copy the network-wide fields into a freshly constructed config
+		 *
+		 * @param nc Network config to fill
+		 */
+		void fill(NetworkConfig &nc) const;
+
+		uint64_t networkId;
+		uint64_t revision;
+		uint64_t flags;
+		ZT_VirtualNetworkType type;
+		unsigned int mtu;
+		unsigned int multicastLimit;
+		Address remoteTraceTarget;
+		Trace::Level remoteTraceLevel;
+		std::string name;
+		std::vector<ZT_VirtualNetworkRule> rules;
+		std::vector<ZT_VirtualNetworkRoute> routes;
+		std::string dnsDomain;
+		std::vector<InetAddress> dnsServers;
+		std::map< uint32_t,std::vector<ZT_VirtualNetworkRule> > capabilities;
+		std::vector<uint32_t> defaultCapabilities;
+		std::vector< std::pair<uint32_t,uint32_t> > defaultTags;
+		std::vector< std::pair<InetAddress,InetAddress> > ipAssignmentPools;
+		std::map< std::string,int64_t > authTokens;
+		bool v4AssignZt;
+		bool v6AssignZt;
+		bool v6AssignRfc4193;
+		bool v6Assign6plane;
+	};
+
+	/**
+	 * Statistics for drivers that write records behind a commit queue
+	 */
+	struct CommitQueueStats
+	{
+		CommitQueueStats() : depth(0),oldestAge(0),committed(0),coalesced(0),failed(0),latencyMean(0.0f),latencyPeak(0.0f) {}
+
+		unsigned long depth; // records waiting to be written
+		int64_t oldestAge; // ms the oldest waiting record has been queued
+		uint64_t committed; // records written
+		uint64_t coalesced; // updates folded into a record that was already queued
+		uint64_t failed; // records the database rejected
+		float latencyMean; // ms from queueing to commit, weighted toward recent commits
+		float latencyPeak; // ms, recent worst case decaying toward the mean
+	};
+
+	/**
+	 * Member listing filter, returns true to include a member
+	 */
+	typedef std::function<bool (const nlohmann::json &)> MemberFilter;
+
 	static void initNetwork(nlohmann::json &network);
 	static void initMember(nlohmann::json &member);
 	static void cleanNetwork(nlohmann::json &network);
 	static void cleanMember(nlohmann::json &member);
+	static bool parseRule(nlohmann::json &r,ZT_VirtualNetworkRule &rule);
+	static std::shared_ptr<const NetworkTemplate> compileNetwork(const nlohmann::json &network);
 
 	DB();
 	virtual ~DB();
@@ -80,13 +164,74 @@ public:
 		return (_networks.find(networkId) != _networks.end());
 	}
 
+	inline bool hasMember(const uint64_t networkId,const uint64_t memberId) const
+	{
+		std::shared_ptr<_Network> nw;
+		{
+			std::lock_guard<std::mutex> l(_networks_l);
+			auto nwi = _networks.find(networkId);
+			if (nwi == _networks.end())
+				return false;
+			nw = nwi->second;
+		}
+		std::lock_guard<std::mutex> l(nw->lock);
+		return (nw->members.find(memberId) != nw->members.end());
+	}
+
 	bool get(const uint64_t networkId,nlohmann::json &network);
 	bool get(const uint64_t networkId,nlohmann::json &network,const uint64_t memberId,nlohmann::json &member);
 	bool get(const uint64_t networkId,nlohmann::json &network,const uint64_t memberId,nlohmann::json &member,NetworkSummaryInfo &info);
+	bool get(const uint64_t networkId,std::shared_ptr<const NetworkTemplate> &network,const uint64_t memberId,nlohmann::json &member,NetworkSummaryInfo &info);
 	bool get(const uint64_t networkId,nlohmann::json &network,std::vector<nlohmann::json> &members);
 
+	/**
+	 * Get one page of a network's members in ascending member ID order
+	 *
+	 * Only the members returned are copied, so memory use follows the page
+	 * size rather than the size of the network.
+	 *
+	 * @param networkId Network ID
+	 * @param after Return members with IDs above this, or 0 to start at the first
+	 * @param limit Maximum number of members to return
+	 * @param filter If set, called with the network locked and returns true to include a member
+	 * @param members Filled with up to limit members
+	 * @param more Set to true if further matching members follow this page
+	 * @return False if the network does not exist
+	 */
+	bool memberPage(const uint64_t networkId,const uint64_t after,const unsigned long limit,const MemberFilter &filter,std::vector<nlohmann::json> &members,bool &more);
+
 	void networks(std::set<uint64_t> &networks);
 
+	/**
+	 * Find the lowest IPv4 address in a range that is not assigned to any member
+	 *
+	 * @param networkId Network ID
+	 * @param first First address in range (host byte order)
+	 * @param last Last address in range, inclusive (host byte order)
+	 * @return Free address in host byte order or 0 if the whole range is taken
+	 */
+	uint32_t nextFreeIpv4(const uint64_t networkId,const uint32_t first,const uint32_t last);
+
+	/**
+	 * Reserve an address so concurrent requests cannot hand it out twice
+	 *
+	 * The reservation is kept by the member record that is saved with the
+	 * address in its assignments.
+	 *
+	 * @param networkId Network ID
+	 * @param ip Address with port set to zero
+	 * @return False if the address is already assigned or reserved
+	 */
+	bool claimIp(const uint64_t networkId,const InetAddress &ip);
+
+	/**
+	 * Drop a reservation made by claimIp() that no member was saved with
+	 *
+	 * @param networkId Network ID
+	 * @param ip Address with port set to zero
+	 */
+	void releaseIp(const uint64_t networkId,const InetAddress &ip);
+
 	template<typename F>
 	inline void each(F f)
 	{
@@ -107,6 +252,25 @@ public:
 
 	virtual void nodeIsOnline(const uint64_t networkId,const uint64_t memberId,const InetAddress &physicalAddress) = 0;
 
+	/**
+	 * @param stats Filled with commit queue statistics
+	 * @return False if this database writes synchronously and has no queue
+	 */
+	virtual bool commitQueueStats(CommitQueueStats &stats) { return false; }
+
+	/**
+	 * Get networks and members changed since a change log position
+	 *
+	 * Every change to a network or member, including erasure and changes made
+	 * while loading, is given the next sequence number. A key may be listed
+	 * more than once.
+	 *
+	 * @param seq Position from a previous call or 0 for none, updated to the current position
+	 * @param changes Filled with network ID, member ID pairs (member ID 0 for a network)
+	 * @return False if changes since seq are no longer all in the log and a full scan is needed
+	 */
+	bool changesSince(uint64_t &seq,std::vector< std::pair<uint64_t,uint64_t> > &changes);
+
 	inline void addListener(DB::ChangeListener *const listener)
 	{
 		std::lock_guard<std::mutex> l(_changeListeners_l);
@@ -140,10 +304,12 @@ protected:
 	{
 		_Network() : mostRecentDeauthTime(0) {}
 		nlohmann::json config;
-		std::unordered_map<uint64_t,nlohmann::json> members;
+		std::shared_ptr<const NetworkTemplate> compiled; // null until first requested after a revision change
+		std::map<uint64_t,nlohmann::json> members; // ordered so member listings can be paged by ID
 		std::unordered_set<uint64_t> activeBridgeMembers;
 		std::unordered_set<uint64_t> authorizedMembers;
 		std::unordered_set<InetAddress,InetAddress::Hasher> allocatedIps;
+		std::map<uint32_t,uint32_t> allocatedIpv4Ranges; // IPv4 members of allocatedIps as merged [first,last] runs
 		int64_t mostRecentDeauthTime;
 		std::mutex lock;
 	};
@@ -151,12 +317,17 @@ protected:
 	void _memberChanged(nlohmann::json &old,nlohmann::json &memberConfig,bool notifyListeners);
 	void _networkChanged(nlohmann::json &old,nlohmann::json &networkConfig,bool notifyListeners);
 	void _fillSummaryInfo(const std::shared_ptr<_Network> &nw,NetworkSummaryInfo &info);
+	void _logChange(const uint64_t networkId,const uint64_t memberId);
 
 	std::vector<DB::ChangeListener *> _changeListeners;
 	std::unordered_map< uint64_t,std::shared_ptr<_Network> > _networks;
 	std::unordered_multimap< uint64_t,uint64_t > _networkByMember;
 	mutable std::mutex _changeListeners_l;
 	mutable std::mutex _networks_l;
+
+	std::vector< std::pair<uint64_t,uint64_t> > _changeLog; // ring, change N is at (N - 1) % ZT_DB_CHANGE_LOG_SIZE
+	uint64_t _changeSeq; // sequence number of the most recent change
+	std::mutex _changeLog_l;
 };
 
 } // namespace ZeroTier
@@ -13,57 +13,61 @@
 
 #include "DBMirrorSet.hpp"
 
+#include <algorithm>
+
 namespace ZeroTier {
 
+namespace {
+
+// Copy a record from one database to any other that lacks it or has an older revision
+static unsigned long _reconcile(const std::vector< std::shared_ptr<DB> > &dbs,const DB *const from,const uint64_t networkId,const nlohmann::json &network,const uint64_t memberId,const nlohmann::json &member)
+{
+	unsigned long copied = 0;
+	if (network.is_object()) {
+		if (memberId == 0) {
+			for(auto db2=dbs.begin();db2!=dbs.end();++db2) {
+				if (from != db2->get()) {
+					nlohmann::json nw2;
+					if ((!(*db2)->get(networkId,nw2))||((nw2.is_object())&&(OSUtils::jsonInt(nw2["revision"],0) < OSUtils::jsonInt(network["revision"],0)))) {
+						nw2 = network;
+						if ((*db2)->save(nw2,false))
+							++copied;
+					}
+				}
+			}
+		} else if (member.is_object()) {
+			for(auto db2=dbs.begin();db2!=dbs.end();++db2) {
+				if (from != db2->get()) {
+					nlohmann::json nw2,m2;
+					if ((!(*db2)->get(networkId,nw2,memberId,m2))||((m2.is_object())&&(OSUtils::jsonInt(m2["revision"],0) < OSUtils::jsonInt(member["revision"],0)))) {
+						m2 = member;
+						if ((*db2)->save(m2,false))
+							++copied;
+					}
+				}
+			}
+		}
+	}
+	return copied;
+}
+
+} // anonymous namespace
+
 DBMirrorSet::DBMirrorSet(DB::ChangeListener *listener) :
 	_listener(listener),
 	_running(true)
 {
 	_syncCheckerThread = std::thread([this]() {
+		int64_t lastFullScan = 0;
 		for(;;) {
-			for(int i=0;i<120;++i) { // 1 minute delay between checks
+			for(int i=0;i<(ZT_DBMIRRORSET_SYNC_INTERVAL / 500);++i) {
 				if (!_running)
 					return;
 				std::this_thread::sleep_for(std::chrono::milliseconds(500));
 			}
-
-			std::vector< std::shared_ptr<DB> > dbs;
-			{
-				std::lock_guard<std::mutex> l(_dbs_l);
-				if (_dbs.size() <= 1)
-					continue; // no need to do this if there's only one DB, so skip the iteration
-				dbs = _dbs;
-			}
-
-			for(auto db=dbs.begin();db!=dbs.end();++db) {
-				(*db)->each([this,&dbs,&db](uint64_t networkId,const nlohmann::json &network,uint64_t memberId,const nlohmann::json &member) {
-					try {
-						if (network.is_object()) {
-							if (memberId == 0) {
-								for(auto db2=dbs.begin();db2!=dbs.end();++db2) {
-									if (db->get() != db2->get()) {
-										nlohmann::json nw2;
-										if ((!(*db2)->get(networkId,nw2))||((nw2.is_object())&&(OSUtils::jsonInt(nw2["revision"],0) < OSUtils::jsonInt(network["revision"],0)))) {
-											nw2 = network;
-											(*db2)->save(nw2,false);
-										}
-									}
-								}
-							} else if (member.is_object()) {
-								for(auto db2=dbs.begin();db2!=dbs.end();++db2) {
-									if (db->get() != db2->get()) {
-										nlohmann::json nw2,m2;
-										if ((!(*db2)->get(networkId,nw2,memberId,m2))||((m2.is_object())&&(OSUtils::jsonInt(m2["revision"],0) < OSUtils::jsonInt(member["revision"],0)))) {
-											m2 = member;
-											(*db2)->save(m2,false);
-										}
-									}
-								}
-							}
-						}
-					} catch ( ... ) {} // skip entries that generate JSON errors
-				});
-			}
+			const int64_t now = OSUtils::now();
+			if (_sync((now - lastFullScan) >= ZT_DBMIRRORSET_FULL_SCAN_INTERVAL))
+				lastFullScan = now;
 		}
 	});
 }
@@ -84,6 +88,16 @@ bool DBMirrorSet::hasNetwork(const uint64_t networkId) const
 	return false;
 }
 
+bool DBMirrorSet::hasMember(const uint64_t networkId,const uint64_t memberId) const
+{
+	std::lock_guard<std::mutex> l(_dbs_l);
+	for(auto d=_dbs.begin();d!=_dbs.end();++d) {
+		if ((*d)->hasMember(networkId,memberId))
+			return true;
+	}
+	return false;
+}
+
 bool DBMirrorSet::get(const uint64_t networkId,nlohmann::json &network)
 {
 	std::lock_guard<std::mutex> l(_dbs_l);
@@ -115,6 +129,16 @@ bool DBMirrorSet::get(const uint64_t networkId,nlohmann::json &network,const uin
 	return false;
 }
 
+bool DBMirrorSet::get(const uint64_t networkId,std::shared_ptr<const DB::NetworkTemplate> &network,const uint64_t memberId,nlohmann::json &member,DB::NetworkSummaryInfo &info)
+{
+	std::lock_guard<std::mutex> l(_dbs_l);
+	for(auto d=_dbs.begin();d!=_dbs.end();++d) {
+		if ((*d)->get(networkId,network,memberId,member,info))
+			return true;
+	}
+	return false;
+}
+
 bool DBMirrorSet::get(const uint64_t networkId,nlohmann::json &network,std::vector<nlohmann::json> &members)
 {
 	std::lock_guard<std::mutex> l(_dbs_l);
@@ -125,6 +149,16 @@ bool DBMirrorSet::get(const uint64_t networkId,nlohmann::json &network,std::vect
 	return false;
 }
 
+bool DBMirrorSet::memberPage(const uint64_t networkId,const uint64_t after,const unsigned long limit,const DB::MemberFilter &filter,std::vector<nlohmann::json> &members,bool &more)
+{
+	std::lock_guard<std::mutex> l(_dbs_l);
+	for(auto d=_dbs.begin();d!=_dbs.end();++d) {
+		if ((*d)->memberPage(networkId,after,limit,filter,members,more))
+			return true;
+	}
+	return false;
+}
+
 void DBMirrorSet::networks(std::set<uint64_t> &networks)
 {
 	std::lock_guard<std::mutex> l(_dbs_l);
@@ -133,6 +167,37 @@ void DBMirrorSet::networks(std::set<uint64_t> &networks)
 	}
 }
 
+uint32_t DBMirrorSet::nextFreeIpv4(const uint64_t networkId,const uint32_t first,const uint32_t last)
+{
+	std::lock_guard<std::mutex> l(_dbs_l);
+	for(auto d=_dbs.begin();d!=_dbs.end();++d) {
+		if ((*d)->hasNetwork(networkId))
+			return (*d)->nextFreeIpv4(networkId,first,last);
+	}
+	return 0;
+}
+
+bool DBMirrorSet::claimIp(const uint64_t networkId,const InetAddress &ip)
+{
+	std::lock_guard<std::mutex> l(_dbs_l);
+	for(auto d=_dbs.begin();d!=_dbs.end();++d) {
+		if ((*d)->hasNetwork(networkId))
+			return (*d)->claimIp(networkId,ip);
+	}
+	return false;
+}
+
+void DBMirrorSet::releaseIp(const uint64_t networkId,const InetAddress &ip)
+{
+	std::lock_guard<std::mutex> l(_dbs_l);
+	for(auto d=_dbs.begin();d!=_dbs.end();++d) {
+		if ((*d)->hasNetwork(networkId)) {
+			(*d)->releaseIp(networkId,ip);
+			return;
+		}
+	}
+}
+
 bool DBMirrorSet::waitForReady()
 {
 	bool r = false;
@@ -199,6 +264,98 @@ void DBMirrorSet::nodeIsOnline(const uint64_t networkId,const uint64_t memberId,
 	}
 }
 
+bool DBMirrorSet::commitQueueStats(DB::CommitQueueStats &stats)
+{
+	bool any = false;
+	std::lock_guard<std::mutex> l(_dbs_l);
+	for(auto d=_dbs.begin();d!=_dbs.end();++d) {
+		DB::CommitQueueStats s;
+		if ((*d)->commitQueueStats(s)) {
+			stats.depth += s.depth;
+			stats.oldestAge = std::max(stats.oldestAge,s.oldestAge);
+			stats.committed += s.committed;
+			stats.coalesced += s.coalesced;
+			stats.failed += s.failed;
+			stats.latencyMean = std::max(stats.latencyMean,s.latencyMean);
+			stats.latencyPeak = std::max(stats.latencyPeak,s.latencyPeak);
+			any = true;
+		}
+	}
+	return any;
+}
+
+bool DBMirrorSet::syncStats(SyncStats &stats)
+{
+	{
+		std::lock_guard<std::mutex> l(_dbs_l);
+		if (_dbs.size() <= 1)
+			return false;
+	}
+	std::lock_guard<std::mutex> l(_syncStats_l);
+	stats = _syncStats;
+	return true;
+}
+
+bool DBMirrorSet::_sync(bool fullScan)
+{
+	std::vector< std::shared_ptr<DB> > dbs;
+	{
+		std::lock_guard<std::mutex> l(_dbs_l);
+		if (_dbs.size() <= 1)
+			return false; // no need to do this if there's only one DB, so skip the iteration
+		dbs = _dbs;
+	}
+
+	const int64_t start = OSUtils::now();
+
+	// Positions are all taken before any records are read, so anything that
+	// changes during this pass is picked up by the next one. A DB new to the
+	// set, or one whose log has wrapped since the last pass, forces a full scan.
+	std::vector< std::vector< std::pair<uint64_t,uint64_t> > > changes(dbs.size());
+	for(unsigned long i=0;i<dbs.size();++i) {
+		if (!dbs[i]->changesSince(_changeSeqs[dbs[i].get()],changes[i]))
+			fullScan = true;
+	}
+
+	uint64_t checked = 0,copied = 0;
+	for(unsigned long i=0;i<dbs.size();++i) {
+		const DB *const db = dbs[i].get();
+		if (fullScan) {
+			dbs[i]->each([&dbs,db,&checked,&copied](uint64_t networkId,const nlohmann::json &network,uint64_t memberId,const nlohmann::json &member) {
+				try {
+					++checked;
+					copied += _reconcile(dbs,db,networkId,network,memberId,member);
+				} catch ( ... ) {} // skip entries that generate JSON errors
+			});
+		} else {
+			std::vector< std::pair<uint64_t,uint64_t> > &c = changes[i];
+			std::sort(c.begin(),c.end());
+			c.erase(std::unique(c.begin(),c.end()),c.end());
+			for(auto k=c.begin();k!=c.end();++k) {
+				try {
+					nlohmann::json network,member;
+					if ((k->second) ? dbs[i]->get(k->first,network,k->second,member) : dbs[i]->get(k->first,network)) {
+						++checked;
+						copied += _reconcile(dbs,db,k->first,network,k->second,member);
+					}
+				} catch ( ... ) {}
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> l(_syncStats_l);
+	if (fullScan) {
+		++_syncStats.fullScans;
+	} else {
+		++_syncStats.incrementalSyncs;
+	}
+	_syncStats.checked += checked;
+	_syncStats.copied += copied;
+	_syncStats.lastChecked = checked;
+	_syncStats.lastDuration = OSUtils::now() - start;
+	return fullScan;
+}
+
 void DBMirrorSet::onNetworkUpdate(const void *db,uint64_t networkId,const nlohmann::json &network)
 {
 	nlohmann::json record(network);
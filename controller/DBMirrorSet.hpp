@@ -21,24 +21,53 @@
 #include <mutex>
 #include <set>
 #include <thread>
+#include <map>
+
+// Time between syncs of records changed in one database to the others (ms)
+#define ZT_DBMIRRORSET_SYNC_INTERVAL 10000
+
+// Time between full comparisons of every record in every database (ms)
+#define ZT_DBMIRRORSET_FULL_SCAN_INTERVAL 3600000
 
 namespace ZeroTier {
 
 class DBMirrorSet : public DB::ChangeListener
 {
 public:
+	/**
+	 * Cost of keeping the databases in a set consistent with each other
+	 */
+	struct SyncStats
+	{
+		SyncStats() : incrementalSyncs(0),fullScans(0),checked(0),copied(0),lastChecked(0),lastDuration(0) {}
+
+		uint64_t incrementalSyncs; // passes over records changed since the last pass
+		uint64_t fullScans; // passes over every record
+		uint64_t checked; // records compared across databases
+		uint64_t copied; // records saved to a database that was missing them or behind
+		uint64_t lastChecked; // records compared by the most recent pass
+		int64_t lastDuration; // ms taken by the most recent pass
+	};
+
 	DBMirrorSet(DB::ChangeListener *listener);
 	virtual ~DBMirrorSet();
 
 	bool hasNetwork(const uint64_t networkId) const;
+	bool hasMember(const uint64_t networkId,const uint64_t memberId) const;
 
 	bool get(const uint64_t networkId,nlohmann::json &network);
 	bool get(const uint64_t networkId,nlohmann::json &network,const uint64_t memberId,nlohmann::json &member);
 	bool get(const uint64_t networkId,nlohmann::json &network,const uint64_t memberId,nlohmann::json &member,DB::NetworkSummaryInfo &info);
+	bool get(const uint64_t networkId,std::shared_ptr<const DB::NetworkTemplate> &network,const uint64_t memberId,nlohmann::json &member,DB::NetworkSummaryInfo &info);
 	bool get(const uint64_t networkId,nlohmann::json &network,std::vector<nlohmann::json> &members);
+	bool memberPage(const uint64_t networkId,const uint64_t after,const unsigned long limit,const DB::MemberFilter &filter,std::vector<nlohmann::json> &members,bool &more);
 
 	void networks(std::set<uint64_t> &networks);
 
+	uint32_t nextFreeIpv4(const uint64_t networkId,const uint32_t first,const uint32_t last);
+	bool claimIp(const uint64_t networkId,const InetAddress &ip);
+	void releaseIp(const uint64_t networkId,const InetAddress &ip);
+
 	bool waitForReady();
 	bool isReady();
 	bool save(nlohmann::json &record,bool notifyListeners);
@@ -46,6 +75,21 @@ public:
 	void eraseMember(const uint64_t networkId,const uint64_t memberId);
 	void nodeIsOnline(const uint64_t networkId,const uint64_t memberId,const InetAddress &physicalAddress);
 
+	/**
+	 * Sum commit queue statistics over all databases that have a queue
+	 *
+	 * Latencies are the worst of any database.
+	 *
+	 * @return False if no database has a commit queue
+	 */
+	bool commitQueueStats(DB::CommitQueueStats &stats);
+
+	/**
+	 * @param stats Filled with statistics on syncing records between databases
+	 * @return False if there is only one database
+	 */
+	bool syncStats(SyncStats &stats);
+
 	// These are called by various DB instances when changes occur.
 	virtual void onNetworkUpdate(const void *db,uint64_t networkId,const nlohmann::json &network);
 	virtual void onNetworkMemberUpdate(const void *db,uint64_t networkId,uint64_t memberId,const nlohmann::json &member);
@@ -59,11 +103,17 @@ public:
 	}
 
 private:
+	bool _sync(bool fullScan);
+
 	DB::ChangeListener *const _listener;
 	std::atomic_bool _running;
 	std::thread _syncCheckerThread;
 	std::vector< std::shared_ptr< DB > > _dbs;
 	mutable std::mutex _dbs_l;
+
+	std::map< const DB *,uint64_t > _changeSeqs; // change log position synced so far for each DB, used only by the sync thread
+	SyncStats _syncStats;
+	std::mutex _syncStats_l;
 };
 
 } // namespace ZeroTier
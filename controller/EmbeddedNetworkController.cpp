@@ -35,6 +35,7 @@
 #include "EmbeddedNetworkController.hpp"
 #include "LFDB.hpp"
 #include "FileDB.hpp"
+#include "LogDB.hpp"
 #ifdef ZT_CONTROLLER_USE_LIBPQ
 #include "PostgreSQL.hpp"
 #endif
@@ -53,6 +54,27 @@ using json = nlohmann::json;
 // Min duration between requests for an address/nwid combo to prevent floods
 #define ZT_NETCONF_MIN_REQUEST_PERIOD 1000
 
+// Maximum number of requests waiting for a worker thread, after which refreshes are shed
+#define ZT_NETCONF_MAX_QUEUED_REQUESTS 16384
+
+// Joins served in a row before a waiting refresh gets a turn
+#define ZT_NETCONF_MAX_JOIN_STREAK 8
+
+// Number of recent queue wait times kept for percentiles
+#define ZT_NETCONF_QUEUE_WAIT_SAMPLES 4096
+
+// Longest a signed network config may be replayed to a member before its credentials are re-issued
+#define ZT_NETCONF_SIGNED_CONFIG_MAX_AGE 300000
+
+// Members returned per page of a filtered or paged member listing unless the request asks for fewer or more
+#define ZT_NETCONF_MEMBER_PAGE_DEFAULT 100
+
+// Most members returned per page of a member listing
+#define ZT_NETCONF_MEMBER_PAGE_MAX 1000
+
+// Members read from the DB per part of a streamed full member listing
+#define ZT_NETCONF_MEMBER_STREAM_PAGE 1024
+
 // Global maximum size of arrays in JSON objects
 #define ZT_CONTROLLER_MAX_ARRAY_SIZE 16384
 
@@ -248,212 +270,6 @@ static json _renderRule(ZT_VirtualNetworkRule &rule)
 	return r;
 }
 
-static bool _parseRule(json &r,ZT_VirtualNetworkRule &rule)
-{
-	if (!r.is_object())
-		return false;
-
-	const std::string t(OSUtils::jsonString(r["type"],""));
-	memset(&rule,0,sizeof(ZT_VirtualNetworkRule));
-
-	if (OSUtils::jsonBool(r["not"],false))
-		rule.t = 0x80;
-	else rule.t = 0x00;
-	if (OSUtils::jsonBool(r["or"],false))
-		rule.t |= 0x40;
-
-	bool tag = false;
-	if (t == "ACTION_DROP") {
-		rule.t |= ZT_NETWORK_RULE_ACTION_DROP;
-		return true;
-	} else if (t == "ACTION_ACCEPT") {
-		rule.t |= ZT_NETWORK_RULE_ACTION_ACCEPT;
-		return true;
-	} else if (t == "ACTION_TEE") {
-		rule.t |= ZT_NETWORK_RULE_ACTION_TEE;
-		rule.v.fwd.address = Utils::hexStrToU64(OSUtils::jsonString(r["address"],"0").c_str()) & 0xffffffffffULL;
-		rule.v.fwd.flags = (uint32_t)(OSUtils::jsonInt(r["flags"],0ULL) & 0xffffffffULL);
-		rule.v.fwd.length = (uint16_t)(OSUtils::jsonInt(r["length"],0ULL) & 0xffffULL);
-		return true;
-	} else if (t == "ACTION_WATCH") {
-		rule.t |= ZT_NETWORK_RULE_ACTION_WATCH;
-		rule.v.fwd.address = Utils::hexStrToU64(OSUtils::jsonString(r["address"],"0").c_str()) & 0xffffffffffULL;
-		rule.v.fwd.flags = (uint32_t)(OSUtils::jsonInt(r["flags"],0ULL) & 0xffffffffULL);
-		rule.v.fwd.length = (uint16_t)(OSUtils::jsonInt(r["length"],0ULL) & 0xffffULL);
-		return true;
-	} else if (t == "ACTION_REDIRECT") {
-		rule.t |= ZT_NETWORK_RULE_ACTION_REDIRECT;
-		rule.v.fwd.address = Utils::hexStrToU64(OSUtils::jsonString(r["address"],"0").c_str()) & 0xffffffffffULL;
-		rule.v.fwd.flags = (uint32_t)(OSUtils::jsonInt(r["flags"],0ULL) & 0xffffffffULL);
-		return true;
-	} else if (t == "ACTION_BREAK") {
-		rule.t |= ZT_NETWORK_RULE_ACTION_BREAK;
-		return true;
-	} else if (t == "MATCH_SOURCE_ZEROTIER_ADDRESS") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_SOURCE_ZEROTIER_ADDRESS;
-		rule.v.zt = Utils::hexStrToU64(OSUtils::jsonString(r["zt"],"0").c_str()) & 0xffffffffffULL;
-		return true;
-	} else if (t == "MATCH_DEST_ZEROTIER_ADDRESS") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_DEST_ZEROTIER_ADDRESS;
-		rule.v.zt = Utils::hexStrToU64(OSUtils::jsonString(r["zt"],"0").c_str()) & 0xffffffffffULL;
-		return true;
-	} else if (t == "MATCH_VLAN_ID") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_VLAN_ID;
-		rule.v.vlanId = (uint16_t)(OSUtils::jsonInt(r["vlanId"],0ULL) & 0xffffULL);
-		return true;
-	} else if (t == "MATCH_VLAN_PCP") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_VLAN_PCP;
-		rule.v.vlanPcp = (uint8_t)(OSUtils::jsonInt(r["vlanPcp"],0ULL) & 0xffULL);
-		return true;
-	} else if (t == "MATCH_VLAN_DEI") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_VLAN_DEI;
-		rule.v.vlanDei = (uint8_t)(OSUtils::jsonInt(r["vlanDei"],0ULL) & 0xffULL);
-		return true;
-	} else if (t == "MATCH_MAC_SOURCE") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_MAC_SOURCE;
-		const std::string mac(OSUtils::jsonString(r["mac"],"0"));
-		Utils::unhex(mac.c_str(),(unsigned int)mac.length(),rule.v.mac,6);
-		return true;
-	} else if (t == "MATCH_MAC_DEST") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_MAC_DEST;
-		const std::string mac(OSUtils::jsonString(r["mac"],"0"));
-		Utils::unhex(mac.c_str(),(unsigned int)mac.length(),rule.v.mac,6);
-		return true;
-	} else if (t == "MATCH_IPV4_SOURCE") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_IPV4_SOURCE;
-		InetAddress ip(OSUtils::jsonString(r["ip"],"0.0.0.0").c_str());
-		rule.v.ipv4.ip = reinterpret_cast<struct sockaddr_in *>(&ip)->sin_addr.s_addr;
-		rule.v.ipv4.mask = Utils::ntoh(reinterpret_cast<struct sockaddr_in *>(&ip)->sin_port) & 0xff;
-		if (rule.v.ipv4.mask > 32) rule.v.ipv4.mask = 32;
-		return true;
-	} else if (t == "MATCH_IPV4_DEST") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_IPV4_DEST;
-		InetAddress ip(OSUtils::jsonString(r["ip"],"0.0.0.0").c_str());
-		rule.v.ipv4.ip = reinterpret_cast<struct sockaddr_in *>(&ip)->sin_addr.s_addr;
-		rule.v.ipv4.mask = Utils::ntoh(reinterpret_cast<struct sockaddr_in *>(&ip)->sin_port) & 0xff;
-		if (rule.v.ipv4.mask > 32) rule.v.ipv4.mask = 32;
-		return true;
-	} else if (t == "MATCH_IPV6_SOURCE") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_IPV6_SOURCE;
-		InetAddress ip(OSUtils::jsonString(r["ip"],"::0").c_str());
-		memcpy(rule.v.ipv6.ip,reinterpret_cast<struct sockaddr_in6 *>(&ip)->sin6_addr.s6_addr,16);
-		rule.v.ipv6.mask = Utils::ntoh(reinterpret_cast<struct sockaddr_in6 *>(&ip)->sin6_port) & 0xff;
-		if (rule.v.ipv6.mask > 128) rule.v.ipv6.mask = 128;
-		return true;
-	} else if (t == "MATCH_IPV6_DEST") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_IPV6_DEST;
-		InetAddress ip(OSUtils::jsonString(r["ip"],"::0").c_str());
-		memcpy(rule.v.ipv6.ip,reinterpret_cast<struct sockaddr_in6 *>(&ip)->sin6_addr.s6_addr,16);
-		rule.v.ipv6.mask = Utils::ntoh(reinterpret_cast<struct sockaddr_in6 *>(&ip)->sin6_port) & 0xff;
-		if (rule.v.ipv6.mask > 128) rule.v.ipv6.mask = 128;
-		return true;
-	} else if (t == "MATCH_IP_TOS") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_IP_TOS;
-		rule.v.ipTos.mask = (uint8_t)(OSUtils::jsonInt(r["mask"],0ULL) & 0xffULL);
-		rule.v.ipTos.value[0] = (uint8_t)(OSUtils::jsonInt(r["start"],0ULL) & 0xffULL);
-		rule.v.ipTos.value[1] = (uint8_t)(OSUtils::jsonInt(r["end"],0ULL) & 0xffULL);
-		return true;
-	} else if (t == "MATCH_IP_PROTOCOL") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_IP_PROTOCOL;
-		rule.v.ipProtocol = (uint8_t)(OSUtils::jsonInt(r["ipProtocol"],0ULL) & 0xffULL);
-		return true;
-	} else if (t == "MATCH_ETHERTYPE") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_ETHERTYPE;
-		rule.v.etherType = (uint16_t)(OSUtils::jsonInt(r["etherType"],0ULL) & 0xffffULL);
-		return true;
-	} else if (t == "MATCH_ICMP") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_ICMP;
-		rule.v.icmp.type = (uint8_t)(OSUtils::jsonInt(r["icmpType"],0ULL) & 0xffULL);
-		json &code = r["icmpCode"];
-		if (code.is_null()) {
-			rule.v.icmp.code = 0;
-			rule.v.icmp.flags = 0x00;
-		} else {
-			rule.v.icmp.code = (uint8_t)(OSUtils::jsonInt(code,0ULL) & 0xffULL);
-			rule.v.icmp.flags = 0x01;
-		}
-		return true;
-	} else if (t == "MATCH_IP_SOURCE_PORT_RANGE") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_IP_SOURCE_PORT_RANGE;
-		rule.v.port[0] = (uint16_t)(OSUtils::jsonInt(r["start"],0ULL) & 0xffffULL);
-		rule.v.port[1] = (uint16_t)(OSUtils::jsonInt(r["end"],(uint64_t)rule.v.port[0]) & 0xffffULL);
-		return true;
-	} else if (t == "MATCH_IP_DEST_PORT_RANGE") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_IP_DEST_PORT_RANGE;
-		rule.v.port[0] = (uint16_t)(OSUtils::jsonInt(r["start"],0ULL) & 0xffffULL);
-		rule.v.port[1] = (uint16_t)(OSUtils::jsonInt(r["end"],(uint64_t)rule.v.port[0]) & 0xffffULL);
-		return true;
-	} else if (t == "MATCH_CHARACTERISTICS") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_CHARACTERISTICS;
-		if (r.count("mask")) {
-			json &v = r["mask"];
-			if (v.is_number()) {
-				rule.v.characteristics = v;
-			} else {
-				std::string tmp = v;
-				rule.v.characteristics = Utils::hexStrToU64(tmp.c_str());
-			}
-		}
-		return true;
-	} else if (t == "MATCH_FRAME_SIZE_RANGE") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_FRAME_SIZE_RANGE;
-		rule.v.frameSize[0] = (uint16_t)(OSUtils::jsonInt(r["start"],0ULL) & 0xffffULL);
-		rule.v.frameSize[1] = (uint16_t)(OSUtils::jsonInt(r["end"],(uint64_t)rule.v.frameSize[0]) & 0xffffULL);
-		return true;
-	} else if (t == "MATCH_RANDOM") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_RANDOM;
-		rule.v.randomProbability = (uint32_t)(OSUtils::jsonInt(r["probability"],0ULL) & 0xffffffffULL);
-		return true;
-	} else if (t == "MATCH_TAGS_DIFFERENCE") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_TAGS_DIFFERENCE;
-		tag = true;
-	} else if (t == "MATCH_TAGS_BITWISE_AND") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_TAGS_BITWISE_AND;
-		tag = true;
-	} else if (t == "MATCH_TAGS_BITWISE_OR") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_TAGS_BITWISE_OR;
-		tag = true;
-	} else if (t == "MATCH_TAGS_BITWISE_XOR") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_TAGS_BITWISE_XOR;
-		tag = true;
-	} else if (t == "MATCH_TAGS_EQUAL") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_TAGS_EQUAL;
-		tag = true;
-	} else if (t == "MATCH_TAG_SENDER") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_TAG_SENDER;
-		tag = true;
-	} else if (t == "MATCH_TAG_RECEIVER") {
-		rule.t |= ZT_NETWORK_RULE_MATCH_TAG_RECEIVER;
-		tag = true;
-	} else if (t == "INTEGER_RANGE") {
-		json &s = r["start"];
-		if (s.is_string()) {
-			std::string tmp = s;
-			rule.v.intRange.start = Utils::hexStrToU64(tmp.c_str());
-		} else {
-			rule.v.intRange.start = OSUtils::jsonInt(s,0ULL);
-		}
-		json &e = r["end"];
-		if (e.is_string()) {
-			std::string tmp = e;
-			rule.v.intRange.end = (uint32_t)(Utils::hexStrToU64(tmp.c_str()) - rule.v.intRange.start);
-		} else {
-			rule.v.intRange.end = (uint32_t)(OSUtils::jsonInt(e,0ULL) - rule.v.intRange.start);
-		}
-		rule.v.intRange.idx = (uint16_t)OSUtils::jsonInt(r["idx"],0ULL);
-		rule.v.intRange.format = (OSUtils::jsonBool(r["little"],false)) ? 0x80 : 0x00;
-		rule.v.intRange.format |= (uint8_t)((OSUtils::jsonInt(r["bits"],1ULL) - 1) & 63);
-	}
-
-	if (tag) {
-		rule.v.tag.id = (uint32_t)(OSUtils::jsonInt(r["id"],0ULL) & 0xffffffffULL);
-		rule.v.tag.value = (uint32_t)(OSUtils::jsonInt(r["value"],0ULL) & 0xffffffffULL);
-		return true;
-	}
-
-	return false;
-}
-
 } // anonymous namespace
 
 EmbeddedNetworkController::EmbeddedNetworkController(Node *node,const char *ztPath,const char *dbPath, int listenPort, RedisConfig *rc) :
@@ -464,16 +280,36 @@ EmbeddedNetworkController::EmbeddedNetworkController(Node *node,const char *ztPa
 	_path(dbPath),
 	_sender((NetworkController::Sender *)0),
 	_db(this),
+	_joinStreak(0),
+	_queueRunning(true),
+	_requestsCoalesced(0),
+	_requestsShed(0),
+	_queueWaitPtr(0),
+	_lastSignedConfigSweep(0),
+	_signedConfigHits(0),
+	_signedConfigMisses(0),
 	_rc(rc)
 {
 }
 
 EmbeddedNetworkController::~EmbeddedNetworkController()
 {
-	std::lock_guard<std::mutex> l(_threads_l);
-	_queue.stop();
-	for(auto t=_threads.begin();t!=_threads.end();++t)
+	{
+		std::lock_guard<std::mutex> ql(_queue_l);
+		_queueRunning = false;
+		_queue_c.notify_all();
+	}
+	// Workers still finishing a request can get here via _queueRequest(), so
+	// join them without holding _threads_l.
+	std::vector<std::thread> threads;
+	{
+		std::lock_guard<std::mutex> l(_threads_l);
+		threads.swap(_threads);
+	}
+	for(auto t=threads.begin();t!=threads.end();++t)
 		t->join();
+	for(auto q=_queued.begin();q!=_queued.end();++q)
+		delete q->second;
 }
 
 void EmbeddedNetworkController::init(const Identity &signingId,Sender *sender)
@@ -483,20 +319,30 @@ void EmbeddedNetworkController::init(const Identity &signingId,Sender *sender)
 	_sender = sender;
 	_signingIdAddressString = signingId.address().toString(tmp);
 
+	std::string lfJSON;
+	nlohmann::json lfConfig;
+	OSUtils::readFile((_ztPath + ZT_PATH_SEPARATOR_S "local.conf").c_str(),lfJSON);
+	if (lfJSON.length() > 0)
+		lfConfig = OSUtils::jsonParse(lfJSON);
+	std::string dbType;
+	if ((lfConfig["settings"].is_object())&&(lfConfig["settings"]["controllerDb"].is_object()))
+		dbType = OSUtils::jsonString(lfConfig["settings"]["controllerDb"]["type"],"");
+
 #ifdef ZT_CONTROLLER_USE_LIBPQ
 	if ((_path.length() > 9)&&(_path.substr(0,9) == "postgres:")) {
 		_db.addDB(std::shared_ptr<DB>(new PostgreSQL(_signingId,_path.substr(9).c_str(), _listenPort, _rc)));
 	} else {
 #endif
-		_db.addDB(std::shared_ptr<DB>(new FileDB(_path.c_str())));
+		if (dbType == "log") {
+			_db.addDB(std::shared_ptr<DB>(new LogDB(_path.c_str())));
+		} else {
+			_db.addDB(std::shared_ptr<DB>(new FileDB(_path.c_str())));
+		}
 #ifdef ZT_CONTROLLER_USE_LIBPQ
 	}
 #endif
 
-	std::string lfJSON;
-	OSUtils::readFile((_ztPath + ZT_PATH_SEPARATOR_S "local.conf").c_str(),lfJSON);
 	if (lfJSON.length() > 0) {
-		nlohmann::json lfConfig(OSUtils::jsonParse(lfJSON));
 		nlohmann::json &settings = lfConfig["settings"];
 		if (settings.is_object()) {
 			nlohmann::json &controllerDb = settings["controllerDb"];
@@ -535,15 +381,7 @@ void EmbeddedNetworkController::request(
 {
 	if (((!_signingId)||(!_signingId.hasPrivate()))||(_signingId.address().toInt() != (nwid >> 24))||(!_sender))
 		return;
-	_startThreads();
-	_RQEntry *qe = new _RQEntry;
-	qe->nwid = nwid;
-	qe->requestPacketId = requestPacketId;
-	qe->fromAddr = fromAddr;
-	qe->identity = identity;
-	qe->metaData = metaData;
-	qe->type = _RQEntry::RQENTRY_TYPE_REQUEST;
-	_queue.post(qe);
+	_queueRequest(nwid,fromAddr,requestPacketId,identity,metaData,!_db.hasMember(nwid,identity.address().toInt()));
 }
 
 unsigned int EmbeddedNetworkController::handleControlPlaneHttpGET(
@@ -553,6 +391,23 @@ unsigned int EmbeddedNetworkController::handleControlPlaneHttpGET(
 	const std::string &body,
 	std::string &responseBody,
 	std::string &responseContentType)
+{
+	ResponseStream responseStream;
+	const unsigned int scode = handleControlPlaneHttpGET(path,urlArgs,headers,body,responseBody,responseContentType,responseStream);
+	if (responseStream) {
+		while (responseStream(responseBody)) {}
+	}
+	return scode;
+}
+
+unsigned int EmbeddedNetworkController::handleControlPlaneHttpGET(
+	const std::vector<std::string> &path,
+	const std::map<std::string,std::string> &urlArgs,
+	const std::map<std::string,std::string> &headers,
+	const std::string &body,
+	std::string &responseBody,
+	std::string &responseContentType,
+	ResponseStream &responseStream)
 {
 	if ((!path.empty())&&(path[0] == "network")) {
 
@@ -576,24 +431,112 @@ unsigned int EmbeddedNetworkController::handleControlPlaneHttpGET(
 						responseBody = OSUtils::jsonDump(member);
 						responseContentType = "application/json";
 
-					} else {
-						// List members and their revisions
+					} else if ((urlArgs.count("cursor"))||(urlArgs.count("limit"))||(urlArgs.count("authorized"))||(urlArgs.count("ip"))||(urlArgs.count("seenSince"))) {
+						// List one page of members, optionally filtered
+
+						unsigned long limit = ZT_NETCONF_MEMBER_PAGE_DEFAULT;
+						uint64_t after = 0;
+						int authorized = -1;
+						std::string ip;
+						bool seenFilter = false;
+						std::unordered_set<uint64_t> seen;
+						for(auto a=urlArgs.begin();a!=urlArgs.end();++a) {
+							if (a->first == "limit") {
+								limit = std::min(std::max(Utils::strToULong(a->second.c_str()),1UL),(unsigned long)ZT_NETCONF_MEMBER_PAGE_MAX);
+							} else if (a->first == "cursor") {
+								after = Utils::hexStrToU64(a->second.c_str());
+							} else if (a->first == "authorized") {
+								authorized = ((a->second == "true")||(a->second == "1")) ? 1 : 0;
+							} else if (a->first == "ip") {
+								InetAddress ipf(a->second.c_str());
+								if ((ipf.ss_family != AF_INET)&&(ipf.ss_family != AF_INET6)) {
+									responseBody = "{ \"message\": \"ip is not a valid IP address\" }";
+									responseContentType = "application/json";
+									return 400;
+								}
+								char ipbuf[64];
+								ip = ipf.toIpString(ipbuf);
+							} else if (a->first == "seenSince") {
+								// Members are matched against when they last asked this controller for a config
+								const int64_t since = (int64_t)strtoll(a->second.c_str(),(char **)0,10);
+								seenFilter = true;
+								std::lock_guard<std::mutex> l(_memberStatus_l);
+								for(auto ms=_memberStatus.begin();ms!=_memberStatus.end();++ms) {
+									if ((ms->first.networkId == nwid)&&(ms->second.lastRequestTime)&&((int64_t)ms->second.lastRequestTime >= since))
+										seen.insert(ms->first.nodeId);
+								}
+							}
+						}
 
-						responseBody = "{";
 						std::vector<json> members;
-						if (_db.get(nwid,network,members)) {
-							responseBody.reserve((members.size() + 2) * 32);
-							std::string mid;
-							for(auto member=members.begin();member!=members.end();++member) {
-								mid = OSUtils::jsonString((*member)["id"], "");
-								char tmp[128];
-								OSUtils::ztsnprintf(tmp,sizeof(tmp),"%s\"%s\":%llu",(responseBody.length() > 1) ? "," : "",mid.c_str(),(unsigned long long)OSUtils::jsonInt((*member)["revision"],0));
-								responseBody.append(tmp);
+						bool more = false;
+						_db.memberPage(nwid,after,limit,[&](const json &member) -> bool {
+							if (authorized >= 0) {
+								auto a = member.find("authorized");
+								if ((a == member.end())||(!a->is_boolean())||(a->get<bool>() != (authorized > 0)))
+									return false;
+							}
+							if (seenFilter) {
+								auto id = member.find("id");
+								if ((id == member.end())||(!id->is_string())||(seen.find(Utils::hexStrToU64(id->get<std::string>().c_str())) == seen.end()))
+									return false;
 							}
+							if (ip.length()) {
+								auto ipa = member.find("ipAssignments");
+								if ((ipa == member.end())||(!ipa->is_array()))
+									return false;
+								for(auto i=ipa->begin();i!=ipa->end();++i) {
+									if ((i->is_string())&&(i->get<std::string>() == ip))
+										return true;
+								}
+								return false;
+							}
+							return true;
+						},members,more);
+
+						responseBody = "{\"members\":[";
+						for(auto member=members.begin();member!=members.end();++member) {
+							if (member != members.begin())
+								responseBody.push_back(',');
+							responseBody.append(OSUtils::jsonDump(*member,-1));
+						}
+						responseBody.append("],\"next\":");
+						if ((more)&&(!members.empty())) {
+							responseBody.push_back('"');
+							responseBody.append(OSUtils::jsonString(members.back()["id"],""));
+							responseBody.push_back('"');
+						} else {
+							responseBody.append("null");
 						}
 						responseBody.push_back('}');
 						responseContentType = "application/json";
 
+					} else {
+						// List members and their revisions, streamed a page at a time so
+						// that large networks are never copied whole
+
+						responseBody = "{";
+						responseContentType = "application/json";
+						uint64_t after = 0;
+						bool first = true;
+						responseStream = [this,nwid,after,first](std::string &part) mutable -> bool {
+							std::vector<json> members;
+							bool more = false;
+							_db.memberPage(nwid,after,ZT_NETCONF_MEMBER_STREAM_PAGE,DB::MemberFilter(),members,more);
+							char tmp[128];
+							for(auto member=members.begin();member!=members.end();++member) {
+								OSUtils::ztsnprintf(tmp,sizeof(tmp),"%s\"%s\":%llu",(first) ? "" : ",",OSUtils::jsonString((*member)["id"],"").c_str(),(unsigned long long)OSUtils::jsonInt((*member)["revision"],0));
+								part.append(tmp);
+								first = false;
+							}
+							if ((more)&&(!members.empty())) {
+								after = Utils::hexStrToU64(OSUtils::jsonString(members.back()["id"],"").c_str());
+								return true;
+							}
+							part.push_back('}');
+							return false;
+						};
+
 					}
 					return 200;
 
@@ -633,8 +576,28 @@ unsigned int EmbeddedNetworkController::handleControlPlaneHttpGET(
 
 		char tmp[4096];
 		const bool dbOk = _db.isReady();
-		OSUtils::ztsnprintf(tmp,sizeof(tmp),"{\n\t\"controller\": true,\n\t\"apiVersion\": %d,\n\t\"clock\": %llu,\n\t\"databaseReady\": %s\n}\n",ZT_NETCONF_CONTROLLER_API_VERSION,(unsigned long long)OSUtils::now(),dbOk ? "true" : "false");
+		unsigned long signedConfigs;
+		{
+			std::lock_guard<std::mutex> l(_signedConfigs_l);
+			signedConfigs = (unsigned long)_signedConfigs.size();
+		}
+		OSUtils::ztsnprintf(tmp,sizeof(tmp),"{\n\t\"controller\": true,\n\t\"apiVersion\": %d,\n\t\"clock\": %llu,\n\t\"databaseReady\": %s,\n\t\"signedConfigCache\": {\n\t\t\"entries\": %lu,\n\t\t\"hits\": %llu,\n\t\t\"misses\": %llu\n\t}",ZT_NETCONF_CONTROLLER_API_VERSION,(unsigned long long)OSUtils::now(),dbOk ? "true" : "false",signedConfigs,(unsigned long long)_signedConfigHits,(unsigned long long)_signedConfigMisses);
 		responseBody = tmp;
+		_RequestQueueStats rqs;
+		_requestQueueStats(rqs);
+		OSUtils::ztsnprintf(tmp,sizeof(tmp),",\n\t\"requestQueue\": {\n\t\t\"depth\": %lu,\n\t\t\"joins\": %lu,\n\t\t\"coalesced\": %llu,\n\t\t\"shed\": %llu,\n\t\t\"waitP50\": %.1f,\n\t\t\"waitP99\": %.1f\n\t}",rqs.depth,rqs.joins,(unsigned long long)rqs.coalesced,(unsigned long long)rqs.shed,rqs.waitP50,rqs.waitP99);
+		responseBody.append(tmp);
+		DB::CommitQueueStats cqs;
+		if (_db.commitQueueStats(cqs)) {
+			OSUtils::ztsnprintf(tmp,sizeof(tmp),",\n\t\"commitQueue\": {\n\t\t\"depth\": %lu,\n\t\t\"oldestAge\": %lld,\n\t\t\"committed\": %llu,\n\t\t\"coalesced\": %llu,\n\t\t\"failed\": %llu,\n\t\t\"latencyMean\": %.1f,\n\t\t\"latencyPeak\": %.1f\n\t}",cqs.depth,(long long)cqs.oldestAge,(unsigned long long)cqs.committed,(unsigned long long)cqs.coalesced,(unsigned long long)cqs.failed,(double)cqs.latencyMean,(double)cqs.latencyPeak);
+			responseBody.append(tmp);
+		}
+		DBMirrorSet::SyncStats ss;
+		if (_db.syncStats(ss)) {
+			OSUtils::ztsnprintf(tmp,sizeof(tmp),",\n\t\"mirrorSync\": {\n\t\t\"incrementalSyncs\": %llu,\n\t\t\"fullScans\": %llu,\n\t\t\"checked\": %llu,\n\t\t\"copied\": %llu,\n\t\t\"lastChecked\": %llu,\n\t\t\"lastDuration\": %lld\n\t}",(unsigned long long)ss.incrementalSyncs,(unsigned long long)ss.fullScans,(unsigned long long)ss.checked,(unsigned long long)ss.copied,(unsigned long long)ss.lastChecked,(long long)ss.lastDuration);
+			responseBody.append(tmp);
+		}
+		responseBody.append("\n}\n");
 		responseContentType = "application/json";
 		return dbOk ? 200 : 503;
 
@@ -815,6 +778,8 @@ unsigned int EmbeddedNetworkController::handleControlPlaneHttpPOST(
 					if (b.count("name")) network["name"] = OSUtils::jsonString(b["name"],"");
 					if (b.count("private")) network["private"] = OSUtils::jsonBool(b["private"],true);
 					if (b.count("enableBroadcast")) network["enableBroadcast"] = OSUtils::jsonBool(b["enableBroadcast"],false);
+					if (b.count("multicastTree")) network["multicastTree"] = OSUtils::jsonBool(b["multicastTree"],false);
+					if (b.count("qos")) network["qos"] = OSUtils::jsonBool(b["qos"],false);
 					if (b.count("multicastLimit")) network["multicastLimit"] = OSUtils::jsonInt(b["multicastLimit"],32ULL);
 					if (b.count("mtu")) network["mtu"] = std::max(std::min((unsigned int)OSUtils::jsonInt(b["mtu"],ZT_DEFAULT_MTU),(unsigned int)ZT_MAX_MTU),(unsigned int)ZT_MIN_MTU);
 
@@ -933,7 +898,7 @@ unsigned int EmbeddedNetworkController::handleControlPlaneHttpPOST(
 								json &rule = rules[i];
 								if (rule.is_object()) {
 									ZT_VirtualNetworkRule ztr;
-									if (_parseRule(rule,ztr)) {
+									if (DB::parseRule(rule,ztr)) {
 										nrules.push_back(_renderRule(ztr));
 										if (nrules.size() >= ZT_CONTROLLER_MAX_ARRAY_SIZE)
 											break;
@@ -977,7 +942,7 @@ unsigned int EmbeddedNetworkController::handleControlPlaneHttpPOST(
 											json &rule = rules[i];
 											if (rule.is_object()) {
 												ZT_VirtualNetworkRule ztr;
-												if (_parseRule(rule,ztr)) {
+												if (DB::parseRule(rule,ztr)) {
 													nrules.push_back(_renderRule(ztr));
 													if (nrules.size() >= ZT_CONTROLLER_MAX_ARRAY_SIZE)
 														break;
@@ -1185,36 +1150,45 @@ void EmbeddedNetworkController::handleRemoteTrace(const ZT_RemoteTrace &rt)
 
 void EmbeddedNetworkController::onNetworkUpdate(const void *db,uint64_t networkId,const nlohmann::json &network)
 {
-	// Send an update to all members of the network that are online
+	// Send an update to all members of the network that are online. Like
+	// onNetworkMemberUpdate() this runs with DB locks held, so queue refreshes
+	// directly.
 	const int64_t now = OSUtils::now();
 	std::lock_guard<std::mutex> l(_memberStatus_l);
 	for(auto i=_memberStatus.begin();i!=_memberStatus.end();++i) {
 		if ((i->first.networkId == networkId)&&(i->second.online(now))&&(i->second.lastRequestMetaData))
-			request(networkId,InetAddress(),0,i->second.identity,i->second.lastRequestMetaData);
+			_queueRequest(networkId,InetAddress(),0,i->second.identity,i->second.lastRequestMetaData,false);
 	}
 }
 
 void EmbeddedNetworkController::onNetworkMemberUpdate(const void *db,uint64_t networkId,uint64_t memberId,const nlohmann::json &member)
 {
-	// Push update to member if online
+	// Push update to member if online. This is called with DB locks held, so
+	// queue it directly as a refresh rather than via request()'s member lookup.
 	try {
 		std::lock_guard<std::mutex> l(_memberStatus_l);
 		_MemberStatus &ms = _memberStatus[_MemberStatusKey(networkId,memberId)];
 		if ((ms.online(OSUtils::now()))&&(ms.lastRequestMetaData))
-			request(networkId,InetAddress(),0,ms.identity,ms.lastRequestMetaData);
+			_queueRequest(networkId,InetAddress(),0,ms.identity,ms.lastRequestMetaData,false);
 	} catch ( ... ) {}
 }
 
 void EmbeddedNetworkController::onNetworkMemberDeauthorize(const void *db,uint64_t networkId,uint64_t memberId)
 {
 	const int64_t now = OSUtils::now();
-	Revocation rev((uint32_t)_node->prng(),networkId,0,now,ZT_REVOCATION_FLAG_FAST_PROPAGATE,Address(memberId),Revocation::CREDENTIAL_TYPE_COM);
+	uint32_t revId;
+	Utils::getSecureRandom(&revId,sizeof(revId));
+	Revocation rev(revId,networkId,0,now,ZT_REVOCATION_FLAG_FAST_PROPAGATE,Address(memberId),Revocation::CREDENTIAL_TYPE_COM);
 	rev.sign(_signingId);
+	{
+		std::lock_guard<std::mutex> l(_signedConfigs_l);
+		_signedConfigs.erase(_MemberStatusKey(networkId,memberId));
+	}
 	{
 		std::lock_guard<std::mutex> l(_memberStatus_l);
 		for(auto i=_memberStatus.begin();i!=_memberStatus.end();++i) {
-			if ((i->first.networkId == networkId)&&(i->second.online(now)))
-				_node->ncSendRevocation(Address(i->first.nodeId),rev);
+			if ((i->first.networkId == networkId)&&(i->second.online(now))&&(_sender))
+				_sender->ncSendRevocation(Address(i->first.nodeId),rev);
 		}
 	}
 }
@@ -1228,7 +1202,8 @@ void EmbeddedNetworkController::_request(
 {
 	char nwids[24];
 	DB::NetworkSummaryInfo ns;
-	json network,member;
+	std::shared_ptr<const DB::NetworkTemplate> network;
+	json member;
 
 	if (((!_signingId)||(!_signingId.hasPrivate()))||(_signingId.address().toInt() != (nwid >> 24))||(!_sender))
 		return;
@@ -1247,7 +1222,7 @@ void EmbeddedNetworkController::_request(
 
 	Utils::hex(nwid,nwids);
 	_db.get(nwid,network,identity.address().toInt(),member,ns);
-	if ((!network.is_object())||(network.empty())) {
+	if (!network) {
 		_sender->ncSendError(nwid,requestPacketId,identity.address(),NetworkController::NC_ERROR_OBJECT_NOT_FOUND);
 		return;
 	}
@@ -1291,7 +1266,7 @@ void EmbeddedNetworkController::_request(
 	json autoAuthCredentialType,autoAuthCredential;
 	if (OSUtils::jsonBool(member["authorized"],false)) {
 		authorized = true;
-	} else if (!OSUtils::jsonBool(network["private"],true)) {
+	} else if (network->type == ZT_NETWORK_TYPE_PUBLIC) {
 		authorized = true;
 		autoAuthorized = true;
 		autoAuthCredentialType = "public";
@@ -1301,10 +1276,9 @@ void EmbeddedNetworkController::_request(
 			presentedAuth[511] = (char)0; // sanity check
 			if ((strlen(presentedAuth) > 6)&&(!strncmp(presentedAuth,"token:",6))) {
 				const char *const presentedToken = presentedAuth + 6;
-				json authTokens(network["authTokens"]);
-				json &tokenExpires = authTokens[presentedToken];
-				if (tokenExpires.is_number()) {
-					if ((tokenExpires == 0)||(tokenExpires > now)) {
+				auto tokenExpires = network->authTokens.find(presentedToken);
+				if (tokenExpires != network->authTokens.end()) {
+					if ((tokenExpires->second == 0)||(tokenExpires->second > now)) {
 						authorized = true;
 						autoAuthorized = true;
 						autoAuthCredentialType = "token";
@@ -1373,110 +1347,93 @@ void EmbeddedNetworkController::_request(
 		}
 	}
 
+	// A member asking again for an unchanged config gets the chunks signed for its
+	// last request replayed. Credentials are re-issued once per time bucket, which
+	// is offset per member so that members do not all roll over together.
+	const bool sendLegacyFormatConfig = (metaData.getUI(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_VERSION,0) < 6);
+	const bool replayable = ((!newMember)&&(identity.address() != _signingId.address())&&((metaData.getUI(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_FLAGS,0) & ZT_NETWORKCONFIG_REQUEST_FLAG_ACCEPTS_REPLAY) != 0));
+	_SignedConfigKey sck;
+	if (replayable) {
+		const int64_t bucket = std::max(std::min((int64_t)ZT_NETCONF_SIGNED_CONFIG_MAX_AGE,credentialtmd / 4),(int64_t)1);
+		sck.networkRevision = network->revision;
+		sck.memberRevision = OSUtils::jsonInt(member["revision"],0ULL);
+		sck.credentialTimeMaxDelta = credentialtmd;
+		sck.credentialTimeBucket = (now + (int64_t)(identity.address().toInt() % (uint64_t)bucket)) / bucket;
+		for(std::vector<Address>::const_iterator ab(ns.activeBridges.begin());ab!=ns.activeBridges.end();++ab)
+			sck.activeBridges = (sck.activeBridges * 31ULL) + ab->toInt();
+		sck.rulesEngine = (metaData.getUI(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_RULES_ENGINE_REV,0) > 0);
+		sck.legacyFormat = sendLegacyFormatConfig;
+
+		std::shared_ptr< const std::vector< std::vector<uint8_t> > > chunks;
+		{
+			std::lock_guard<std::mutex> l(_signedConfigs_l);
+			auto sc = _signedConfigs.find(_MemberStatusKey(nwid,identity.address().toInt()));
+			if ((sc != _signedConfigs.end())&&(sc->second.key == sck))
+				chunks = sc->second.chunks;
+		}
+		if (chunks) {
+			++_signedConfigHits;
+			DB::cleanMember(member);
+			_db.save(member,true);
+			_sender->ncSendConfigChunks(nwid,requestPacketId,identity.address(),*chunks);
+			return;
+		}
+		++_signedConfigMisses;
+	}
+
+	// Start from the network's compiled template and overlay this member
 	std::unique_ptr<NetworkConfig> nc(new NetworkConfig());
+	network->fill(*nc);
 
 	nc->networkId = nwid;
-	nc->type = OSUtils::jsonBool(network["private"],true) ? ZT_NETWORK_TYPE_PRIVATE : ZT_NETWORK_TYPE_PUBLIC;
 	nc->timestamp = now;
 	nc->credentialTimeMaxDelta = credentialtmd;
-	nc->revision = OSUtils::jsonInt(network["revision"],0ULL);
 	nc->issuedTo = identity.address();
-	if (OSUtils::jsonBool(network["enableBroadcast"],true)) nc->flags |= ZT_NETWORKCONFIG_FLAG_ENABLE_BROADCAST;
-	Utils::scopy(nc->name,sizeof(nc->name),OSUtils::jsonString(network["name"],"").c_str());
-	nc->mtu = std::max(std::min((unsigned int)OSUtils::jsonInt(network["mtu"],ZT_DEFAULT_MTU),(unsigned int)ZT_MAX_MTU),(unsigned int)ZT_MIN_MTU);
-	nc->multicastLimit = (unsigned int)OSUtils::jsonInt(network["multicastLimit"],32ULL);
 
-	
-	std::string rtt(OSUtils::jsonString(member["remoteTraceTarget"],""));
+	const std::string rtt(OSUtils::jsonString(member["remoteTraceTarget"],""));
 	if (rtt.length() == 10) {
 		nc->remoteTraceTarget = Address(Utils::hexStrToU64(rtt.c_str()));
 		nc->remoteTraceLevel = (Trace::Level)OSUtils::jsonInt(member["remoteTraceLevel"],0ULL);
-	} else {
-		rtt = OSUtils::jsonString(network["remoteTraceTarget"],"");
-		if (rtt.length() == 10) {
-			nc->remoteTraceTarget = Address(Utils::hexStrToU64(rtt.c_str()));
-		} else {
-			nc->remoteTraceTarget.zero();
-		}
-		nc->remoteTraceLevel = (Trace::Level)OSUtils::jsonInt(network["remoteTraceLevel"],0ULL);
 	}
 
 	for(std::vector<Address>::const_iterator ab(ns.activeBridges.begin());ab!=ns.activeBridges.end();++ab)
 		nc->addSpecialist(*ab,ZT_NETWORKCONFIG_SPECIALIST_TYPE_ACTIVE_BRIDGE);
 
-	json &v4AssignMode = network["v4AssignMode"];
-	json &v6AssignMode = network["v6AssignMode"];
-	json &ipAssignmentPools = network["ipAssignmentPools"];
-	json &routes = network["routes"];
-	json &rules = network["rules"];
-	json &capabilities = network["capabilities"];
-	json &tags = network["tags"];
 	json &memberCapabilities = member["capabilities"];
 	json &memberTags = member["tags"];
-	json &dns = network["dns"];
 
 	if (metaData.getUI(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_RULES_ENGINE_REV,0) <= 0) {
 		// Old versions with no rules engine support get an allow everything rule.
 		// Since rules are enforced bidirectionally, newer versions *will* still
 		// enforce rules on the inbound side.
 		nc->ruleCount = 1;
+		memset(&(nc->rules[0]),0,sizeof(ZT_VirtualNetworkRule));
 		nc->rules[0].t = ZT_NETWORK_RULE_ACTION_ACCEPT;
 	} else {
-		if (rules.is_array()) {
-			for(unsigned long i=0;i<rules.size();++i) {
-				if (nc->ruleCount >= ZT_MAX_NETWORK_RULES)
-					break;
-				if (_parseRule(rules[i],nc->rules[nc->ruleCount]))
-					++nc->ruleCount;
-			}
-		}
-
-		std::map< uint64_t,json * > capsById;
 		if (!memberCapabilities.is_array())
 			memberCapabilities = json::array();
-		if (capabilities.is_array()) {
-			for(unsigned long i=0;i<capabilities.size();++i) {
-				json &cap = capabilities[i];
-				if (cap.is_object()) {
-					const uint64_t id = OSUtils::jsonInt(cap["id"],0ULL) & 0xffffffffULL;
-					capsById[id] = &cap;
-					if ((newMember)&&(OSUtils::jsonBool(cap["default"],false))) {
-						bool have = false;
-						for(unsigned long i=0;i<memberCapabilities.size();++i) {
-							if (id == (OSUtils::jsonInt(memberCapabilities[i],0ULL) & 0xffffffffULL)) {
-								have = true;
-								break;
-							}
-						}
-						if (!have)
-							memberCapabilities.push_back(id);
+		if (newMember) {
+			for(auto dc=network->defaultCapabilities.begin();dc!=network->defaultCapabilities.end();++dc) {
+				bool have = false;
+				for(unsigned long i=0;i<memberCapabilities.size();++i) {
+					if (*dc == (OSUtils::jsonInt(memberCapabilities[i],0ULL) & 0xffffffffULL)) {
+						have = true;
+						break;
 					}
 				}
+				if (!have)
+					memberCapabilities.push_back(*dc);
 			}
 		}
 		for(unsigned long i=0;i<memberCapabilities.size();++i) {
-			const uint64_t capId = OSUtils::jsonInt(memberCapabilities[i],0ULL) & 0xffffffffULL;
-			std::map< uint64_t,json * >::const_iterator ctmp = capsById.find(capId);
-			if (ctmp != capsById.end()) {
-				json *cap = ctmp->second;
-				if ((cap)&&(cap->is_object())&&(!cap->empty())) {
-					ZT_VirtualNetworkRule capr[ZT_MAX_CAPABILITY_RULES];
-					unsigned int caprc = 0;
-					json &caprj = (*cap)["rules"];
-					if ((caprj.is_array())&&(!caprj.empty())) {
-						for(unsigned long j=0;j<caprj.size();++j) {
-							if (caprc >= ZT_MAX_CAPABILITY_RULES)
-								break;
-							if (_parseRule(caprj[j],capr[caprc]))
-								++caprc;
-						}
-					}
-					nc->capabilities[nc->capabilityCount] = Capability((uint32_t)capId,nwid,now,1,capr,caprc);
-					if (nc->capabilities[nc->capabilityCount].sign(_signingId,identity.address()))
-						++nc->capabilityCount;
-					if (nc->capabilityCount >= ZT_MAX_NETWORK_CAPABILITIES)
-						break;
-				}
+			const uint32_t capId = (uint32_t)(OSUtils::jsonInt(memberCapabilities[i],0ULL) & 0xffffffffULL);
+			auto cap = network->capabilities.find(capId);
+			if (cap != network->capabilities.end()) {
+				nc->capabilities[nc->capabilityCount] = Capability(capId,nwid,now,1,cap->second.data(),(unsigned int)cap->second.size());
+				if (nc->capabilities[nc->capabilityCount].sign(_signingId,identity.address()))
+					++nc->capabilityCount;
+				if (nc->capabilityCount >= ZT_MAX_NETWORK_CAPABILITIES)
+					break;
 			}
 		}
 
@@ -1488,20 +1445,13 @@ void EmbeddedNetworkController::_request(
 					memberTagsById[(uint32_t)(OSUtils::jsonInt(t[0],0ULL) & 0xffffffffULL)] = (uint32_t)(OSUtils::jsonInt(t[1],0ULL) & 0xffffffffULL);
 			}
 		}
-		if (tags.is_array()) { // check network tags array for defaults that are not present in member tags
-			for(unsigned long i=0;i<tags.size();++i) {
-				json &t = tags[i];
-				if (t.is_object()) {
-					const uint32_t id = (uint32_t)(OSUtils::jsonInt(t["id"],0) & 0xffffffffULL);
-					json &dfl = t["default"];
-					if ((dfl.is_number())&&(memberTagsById.find(id) == memberTagsById.end())) {
-						memberTagsById[id] = (uint32_t)(OSUtils::jsonInt(dfl,0) & 0xffffffffULL);
-						json mt = json::array();
-						mt.push_back(id);
-						mt.push_back(dfl);
-						memberTags.push_back(mt); // add default to member tags if not present
-					}
-				}
+		for(auto dt=network->defaultTags.begin();dt!=network->defaultTags.end();++dt) { // add network tag defaults that are not present in member tags
+			if (memberTagsById.find(dt->first) == memberTagsById.end()) {
+				memberTagsById[dt->first] = dt->second;
+				json mt = json::array();
+				mt.push_back(dt->first);
+				mt.push_back(dt->second);
+				memberTags.push_back(mt);
 			}
 		}
 		for(std::map< uint32_t,uint32_t >::const_iterator t(memberTagsById.begin());t!=memberTagsById.end();++t) {
@@ -1513,41 +1463,34 @@ void EmbeddedNetworkController::_request(
 		}
 	}
 
-	if (routes.is_array()) {
-		for(unsigned long i=0;i<routes.size();++i) {
-			if (nc->routeCount >= ZT_MAX_NETWORK_ROUTES)
-				break;
-			json &route = routes[i];
-			json &target = route["target"];
-			json &via = route["via"];
-			if (target.is_string()) {
-				const InetAddress t(target.get<std::string>().c_str());
-				InetAddress v;
-				if (via.is_string()) v.fromString(via.get<std::string>().c_str());
-				if ((t.ss_family == AF_INET)||(t.ss_family == AF_INET6)) {
-					ZT_VirtualNetworkRoute *r = &(nc->routes[nc->routeCount]);
-					*(reinterpret_cast<InetAddress *>(&(r->target))) = t;
-					if (v.ss_family == t.ss_family)
-						*(reinterpret_cast<InetAddress *>(&(r->via))) = v;
-					++nc->routeCount;
-				}
-			}
-		}
-	}
-
 	const bool noAutoAssignIps = OSUtils::jsonBool(member["noAutoAssignIps"],false);
 
-	if ((v6AssignMode.is_object())&&(!noAutoAssignIps)) {
-		if ((OSUtils::jsonBool(v6AssignMode["rfc4193"],false))&&(nc->staticIpCount < ZT_MAX_ZT_ASSIGNED_ADDRESSES)) {
+	if (!noAutoAssignIps) {
+		if ((network->v6AssignRfc4193)&&(nc->staticIpCount < ZT_MAX_ZT_ASSIGNED_ADDRESSES)) {
 			nc->staticIps[nc->staticIpCount++] = InetAddress::makeIpv6rfc4193(nwid,identity.address().toInt());
 			nc->flags |= ZT_NETWORKCONFIG_FLAG_ENABLE_IPV6_NDP_EMULATION;
 		}
-		if ((OSUtils::jsonBool(v6AssignMode["6plane"],false))&&(nc->staticIpCount < ZT_MAX_ZT_ASSIGNED_ADDRESSES)) {
+		if ((network->v6Assign6plane)&&(nc->staticIpCount < ZT_MAX_ZT_ASSIGNED_ADDRESSES)) {
 			nc->staticIps[nc->staticIpCount++] = InetAddress::makeIpv66plane(nwid,identity.address().toInt());
 			nc->flags |= ZT_NETWORKCONFIG_FLAG_ENABLE_IPV6_NDP_EMULATION;
 		}
 	}
 
+	// Addresses claimed below are released again if this request ends before
+	// the member is saved with them, including by an exception
+	struct _ClaimedIps
+	{
+		_ClaimedIps(DBMirrorSet &d,const uint64_t n) : db(d),nwid(n) {}
+		~_ClaimedIps()
+		{
+			for(auto ip=ips.begin();ip!=ips.end();++ip)
+				db.releaseIp(nwid,*ip);
+		}
+		DBMirrorSet &db;
+		const uint64_t nwid;
+		std::vector<InetAddress> ips;
+	} claimedIps(_db,nwid);
+
 	bool haveManagedIpv4AutoAssignment = false;
 	bool haveManagedIpv6AutoAssignment = false; // "special" NDP-emulated address types do not count
 	json ipAssignments = member["ipAssignments"]; // we want to make a copy
@@ -1582,63 +1525,61 @@ void EmbeddedNetworkController::_request(
 		ipAssignments = json::array();
 	}
 
-	if ( (ipAssignmentPools.is_array()) && ((v6AssignMode.is_object())&&(OSUtils::jsonBool(v6AssignMode["zt"],false))) && (!haveManagedIpv6AutoAssignment) && (!noAutoAssignIps) ) {
-		for(unsigned long p=0;((p<ipAssignmentPools.size())&&(!haveManagedIpv6AutoAssignment));++p) {
-			json &pool = ipAssignmentPools[p];
-			if (pool.is_object()) {
-				InetAddress ipRangeStart(OSUtils::jsonString(pool["ipRangeStart"],"").c_str());
-				InetAddress ipRangeEnd(OSUtils::jsonString(pool["ipRangeEnd"],"").c_str());
-				if ( (ipRangeStart.ss_family == AF_INET6) && (ipRangeEnd.ss_family == AF_INET6) ) {
-					uint64_t s[2],e[2],x[2],xx[2];
-					memcpy(s,ipRangeStart.rawIpData(),16);
-					memcpy(e,ipRangeEnd.rawIpData(),16);
-					s[0] = Utils::ntoh(s[0]);
-					s[1] = Utils::ntoh(s[1]);
-					e[0] = Utils::ntoh(e[0]);
-					e[1] = Utils::ntoh(e[1]);
-					x[0] = s[0];
-					x[1] = s[1];
-
-					for(unsigned int trialCount=0;trialCount<1000;++trialCount) {
-						if ((trialCount == 0)&&(e[1] > s[1])&&((e[1] - s[1]) >= 0xffffffffffULL)) {
-							// First see if we can just cram a ZeroTier ID into the higher 64 bits. If so do that.
-							xx[0] = Utils::hton(x[0]);
-							xx[1] = Utils::hton(x[1] + identity.address().toInt());
-						} else {
-							// Otherwise pick random addresses -- this technically doesn't explore the whole range if the lower 64 bit range is >= 1 but that won't matter since that would be huge anyway
-							Utils::getSecureRandom((void *)xx,16);
-							if ((e[0] > s[0]))
-								xx[0] %= (e[0] - s[0]);
-							else xx[0] = 0;
-							if ((e[1] > s[1]))
-								xx[1] %= (e[1] - s[1]);
-							else xx[1] = 0;
-							xx[0] = Utils::hton(x[0] + xx[0]);
-							xx[1] = Utils::hton(x[1] + xx[1]);
-						}
+	if ( (network->v6AssignZt) && (!haveManagedIpv6AutoAssignment) && (!noAutoAssignIps) ) {
+		for(auto pool=network->ipAssignmentPools.begin();((pool!=network->ipAssignmentPools.end())&&(!haveManagedIpv6AutoAssignment));++pool) {
+			const InetAddress &ipRangeStart = pool->first;
+			const InetAddress &ipRangeEnd = pool->second;
+			if ( (ipRangeStart.ss_family == AF_INET6) && (ipRangeEnd.ss_family == AF_INET6) ) {
+				uint64_t s[2],e[2],x[2],xx[2];
+				memcpy(s,ipRangeStart.rawIpData(),16);
+				memcpy(e,ipRangeEnd.rawIpData(),16);
+				s[0] = Utils::ntoh(s[0]);
+				s[1] = Utils::ntoh(s[1]);
+				e[0] = Utils::ntoh(e[0]);
+				e[1] = Utils::ntoh(e[1]);
+				x[0] = s[0];
+				x[1] = s[1];
+
+				for(unsigned int trialCount=0;trialCount<1000;++trialCount) {
+					if ((trialCount == 0)&&(e[1] > s[1])&&((e[1] - s[1]) >= 0xffffffffffULL)) {
+						// First see if we can just cram a ZeroTier ID into the higher 64 bits. If so do that.
+						xx[0] = Utils::hton(x[0]);
+						xx[1] = Utils::hton(x[1] + identity.address().toInt());
+					} else {
+						// Otherwise pick random addresses -- this technically doesn't explore the whole range if the lower 64 bit range is >= 1 but that won't matter since that would be huge anyway
+						Utils::getSecureRandom((void *)xx,16);
+						if ((e[0] > s[0]))
+							xx[0] %= (e[0] - s[0]);
+						else xx[0] = 0;
+						if ((e[1] > s[1]))
+							xx[1] %= (e[1] - s[1]);
+						else xx[1] = 0;
+						xx[0] = Utils::hton(x[0] + xx[0]);
+						xx[1] = Utils::hton(x[1] + xx[1]);
+					}
 
-						InetAddress ip6((const void *)xx,16,0);
+					InetAddress ip6((const void *)xx,16,0);
 
-						// Check if this IP is within a local-to-Ethernet routed network
-						int routedNetmaskBits = 0;
-						for(unsigned int rk=0;rk<nc->routeCount;++rk) {
-							if ( (!nc->routes[rk].via.ss_family) && (nc->routes[rk].target.ss_family == AF_INET6) && (reinterpret_cast<const InetAddress *>(&(nc->routes[rk].target))->containsAddress(ip6)) )
-								routedNetmaskBits = reinterpret_cast<const InetAddress *>(&(nc->routes[rk].target))->netmaskBits();
-						}
+					// Check if this IP is within a local-to-Ethernet routed network
+					int routedNetmaskBits = 0;
+					for(unsigned int rk=0;rk<nc->routeCount;++rk) {
+						if ( (!nc->routes[rk].via.ss_family) && (nc->routes[rk].target.ss_family == AF_INET6) && (reinterpret_cast<const InetAddress *>(&(nc->routes[rk].target))->containsAddress(ip6)) )
+							routedNetmaskBits = reinterpret_cast<const InetAddress *>(&(nc->routes[rk].target))->netmaskBits();
+					}
 
-						// If it's routed, then try to claim and assign it and if successful end loop
-						if ( (routedNetmaskBits > 0) && (!std::binary_search(ns.allocatedIps.begin(),ns.allocatedIps.end(),ip6)) ) {
-							char tmpip[64];
-							const std::string ipStr(ip6.toIpString(tmpip));
-							if (std::find(ipAssignments.begin(),ipAssignments.end(),ipStr) == ipAssignments.end()) {
-								ipAssignments.push_back(ipStr);
-								member["ipAssignments"] = ipAssignments;
-								ip6.setPort((unsigned int)routedNetmaskBits);
-								if (nc->staticIpCount < ZT_MAX_ZT_ASSIGNED_ADDRESSES)
-									nc->staticIps[nc->staticIpCount++] = ip6;
-								haveManagedIpv6AutoAssignment = true;
-								break;
-							}
+					// If it's routed, then try to claim and assign it and if successful end loop
+					if (routedNetmaskBits > 0) {
+						char tmpip[64];
+						const std::string ipStr(ip6.toIpString(tmpip));
+						if ((std::find(ipAssignments.begin(),ipAssignments.end(),ipStr) == ipAssignments.end())&&(_db.claimIp(nwid,ip6))) {
+							claimedIps.ips.push_back(ip6);
+							ipAssignments.push_back(ipStr);
+							member["ipAssignments"] = ipAssignments;
+							ip6.setPort((unsigned int)routedNetmaskBits);
+							if (nc->staticIpCount < ZT_MAX_ZT_ASSIGNED_ADDRESSES)
+								nc->staticIps[nc->staticIpCount++] = ip6;
+							haveManagedIpv6AutoAssignment = true;
+							break;
 						}
 					}
 				}
@@ -1646,80 +1587,77 @@ void EmbeddedNetworkController::_request(
 		}
 	}
 
-	if ( (ipAssignmentPools.is_array()) && ((v4AssignMode.is_object())&&(OSUtils::jsonBool(v4AssignMode["zt"],false))) && (!haveManagedIpv4AutoAssignment) && (!noAutoAssignIps) ) {
-		for(unsigned long p=0;((p<ipAssignmentPools.size())&&(!haveManagedIpv4AutoAssignment));++p) {
-			json &pool = ipAssignmentPools[p];
-			if (pool.is_object()) {
-				InetAddress ipRangeStartIA(OSUtils::jsonString(pool["ipRangeStart"],"").c_str());
-				InetAddress ipRangeEndIA(OSUtils::jsonString(pool["ipRangeEnd"],"").c_str());
-				if ( (ipRangeStartIA.ss_family == AF_INET) && (ipRangeEndIA.ss_family == AF_INET) ) {
-					uint32_t ipRangeStart = Utils::ntoh((uint32_t)(reinterpret_cast<struct sockaddr_in *>(&ipRangeStartIA)->sin_addr.s_addr));
-					uint32_t ipRangeEnd = Utils::ntoh((uint32_t)(reinterpret_cast<struct sockaddr_in *>(&ipRangeEndIA)->sin_addr.s_addr));
-
-					if ((ipRangeEnd < ipRangeStart)||(ipRangeStart == 0))
+	if ( (network->v4AssignZt) && (!haveManagedIpv4AutoAssignment) && (!noAutoAssignIps) ) {
+		for(auto pool=network->ipAssignmentPools.begin();((pool!=network->ipAssignmentPools.end())&&(!haveManagedIpv4AutoAssignment));++pool) {
+			const InetAddress &ipRangeStartIA = pool->first;
+			const InetAddress &ipRangeEndIA = pool->second;
+			if ( (ipRangeStartIA.ss_family == AF_INET) && (ipRangeEndIA.ss_family == AF_INET) ) {
+				uint32_t ipRangeStart = Utils::ntoh((uint32_t)(reinterpret_cast<const struct sockaddr_in *>(&ipRangeStartIA)->sin_addr.s_addr));
+				uint32_t ipRangeEnd = Utils::ntoh((uint32_t)(reinterpret_cast<const struct sockaddr_in *>(&ipRangeEndIA)->sin_addr.s_addr));
+
+				if ((ipRangeEnd < ipRangeStart)||(ipRangeStart == 0))
+					continue;
+				const uint32_t ipRangeLen = ipRangeEnd - ipRangeStart;
+
+				// Start at a position picked by the member's address and take the next
+				// address that is not assigned yet, wrapping once to the start of the pool.
+				// Assigned runs are skipped in one step, so only addresses that are free
+				// but unusable (unrouted or ending in .255) count as trials.
+				uint32_t ip = (ipRangeLen > 0) ? (ipRangeStart + ((uint32_t)(identity.address().toInt() & 0xffffffff) % ipRangeLen)) : ipRangeStart;
+				bool wrapped = false;
+				for(unsigned int trialCount=0;trialCount<1000;) {
+					ip = _db.nextFreeIpv4(nwid,ip,ipRangeEnd);
+					if (!ip) {
+						if (wrapped)
+							break;
+						wrapped = true;
+						ip = ipRangeStart;
 						continue;
-					uint32_t ipRangeLen = ipRangeEnd - ipRangeStart;
-
-					// Start with the LSB of the member's address
-					uint32_t ipTrialCounter = (uint32_t)(identity.address().toInt() & 0xffffffff);
+					}
+					++trialCount;
 
-					for(uint32_t k=ipRangeStart,trialCount=0;((k<=ipRangeEnd)&&(trialCount < 1000));++k,++trialCount) {
-						uint32_t ip = (ipRangeLen > 0) ? (ipRangeStart + (ipTrialCounter % ipRangeLen)) : ipRangeStart;
-						++ipTrialCounter;
-						if ((ip & 0x000000ff) == 0x000000ff) {
-							continue; // don't allow addresses that end in .255
-						}
+					if ((ip & 0x000000ff) == 0x000000ff) {
+						++ip;
+						continue; // don't allow addresses that end in .255
+					}
 
-						// Check if this IP is within a local-to-Ethernet routed network
-						int routedNetmaskBits = -1;
-						for(unsigned int rk=0;rk<nc->routeCount;++rk) {
-							if (nc->routes[rk].target.ss_family == AF_INET) {
-								uint32_t targetIp = Utils::ntoh((uint32_t)(reinterpret_cast<const struct sockaddr_in *>(&(nc->routes[rk].target))->sin_addr.s_addr));
-								int targetBits = Utils::ntoh((uint16_t)(reinterpret_cast<const struct sockaddr_in *>(&(nc->routes[rk].target))->sin_port));
-								if ((ip & (0xffffffff << (32 - targetBits))) == targetIp) {
-									routedNetmaskBits = targetBits;
-									break;
-								}
+					// Check if this IP is within a local-to-Ethernet routed network
+					int routedNetmaskBits = -1;
+					for(unsigned int rk=0;rk<nc->routeCount;++rk) {
+						if (nc->routes[rk].target.ss_family == AF_INET) {
+							uint32_t targetIp = Utils::ntoh((uint32_t)(reinterpret_cast<const struct sockaddr_in *>(&(nc->routes[rk].target))->sin_addr.s_addr));
+							int targetBits = Utils::ntoh((uint16_t)(reinterpret_cast<const struct sockaddr_in *>(&(nc->routes[rk].target))->sin_port));
+							if ((ip & (0xffffffff << (32 - targetBits))) == targetIp) {
+								routedNetmaskBits = targetBits;
+								break;
 							}
 						}
+					}
 
-						// If it's routed, then try to claim and assign it and if successful end loop
-						const InetAddress ip4(Utils::hton(ip),0);
-						if ( (routedNetmaskBits > 0) && (!std::binary_search(ns.allocatedIps.begin(),ns.allocatedIps.end(),ip4)) ) {
-							char tmpip[64];
-							const std::string ipStr(ip4.toIpString(tmpip));
-							if (std::find(ipAssignments.begin(),ipAssignments.end(),ipStr) == ipAssignments.end()) {
-								ipAssignments.push_back(ipStr);
-								member["ipAssignments"] = ipAssignments;
-								if (nc->staticIpCount < ZT_MAX_ZT_ASSIGNED_ADDRESSES) {
-									struct sockaddr_in *const v4ip = reinterpret_cast<struct sockaddr_in *>(&(nc->staticIps[nc->staticIpCount++]));
-									v4ip->sin_family = AF_INET;
-									v4ip->sin_port = Utils::hton((uint16_t)routedNetmaskBits);
-									v4ip->sin_addr.s_addr = Utils::hton(ip);
-								}
-								haveManagedIpv4AutoAssignment = true;
-								break;
+					// If it's routed, then try to claim and assign it and if successful end loop
+					const InetAddress ip4(Utils::hton(ip),0);
+					if (routedNetmaskBits > 0) {
+						char tmpip[64];
+						const std::string ipStr(ip4.toIpString(tmpip));
+						if ((std::find(ipAssignments.begin(),ipAssignments.end(),ipStr) == ipAssignments.end())&&(_db.claimIp(nwid,ip4))) {
+							claimedIps.ips.push_back(ip4);
+							ipAssignments.push_back(ipStr);
+							member["ipAssignments"] = ipAssignments;
+							if (nc->staticIpCount < ZT_MAX_ZT_ASSIGNED_ADDRESSES) {
+								struct sockaddr_in *const v4ip = reinterpret_cast<struct sockaddr_in *>(&(nc->staticIps[nc->staticIpCount++]));
+								v4ip->sin_family = AF_INET;
+								v4ip->sin_port = Utils::hton((uint16_t)routedNetmaskBits);
+								v4ip->sin_addr.s_addr = Utils::hton(ip);
 							}
+							haveManagedIpv4AutoAssignment = true;
+							break;
 						}
 					}
+					++ip;
 				}
 			}
 		}
 	}
-	
-	if(dns.is_object()) {
-		std::string domain = OSUtils::jsonString(dns["domain"],"");
-		memcpy(nc->dns.domain, domain.c_str(), domain.size());
-		json &addrArray = dns["servers"];
-		if (addrArray.is_array()) {
-			for(unsigned int j = 0; j < addrArray.size() && j < ZT_MAX_DNS_SERVERS; ++j) {
-				json &addr = addrArray[j];
-				nc->dns.server_addr[j] = InetAddress(OSUtils::jsonString(addr,"").c_str());
-			}
-		}
-	} else {
-		dns = json::object();
-	}
 
 	// Issue a certificate of ownership for all static IPs
 	if (nc->staticIpCount) {
@@ -1740,7 +1678,33 @@ void EmbeddedNetworkController::_request(
 
 	DB::cleanMember(member);
 	_db.save(member,true);
-	_sender->ncSendConfig(nwid,requestPacketId,identity.address(),*(nc.get()),metaData.getUI(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_VERSION,0) < 6);
+	claimedIps.ips.clear(); // now held by the saved member
+
+	if (replayable) {
+		std::shared_ptr< std::vector< std::vector<uint8_t> > > chunks(new std::vector< std::vector<uint8_t> >());
+		if (_sender->ncSignConfig(nwid,*(nc.get()),sendLegacyFormatConfig,*chunks)) {
+			{
+				std::lock_guard<std::mutex> l(_signedConfigs_l);
+				// Entries past the longest time bucket can never be replayed again, e.g.
+				// from members that left without being deauthorized, so drop them
+				if ((now - _lastSignedConfigSweep) >= ZT_NETCONF_SIGNED_CONFIG_MAX_AGE) {
+					_lastSignedConfigSweep = now;
+					for(auto i=_signedConfigs.begin();i!=_signedConfigs.end();) {
+						if ((now - i->second.signedAt) > ZT_NETCONF_SIGNED_CONFIG_MAX_AGE)
+							_signedConfigs.erase(i++);
+						else ++i;
+					}
+				}
+				_SignedConfig &sc = _signedConfigs[_MemberStatusKey(nwid,identity.address().toInt())];
+				sc.key = sck;
+				sc.chunks = chunks;
+				sc.signedAt = now;
+			}
+			_sender->ncSendConfigChunks(nwid,requestPacketId,identity.address(),*chunks);
+		}
+	} else {
+		_sender->ncSendConfig(nwid,requestPacketId,identity.address(),*(nc.get()),sendLegacyFormatConfig);
+	}
 }
 
 void EmbeddedNetworkController::_startThreads()
@@ -1748,26 +1712,150 @@ void EmbeddedNetworkController::_startThreads()
 	std::lock_guard<std::mutex> l(_threads_l);
 	if (!_threads.empty())
 		return;
+	{
+		std::lock_guard<std::mutex> ql(_queue_l);
+		if (!_queueRunning)
+			return;
+	}
 	const long hwc = std::max((long)std::thread::hardware_concurrency(),(long)1);
 	for(long t=0;t<hwc;++t) {
 		_threads.emplace_back([this]() {
 			for(;;) {
-				_RQEntry *qe = (_RQEntry *)0;
-				if (!_queue.get(qe))
+				_RQEntry *const qe = _dequeueRequest();
+				if (!qe)
 					break;
 				try {
-					if (qe) {
-						_request(qe->nwid,qe->fromAddr,qe->requestPacketId,qe->identity,qe->metaData);
-						delete qe;
-					}
+					_request(qe->nwid,qe->fromAddr,qe->requestPacketId,qe->identity,qe->metaData);
 				} catch (std::exception &e) {
 					fprintf(stderr,"ERROR: exception in controller request handling thread: %s" ZT_EOL_S,e.what());
 				} catch ( ... ) {
 					fprintf(stderr,"ERROR: exception in controller request handling thread: unknown exception" ZT_EOL_S);
 				}
+				delete qe;
 			}
 		});
 	}
 }
 
+void EmbeddedNetworkController::_queueRequest(uint64_t nwid,const InetAddress &fromAddr,uint64_t requestPacketId,const Identity &identity,const Dictionary<ZT_NETWORKCONFIG_METADATA_DICT_CAPACITY> &metaData,bool join)
+{
+	_startThreads();
+	_RQEntry *qe = new _RQEntry;
+	qe->nwid = nwid;
+	qe->requestPacketId = requestPacketId;
+	qe->fromAddr = fromAddr;
+	qe->identity = identity;
+	qe->metaData = metaData;
+	qe->type = _RQEntry::RQENTRY_TYPE_REQUEST;
+	qe->join = join;
+
+	const _MemberStatusKey k(nwid,identity.address().toInt());
+	std::lock_guard<std::mutex> l(_queue_l);
+	if (!_queueRunning) {
+		delete qe;
+		return;
+	}
+
+	// A member that retries while its last request is still queued only needs
+	// one answer, so fold the retry into the queued entry and reply to the
+	// newest packet. The entry keeps its place and its wait time. A push has
+	// no packet to reply to, so it must not replace the one a request has.
+	auto q = _queued.find(k);
+	if (q != _queued.end()) {
+		if (q->second->identity == qe->identity) {
+			if (qe->requestPacketId) {
+				q->second->requestPacketId = qe->requestPacketId;
+				q->second->fromAddr = qe->fromAddr;
+			}
+			q->second->metaData = qe->metaData;
+		}
+		++_requestsCoalesced;
+		delete qe;
+		return;
+	}
+
+	// When full, make room for a join by dropping the longest waiting refresh.
+	// Members retry on their own, so a shed request costs a delay, not a member.
+	if (_queued.size() >= ZT_NETCONF_MAX_QUEUED_REQUESTS) {
+		if ((!qe->join)||(_refreshQueue.empty())) {
+			++_requestsShed;
+			delete qe;
+			return;
+		}
+		_RQEntry *const old = _refreshQueue.front();
+		_refreshQueue.pop_front();
+		_queued.erase(_MemberStatusKey(old->nwid,old->identity.address().toInt()));
+		delete old;
+		++_requestsShed;
+	}
+
+	qe->queuedAt = std::chrono::steady_clock::now();
+	_queued[k] = qe;
+	if (qe->join) {
+		_joinQueue.push_back(qe);
+	} else {
+		_refreshQueue.push_back(qe);
+	}
+	_queue_c.notify_one();
+}
+
+EmbeddedNetworkController::_RQEntry *EmbeddedNetworkController::_dequeueRequest()
+{
+	std::unique_lock<std::mutex> l(_queue_l);
+	for(;;) {
+		if (!_queueRunning)
+			return (_RQEntry *)0;
+		if ((!_joinQueue.empty())||(!_refreshQueue.empty()))
+			break;
+		_queue_c.wait(l);
+	}
+
+	// Joins go first, but a steady stream of them must not starve refreshes.
+	_RQEntry *qe;
+	if ((!_joinQueue.empty())&&((_refreshQueue.empty())||(_joinStreak < ZT_NETCONF_MAX_JOIN_STREAK))) {
+		qe = _joinQueue.front();
+		_joinQueue.pop_front();
+		++_joinStreak;
+	} else {
+		qe = _refreshQueue.front();
+		_refreshQueue.pop_front();
+		_joinStreak = 0;
+	}
+	_queued.erase(_MemberStatusKey(qe->nwid,qe->identity.address().toInt()));
+
+	const int64_t waited = (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - qe->queuedAt).count();
+	const uint32_t w = (uint32_t)std::min(std::max(waited,(int64_t)0),(int64_t)0xffffffff);
+	if (_queueWaits.size() < ZT_NETCONF_QUEUE_WAIT_SAMPLES) {
+		_queueWaits.push_back(w);
+	} else {
+		_queueWaits[_queueWaitPtr] = w;
+		_queueWaitPtr = (_queueWaitPtr + 1) % ZT_NETCONF_QUEUE_WAIT_SAMPLES;
+	}
+
+	return qe;
+}
+
+void EmbeddedNetworkController::_requestQueueStats(_RequestQueueStats &stats)
+{
+	std::vector<uint32_t> waits;
+	{
+		std::lock_guard<std::mutex> l(_queue_l);
+		stats.depth = (unsigned long)_queued.size();
+		stats.joins = (unsigned long)_joinQueue.size();
+		stats.coalesced = _requestsCoalesced;
+		stats.shed = _requestsShed;
+		waits = _queueWaits;
+	}
+	stats.waitP50 = 0.0;
+	stats.waitP99 = 0.0;
+	if (!waits.empty()) {
+		std::vector<uint32_t>::iterator p(waits.begin() + (waits.size() / 2));
+		std::nth_element(waits.begin(),p,waits.end());
+		stats.waitP50 = (double)*p / 1000.0;
+		p = waits.begin() + ((waits.size() * 99) / 100);
+		std::nth_element(waits.begin(),p,waits.end());
+		stats.waitP99 = (double)*p / 1000.0;
+	}
+}
+
 } // namespace ZeroTier
@@ -21,9 +21,15 @@
 #include <vector>
 #include <set>
 #include <list>
+#include <deque>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <unordered_map>
 #include <atomic>
+#include <memory>
+#include <chrono>
+#include <functional>
 
 #include "../node/Constants.hpp"
 #include "../node/NetworkController.hpp"
@@ -33,7 +39,6 @@
 
 #include "../osdep/OSUtils.hpp"
 #include "../osdep/Thread.hpp"
-#include "../osdep/BlockingQueue.hpp"
 
 #include "../ext/json/json.hpp"
 
@@ -64,6 +69,14 @@ public:
 		const Identity &identity,
 		const Dictionary<ZT_NETWORKCONFIG_METADATA_DICT_CAPACITY> &metaData);
 
+	/**
+	 * Produces the rest of a response body in parts
+	 *
+	 * Each call appends the next part and returns false once the body is
+	 * complete.
+	 */
+	typedef std::function<bool (std::string &)> ResponseStream;
+
 	unsigned int handleControlPlaneHttpGET(
 		const std::vector<std::string> &path,
 		const std::map<std::string,std::string> &urlArgs,
@@ -71,6 +84,21 @@ public:
 		const std::string &body,
 		std::string &responseBody,
 		std::string &responseContentType);
+
+	/**
+	 * Handle a GET, possibly leaving the rest of a large body to a stream
+	 *
+	 * If responseStream is set on return, responseBody holds only the start of
+	 * the body and the caller must pull the rest from the stream.
+	 */
+	unsigned int handleControlPlaneHttpGET(
+		const std::vector<std::string> &path,
+		const std::map<std::string,std::string> &urlArgs,
+		const std::map<std::string,std::string> &headers,
+		const std::string &body,
+		std::string &responseBody,
+		std::string &responseContentType,
+		ResponseStream &responseStream);
 	unsigned int handleControlPlaneHttpPOST(
 		const std::vector<std::string> &path,
 		const std::map<std::string,std::string> &urlArgs,
@@ -106,6 +134,8 @@ private:
 		enum {
 			RQENTRY_TYPE_REQUEST = 0
 		} type;
+		std::chrono::steady_clock::time_point queuedAt;
+		bool join; // requester is not yet a member of the network
 	};
 	struct _MemberStatusKey
 	{
@@ -131,6 +161,42 @@ private:
 			return (std::size_t)(networkIdNodeId.networkId + networkIdNodeId.nodeId);
 		}
 	};
+	struct _RequestQueueStats
+	{
+		unsigned long depth;
+		unsigned long joins;
+		uint64_t coalesced;
+		uint64_t shed;
+		double waitP50;
+		double waitP99;
+	};
+
+	void _queueRequest(uint64_t nwid,const InetAddress &fromAddr,uint64_t requestPacketId,const Identity &identity,const Dictionary<ZT_NETWORKCONFIG_METADATA_DICT_CAPACITY> &metaData,bool join);
+	_RQEntry *_dequeueRequest();
+	void _requestQueueStats(_RequestQueueStats &stats);
+
+	struct _SignedConfigKey
+	{
+		_SignedConfigKey() : networkRevision(0),memberRevision(0),credentialTimeMaxDelta(0),credentialTimeBucket(0),activeBridges(0),rulesEngine(false),legacyFormat(false) {}
+		uint64_t networkRevision;
+		uint64_t memberRevision;
+		int64_t credentialTimeMaxDelta;
+		int64_t credentialTimeBucket;
+		uint64_t activeBridges;
+		bool rulesEngine;
+		bool legacyFormat;
+		inline bool operator==(const _SignedConfigKey &k) const
+		{
+			return ((k.networkRevision == networkRevision)&&(k.memberRevision == memberRevision)&&(k.credentialTimeMaxDelta == credentialTimeMaxDelta)&&(k.credentialTimeBucket == credentialTimeBucket)&&(k.activeBridges == activeBridges)&&(k.rulesEngine == rulesEngine)&&(k.legacyFormat == legacyFormat));
+		}
+	};
+	struct _SignedConfig
+	{
+		_SignedConfig() : signedAt(0) {}
+		_SignedConfigKey key;
+		std::shared_ptr< const std::vector< std::vector<uint8_t> > > chunks;
+		int64_t signedAt;
+	};
 
 	const int64_t _startTime;
 	int _listenPort;
@@ -142,7 +208,20 @@ private:
 	NetworkController::Sender *_sender;
 
 	DBMirrorSet _db;
-	BlockingQueue< _RQEntry * > _queue;
+
+	// Pending requests, with joins served ahead of refreshes from members that
+	// already exist. A member has at most one entry queued at a time.
+	std::deque< _RQEntry * > _joinQueue;
+	std::deque< _RQEntry * > _refreshQueue;
+	std::unordered_map< _MemberStatusKey,_RQEntry *,_MemberStatusHash > _queued;
+	unsigned long _joinStreak;
+	bool _queueRunning;
+	uint64_t _requestsCoalesced;
+	uint64_t _requestsShed;
+	std::vector<uint32_t> _queueWaits; // ring of recent queue waits in microseconds
+	unsigned long _queueWaitPtr;
+	std::mutex _queue_l;
+	std::condition_variable _queue_c;
 
 	std::vector<std::thread> _threads;
 	std::mutex _threads_l;
@@ -150,6 +229,13 @@ private:
 	std::unordered_map< _MemberStatusKey,_MemberStatus,_MemberStatusHash > _memberStatus;
 	std::mutex _memberStatus_l;
 
+	// Most recent serialized and signed config sent to each member
+	std::unordered_map< _MemberStatusKey,_SignedConfig,_MemberStatusHash > _signedConfigs;
+	int64_t _lastSignedConfigSweep;
+	std::mutex _signedConfigs_l;
+	std::atomic<uint64_t> _signedConfigHits;
+	std::atomic<uint64_t> _signedConfigMisses;
+
 	RedisConfig *_rc;
 };
 
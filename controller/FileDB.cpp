@@ -28,18 +28,29 @@ FileDB::FileDB(const char *path) :
 	OSUtils::mkdir(_networksPath.c_str());
 	OSUtils::mkdir(_tracePath.c_str());
 
-	std::vector<std::string> networks(OSUtils::listDirectory(_networksPath.c_str(),false));
+	forEachRecord(_networksPath,[this](nlohmann::json &record,bool isMember) {
+		nlohmann::json nullJson;
+		if (isMember) {
+			_memberChanged(nullJson,record,false);
+		} else {
+			_networkChanged(nullJson,record,false);
+		}
+	});
+}
+
+void FileDB::forEachRecord(const std::string &networksPath,const std::function<void(nlohmann::json &,bool)> &f)
+{
+	std::vector<std::string> networks(OSUtils::listDirectory(networksPath.c_str(),false));
 	std::string buf;
 	for(auto n=networks.begin();n!=networks.end();++n) {
 		buf.clear();
-		if ((n->length() == 21)&&(OSUtils::readFile((_networksPath + ZT_PATH_SEPARATOR_S + *n).c_str(),buf))) {
+		if ((n->length() == 21)&&(OSUtils::readFile((networksPath + ZT_PATH_SEPARATOR_S + *n).c_str(),buf))) {
 			try {
 				nlohmann::json network(OSUtils::jsonParse(buf));
 				const std::string nwids = network["id"];
 				if (nwids.length() == 16) {
-					nlohmann::json nullJson;
-					_networkChanged(nullJson,network,false);
-					std::string membersPath(_networksPath + ZT_PATH_SEPARATOR_S + nwids + ZT_PATH_SEPARATOR_S "member");
+					f(network,false);
+					std::string membersPath(networksPath + ZT_PATH_SEPARATOR_S + nwids + ZT_PATH_SEPARATOR_S "member");
 					std::vector<std::string> members(OSUtils::listDirectory(membersPath.c_str(),false));
 					for(auto m=members.begin();m!=members.end();++m) {
 						buf.clear();
@@ -48,8 +59,7 @@ FileDB::FileDB(const char *path) :
 								nlohmann::json member(OSUtils::jsonParse(buf));
 								const std::string addrs = member["id"];
 								if (addrs.length() == 10) {
-									nlohmann::json nullJson2;
-									_memberChanged(nullJson2,member,false);
+									f(member,true);
 								}
 							} catch ( ... ) {}
 						}
@@ -16,6 +16,8 @@
 
 #include "DB.hpp"
 
+#include <functional>
+
 namespace ZeroTier
 {
 
@@ -32,6 +34,16 @@ public:
 	virtual void eraseMember(const uint64_t networkId,const uint64_t memberId);
 	virtual void nodeIsOnline(const uint64_t networkId,const uint64_t memberId,const InetAddress &physicalAddress);
 
+	/**
+	 * Read every record stored in a FileDB directory tree
+	 *
+	 * Each network is visited before its members. Unreadable files are skipped.
+	 *
+	 * @param networksPath Path to the "network" directory
+	 * @param f Function called with each record and true if it is a member
+	 */
+	static void forEachRecord(const std::string &networksPath,const std::function<void(nlohmann::json &,bool)> &f);
+
 protected:
 	std::string _path;
 	std::string _networksPath;
@@ -0,0 +1,501 @@
+/*
+ * Copyright (c)2019 ZeroTier, Inc.
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file in the project's root directory.
+ *
+ * Change Date: 2025-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2.0 of the Apache License.
+ */
+/****/
+
+#include "LogDB.hpp"
+#include "FileDB.hpp"
+
+#include <string.h>
+#include <chrono>
+
+#ifdef __WINDOWS__
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Log file header, bumped if the record format ever changes
+#define ZT_LOGDB_MAGIC "ZTLOGDB1"
+#define ZT_LOGDB_MAGIC_LEN 8
+
+// Record header: payload length, CRC-32 of everything after it, type, 3 reserved bytes, network ID, member ID
+#define ZT_LOGDB_HEADER_LEN 28
+
+namespace ZeroTier
+{
+
+namespace {
+
+struct _Crc32Table
+{
+	_Crc32Table()
+	{
+		for(uint32_t i=0;i<256;++i) {
+			uint32_t c = i;
+			for(int k=0;k<8;++k)
+				c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+			t[i] = c;
+		}
+	}
+	uint32_t t[256];
+};
+
+static uint32_t _crc32(const uint8_t *p,unsigned long len)
+{
+	static const _Crc32Table table;
+	uint32_t c = 0xffffffff;
+	while (len--)
+		c = table.t[(c ^ *(p++)) & 0xff] ^ (c >> 8);
+	return c ^ 0xffffffff;
+}
+
+static inline void _put32(uint8_t *p,const uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);
+	p[3] = (uint8_t)v;
+}
+
+static inline void _put64(uint8_t *p,const uint64_t v)
+{
+	_put32(p,(uint32_t)(v >> 32));
+	_put32(p + 4,(uint32_t)v);
+}
+
+static inline uint32_t _get32(const uint8_t *p)
+{
+	return (((uint32_t)p[0] << 24)|((uint32_t)p[1] << 16)|((uint32_t)p[2] << 8)|(uint32_t)p[3]);
+}
+
+static inline uint64_t _get64(const uint8_t *p)
+{
+	return (((uint64_t)_get32(p) << 32)|(uint64_t)_get32(p + 4));
+}
+
+static void _syncFile(FILE *f)
+{
+#ifdef __WINDOWS__
+	_commit(_fileno(f));
+#else
+	fsync(fileno(f));
+#endif
+}
+
+static bool _replaceFile(const char *from,const char *to)
+{
+#ifdef __WINDOWS__
+	return (MoveFileExA(from,to,MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH) != FALSE);
+#else
+	return (rename(from,to) == 0);
+#endif
+}
+
+} // anonymous namespace
+
+LogDB::LogDB(const char *path) :
+	DB(),
+	_path(path),
+	_logPath(_path + ZT_PATH_SEPARATOR_S + "controller.log"),
+	_networksPath(_path + ZT_PATH_SEPARATOR_S + "network"),
+	_log((FILE *)0),
+	_logSize(0),
+	_liveSize(0),
+	_dirty(false),
+	_rewrite(false),
+	_running(true)
+{
+	OSUtils::mkdir(_path.c_str());
+	OSUtils::lockDownFile(_path.c_str(),true);
+	_load();
+	_syncThread = std::thread(&LogDB::_syncMain,this);
+}
+
+LogDB::~LogDB()
+{
+	{
+		std::lock_guard<std::mutex> l(_log_l);
+		_running = false;
+		_sync_c.notify_all();
+	}
+	_syncThread.join();
+	std::lock_guard<std::mutex> l(_log_l);
+	if (_log) {
+		_syncFile(_log);
+		fclose(_log);
+		_log = (FILE *)0;
+	}
+}
+
+bool LogDB::waitForReady() { return true; }
+bool LogDB::isReady() { return true; }
+
+bool LogDB::save(nlohmann::json &record,bool notifyListeners)
+{
+	bool modified = false;
+	try {
+		const std::string objtype = record["objtype"];
+		if (objtype == "network") {
+
+			const uint64_t nwid = OSUtils::jsonIntHex(record["id"],0ULL);
+			if (nwid) {
+				nlohmann::json old;
+				get(nwid,old);
+				if ((!old.is_object())||(!_compareRecords(old,record))) {
+					record["revision"] = OSUtils::jsonInt(record["revision"],0ULL) + 1ULL;
+					_append(RECORD_NETWORK,nwid,0,OSUtils::jsonDump(record,-1));
+					_networkChanged(old,record,notifyListeners);
+					modified = true;
+				}
+			}
+
+		} else if (objtype == "member") {
+
+			const uint64_t id = OSUtils::jsonIntHex(record["id"],0ULL);
+			const uint64_t nwid = OSUtils::jsonIntHex(record["nwid"],0ULL);
+			if ((id)&&(nwid)) {
+				nlohmann::json network,old;
+				get(nwid,network,id,old);
+				if ((!old.is_object())||(!_compareRecords(old,record))) {
+					record["revision"] = OSUtils::jsonInt(record["revision"],0ULL) + 1ULL;
+					_append(RECORD_MEMBER,nwid,id,OSUtils::jsonDump(record,-1));
+					_memberChanged(old,record,notifyListeners);
+					modified = true;
+				}
+			}
+
+		}
+	} catch ( ... ) {} // drop invalid records missing fields
+	return modified;
+}
+
+void LogDB::eraseNetwork(const uint64_t networkId)
+{
+	nlohmann::json network,nullJson;
+	get(networkId,network);
+	_append(RECORD_ERASE_NETWORK,networkId,0,std::string());
+	_networkChanged(network,nullJson,true);
+	std::lock_guard<std::mutex> l(this->_online_l);
+	this->_online.erase(networkId);
+}
+
+void LogDB::eraseMember(const uint64_t networkId,const uint64_t memberId)
+{
+	nlohmann::json network,member,nullJson;
+	get(networkId,network,memberId,member);
+	_append(RECORD_ERASE_MEMBER,networkId,memberId,std::string());
+	_memberChanged(member,nullJson,true);
+	std::lock_guard<std::mutex> l(this->_online_l);
+	this->_online[networkId].erase(memberId);
+}
+
+void LogDB::nodeIsOnline(const uint64_t networkId,const uint64_t memberId,const InetAddress &physicalAddress)
+{
+	std::lock_guard<std::mutex> l(this->_online_l);
+	this->_online[networkId][memberId][OSUtils::now()] = physicalAddress;
+}
+
+uint64_t LogDB::logSize()
+{
+	std::lock_guard<std::mutex> l(_log_l);
+	return _logSize;
+}
+
+void LogDB::_load()
+{
+	// A leftover temporary file is from an interrupted compaction or import.
+	// The log it was going to replace, or the FileDB tree, is still complete.
+	const std::string tmpPath(_logPath + ".tmp");
+	OSUtils::rm(tmpPath.c_str());
+
+	std::string buf;
+	if (!OSUtils::readFile(_logPath.c_str(),buf)) {
+		unsigned long networks = 0,members = 0;
+		FileDB::forEachRecord(_networksPath,[&](nlohmann::json &record,bool isMember) {
+			nlohmann::json nullJson;
+			if (isMember) {
+				_memberChanged(nullJson,record,false);
+				++members;
+			} else {
+				_networkChanged(nullJson,record,false);
+				++networks;
+			}
+		});
+		if ((!networks)&&(!members)) {
+			std::lock_guard<std::mutex> l(_log_l);
+			_open();
+			return;
+		}
+
+		// The import is written to a temporary file and only renamed into place
+		// once it is complete and synced, so a crash part way through leaves no
+		// log and the next start imports again.
+		{
+			std::lock_guard<std::mutex> l(_log_l);
+			_log = fopen(tmpPath.c_str(),"w+b");
+			if ((!_log)||(fwrite(ZT_LOGDB_MAGIC,1,ZT_LOGDB_MAGIC_LEN,_log) != ZT_LOGDB_MAGIC_LEN)) {
+				fprintf(stderr,"WARNING: controller unable to import into database log: %s" ZT_EOL_S,tmpPath.c_str());
+				if (_log)
+					fclose(_log);
+				_log = (FILE *)0;
+				OSUtils::rm(tmpPath.c_str());
+				return;
+			}
+			_logSize = ZT_LOGDB_MAGIC_LEN;
+		}
+		each([this](uint64_t networkId,nlohmann::json &network,uint64_t memberId,nlohmann::json &member) {
+			if (memberId) {
+				_append(RECORD_MEMBER,networkId,memberId,OSUtils::jsonDump(member,-1));
+			} else {
+				_append(RECORD_NETWORK,networkId,0,OSUtils::jsonDump(network,-1));
+			}
+		});
+		std::lock_guard<std::mutex> l(_log_l);
+		const bool ok = ((!_rewrite)&&(fflush(_log) == 0));
+		if (ok)
+			_syncFile(_log);
+		fclose(_log);
+		_log = (FILE *)0;
+		_dirty = false;
+		_rewrite = false;
+		if ((!ok)||(!_replaceFile(tmpPath.c_str(),_logPath.c_str()))) {
+			// Saves are refused until restart, which imports again
+			OSUtils::rm(tmpPath.c_str());
+			fprintf(stderr,"WARNING: controller unable to import into database log: %s" ZT_EOL_S,_logPath.c_str());
+			return;
+		}
+		if (_open())
+			fprintf(stderr,"NOTICE: controller imported %lu networks and %lu members into %s" ZT_EOL_S,networks,members,_logPath.c_str());
+		return;
+	}
+
+	uint64_t good = 0;
+	if ((buf.length() >= ZT_LOGDB_MAGIC_LEN)&&(memcmp(buf.data(),ZT_LOGDB_MAGIC,ZT_LOGDB_MAGIC_LEN) == 0)) {
+		// Replay headers to find each key's latest record, stopping at the first
+		// record that is truncated or fails its checksum.
+		const uint8_t *const b = reinterpret_cast<const uint8_t *>(buf.data());
+		good = ZT_LOGDB_MAGIC_LEN;
+		while ((good + ZT_LOGDB_HEADER_LEN) <= (uint64_t)buf.length()) {
+			const uint32_t len = _get32(b + good);
+			if (((uint64_t)buf.length() - (good + ZT_LOGDB_HEADER_LEN)) < (uint64_t)len)
+				break;
+			if (_crc32(b + good + 8,(ZT_LOGDB_HEADER_LEN - 8) + len) != _get32(b + good + 4))
+				break;
+			const unsigned int type = b[good + 8];
+			const uint64_t nwid = _get64(b + good + 12);
+			const uint64_t mid = _get64(b + good + 20);
+			if ((type == RECORD_NETWORK)||(type == RECORD_MEMBER)) {
+				_Extent &e = _index[std::pair<uint64_t,uint64_t>(nwid,(type == RECORD_NETWORK) ? 0ULL : mid)];
+				e.offset = good;
+				e.size = ZT_LOGDB_HEADER_LEN + len;
+			} else if (type == RECORD_ERASE_NETWORK) {
+				auto i = _index.lower_bound(std::pair<uint64_t,uint64_t>(nwid,0ULL));
+				while ((i != _index.end())&&(i->first.first == nwid))
+					_index.erase(i++);
+			} else if (type == RECORD_ERASE_MEMBER) {
+				_index.erase(std::pair<uint64_t,uint64_t>(nwid,mid));
+			} else {
+				break;
+			}
+			good += ZT_LOGDB_HEADER_LEN + len;
+		}
+
+		// Networks sort before their members since the network key's member ID is 0
+		for(auto i=_index.begin();i!=_index.end();) {
+			try {
+				nlohmann::json record(OSUtils::jsonParse(buf.substr((std::string::size_type)(i->second.offset + ZT_LOGDB_HEADER_LEN),(std::string::size_type)(i->second.size - ZT_LOGDB_HEADER_LEN))));
+				nlohmann::json nullJson;
+				if (i->first.second) {
+					_memberChanged(nullJson,record,false);
+				} else {
+					_networkChanged(nullJson,record,false);
+				}
+				_liveSize += i->second.size;
+				++i;
+			} catch ( ... ) {
+				_index.erase(i++);
+			}
+		}
+	} else if (buf.length() >= ZT_LOGDB_MAGIC_LEN) {
+		fprintf(stderr,"FATAL: %s is not a controller database log" ZT_EOL_S,_logPath.c_str());
+		exit(1);
+	}
+
+	std::lock_guard<std::mutex> l(_log_l);
+	if (!good)
+		OSUtils::rm(_logPath.c_str()); // crashed before the file header was written
+	if (!_open())
+		return;
+	if ((good)&&(good < _logSize)) {
+		fprintf(stderr,"WARNING: discarding %llu bytes of incomplete or corrupt records at the end of %s" ZT_EOL_S,(unsigned long long)(_logSize - good),_logPath.c_str());
+		_compact();
+	} else if ((_logSize >= ZT_LOGDB_COMPACT_MIN_SIZE)&&(_logSize > (_liveSize * ZT_LOGDB_COMPACT_RATIO))) {
+		_compact();
+	}
+}
+
+bool LogDB::_open()
+{
+	_log = fopen(_logPath.c_str(),"a+b");
+	if (!_log) {
+		fprintf(stderr,"WARNING: controller unable to open database log: %s" ZT_EOL_S,_logPath.c_str());
+		return false;
+	}
+	fseek(_log,0,SEEK_END);
+	_logSize = (uint64_t)ftell(_log);
+	if (!_logSize) {
+		if ((fwrite(ZT_LOGDB_MAGIC,1,ZT_LOGDB_MAGIC_LEN,_log) != ZT_LOGDB_MAGIC_LEN)||(fflush(_log) != 0)) {
+			fprintf(stderr,"WARNING: controller unable to write to database log: %s" ZT_EOL_S,_logPath.c_str());
+			fclose(_log);
+			_log = (FILE *)0;
+			return false;
+		}
+		_syncFile(_log);
+		_logSize = ZT_LOGDB_MAGIC_LEN;
+	}
+	return true;
+}
+
+void LogDB::_append(RecordType type,uint64_t networkId,uint64_t memberId,const std::string &payload)
+{
+	std::string rec;
+	rec.resize(ZT_LOGDB_HEADER_LEN);
+	uint8_t *const h = reinterpret_cast<uint8_t *>(&(rec[0]));
+	_put32(h,(uint32_t)payload.length());
+	h[8] = (uint8_t)type;
+	h[9] = 0;
+	h[10] = 0;
+	h[11] = 0;
+	_put64(h + 12,networkId);
+	_put64(h + 20,memberId);
+	rec.append(payload);
+	_put32(reinterpret_cast<uint8_t *>(&(rec[4])),_crc32(reinterpret_cast<const uint8_t *>(rec.data()) + 8,(unsigned long)rec.length() - 8));
+
+	std::lock_guard<std::mutex> l(_log_l);
+	if (!_log) {
+		fprintf(stderr,"WARNING: controller unable to write to database log: %s" ZT_EOL_S,_logPath.c_str());
+		return;
+	}
+
+	// Flushing hands the record to the OS so it survives a crash of this
+	// process. The sync thread gets it onto the disk shortly after.
+	fseek(_log,0,SEEK_END);
+	const uint64_t offset = (uint64_t)ftell(_log);
+	if ((fwrite(rec.data(),1,rec.length(),_log) != rec.length())||(fflush(_log) != 0)) {
+		fprintf(stderr,"WARNING: controller unable to write to database log: %s" ZT_EOL_S,_logPath.c_str());
+		// Whatever part of the record made it out would hide everything after
+		// it on the next load, so have the sync thread rewrite the log.
+		_rewrite = true;
+		_sync_c.notify_one();
+		return;
+	}
+	_logSize = offset + rec.length();
+	_dirty = true;
+
+	if ((type == RECORD_NETWORK)||(type == RECORD_MEMBER)) {
+		_Extent &e = _index[std::pair<uint64_t,uint64_t>(networkId,(type == RECORD_NETWORK) ? 0ULL : memberId)];
+		if (e.size)
+			_liveSize -= e.size;
+		e.offset = offset;
+		e.size = (uint32_t)rec.length();
+		_liveSize += e.size;
+	} else if (type == RECORD_ERASE_NETWORK) {
+		auto i = _index.lower_bound(std::pair<uint64_t,uint64_t>(networkId,0ULL));
+		while ((i != _index.end())&&(i->first.first == networkId)) {
+			_liveSize -= i->second.size;
+			_index.erase(i++);
+		}
+	} else {
+		auto i = _index.find(std::pair<uint64_t,uint64_t>(networkId,memberId));
+		if (i != _index.end()) {
+			_liveSize -= i->second.size;
+			_index.erase(i);
+		}
+	}
+
+	if ((_logSize >= ZT_LOGDB_COMPACT_MIN_SIZE)&&(_logSize > (_liveSize * ZT_LOGDB_COMPACT_RATIO)))
+		_sync_c.notify_one();
+}
+
+bool LogDB::_compact()
+{
+	// Copies the latest record for each key into a new file and swaps it in.
+	// Records are copied as-is, so this is sequential I/O with no JSON work,
+	// but saves wait on _log_l until it is done.
+	const std::string tmpPath(_logPath + ".tmp");
+	FILE *out = fopen(tmpPath.c_str(),"wb");
+	if (!out) {
+		fprintf(stderr,"WARNING: controller unable to compact database log: %s" ZT_EOL_S,tmpPath.c_str());
+		return false;
+	}
+
+	std::vector<uint64_t> offsets;
+	offsets.reserve(_index.size());
+	std::vector<char> rec;
+	uint64_t outSize = ZT_LOGDB_MAGIC_LEN;
+	bool ok = ((fflush(_log) == 0)&&(fwrite(ZT_LOGDB_MAGIC,1,ZT_LOGDB_MAGIC_LEN,out) == ZT_LOGDB_MAGIC_LEN));
+	for(auto i=_index.begin();(ok)&&(i!=_index.end());++i) {
+		rec.resize(i->second.size);
+		ok = ((fseek(_log,(long)i->second.offset,SEEK_SET) == 0)&&(fread(rec.data(),1,rec.size(),_log) == rec.size())&&(fwrite(rec.data(),1,rec.size(),out) == rec.size()));
+		offsets.push_back(outSize);
+		outSize += rec.size();
+	}
+	ok = ok && (fflush(out) == 0);
+	if (ok)
+		_syncFile(out);
+	fclose(out);
+	if (!ok) {
+		OSUtils::rm(tmpPath.c_str());
+		fprintf(stderr,"WARNING: controller unable to compact database log: %s" ZT_EOL_S,_logPath.c_str());
+		return false;
+	}
+
+	fclose(_log);
+	_log = (FILE *)0;
+	if (!_replaceFile(tmpPath.c_str(),_logPath.c_str())) {
+		OSUtils::rm(tmpPath.c_str());
+		fprintf(stderr,"WARNING: controller unable to replace database log: %s" ZT_EOL_S,_logPath.c_str());
+		_open();
+		return false;
+	}
+
+	auto o = offsets.begin();
+	for(auto i=_index.begin();i!=_index.end();++i)
+		i->second.offset = *(o++);
+	_liveSize = outSize - ZT_LOGDB_MAGIC_LEN;
+	_dirty = false;
+	_rewrite = false;
+	return _open();
+}
+
+void LogDB::_syncMain()
+{
+	std::unique_lock<std::mutex> l(_log_l);
+	while (_running) {
+		_sync_c.wait_for(l,std::chrono::milliseconds(ZT_LOGDB_SYNC_INTERVAL));
+		if (!_log)
+			continue;
+		if ((_rewrite)||((_logSize >= ZT_LOGDB_COMPACT_MIN_SIZE)&&(_logSize > (_liveSize * ZT_LOGDB_COMPACT_RATIO)))) {
+			_compact();
+		} else if (_dirty) {
+			// The FILE is only ever replaced by this thread, so it stays valid
+			// while the lock is released for the sync.
+			_dirty = false;
+			FILE *const f = _log;
+			l.unlock();
+			_syncFile(f);
+			l.lock();
+		}
+	}
+}
+
+} // namespace ZeroTier
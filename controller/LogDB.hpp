@@ -0,0 +1,109 @@
+/*
+ * Copyright (c)2019 ZeroTier, Inc.
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file in the project's root directory.
+ *
+ * Change Date: 2025-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2.0 of the Apache License.
+ */
+/****/
+
+#ifndef ZT_CONTROLLER_LOGDB_HPP
+#define ZT_CONTROLLER_LOGDB_HPP
+
+#include "DB.hpp"
+
+#include <stdio.h>
+#include <condition_variable>
+
+// Maximum time appended records may sit in the OS page cache before being synced to disk (ms)
+#define ZT_LOGDB_SYNC_INTERVAL 100
+
+// Logs smaller than this are never compacted
+#define ZT_LOGDB_COMPACT_MIN_SIZE 1048576
+
+// Compact once the log is this many times larger than the live records it holds
+#define ZT_LOGDB_COMPACT_RATIO 2
+
+namespace ZeroTier
+{
+
+/**
+ * A local controller database kept in a single append-only record log
+ *
+ * Every save appends one checksummed record instead of rewriting a file, and
+ * an in-memory index maps each network and member to its latest record. The
+ * log is synced to disk in the background at most every ZT_LOGDB_SYNC_INTERVAL
+ * ms and rewritten without superseded records once it has grown to
+ * ZT_LOGDB_COMPACT_RATIO times the size of the live data.
+ *
+ * On startup a torn or corrupt tail left by a crash is discarded. If there is
+ * no log yet but the directory holds a FileDB tree, its records are imported,
+ * and the log only appears once the import is complete.
+ * The old JSON files are left in place but are no longer updated.
+ */
+class LogDB : public DB
+{
+public:
+	LogDB(const char *path);
+	virtual ~LogDB();
+
+	virtual bool waitForReady();
+	virtual bool isReady();
+	virtual bool save(nlohmann::json &record,bool notifyListeners);
+	virtual void eraseNetwork(const uint64_t networkId);
+	virtual void eraseMember(const uint64_t networkId,const uint64_t memberId);
+	virtual void nodeIsOnline(const uint64_t networkId,const uint64_t memberId,const InetAddress &physicalAddress);
+
+	/**
+	 * @return Current size of the log file in bytes
+	 */
+	uint64_t logSize();
+
+protected:
+	enum RecordType
+	{
+		RECORD_NETWORK = 1,
+		RECORD_MEMBER = 2,
+		RECORD_ERASE_NETWORK = 3,
+		RECORD_ERASE_MEMBER = 4
+	};
+
+	// Location of a key's latest record in the log, header included
+	struct _Extent
+	{
+		uint64_t offset;
+		uint32_t size;
+	};
+
+	void _load();
+	bool _open();
+	void _append(RecordType type,uint64_t networkId,uint64_t memberId,const std::string &payload);
+	bool _compact();
+	void _syncMain();
+
+	std::string _path;
+	std::string _logPath;
+	std::string _networksPath;
+
+	FILE *_log;
+	uint64_t _logSize;
+	uint64_t _liveSize;
+	std::map< std::pair<uint64_t,uint64_t>,_Extent > _index; // member ID 0 is the network record
+	bool _dirty;
+	bool _rewrite;
+	bool _running;
+	std::mutex _log_l;
+	std::condition_variable _sync_c;
+	std::thread _syncThread;
+
+	std::map< uint64_t,std::map<uint64_t,std::map<int64_t,InetAddress> > > _online;
+	std::mutex _online_l;
+};
+
+} // namespace ZeroTier
+
+#endif
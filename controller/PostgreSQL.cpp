@@ -23,6 +23,9 @@
 #include <libpq-fe.h>
 #include <sstream>
 #include <climits>
+#include <deque>
+#include <functional>
+#include <condition_variable>
 
 
 using json = nlohmann::json;
@@ -48,6 +51,506 @@ static const char *_timestr()
 	return ts;
 }
 
+/**
+ * Run a query in single row mode and hand rows to parser threads as they arrive
+ *
+ * Rows are passed on in batches so parsing overlaps the transfer and the full
+ * result set is never held in memory at once. The row handler is called from
+ * up to maxThreads threads concurrently and must do its own locking for any
+ * shared state. The first exception thrown by a handler stops the load and is
+ * rethrown to the caller once all threads have finished.
+ *
+ * @return Empty string on success or the query error
+ */
+static std::string _streamRows(PGconn *conn,const char *query,int nParams,const char *const *params,unsigned int maxThreads,const std::function<void(const PGresult *)> &rowHandler)
+{
+	static const unsigned long ROWS_PER_BATCH = 256;
+	static const unsigned long MAX_QUEUED_BATCHES = 64;
+
+	if (!PQsendQueryParams(conn,query,nParams,NULL,params,NULL,NULL,0))
+		return std::string(PQerrorMessage(conn));
+	PQsetSingleRowMode(conn);
+
+	std::deque< std::vector<PGresult *> > batches;
+	std::mutex batches_l;
+	std::condition_variable batchReady,batchTaken;
+	bool done = false;
+	std::atomic<bool> failed(false);
+	std::string err;
+
+	const unsigned int nThreads = std::max(std::min(std::thread::hardware_concurrency(),maxThreads),1U);
+	std::vector<std::thread> threads;
+	for(unsigned int t=0;t<nThreads;++t) {
+		threads.push_back(std::thread([&]() {
+			for(;;) {
+				std::vector<PGresult *> batch;
+				{
+					std::unique_lock<std::mutex> l(batches_l);
+					while ((batches.empty())&&(!done))
+						batchReady.wait(l);
+					if (batches.empty())
+						return;
+					batch.swap(batches.front());
+					batches.pop_front();
+					batchTaken.notify_one();
+				}
+				for(auto r=batch.begin();r!=batch.end();++r) {
+					try {
+						if (!failed)
+							rowHandler(*r);
+					} catch (std::exception &e) {
+						std::lock_guard<std::mutex> l(batches_l);
+						if (!failed.exchange(true))
+							err = e.what();
+					}
+					PQclear(*r);
+				}
+			}
+		}));
+	}
+
+	std::vector<PGresult *> batch;
+	std::string queryErr;
+	PGresult *res;
+	while ((res = PQgetResult(conn)) != NULL) {
+		const ExecStatusType st = PQresultStatus(res);
+		if (st == PGRES_SINGLE_TUPLE) {
+			batch.push_back(res);
+			if (batch.size() >= ROWS_PER_BATCH) {
+				std::unique_lock<std::mutex> l(batches_l);
+				while (batches.size() >= MAX_QUEUED_BATCHES)
+					batchTaken.wait(l);
+				batches.push_back(std::vector<PGresult *>());
+				batches.back().swap(batch);
+				batchReady.notify_one();
+			}
+			continue;
+		}
+		if ((st != PGRES_TUPLES_OK)&&(queryErr.empty()))
+			queryErr = PQresultErrorMessage(res);
+		PQclear(res);
+	}
+
+	{
+		std::lock_guard<std::mutex> l(batches_l);
+		if (!batch.empty())
+			batches.push_back(batch);
+		done = true;
+		batchReady.notify_all();
+	}
+	for(auto t=threads.begin();t!=threads.end();++t)
+		t->join();
+
+	if (failed)
+		throw std::runtime_error(err);
+	return queryErr;
+}
+
+/**
+ * A prepared statement and its parameters, queued for a pipelined commit
+ */
+struct _CommitStatement
+{
+	_CommitStatement(const char *n,const char *w) : name(n),what(w) {}
+
+	inline void add(const std::string &v) { values.push_back(v); nulls.push_back(false); }
+	inline void addNull() { values.push_back(std::string()); nulls.push_back(true); }
+
+	const char *name;
+	const char *what; // for error messages
+	std::vector<std::string> values;
+	std::vector<bool> nulls;
+};
+
+/**
+ * Statements prepared once on every commit thread connection
+ */
+static const struct {
+	const char *name;
+	const char *sql;
+	int nParams;
+} COMMIT_STATEMENTS[] = {
+	{ "member_upsert",
+		"INSERT INTO ztc_member (id, network_id, active_bridge, authorized, capabilities, "
+		"identity, last_authorized_time, last_deauthorized_time, no_auto_assign_ips, "
+		"remote_trace_level, remote_trace_target, revision, tags, v_major, v_minor, v_rev, v_proto) "
+		"VALUES ($1, $2, $3, $4, $5, $6, "
+		"TO_TIMESTAMP($7::double precision/1000), TO_TIMESTAMP($8::double precision/1000), "
+		"$9, $10, $11, $12, $13, $14, $15, $16, $17) ON CONFLICT (network_id, id) DO UPDATE SET "
+		"active_bridge = EXCLUDED.active_bridge, authorized = EXCLUDED.authorized, capabilities = EXCLUDED.capabilities, "
+		"identity = EXCLUDED.identity, last_authorized_time = EXCLUDED.last_authorized_time, "
+		"last_deauthorized_time = EXCLUDED.last_deauthorized_time, no_auto_assign_ips = EXCLUDED.no_auto_assign_ips, "
+		"remote_trace_level = EXCLUDED.remote_trace_level, remote_trace_target = EXCLUDED.remote_trace_target, "
+		"revision = EXCLUDED.revision+1, tags = EXCLUDED.tags, v_major = EXCLUDED.v_major, "
+		"v_minor = EXCLUDED.v_minor, v_rev = EXCLUDED.v_rev, v_proto = EXCLUDED.v_proto",
+		17 },
+	{ "member_ips_delete",
+		"DELETE FROM ztc_member_ip_assignment WHERE member_id = $1 AND network_id = $2",
+		2 },
+	{ "member_ips_insert",
+		"INSERT INTO ztc_member_ip_assignment (member_id, network_id, address) "
+		"SELECT $1, $2, a FROM unnest($3::inet[]) AS a "
+		"ON CONFLICT (network_id, member_id, address) DO NOTHING",
+		3 },
+	{ "member_delete",
+		"UPDATE ztc_member SET hidden = true, deleted = true WHERE id = $1 AND network_id = $2",
+		2 },
+	// This ugly query exists because when we want to mirror networks to/from
+	// another data store (e.g. FileDB or LFDB) it is possible to get a network
+	// that doesn't exist in Central's database. This does an upsert and sets
+	// the owner_id to the "first" global admin in the user DB if the record
+	// did not previously exist. If the record already exists owner_id is left
+	// unchanged, so owner_id should be left out of the update clause.
+	{ "network_upsert",
+		"INSERT INTO ztc_network (id, creation_time, owner_id, controller_id, capabilities, enable_broadcast, "
+		"last_modified, mtu, multicast_limit, name, private, "
+		"remote_trace_level, remote_trace_target, rules, rules_source, "
+		"tags, v4_assign_mode, v6_assign_mode) VALUES ("
+		"$1, TO_TIMESTAMP($5::double precision/1000), "
+		"(SELECT user_id AS owner_id FROM ztc_global_permissions WHERE authorize = true AND del = true AND modify = true AND read = true LIMIT 1),"
+		"$2, $3, $4, TO_TIMESTAMP($5::double precision/1000), "
+		"$6, $7, $8, $9, $10, $11, $12, $13, $14, $15, $16) "
+		"ON CONFLICT (id) DO UPDATE set controller_id = EXCLUDED.controller_id, "
+		"capabilities = EXCLUDED.capabilities, enable_broadcast = EXCLUDED.enable_broadcast, "
+		"last_modified = EXCLUDED.last_modified, mtu = EXCLUDED.mtu, "
+		"multicast_limit = EXCLUDED.multicast_limit, name = EXCLUDED.name, "
+		"private = EXCLUDED.private, remote_trace_level = EXCLUDED.remote_trace_level, "
+		"remote_trace_target = EXCLUDED.remote_trace_target, rules = EXCLUDED.rules, "
+		"rules_source = EXCLUDED.rules_source, tags = EXCLUDED.tags, "
+		"v4_assign_mode = EXCLUDED.v4_assign_mode, v6_assign_mode = EXCLUDED.v6_assign_mode",
+		16 },
+	{ "network_pools_delete",
+		"DELETE FROM ztc_network_assignment_pool WHERE network_id = $1",
+		1 },
+	{ "network_pools_insert",
+		"INSERT INTO ztc_network_assignment_pool (network_id, ip_range_start, ip_range_end) "
+		"SELECT $1, p.s, p.e FROM unnest($2::inet[], $3::inet[]) AS p(s, e)",
+		3 },
+	{ "network_routes_delete",
+		"DELETE FROM ztc_network_route WHERE network_id = $1",
+		1 },
+	{ "network_routes_insert",
+		"INSERT INTO ztc_network_route (network_id, address, bits, via) "
+		"SELECT $1, r.a, r.b, r.v FROM unnest($2::inet[], $3::int[], $4::inet[]) AS r(a, b, v)",
+		4 },
+	{ "network_dns_upsert",
+		"INSERT INTO ztc_network_dns (network_id, domain, servers) VALUES ($1, $2, $3) "
+		"ON CONFLICT (network_id) DO UPDATE SET domain = EXCLUDED.domain, servers = EXCLUDED.servers",
+		3 },
+	{ "network_delete",
+		"UPDATE ztc_network SET deleted = true WHERE id = $1",
+		1 }
+};
+
+/**
+ * Format a PostgreSQL array literal, writing elements flagged null as NULL
+ */
+static std::string _pgArray(const std::vector<std::string> &elements,const std::vector<bool> *nulls = nullptr)
+{
+	std::string a("{");
+	for(unsigned long i=0;i<elements.size();++i) {
+		if (i)
+			a.push_back(',');
+		if ((nulls)&&((*nulls)[i])) {
+			a.append("NULL");
+			continue;
+		}
+		a.push_back('"');
+		for(auto c=elements[i].begin();c!=elements[i].end();++c) {
+			if ((*c == '"')||(*c == '\\'))
+				a.push_back('\\');
+			a.push_back(*c);
+		}
+		a.push_back('"');
+	}
+	a.push_back('}');
+	return a;
+}
+
+/**
+ * Turn a queued record into the statements that write it
+ *
+ * Throws if the record is malformed. Nothing has been sent at that point, so
+ * the record can be dropped without disturbing the rest of its batch.
+ */
+static void _commitStatements(json &config,const std::string &controllerId,std::vector<_CommitStatement> &stmts)
+{
+	const std::string objtype = config["objtype"];
+	if (objtype == "member") {
+		std::string memberId = config["id"];
+		std::string networkId = config["nwid"];
+		std::string identity = config["identity"];
+
+		stmts.push_back(_CommitStatement("member_upsert","updating member"));
+		_CommitStatement &m = stmts.back();
+		m.add(memberId);
+		m.add(networkId);
+		m.add(config["activeBridge"] ? "true" : "false");
+		m.add(config["authorized"] ? "true" : "false");
+		m.add(ZeroTier::OSUtils::jsonDump(config["capabilities"], -1));
+		m.add(identity);
+		m.add(std::to_string((long long)config["lastAuthorizedTime"]));
+		m.add(std::to_string((long long)config["lastDeauthorizedTime"]));
+		m.add(config["noAutoAssignIps"] ? "true" : "false");
+		m.add(std::to_string((int)config["remoteTraceLevel"]));
+		if (config["remoteTraceTarget"].is_null()) {
+			m.addNull();
+		} else {
+			m.add(config["remoteTraceTarget"]);
+		}
+		m.add(std::to_string((unsigned long long)config["revision"]));
+		m.add(ZeroTier::OSUtils::jsonDump(config["tags"], -1));
+		m.add(std::to_string((int)config["vMajor"]));
+		m.add(std::to_string((int)config["vMinor"]));
+		m.add(std::to_string((int)config["vRev"]));
+		m.add(std::to_string((int)config["vProto"]));
+
+		stmts.push_back(_CommitStatement("member_ips_delete","updating IP address assignments"));
+		stmts.back().add(memberId);
+		stmts.back().add(networkId);
+
+		std::vector<std::string> assignments;
+		for (auto i = config["ipAssignments"].begin(); i != config["ipAssignments"].end(); ++i) {
+			std::string addr = *i;
+			if (std::find(assignments.begin(), assignments.end(), addr) == assignments.end())
+				assignments.push_back(addr);
+		}
+		if (!assignments.empty()) {
+			stmts.push_back(_CommitStatement("member_ips_insert","setting IP addresses for member"));
+			stmts.back().add(memberId);
+			stmts.back().add(networkId);
+			stmts.back().add(_pgArray(assignments));
+		}
+	} else if (objtype == "network") {
+		std::string id = config["id"];
+		std::string name = config["name"];
+		std::string rulesSource;
+		if (config["rulesSource"].is_string()) {
+			rulesSource = config["rulesSource"];
+		}
+		bool enableBroadcast = config["enableBroadcast"];
+		bool isPrivate = config["private"];
+
+		stmts.push_back(_CommitStatement("network_upsert","updating network record"));
+		_CommitStatement &n = stmts.back();
+		n.add(id);
+		n.add(controllerId);
+		n.add(ZeroTier::OSUtils::jsonDump(config["capabilities"], -1));
+		n.add(enableBroadcast ? "true" : "false");
+		n.add(std::to_string(ZeroTier::OSUtils::now()));
+		n.add(std::to_string((int)config["mtu"]));
+		n.add(std::to_string((int)config["multicastLimit"]));
+		n.add(name);
+		n.add(isPrivate ? "true" : "false");
+		n.add(std::to_string((int)config["remoteTraceLevel"]));
+		if (config["remoteTraceTarget"].is_null()) {
+			n.addNull();
+		} else {
+			n.add(config["remoteTraceTarget"]);
+		}
+		n.add(ZeroTier::OSUtils::jsonDump(config["rules"], -1));
+		n.add(rulesSource);
+		n.add(ZeroTier::OSUtils::jsonDump(config["tags"], -1));
+		n.add(ZeroTier::OSUtils::jsonDump(config["v4AssignMode"], -1));
+		n.add(ZeroTier::OSUtils::jsonDump(config["v6AssignMode"], -1));
+
+		stmts.push_back(_CommitStatement("network_pools_delete","updating assignment pool"));
+		stmts.back().add(id);
+
+		std::vector<std::string> starts,ends;
+		auto pool = config["ipAssignmentPools"];
+		for (auto i = pool.begin(); i != pool.end(); ++i) {
+			starts.push_back((*i)["ipRangeStart"]);
+			ends.push_back((*i)["ipRangeEnd"]);
+		}
+		if (!starts.empty()) {
+			stmts.push_back(_CommitStatement("network_pools_insert","updating assignment pool"));
+			stmts.back().add(id);
+			stmts.back().add(_pgArray(starts));
+			stmts.back().add(_pgArray(ends));
+		}
+
+		stmts.push_back(_CommitStatement("network_routes_delete","updating routes"));
+		stmts.back().add(id);
+
+		std::vector<std::string> targetAddrs,targetBits,vias;
+		std::vector<bool> viaNulls;
+		auto routes = config["routes"];
+		for (auto i = routes.begin(); i != routes.end(); ++i) {
+			std::string t = (*i)["target"];
+			std::vector<std::string> target;
+			std::istringstream f(t);
+			std::string s;
+			while(std::getline(f, s, '/')) {
+				target.push_back(s);
+			}
+			if (target.empty() || target.size() != 2) {
+				continue;
+			}
+			targetAddrs.push_back(target[0]);
+			targetBits.push_back(target[1]);
+			if ((*i)["via"].is_null()) {
+				vias.push_back(std::string());
+				viaNulls.push_back(true);
+			} else {
+				vias.push_back((*i)["via"]);
+				viaNulls.push_back(false);
+			}
+		}
+		if (!targetAddrs.empty()) {
+			stmts.push_back(_CommitStatement("network_routes_insert","updating routes"));
+			stmts.back().add(id);
+			stmts.back().add(_pgArray(targetAddrs));
+			stmts.back().add(_pgArray(targetBits));
+			stmts.back().add(_pgArray(vias,&viaNulls));
+		}
+
+		// Networks without DNS carry an empty array here
+		auto dns = config["dns"];
+		if ((dns.is_object())&&(dns["domain"].is_string())) {
+			std::string domain = dns["domain"];
+			std::stringstream servers;
+			servers << "{";
+			for (auto j = dns["servers"].begin(); j < dns["servers"].end(); ++j) {
+				servers << *j;
+				if ( (j+1) != dns["servers"].end()) {
+					servers << ",";
+				}
+			}
+			servers << "}";
+
+			stmts.push_back(_CommitStatement("network_dns_upsert","updating DNS"));
+			stmts.back().add(id);
+			stmts.back().add(domain);
+			stmts.back().add(servers.str());
+		}
+	} else if (objtype == "_delete_network") {
+		stmts.push_back(_CommitStatement("network_delete","deleting network"));
+		stmts.back().add(config["id"]);
+	} else if (objtype == "_delete_member") {
+		stmts.push_back(_CommitStatement("member_delete","deleting member"));
+		stmts.back().add(config["id"]);
+		stmts.back().add(config["nwid"]);
+	} else {
+		throw std::runtime_error("unknown objtype");
+	}
+}
+
+#ifdef LIBPQ_HAS_PIPELINING
+
+/**
+ * Run statements in one transaction using libpq pipeline mode
+ *
+ * Everything is sent before any result is read, so a whole batch costs one
+ * round trip instead of one per statement. Batches are kept small enough
+ * that the results always fit in the socket buffers while we are still
+ * sending.
+ *
+ * @return True if the transaction committed
+ */
+static bool _execPipelined(PGconn *conn,const std::vector<const _CommitStatement *> &stmts)
+{
+	if (!PQenterPipelineMode(conn)) {
+		fprintf(stderr, "ERROR: Error entering pipeline mode: %s\n", PQerrorMessage(conn));
+		return false;
+	}
+
+	bool ok = (PQsendQueryParams(conn, "BEGIN", 0, NULL, NULL, NULL, NULL, 0) != 0);
+	std::vector<const char *> values;
+	for(auto s=stmts.begin();(ok)&&(s!=stmts.end());++s) {
+		values.clear();
+		for(unsigned long i=0;i<(*s)->values.size();++i)
+			values.push_back((*s)->nulls[i] ? NULL : (*s)->values[i].c_str());
+		ok = (PQsendQueryPrepared(conn, (*s)->name, (int)values.size(), values.data(), NULL, NULL, 0) != 0);
+	}
+	ok = ok && (PQsendQueryParams(conn, "COMMIT", 0, NULL, NULL, NULL, NULL, 0) != 0);
+	ok = ok && (PQpipelineSync(conn) != 0);
+	if (!ok) {
+		fprintf(stderr, "ERROR: Error sending commit batch: %s\n", PQerrorMessage(conn));
+		PQexitPipelineMode(conn);
+		return false;
+	}
+
+	// Each statement yields its result followed by a NULL. After the first
+	// error the server skips everything else up to the sync point.
+	for(unsigned long i=0;i<(stmts.size() + 2);++i) {
+		PGresult *res = PQgetResult(conn);
+		if (!res) {
+			ok = false;
+			break;
+		}
+		const ExecStatusType st = PQresultStatus(res);
+		if ((st != PGRES_COMMAND_OK)&&(st != PGRES_TUPLES_OK)) {
+			if ((ok)&&(st != PGRES_PIPELINE_ABORTED))
+				fprintf(stderr, "ERROR: Error %s: %s\n", ((i > 0)&&(i <= stmts.size())) ? stmts[i - 1]->what : "committing transaction", PQresultErrorMessage(res));
+			ok = false;
+		}
+		PQclear(res);
+		while ((res = PQgetResult(conn)) != NULL)
+			PQclear(res);
+	}
+	PGresult *res;
+	while ((res = PQgetResult(conn)) != NULL) {
+		const bool synced = (PQresultStatus(res) == PGRES_PIPELINE_SYNC);
+		PQclear(res);
+		if (synced)
+			break;
+	}
+	PQexitPipelineMode(conn);
+
+	if (PQtransactionStatus(conn) != PQTRANS_IDLE)
+		PQclear(PQexec(conn, "ROLLBACK"));
+	return ok;
+}
+
+#else
+
+/**
+ * Run statements in one transaction, for libpq older than 14
+ *
+ * Without pipeline mode each statement waits for its own result, so a
+ * batch costs one round trip per statement but still one transaction.
+ *
+ * @return True if the transaction committed
+ */
+static bool _execPipelined(PGconn *conn,const std::vector<const _CommitStatement *> &stmts)
+{
+	PGresult *res = PQexec(conn, "BEGIN");
+	bool ok = (PQresultStatus(res) == PGRES_COMMAND_OK);
+	if (!ok)
+		fprintf(stderr, "ERROR: Error beginning transaction: %s\n", PQresultErrorMessage(res));
+	PQclear(res);
+
+	std::vector<const char *> values;
+	for(auto s=stmts.begin();(ok)&&(s!=stmts.end());++s) {
+		values.clear();
+		for(unsigned long i=0;i<(*s)->values.size();++i)
+			values.push_back((*s)->nulls[i] ? NULL : (*s)->values[i].c_str());
+		res = PQexecPrepared(conn, (*s)->name, (int)values.size(), values.data(), NULL, NULL, 0);
+		const ExecStatusType st = PQresultStatus(res);
+		if ((st != PGRES_COMMAND_OK)&&(st != PGRES_TUPLES_OK)) {
+			fprintf(stderr, "ERROR: Error %s: %s\n", (*s)->what, PQresultErrorMessage(res));
+			ok = false;
+		}
+		PQclear(res);
+	}
+
+	if (ok) {
+		res = PQexec(conn, "COMMIT");
+		if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+			fprintf(stderr, "ERROR: Error committing transaction: %s\n", PQresultErrorMessage(res));
+			ok = false;
+		}
+		PQclear(res);
+	}
+
+	if (PQtransactionStatus(conn) != PQTRANS_IDLE)
+		PQclear(PQexec(conn, "ROLLBACK"));
+	return ok;
+}
+
+#endif // LIBPQ_HAS_PIPELINING
+
 /*
 std::string join(const std::vector<std::string> &elements, const char * const separator)
 {
@@ -77,6 +580,9 @@ PostgreSQL::PostgreSQL(const Identity &myId, const char *path, int listenPort, R
 	: DB()
 	, _myId(myId)
 	, _myAddress(myId.address())
+	, _committed(0)
+	, _coalesced(0)
+	, _commitFailed(0)
 	, _ready(0)
 	, _connected(1)
 	, _run(1)
@@ -149,7 +655,7 @@ PostgreSQL::PostgreSQL(const Identity &myId, const char *path, int listenPort, R
 	_membersDbWatcher = std::thread(&PostgreSQL::membersDbWatcher, this);
 	_networksDbWatcher = std::thread(&PostgreSQL::networksDbWatcher, this);
 	for (int i = 0; i < ZT_CENTRAL_CONTROLLER_COMMIT_THREADS; ++i) {
-		_commitThread[i] = std::thread(&PostgreSQL::commitThread, this);
+		_commitThread[i] = std::thread(&PostgreSQL::commitThread, this, (unsigned int)i);
 	}
 	_onlineNotificationThread = std::thread(&PostgreSQL::onlineNotificationThread, this);
 }
@@ -162,7 +668,10 @@ PostgreSQL::~PostgreSQL()
 	_heartbeatThread.join();
 	_membersDbWatcher.join();
 	_networksDbWatcher.join();
-	_commitQueue.stop();
+	for (int i = 0; i < ZT_CENTRAL_CONTROLLER_COMMIT_THREADS; ++i) {
+		std::lock_guard<std::mutex> l(_commitShards[i].lock);
+		_commitShards[i].wake.notify_all();
+	}
 	for (int i = 0; i < ZT_CENTRAL_CONTROLLER_COMMIT_THREADS; ++i) {
 		_commitThread[i].join();
 	}
@@ -198,7 +707,7 @@ bool PostgreSQL::save(nlohmann::json &record,bool notifyListeners)
 				get(nwid,old);
 				if ((!old.is_object())||(!_compareRecords(old,record))) {
 					record["revision"] = OSUtils::jsonInt(record["revision"],0ULL) + 1ULL;
-					_commitQueue.post(std::pair<nlohmann::json,bool>(record,notifyListeners));
+					_queueCommit(record,notifyListeners);
 					modified = true;
 				}
 			}
@@ -210,7 +719,7 @@ bool PostgreSQL::save(nlohmann::json &record,bool notifyListeners)
 				get(nwid,network,id,old);
 				if ((!old.is_object())||(!_compareRecords(old,record))) {
 					record["revision"] = OSUtils::jsonInt(record["revision"],0ULL) + 1ULL;
-					_commitQueue.post(std::pair<nlohmann::json,bool>(record,notifyListeners));
+					_queueCommit(record,notifyListeners);
 					modified = true;
 				}
 			}
@@ -232,7 +741,7 @@ void PostgreSQL::eraseNetwork(const uint64_t networkId)
 	tmp.first["id"] = tmp2;
 	tmp.first["objtype"] = "_delete_network";
 	tmp.second = true;
-	_commitQueue.post(tmp);
+	_queueCommit(tmp.first, tmp.second);
 	nlohmann::json nullJson;
 	_networkChanged(tmp.first, nullJson, true);
 }
@@ -248,7 +757,7 @@ void PostgreSQL::eraseMember(const uint64_t networkId, const uint64_t memberId)
 	tmp.first["id"] = tmp2;
 	tmp.first["objtype"] = "_delete_member";
 	tmp.second = true;
-	_commitQueue.post(tmp);
+	_queueCommit(tmp.first, tmp.second);
 	nlohmann::json nullJson;
 	_memberChanged(tmp.first, nullJson, true);
 }
@@ -263,6 +772,66 @@ void PostgreSQL::nodeIsOnline(const uint64_t networkId, const uint64_t memberId,
 	}
 }
 
+bool PostgreSQL::commitQueueStats(CommitQueueStats &stats)
+{
+	const int64_t now = OSUtils::now();
+	for (int i = 0; i < ZT_CENTRAL_CONTROLLER_COMMIT_THREADS; ++i) {
+		std::lock_guard<std::mutex> l(_commitShards[i].lock);
+		stats.depth += (unsigned long)_commitShards[i].order.size();
+		if (!_commitShards[i].order.empty()) {
+			// Coalesced updates keep their place in line, so the front is the oldest
+			auto p = _commitShards[i].pending.find(_commitShards[i].order.front());
+			if (p != _commitShards[i].pending.end())
+				stats.oldestAge = std::max(stats.oldestAge, now - p->second.queued);
+		}
+	}
+	std::lock_guard<std::mutex> l(_commitStats_l);
+	stats.committed = _committed;
+	stats.coalesced = _coalesced;
+	stats.failed = _commitFailed;
+	stats.latencyMean = _commitLatency.mean();
+	stats.latencyPeak = _commitLatency.peak();
+	return true;
+}
+
+void PostgreSQL::_queueCommit(nlohmann::json &record, bool notifyListeners)
+{
+	const std::string objtype = record["objtype"];
+	std::pair<uint64_t,uint64_t> key;
+	if ((objtype == "member")||(objtype == "_delete_member")) {
+		key.first = OSUtils::jsonIntHex(record["nwid"], 0ULL);
+		key.second = OSUtils::jsonIntHex(record["id"], 0ULL);
+	} else {
+		key.first = OSUtils::jsonIntHex(record["id"], 0ULL);
+		key.second = 0;
+	}
+
+	bool coalesced = false;
+	{
+		_CommitShard &cs = _commitShards[key.first % ZT_CENTRAL_CONTROLLER_COMMIT_THREADS];
+		std::lock_guard<std::mutex> l(cs.lock);
+		auto p = cs.pending.find(key);
+		if (p != cs.pending.end()) {
+			// Only the newest version of a record needs writing. Listeners are
+			// still told if any of the updates folded into it asked for that.
+			p->second.record = record;
+			p->second.notifyListeners |= notifyListeners;
+			coalesced = true;
+		} else {
+			_PendingCommit &pc = cs.pending[key];
+			pc.record = record;
+			pc.queued = OSUtils::now();
+			pc.notifyListeners = notifyListeners;
+			cs.order.push_back(key);
+			cs.wake.notify_one();
+		}
+	}
+	if (coalesced) {
+		std::lock_guard<std::mutex> l(_commitStats_l);
+		++_coalesced;
+	}
+}
+
 void PostgreSQL::initializeNetworks(PGconn *conn)
 {
 	try {
@@ -294,186 +863,166 @@ void PostgreSQL::initializeNetworks(PGconn *conn)
 
 		fprintf(stderr, "Initializing Networks...\n");
 
-		PGresult *res = PQexecParams(conn, "SELECT id, EXTRACT(EPOCH FROM creation_time AT TIME ZONE 'UTC')*1000, capabilities, "
-			"enable_broadcast, EXTRACT(EPOCH FROM last_modified AT TIME ZONE 'UTC')*1000, mtu, multicast_limit, name, private, remote_trace_level, "
-			"remote_trace_target, revision, rules, tags, v4_assign_mode, v6_assign_mode FROM ztc_network "
-			"WHERE deleted = false AND controller_id = $1",
-			1,
-			NULL,
-			params,
-			NULL,
-			NULL,
-			0);
-
-		if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-			fprintf(stderr, "Networks Initialization Failed: %s", PQerrorMessage(conn));
-			PQclear(res);
+		// Pools, routes and DNS are fetched once for all of this controller's
+		// networks and grouped by network ID here instead of being queried
+		// separately for every network.
+		std::unordered_map< std::string,json > pools,routes,dns;
+
+		std::string qerr = _streamRows(conn,
+			"SELECT p.network_id, host(p.ip_range_start), host(p.ip_range_end) FROM ztc_network_assignment_pool p "
+			"INNER JOIN ztc_network n ON n.id = p.network_id "
+			"WHERE n.deleted = false AND n.controller_id = $1",
+			1,params,1,[&pools](const PGresult *r) {
+				json ip;
+				ip["ipRangeStart"] = PQgetvalue(r, 0, 1);
+				ip["ipRangeEnd"] = PQgetvalue(r, 0, 2);
+				json &p = pools[PQgetvalue(r, 0, 0)];
+				if (!p.is_array())
+					p = json::array();
+				p.push_back(ip);
+			});
+		if (!qerr.empty()) {
+			fprintf(stderr, "ERROR: Error retreiving IP pools for networks: %s\n", qerr.c_str());
 			exit(1);
 		}
 
-		int numRows = PQntuples(res);
-		for (int i = 0; i < numRows; ++i) {
+		qerr = _streamRows(conn,
+			"SELECT r.network_id, host(r.address), r.bits, host(r.via) FROM ztc_network_route r "
+			"INNER JOIN ztc_network n ON n.id = r.network_id "
+			"WHERE n.deleted = false AND n.controller_id = $1",
+			1,params,1,[&routes](const PGresult *r) {
+				std::string addr = PQgetvalue(r, 0, 1);
+				std::string bits = PQgetvalue(r, 0, 2);
+				std::string via = PQgetvalue(r, 0, 3);
+				json route;
+				route["target"] = addr + "/" + bits;
+
+				if (via == "NULL") {
+					route["via"] = nullptr;
+				} else {
+					route["via"] = via;
+				}
+				json &rt = routes[PQgetvalue(r, 0, 0)];
+				if (!rt.is_array())
+					rt = json::array();
+				rt.push_back(route);
+			});
+		if (!qerr.empty()) {
+			fprintf(stderr, "ERROR: Error retreiving routes for networks: %s\n", qerr.c_str());
+			exit(1);
+		}
+
+		qerr = _streamRows(conn,
+			"SELECT d.network_id, d.domain, d.servers FROM ztc_network_dns d "
+			"INNER JOIN ztc_network n ON n.id = d.network_id "
+			"WHERE n.deleted = false AND n.controller_id = $1",
+			1,params,1,[&dns](const PGresult *r) {
+				const std::string nwid = PQgetvalue(r, 0, 0);
+				json &obj = dns[nwid];
+				if (obj.is_object()) {
+					fprintf(stderr, "ERROR: invalid number of DNS configurations for network %s.  Must be 0 or 1\n", nwid.c_str());
+					obj = false; // marks network as having a bad DNS config
+					return;
+				} else if (!obj.is_null()) {
+					return;
+				}
+				std::string domain = PQgetvalue(r, 0, 1);
+				std::string serverList = PQgetvalue(r, 0, 2);
+				auto servers = json::array();
+				if (serverList.rfind("{",0) != std::string::npos) {
+					serverList = serverList.substr(1, serverList.size()-2);
+					std::stringstream ss(serverList);
+					while(ss.good()) {
+						std::string server;
+						std::getline(ss, server, ',');
+						servers.push_back(server);
+					}
+				}
+				obj["domain"] = domain;
+				obj["servers"] = servers;
+			});
+		if (!qerr.empty()) {
+			fprintf(stderr, "ERROR: Error retrieving DNS settings for networks: %s\n", qerr.c_str());
+			exit(1);
+		}
+
+		std::mutex networkSet_l;
+		qerr = _streamRows(conn, "SELECT id, EXTRACT(EPOCH FROM creation_time AT TIME ZONE 'UTC')*1000, capabilities, "
+			"enable_broadcast, EXTRACT(EPOCH FROM last_modified AT TIME ZONE 'UTC')*1000, mtu, multicast_limit, name, private, remote_trace_level, "
+			"remote_trace_target, revision, rules, tags, v4_assign_mode, v6_assign_mode FROM ztc_network "
+			"WHERE deleted = false AND controller_id = $1",
+			1,params,ZT_CENTRAL_CONTROLLER_LOAD_THREADS,[&](const PGresult *res) {
 			json empty;
 			json config;
 
-			const char *nwidparam[1] = {
-				PQgetvalue(res, i, 0)
-			};
-			std::string nwid = PQgetvalue(res, i, 0);
-			
-			networkSet.insert(nwid);
+			std::string nwid = PQgetvalue(res, 0, 0);
+
+			{
+				std::lock_guard<std::mutex> l(networkSet_l);
+				networkSet.insert(nwid);
+			}
 
 			config["id"] = nwid;
 			config["nwid"] = nwid;
 			try {
-				config["creationTime"] = std::stoull(PQgetvalue(res, i, 1));
+				config["creationTime"] = std::stoull(PQgetvalue(res, 0, 1));
 			} catch (std::exception &e) {
 				config["creationTime"] = 0ULL;
-				//fprintf(stderr, "Error converting creation time: %s\n", PQgetvalue(res, i, 1));
+				//fprintf(stderr, "Error converting creation time: %s\n", PQgetvalue(res, 0, 1));
 			}
-			config["capabilities"] = json::parse(PQgetvalue(res, i, 2));
-			config["enableBroadcast"] = (strcmp(PQgetvalue(res, i, 3),"t")==0);
+			config["capabilities"] = json::parse(PQgetvalue(res, 0, 2));
+			config["enableBroadcast"] = (strcmp(PQgetvalue(res, 0, 3),"t")==0);
 			try {
-				config["lastModified"] = std::stoull(PQgetvalue(res, i, 4));
+				config["lastModified"] = std::stoull(PQgetvalue(res, 0, 4));
 			} catch (std::exception &e) {
 				config["lastModified"] = 0ULL;
-				//fprintf(stderr, "Error converting last modified: %s\n", PQgetvalue(res, i, 4));
+				//fprintf(stderr, "Error converting last modified: %s\n", PQgetvalue(res, 0, 4));
 			}
 			try {
-				config["mtu"] = std::stoi(PQgetvalue(res, i, 5));
+				config["mtu"] = std::stoi(PQgetvalue(res, 0, 5));
 			} catch (std::exception &e) {
 				config["mtu"] = 2800;
 			}
 			try {
-				config["multicastLimit"] = std::stoi(PQgetvalue(res, i, 6));
+				config["multicastLimit"] = std::stoi(PQgetvalue(res, 0, 6));
 			} catch (std::exception &e) {
 				config["multicastLimit"] = 64;
 			}
-			config["name"] = PQgetvalue(res, i, 7);
-			config["private"] = (strcmp(PQgetvalue(res, i, 8),"t")==0);
+			config["name"] = PQgetvalue(res, 0, 7);
+			config["private"] = (strcmp(PQgetvalue(res, 0, 8),"t")==0);
 			try {
-				config["remoteTraceLevel"] = std::stoi(PQgetvalue(res, i, 9));
+				config["remoteTraceLevel"] = std::stoi(PQgetvalue(res, 0, 9));
 			} catch (std::exception &e) {
 				config["remoteTraceLevel"] = 0;
 			}
-			config["remoteTraceTarget"] = PQgetvalue(res, i, 10);
+			config["remoteTraceTarget"] = PQgetvalue(res, 0, 10);
 			try {
-				config["revision"] = std::stoull(PQgetvalue(res, i, 11));
+				config["revision"] = std::stoull(PQgetvalue(res, 0, 11));
 			} catch (std::exception &e) {
 				config["revision"] = 0ULL;
-				//fprintf(stderr, "Error converting revision: %s\n", PQgetvalue(res, i, 11));
+				//fprintf(stderr, "Error converting revision: %s\n", PQgetvalue(res, 0, 11));
 			}
-			config["rules"] = json::parse(PQgetvalue(res, i, 12));
-			config["tags"] = json::parse(PQgetvalue(res, i, 13));
-			config["v4AssignMode"] = json::parse(PQgetvalue(res, i, 14));
-			config["v6AssignMode"] = json::parse(PQgetvalue(res, i, 15));
+			config["rules"] = json::parse(PQgetvalue(res, 0, 12));
+			config["tags"] = json::parse(PQgetvalue(res, 0, 13));
+			config["v4AssignMode"] = json::parse(PQgetvalue(res, 0, 14));
+			config["v6AssignMode"] = json::parse(PQgetvalue(res, 0, 15));
 			config["objtype"] = "network";
-			config["ipAssignmentPools"] = json::array();
-			config["routes"] = json::array();
-
-			PGresult *r2 = PQexecParams(conn,
-				"SELECT host(ip_range_start), host(ip_range_end) FROM ztc_network_assignment_pool WHERE network_id = $1",
-				1,
-				NULL,
-				nwidparam,
-				NULL,
-				NULL,
-				0);
-
-			if (PQresultStatus(r2) != PGRES_TUPLES_OK) {
-				fprintf(stderr, "ERROR: Error retreiving IP pools for network: %s\n", PQresultErrorMessage(r2));
-				PQclear(r2);
-				PQclear(res);
-				exit(1);
-			}
-
-			int n = PQntuples(r2);
-			for (int j = 0; j < n; ++j) {
-				json ip;
-				ip["ipRangeStart"] = PQgetvalue(r2, j, 0);
-				ip["ipRangeEnd"] = PQgetvalue(r2, j, 1);
-
-				config["ipAssignmentPools"].push_back(ip);
-			}
-
-			PQclear(r2);
-
-			r2 = PQexecParams(conn,
-				"SELECT host(address), bits, host(via) FROM ztc_network_route WHERE network_id = $1",
-				1,
-				NULL,
-				nwidparam,
-				NULL,
-				NULL,
-				0);
-
-			if (PQresultStatus(r2) != PGRES_TUPLES_OK) {
-				fprintf(stderr, "ERROR: Error retreiving routes for network: %s\n", PQresultErrorMessage(r2));
-				PQclear(r2);
-				PQclear(res);
-				exit(1);
-			}
-
-			n = PQntuples(r2);
-			for (int j = 0; j < n; ++j) {
-				std::string addr = PQgetvalue(r2, j, 0);
-				std::string bits = PQgetvalue(r2, j, 1);
-				std::string via = PQgetvalue(r2, j, 2);
-				json route;
-				route["target"] = addr + "/" + bits;
 
-				if (via == "NULL") {
-					route["via"] = nullptr;
-				} else {
-					route["via"] = via;
-				}
-				config["routes"].push_back(route);
-			}
-
-			r2 = PQexecParams(conn,
-				"SELECT domain, servers FROM ztc_network_dns WHERE network_id = $1",
-				1,
-				NULL,
-				nwidparam,
-				NULL,
-				NULL,
-				0);
-			
-			if (PQresultStatus(r2) != PGRES_TUPLES_OK) {
-				fprintf(stderr, "ERROR: Error retrieving DNS settings for network: %s\n", PQresultErrorMessage(r2));
-				PQclear(r2);
-				PQclear(res);
-				exit(1);
-			}
-
-			n = PQntuples(r2);
-			if (n > 1) {
-				fprintf(stderr, "ERROR: invalid number of DNS configurations for network %s.  Must be 0 or 1\n", nwid.c_str());
-			} else if (n == 1) {
-				json obj;
-				std::string domain = PQgetvalue(r2, 0, 0);
-				std::string serverList = PQgetvalue(r2, 0, 1);
-				auto servers = json::array();
-				if (serverList.rfind("{",0) != std::string::npos) {
-					serverList = serverList.substr(1, serverList.size()-2);
-					std::stringstream ss(serverList);
-					while(ss.good()) {
-						std::string server;
-						std::getline(ss, server, ',');
-						servers.push_back(server);
-					}
-				}
-				obj["domain"] = domain;
-				obj["servers"] = servers;
-				config["dns"] = obj;
-			}
-
-			PQclear(r2);
+			auto p = pools.find(nwid);
+			config["ipAssignmentPools"] = (p == pools.end()) ? json::array() : p->second;
+			auto rt = routes.find(nwid);
+			config["routes"] = (rt == routes.end()) ? json::array() : rt->second;
+			auto d = dns.find(nwid);
+			if ((d != dns.end())&&(d->second.is_object()))
+				config["dns"] = d->second;
 
 			_networkChanged(empty, config, false);
-		}
+		});
 
-		PQclear(res);
+		if (!qerr.empty()) {
+			fprintf(stderr, "Networks Initialization Failed: %s", qerr.c_str());
+			exit(1);
+		}
 
 		// if(!networkSet.empty()) {
 		// 	if (_rc && _rc->clusterMode) {
@@ -547,7 +1096,27 @@ void PostgreSQL::initializeMembers(PGconn *conn)
 		std::unordered_map<std::string, std::string> networkMembers;
 
 		fprintf(stderr, "Initializing Members...\n");
-		PGresult *res = PQexecParams(conn,
+		// All IP assignments are fetched in one pass and grouped by network and
+		// member before the members themselves are streamed in.
+		std::unordered_map< std::string,std::vector<std::string> > ipAssignments;
+		std::string qerr = _streamRows(conn,
+			"SELECT DISTINCT a.network_id, a.member_id, a.address FROM ztc_member_ip_assignment a "
+			"INNER JOIN ztc_network n ON n.id = a.network_id "
+			"WHERE n.controller_id = $1",
+			1,params,1,[&ipAssignments](const PGresult *r) {
+				std::string ipaddr = PQgetvalue(r, 0, 2);
+				std::size_t pos = ipaddr.find('/');
+				if (pos != std::string::npos) {
+					ipaddr = ipaddr.substr(0, pos);
+				}
+				ipAssignments[std::string(PQgetvalue(r, 0, 0)) + PQgetvalue(r, 0, 1)].push_back(ipaddr);
+			});
+		if (!qerr.empty()) {
+			fprintf(stderr, "Member Initialization Failed: %s", qerr.c_str());
+			exit(1);
+		}
+
+		qerr = _streamRows(conn,
 			"SELECT m.id, m.network_id, m.active_bridge, m.authorized, m.capabilities, EXTRACT(EPOCH FROM m.creation_time AT TIME ZONE 'UTC')*1000, m.identity, "
 			"	EXTRACT(EPOCH FROM m.last_authorized_time AT TIME ZONE 'UTC')*1000, "
 			"	EXTRACT(EPOCH FROM m.last_deauthorized_time AT TIME ZONE 'UTC')*1000, "
@@ -557,133 +1126,96 @@ void PostgreSQL::initializeMembers(PGconn *conn)
 			"INNER JOIN ztc_network n "
 			"	ON n.id = m.network_id "
 			"WHERE n.controller_id = $1 AND m.deleted = false",
-			1,
-			NULL,
-			params,
-			NULL,
-			NULL,
-			0);
-
-		if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-			fprintf(stderr, "Member Initialization Failed: %s", PQerrorMessage(conn));
-			PQclear(res);
-			exit(1);
-		}
-
-		int numRows = PQntuples(res);
-		for (int i = 0; i < numRows; ++i) {
+			1,params,ZT_CENTRAL_CONTROLLER_LOAD_THREADS,[&](const PGresult *res) {
 			json empty;
 			json config;
 
-			std::string memberId(PQgetvalue(res, i, 0));
-			std::string networkId(PQgetvalue(res, i, 1));
+			std::string memberId(PQgetvalue(res, 0, 0));
+			std::string networkId(PQgetvalue(res, 0, 1));
 
 			// networkMembers.insert(std::pair<std::string, std::string>(setKeyBase+networkId, memberId));
 
-			std::string ctime = PQgetvalue(res, i, 5);
 			config["id"] = memberId;
 			config["nwid"] = networkId;
-			config["activeBridge"] = (strcmp(PQgetvalue(res, i, 2), "t") == 0);
-			config["authorized"] = (strcmp(PQgetvalue(res, i, 3), "t") == 0);
+			config["activeBridge"] = (strcmp(PQgetvalue(res, 0, 2), "t") == 0);
+			config["authorized"] = (strcmp(PQgetvalue(res, 0, 3), "t") == 0);
 			try {
-				config["capabilities"] = json::parse(PQgetvalue(res, i, 4));
+				config["capabilities"] = json::parse(PQgetvalue(res, 0, 4));
 			} catch (std::exception &e) {
 				config["capabilities"] = json::array();
 			}
 			try {
-				config["creationTime"] = std::stoull(PQgetvalue(res, i, 5));
+				config["creationTime"] = std::stoull(PQgetvalue(res, 0, 5));
 			} catch (std::exception &e) {
 				config["creationTime"] = 0ULL;
-				//fprintf(stderr, "Error upding creation time (member): %s\n", PQgetvalue(res, i, 5));
+				//fprintf(stderr, "Error upding creation time (member): %s\n", PQgetvalue(res, 0, 5));
 			}
-			config["identity"] = PQgetvalue(res, i, 6);
+			config["identity"] = PQgetvalue(res, 0, 6);
 			try {
-				config["lastAuthorizedTime"] = std::stoull(PQgetvalue(res, i, 7));
+				config["lastAuthorizedTime"] = std::stoull(PQgetvalue(res, 0, 7));
 			} catch(std::exception &e) {
 				config["lastAuthorizedTime"] = 0ULL;
-				//fprintf(stderr, "Error updating last auth time (member): %s\n", PQgetvalue(res, i, 7));
+				//fprintf(stderr, "Error updating last auth time (member): %s\n", PQgetvalue(res, 0, 7));
 			}
 			try {
-				config["lastDeauthorizedTime"] = std::stoull(PQgetvalue(res, i, 8));
+				config["lastDeauthorizedTime"] = std::stoull(PQgetvalue(res, 0, 8));
 			} catch( std::exception &e) {
 				config["lastDeauthorizedTime"] = 0ULL;
-				//fprintf(stderr, "Error updating last deauth time (member): %s\n", PQgetvalue(res, i, 8));
+				//fprintf(stderr, "Error updating last deauth time (member): %s\n", PQgetvalue(res, 0, 8));
 			}
 			try {
-				config["remoteTraceLevel"] = std::stoi(PQgetvalue(res, i, 9));
+				config["remoteTraceLevel"] = std::stoi(PQgetvalue(res, 0, 9));
 			} catch (std::exception &e) {
 				config["remoteTraceLevel"] = 0;
 			}
-			config["remoteTraceTarget"] = PQgetvalue(res, i, 10);
+			config["remoteTraceTarget"] = PQgetvalue(res, 0, 10);
 			try {
-				config["tags"] = json::parse(PQgetvalue(res, i, 11));
+				config["tags"] = json::parse(PQgetvalue(res, 0, 11));
 			} catch (std::exception &e) {
 				config["tags"] = json::array();
 			}
 			try {
-				config["vMajor"] = std::stoi(PQgetvalue(res, i, 12));
+				config["vMajor"] = std::stoi(PQgetvalue(res, 0, 12));
 			} catch(std::exception &e) {
 				config["vMajor"] = -1;
 			}
 			try {
-				config["vMinor"] = std::stoi(PQgetvalue(res, i, 13));
+				config["vMinor"] = std::stoi(PQgetvalue(res, 0, 13));
 			} catch (std::exception &e) {
 				config["vMinor"] = -1;
 			}
 			try {
-				config["vRev"] = std::stoi(PQgetvalue(res, i, 14));
+				config["vRev"] = std::stoi(PQgetvalue(res, 0, 14));
 			} catch (std::exception &e) {
 				config["vRev"] = -1;
 			}
 			try {
-				config["vProto"] = std::stoi(PQgetvalue(res, i, 15));
+				config["vProto"] = std::stoi(PQgetvalue(res, 0, 15));
 			} catch (std::exception &e) {
 				config["vProto"] = -1;
 			}
-			config["noAutoAssignIps"] = (strcmp(PQgetvalue(res, i, 16), "t") == 0);
+			config["noAutoAssignIps"] = (strcmp(PQgetvalue(res, 0, 16), "t") == 0);
 			try {
-				config["revision"] = std::stoull(PQgetvalue(res, i, 17));
+				config["revision"] = std::stoull(PQgetvalue(res, 0, 17));
 			} catch (std::exception &e) {
 				config["revision"] = 0ULL;
-				//fprintf(stderr, "Error updating revision (member): %s\n", PQgetvalue(res, i, 17));
+				//fprintf(stderr, "Error updating revision (member): %s\n", PQgetvalue(res, 0, 17));
 			}
 			config["objtype"] = "member";
 			config["ipAssignments"] = json::array();
-			const char *p2[2] = {
-				memberId.c_str(),
-				networkId.c_str()
-			};
-
-			PGresult *r2 = PQexecParams(conn,
-				"SELECT DISTINCT address FROM ztc_member_ip_assignment WHERE member_id = $1 AND network_id = $2",
-				2,
-				NULL,
-				p2,
-				NULL,
-				NULL,
-				0);
-
-			if (PQresultStatus(r2) != PGRES_TUPLES_OK) {
-				fprintf(stderr, "Member Initialization Failed: %s", PQerrorMessage(conn));
-				PQclear(r2);
-				PQclear(res);
-				exit(1);
-			}
-
-			int n = PQntuples(r2);
-			for (int j = 0; j < n; ++j) {
-				std::string ipaddr = PQgetvalue(r2, j, 0);
-				std::size_t pos = ipaddr.find('/');
-				if (pos != std::string::npos) {
-					ipaddr = ipaddr.substr(0, pos);
-				}
-				config["ipAssignments"].push_back(ipaddr);
+			auto ips = ipAssignments.find(networkId + memberId);
+			if (ips != ipAssignments.end()) {
+				for(auto ip=ips->second.begin();ip!=ips->second.end();++ip)
+					config["ipAssignments"].push_back(*ip);
 			}
 
 			_memberChanged(empty, config, false);
-		}
+		});
 
-		PQclear(res);
+		if (!qerr.empty()) {
+			fprintf(stderr, "Member Initialization Failed: %s", qerr.c_str());
+			exit(1);
+		}
 
 		// if (!networkMembers.empty()) {
 		// 	if (_rc != NULL) {
@@ -1054,7 +1586,7 @@ void PostgreSQL::_networksWatcher_Redis() {
 	fprintf(stderr, "networksWatcher ended\n");
 }
 
-void PostgreSQL::commitThread()
+void PostgreSQL::commitThread(unsigned int shard)
 {
 	PGconn *conn = getPgConn();
 	if (PQstatus(conn) == CONNECTION_BAD) {
@@ -1062,591 +1594,129 @@ void PostgreSQL::commitThread()
 		PQfinish(conn);
 		exit(1);
 	}
+	for (unsigned int i = 0; i < (sizeof(COMMIT_STATEMENTS) / sizeof(COMMIT_STATEMENTS[0])); ++i) {
+		PGresult *res = PQprepare(conn, COMMIT_STATEMENTS[i].name, COMMIT_STATEMENTS[i].sql, COMMIT_STATEMENTS[i].nParams, NULL);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+			fprintf(stderr, "ERROR: Error preparing %s: %s\n", COMMIT_STATEMENTS[i].name, PQresultErrorMessage(res));
+			PQclear(res);
+			PQfinish(conn);
+			exit(1);
+		}
+		PQclear(res);
+	}
 
-	std::pair<nlohmann::json,bool> qitem;
-	while(_commitQueue.get(qitem)&(_run == 1)) {
-		if (!qitem.first.is_object()) {
-			continue;
+	_CommitShard &cs = _commitShards[shard];
+	std::vector<_PendingCommit> batch;
+	std::vector< std::vector<_CommitStatement> > stmts;
+	std::vector<const _CommitStatement *> pipeline;
+	std::vector<bool> done;
+	while (_run == 1) {
+		batch.clear();
+		{
+			std::unique_lock<std::mutex> l(cs.lock);
+			while ((cs.order.empty())&&(_run == 1))
+				cs.wake.wait(l);
+			while ((!cs.order.empty())&&(batch.size() < ZT_CENTRAL_CONTROLLER_COMMIT_BATCH_SIZE)) {
+				auto p = cs.pending.find(cs.order.front());
+				cs.order.pop_front();
+				if (p != cs.pending.end()) {
+					batch.push_back(std::move(p->second));
+					cs.pending.erase(p);
+				}
+			}
 		}
+		if (batch.empty())
+			continue;
+
 		if (PQstatus(conn) == CONNECTION_BAD) {
 			fprintf(stderr, "ERROR: Connection to database failed: %s\n", PQerrorMessage(conn));
 			PQfinish(conn);
 			exit(1);
 		}
-		try {
-			nlohmann::json *config = &(qitem.first);
-			const std::string objtype = (*config)["objtype"];
-			if (objtype == "member") {
-				try {
-					std::string memberId = (*config)["id"];
-					std::string networkId = (*config)["nwid"];
-					std::string identity = (*config)["identity"];
-					std::string target = "NULL";
-
-					if (!(*config)["remoteTraceTarget"].is_null()) {
-						target = (*config)["remoteTraceTarget"];
-					}
-
-					std::string caps = OSUtils::jsonDump((*config)["capabilities"], -1);
-					std::string lastAuthTime = std::to_string((long long)(*config)["lastAuthorizedTime"]);
-					std::string lastDeauthTime = std::to_string((long long)(*config)["lastDeauthorizedTime"]);
-					std::string rtraceLevel = std::to_string((int)(*config)["remoteTraceLevel"]);
-					std::string rev = std::to_string((unsigned long long)(*config)["revision"]);
-					std::string tags = OSUtils::jsonDump((*config)["tags"], -1);
-					std::string vmajor = std::to_string((int)(*config)["vMajor"]);
-					std::string vminor = std::to_string((int)(*config)["vMinor"]);
-					std::string vrev = std::to_string((int)(*config)["vRev"]);
-					std::string vproto = std::to_string((int)(*config)["vProto"]);
-					const char *values[19] = {
-						memberId.c_str(),
-						networkId.c_str(),
-						((*config)["activeBridge"] ? "true" : "false"),
-						((*config)["authorized"] ? "true" : "false"),
-						caps.c_str(),
-						identity.c_str(),
-						lastAuthTime.c_str(),
-						lastDeauthTime.c_str(),
-						((*config)["noAutoAssignIps"] ? "true" : "false"),
-						rtraceLevel.c_str(),
-						(target == "NULL") ? NULL : target.c_str(),
-						rev.c_str(),
-						tags.c_str(),
-						vmajor.c_str(),
-						vminor.c_str(),
-						vrev.c_str(),
-						vproto.c_str()
-					};
-
-					PGresult *res = PQexec(conn, "BEGIN");
-					if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-						fprintf(stderr, "ERROR: Error beginning update transaction: %s\n", PQresultErrorMessage(res));
-						PQclear(res);
-						delete config;
-						config = nullptr;
-						continue;
-					}
-					
-					
-					res = PQexecParams(conn,
-						"INSERT INTO ztc_member (id, network_id, active_bridge, authorized, capabilities, "
-						"identity, last_authorized_time, last_deauthorized_time, no_auto_assign_ips, "
-						"remote_trace_level, remote_trace_target, revision, tags, v_major, v_minor, v_rev, v_proto) "
-						"VALUES ($1, $2, $3, $4, $5, $6, "
-						"TO_TIMESTAMP($7::double precision/1000), TO_TIMESTAMP($8::double precision/1000), "
-						"$9, $10, $11, $12, $13, $14, $15, $16, $17) ON CONFLICT (network_id, id) DO UPDATE SET "
-						"active_bridge = EXCLUDED.active_bridge, authorized = EXCLUDED.authorized, capabilities = EXCLUDED.capabilities, "
-						"identity = EXCLUDED.identity, last_authorized_time = EXCLUDED.last_authorized_time, "
-						"last_deauthorized_time = EXCLUDED.last_deauthorized_time, no_auto_assign_ips = EXCLUDED.no_auto_assign_ips, "
-						"remote_trace_level = EXCLUDED.remote_trace_level, remote_trace_target = EXCLUDED.remote_trace_target, "
-						"revision = EXCLUDED.revision+1, tags = EXCLUDED.tags, v_major = EXCLUDED.v_major, "
-						"v_minor = EXCLUDED.v_minor, v_rev = EXCLUDED.v_rev, v_proto = EXCLUDED.v_proto",
-						17,
-						NULL,
-						values,
-						NULL,
-						NULL,
-						0);
-
-					if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-						fprintf(stderr, "ERROR: Error updating member: %s\n", PQresultErrorMessage(res));
-						fprintf(stderr, "%s", OSUtils::jsonDump(*config, 2).c_str());
-						PQclear(res);
-						PQclear(PQexec(conn, "ROLLBACK"));
-						delete config;
-						config = nullptr;
-						continue;
-					}
-
-					PQclear(res);
-
-					const char *v2[2] = {
-						memberId.c_str(),
-						networkId.c_str()
-					};
-
-					res = PQexecParams(conn,
-						"DELETE FROM ztc_member_ip_assignment WHERE member_id = $1 AND network_id = $2",
-						2,
-						NULL,
-						v2,
-						NULL,
-						NULL,
-						0);
-
-					if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-						fprintf(stderr, "ERROR: Error updating IP address assignments: %s\n", PQresultErrorMessage(res));
-						PQclear(res);
-						PQclear(PQexec(conn, "ROLLBACK"));;
-						delete config;
-						config = nullptr;
-						continue;
-					}
-
-					PQclear(res);
-
-					std::vector<std::string> assignments;
-					bool ipAssignError = false;
-					for (auto i = (*config)["ipAssignments"].begin(); i != (*config)["ipAssignments"].end(); ++i) {
-						std::string addr = *i;
 
-						if (std::find(assignments.begin(), assignments.end(), addr) != assignments.end()) {
-							continue;
-						}
+		stmts.clear();
+		stmts.resize(batch.size());
+		done.assign(batch.size(), false);
+		std::vector<bool> valid(batch.size(), false);
+		pipeline.clear();
+		for (unsigned long i = 0; i < batch.size(); ++i) {
+			try {
+				_commitStatements(batch[i].record, _myAddressStr, stmts[i]);
+				valid[i] = true;
+				for (auto s = stmts[i].begin(); s != stmts[i].end(); ++s)
+					pipeline.push_back(&(*s));
+			} catch (std::exception &e) {
+				fprintf(stderr, "ERROR: Error preparing record for commit: %s\n", e.what());
+			}
+		}
 
-						const char *v3[3] = {
-							memberId.c_str(),
-							networkId.c_str(),
-							addr.c_str()
-						};
-
-						res = PQexecParams(conn,
-							"INSERT INTO ztc_member_ip_assignment (member_id, network_id, address) VALUES ($1, $2, $3) ON CONFLICT (network_id, member_id, address) DO NOTHING",
-							3,
-							NULL,
-							v3,
-							NULL,
-							NULL,
-							0);
-
-						if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-							fprintf(stderr, "ERROR: Error setting IP addresses for member: %s\n", PQresultErrorMessage(res));
-							PQclear(res);
-							PQclear(PQexec(conn, "ROLLBACK"));
-							ipAssignError = true;
-							break;
-						}
-						PQclear(res);
-						assignments.push_back(addr);
-					}
-					if (ipAssignError) {
-						delete config;
-						config = nullptr;
-						continue;
-					}
+		if ((!pipeline.empty())&&(_execPipelined(conn, pipeline))) {
+			done = valid;
+		} else if (pipeline.size() > 1) {
+			// A bad record aborts the transaction it is in, so commit one at a
+			// time to find it and get everything else written.
+			for (unsigned long i = 0; i < batch.size(); ++i) {
+				if (valid[i]) {
+					pipeline.clear();
+					for (auto s = stmts[i].begin(); s != stmts[i].end(); ++s)
+						pipeline.push_back(&(*s));
+					done[i] = _execPipelined(conn, pipeline);
+				}
+			}
+		}
 
-					res = PQexec(conn, "COMMIT");
-					if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-						fprintf(stderr, "ERROR: Error committing member transaction: %s\n", PQresultErrorMessage(res));
-						PQclear(res);
-						PQclear(PQexec(conn, "ROLLBACK"));
-						delete config;
-						config = nullptr;
-						continue;
-					}
+		const int64_t now = OSUtils::now();
+		for (unsigned long i = 0; i < batch.size(); ++i) {
+			{
+				std::lock_guard<std::mutex> l(_commitStats_l);
+				if (done[i]) {
+					++_committed;
+					_commitLatency.push((float)(now - batch[i].queued));
+				} else {
+					++_commitFailed;
+				}
+			}
+			if (!done[i])
+				continue;
 
-					const uint64_t nwidInt = OSUtils::jsonIntHex((*config)["nwid"], 0ULL);
-					const uint64_t memberidInt = OSUtils::jsonIntHex((*config)["id"], 0ULL);
+			try {
+				nlohmann::json &config = batch[i].record;
+				const std::string objtype = config["objtype"];
+				if (objtype == "member") {
+					const uint64_t nwidInt = OSUtils::jsonIntHex(config["nwid"], 0ULL);
+					const uint64_t memberidInt = OSUtils::jsonIntHex(config["id"], 0ULL);
 					if (nwidInt && memberidInt) {
 						nlohmann::json nwOrig;
 						nlohmann::json memOrig;
 
-						nlohmann::json memNew(*config);
+						nlohmann::json memNew(config);
 
 						get(nwidInt, nwOrig, memberidInt, memOrig);
 
-						_memberChanged(memOrig, memNew, qitem.second);
+						_memberChanged(memOrig, memNew, batch[i].notifyListeners);
 					} else {
 						fprintf(stderr, "Can't notify of change.  Error parsing nwid or memberid: %llu-%llu\n", (unsigned long long)nwidInt, (unsigned long long)memberidInt);
 					}
-
-				} catch (std::exception &e) {
-					fprintf(stderr, "ERROR: Error updating member: %s\n", e.what());
-				}
-			} else if (objtype == "network") {
-				try {
-					std::string id = (*config)["id"];
-					std::string controllerId = _myAddressStr.c_str();
-					std::string name = (*config)["name"];
-					std::string remoteTraceTarget("NULL");
-					if (!(*config)["remoteTraceTarget"].is_null()) {
-						remoteTraceTarget = (*config)["remoteTraceTarget"];
-					}
-					std::string rulesSource;
-					if ((*config)["rulesSource"].is_string()) {
-						rulesSource = (*config)["rulesSource"];
-					}
-					std::string caps = OSUtils::jsonDump((*config)["capabilitles"], -1);
-					std::string now = std::to_string(OSUtils::now());
-					std::string mtu = std::to_string((int)(*config)["mtu"]);
-					std::string mcastLimit = std::to_string((int)(*config)["multicastLimit"]);
-					std::string rtraceLevel = std::to_string((int)(*config)["remoteTraceLevel"]);
-					std::string rules = OSUtils::jsonDump((*config)["rules"], -1);
-					std::string tags = OSUtils::jsonDump((*config)["tags"], -1);
-					std::string v4mode = OSUtils::jsonDump((*config)["v4AssignMode"],-1);
-					std::string v6mode = OSUtils::jsonDump((*config)["v6AssignMode"], -1);
-					bool enableBroadcast = (*config)["enableBroadcast"];
-					bool isPrivate = (*config)["private"];
-
-					const char *values[16] = {
-						id.c_str(),
-						controllerId.c_str(),
-						caps.c_str(),
-						enableBroadcast ? "true" : "false",
-						now.c_str(),
-						mtu.c_str(),
-						mcastLimit.c_str(),
-						name.c_str(),
-						isPrivate ? "true" : "false",
-						rtraceLevel.c_str(),
-						(remoteTraceTarget == "NULL" ? NULL : remoteTraceTarget.c_str()),
-						rules.c_str(),
-						rulesSource.c_str(),
-						tags.c_str(),
-						v4mode.c_str(),
-						v6mode.c_str(),
-					};
-
-					PGresult *res = PQexec(conn, "BEGIN");
-					if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-						fprintf(stderr, "ERROR: Error beginnning transaction: %s\n", PQresultErrorMessage(res));
-						PQclear(res);
-						delete config;
-						config = nullptr;
-						continue;
-					}
-
-					PQclear(res);
-
-					// This ugly query exists because when we want to mirror networks to/from
-					// another data store (e.g. FileDB or LFDB) it is possible to get a network
-					// that doesn't exist in Central's database. This does an upsert and sets
-					// the owner_id to the "first" global admin in the user DB if the record
-					// did not previously exist. If the record already exists owner_id is left
-					// unchanged, so owner_id should be left out of the update clause.
-					res = PQexecParams(conn,
-						"INSERT INTO ztc_network (id, creation_time, owner_id, controller_id, capabilities, enable_broadcast, "
-						"last_modified, mtu, multicast_limit, name, private, "
-						"remote_trace_level, remote_trace_target, rules, rules_source, "
-						"tags, v4_assign_mode, v6_assign_mode) VALUES ("
-						"$1, TO_TIMESTAMP($5::double precision/1000), "
-						"(SELECT user_id AS owner_id FROM ztc_global_permissions WHERE authorize = true AND del = true AND modify = true AND read = true LIMIT 1),"
-						"$2, $3, $4, TO_TIMESTAMP($5::double precision/1000), "
-						"$6, $7, $8, $9, $10, $11, $12, $13, $14, $15, $16) "
-						"ON CONFLICT (id) DO UPDATE set controller_id = EXCLUDED.controller_id, "
-						"capabilities = EXCLUDED.capabilities, enable_broadcast = EXCLUDED.enable_broadcast, "
-						"last_modified = EXCLUDED.last_modified, mtu = EXCLUDED.mtu, "
-						"multicast_limit = EXCLUDED.multicast_limit, name = EXCLUDED.name, "
-						"private = EXCLUDED.private, remote_trace_level = EXCLUDED.remote_trace_level, "
-						"remote_trace_target = EXCLUDED.remote_trace_target, rules = EXCLUDED.rules, "
-						"rules_source = EXCLUDED.rules_source, tags = EXCLUDED.tags, "
-						"v4_assign_mode = EXCLUDED.v4_assign_mode, v6_assign_mode = EXCLUDED.v6_assign_mode",
-						16,
-						NULL,
-						values,
-						NULL,
-						NULL,
-						0);
-
-					if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-						fprintf(stderr, "ERROR: Error updating network record: %s\n", PQresultErrorMessage(res));
-						PQclear(res);
-						PQclear(PQexec(conn, "ROLLBACK"));
-						delete config;
-						config = nullptr;
-						continue;
-					}
-
-					PQclear(res);
-			
-					const char *params[1] = {
-						id.c_str()
-					};
-					res = PQexecParams(conn,
-						"DELETE FROM ztc_network_assignment_pool WHERE network_id = $1",
-						1,
-						NULL,
-						params,
-						NULL,
-						NULL,
-						0);
-					if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-						fprintf(stderr, "ERROR: Error updating assignment pool: %s\n", PQresultErrorMessage(res));
-						PQclear(res);
-						PQclear(PQexec(conn, "ROLLBACK"));
-						delete config;
-						config = nullptr;
-						continue;
-					}
-
-					PQclear(res);
-
-					auto pool = (*config)["ipAssignmentPools"];
-					bool err = false;
-					for (auto i = pool.begin(); i != pool.end(); ++i) {
-						std::string start = (*i)["ipRangeStart"];
-						std::string end = (*i)["ipRangeEnd"];
-						const char *p[3] = {
-							id.c_str(),
-							start.c_str(),
-							end.c_str()
-						};
-
-						res = PQexecParams(conn,
-							"INSERT INTO ztc_network_assignment_pool (network_id, ip_range_start, ip_range_end) "
-							"VALUES ($1, $2, $3)",
-							3,
-							NULL,
-							p,
-							NULL,
-							NULL,
-							0);
-						if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-							fprintf(stderr, "ERROR: Error updating assignment pool: %s\n", PQresultErrorMessage(res));
-							PQclear(res);
-							err = true;
-							break;
-						}
-						PQclear(res);
-					}
-					if (err) {
-						PQclear(res);
-						PQclear(PQexec(conn, "ROLLBACK"));
-						delete config;
-						config = nullptr;
-						continue;
-					}
-
-					res = PQexecParams(conn,
-						"DELETE FROM ztc_network_route WHERE network_id = $1",
-						1,
-						NULL,
-						params,
-						NULL,
-						NULL,
-						0);
-
-					if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-						fprintf(stderr, "ERROR: Error updating routes: %s\n", PQresultErrorMessage(res));
-						PQclear(res);
-						PQclear(PQexec(conn, "ROLLBACK"));
-						delete config;
-						config = nullptr;
-						continue;
-					}
-
-
-					auto routes = (*config)["routes"];
-					err = false;
-					for (auto i = routes.begin(); i != routes.end(); ++i) {
-						std::string t = (*i)["target"];
-						std::vector<std::string> target;
-						std::istringstream f(t);
-						std::string s;
-						while(std::getline(f, s, '/')) {
-							target.push_back(s);
-						}
-						if (target.empty() || target.size() != 2) {
-							continue;
-						}
-						std::string targetAddr = target[0];
-						std::string targetBits = target[1];
-						std::string via = "NULL";
-						if (!(*i)["via"].is_null()) {
-							via = (*i)["via"];
-						}
-
-						const char *p[4] = {
-							id.c_str(),
-							targetAddr.c_str(),
-							targetBits.c_str(),
-							(via == "NULL" ? NULL : via.c_str()),
-						};
-
-						res = PQexecParams(conn,
-							"INSERT INTO ztc_network_route (network_id, address, bits, via) VALUES ($1, $2, $3, $4)",
-							4,
-							NULL,
-							p,
-							NULL,
-							NULL,
-							0);
-
-						if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-							fprintf(stderr, "ERROR: Error updating routes: %s\n", PQresultErrorMessage(res));
-							PQclear(res);
-							err = true;
-							break;
-						}
-						PQclear(res);
-					}
-					if (err) {
-						PQclear(PQexec(conn, "ROLLBACK"));
-						delete config;
-						config = nullptr;
-						continue;
-					}
-					auto dns = (*config)["dns"];
-					std::string domain = dns["domain"];
-					std::stringstream servers;
-					servers << "{";
-					for (auto j = dns["servers"].begin(); j < dns["servers"].end(); ++j) {
-						servers << *j;
-						if ( (j+1) != dns["servers"].end()) {
-							servers << ",";
-						}
-					}
-					servers << "}";
-
-					const char *p[3] = {
-						id.c_str(),
-						domain.c_str(),
-						servers.str().c_str()
-					};
-
-					res = PQexecParams(conn, "INSERT INTO ztc_network_dns (network_id, domain, servers) VALUES ($1, $2, $3) ON CONFLICT (network_id) DO UPDATE SET domain = EXCLUDED.domain, servers = EXCLUDED.servers",
-						3,
-						NULL,
-						p,
-						NULL,
-						NULL,
-						0);
-					if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-						fprintf(stderr, "ERROR: Error updating DNS: %s\n", PQresultErrorMessage(res));
-						PQclear(res);
-						PQclear(PQexec(conn, "ROLLBACK"));
-						err = true;
-						break;
-					}
-					PQclear(res);
-
-					res = PQexec(conn, "COMMIT");
-					if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-						fprintf(stderr, "ERROR: Error committing network update: %s\n", PQresultErrorMessage(res));
-						PQclear(res);
-						PQclear(PQexec(conn, "ROLLBACK"));
-						delete config;
-						config = nullptr;
-						continue;
-					}
-					PQclear(res);
-
-					const uint64_t nwidInt = OSUtils::jsonIntHex((*config)["nwid"], 0ULL);
+				} else if (objtype == "network") {
+					const uint64_t nwidInt = OSUtils::jsonIntHex(config["nwid"], 0ULL);
 					if (nwidInt) {
 						nlohmann::json nwOrig;
-						nlohmann::json nwNew(*config);
+						nlohmann::json nwNew(config);
 
 						get(nwidInt, nwOrig);
 
-						_networkChanged(nwOrig, nwNew, qitem.second);
+						_networkChanged(nwOrig, nwNew, batch[i].notifyListeners);
 					} else {
 						fprintf(stderr, "Can't notify network changed: %llu\n", (unsigned long long)nwidInt);
 					}
-
-				} catch (std::exception &e) {
-					fprintf(stderr, "ERROR: Error updating member: %s\n", e.what());
-				}
-				// if (_rc != NULL) {
-				// 	try {
-				// 		std::string id = (*config)["id"];
-				// 		std::string controllerId = _myAddressStr.c_str();
-				// 		std::string key = "networks:{" + controllerId + "}";
-				// 		if (_rc->clusterMode) {
-				// 			_cluster->sadd(key, id);
-				// 		} else {
-				// 			_redis->sadd(key, id);
-				// 		}
-				// 	} catch (sw::redis::Error &e) {
-				// 		fprintf(stderr, "ERROR: Error adding network to Redis: %s\n", e.what());
-				// 	}
-				// }
-			} else if (objtype == "_delete_network") {
-				try {
-					std::string networkId = (*config)["nwid"];
-					const char *values[1] = {
-						networkId.c_str()
-					};
-					PGresult * res = PQexecParams(conn,
-						"UPDATE ztc_network SET deleted = true WHERE id = $1",
-						1,
-						NULL,
-						values,
-						NULL,
-						NULL,
-						0);
-
-					if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-						fprintf(stderr, "ERROR: Error deleting network: %s\n", PQresultErrorMessage(res));
-					}
-
-					PQclear(res);
-				} catch (std::exception &e) {
-					fprintf(stderr, "ERROR: Error deleting network: %s\n", e.what());
-				}
-				// if (_rc != NULL) {
-				// 	try {
-				// 		std::string id = (*config)["id"];
-				// 		std::string controllerId = _myAddressStr.c_str();
-				// 		std::string key = "networks:{" + controllerId + "}";
-				// 		if (_rc->clusterMode) {
-				// 			_cluster->srem(key, id);
-				// 			_cluster->del("network-nodes-online:{"+controllerId+"}:"+id);
-				// 		} else {
-				// 			_redis->srem(key, id);
-				// 			_redis->del("network-nodes-online:{"+controllerId+"}:"+id);
-				// 		}
-				// 	} catch (sw::redis::Error &e) {
-				// 		fprintf(stderr, "ERROR: Error adding network to Redis: %s\n", e.what());
-				// 	}
-				// }
-			} else if (objtype == "_delete_member") {
-				try {
-					std::string memberId = (*config)["id"];
-					std::string networkId = (*config)["nwid"];
-
-					const char *values[2] = {
-						memberId.c_str(),
-						networkId.c_str()
-					};
-
-					PGresult *res = PQexecParams(conn,
-						"UPDATE ztc_member SET hidden = true, deleted = true WHERE id = $1 AND network_id = $2",
-						2,
-						NULL,
-						values,
-						NULL,
-						NULL,
-						0);
-
-					if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-						fprintf(stderr, "ERROR: Error deleting member: %s\n", PQresultErrorMessage(res));
-					}
-
-					PQclear(res);
-				} catch (std::exception &e) {
-					fprintf(stderr, "ERROR: Error deleting member: %s\n", e.what());
 				}
-				// if (_rc != NULL) {
-				// 	try {
-				// 		std::string memberId = (*config)["id"];
-				// 		std::string networkId = (*config)["nwid"];
-				// 		std::string controllerId = _myAddressStr.c_str();
-				// 		std::string key = "network-nodes-all:{" + controllerId + "}:" + networkId;
-				// 		if (_rc->clusterMode) {
-				// 			_cluster->srem(key, memberId);
-				// 			_cluster->del("member:{"+controllerId+"}:"+networkId+":"+memberId);
-				// 		} else {
-				// 			_redis->srem(key, memberId);
-				// 			_redis->del("member:{"+controllerId+"}:"+networkId+":"+memberId);
-				// 		}
-				// 	} catch (sw::redis::Error &e) {
-				// 		fprintf(stderr, "ERROR: Error deleting member from Redis: %s\n", e.what());
-				// 	}
-				// }
-			} else {
-				fprintf(stderr, "ERROR: unknown objtype");
+			} catch (std::exception &e) {
+				fprintf(stderr, "ERROR: Error applying committed record: %s\n", e.what());
 			}
-		} catch (std::exception &e) {
-			fprintf(stderr, "ERROR: Error getting objtype: %s\n", e.what());
 		}
-
-		std::this_thread::sleep_for(std::chrono::milliseconds(100));
 	}
 
 	PQfinish(conn);
-	if (_run == 1) {
-		fprintf(stderr, "ERROR: %s commitThread should still be running! Exiting Controller.\n", _myAddressStr.c_str());
-		exit(7);
-	}
 	fprintf(stderr, "commitThread finished\n");
 }
 
@@ -20,7 +20,17 @@
 
 #define ZT_CENTRAL_CONTROLLER_COMMIT_THREADS 4
 
+// Maximum number of threads parsing rows during the initial network and member load
+#define ZT_CENTRAL_CONTROLLER_LOAD_THREADS 8
+
+// Maximum number of queued records written in one pipelined transaction
+#define ZT_CENTRAL_CONTROLLER_COMMIT_BATCH_SIZE 64
+
+#include "../node/Ewma.hpp"
+
 #include <memory>
+#include <deque>
+#include <condition_variable>
 #include <redis++/redis++.h>
 
 extern "C" {
@@ -49,6 +59,7 @@ public:
 	virtual void eraseNetwork(const uint64_t networkId);
 	virtual void eraseMember(const uint64_t networkId, const uint64_t memberId);
 	virtual void nodeIsOnline(const uint64_t networkId, const uint64_t memberId, const InetAddress &physicalAddress);
+	virtual bool commitQueueStats(CommitQueueStats &stats);
 
 protected:
 	struct _PairHasher
@@ -68,7 +79,8 @@ private:
 	void _membersWatcher_Redis();
 	void _networksWatcher_Redis();
 
-	void commitThread();
+	void commitThread(unsigned int shard);
+	void _queueCommit(nlohmann::json &record, bool notifyListeners);
 	void onlineNotificationThread();
 	void onlineNotification_Postgres();
 	void onlineNotification_Redis();
@@ -87,7 +99,29 @@ private:
 	std::string _myAddressStr;
 	std::string _connString;
 
-	BlockingQueue< std::pair<nlohmann::json,bool> > _commitQueue;
+	struct _PendingCommit
+	{
+		nlohmann::json record;
+		int64_t queued;
+		bool notifyListeners;
+	};
+
+	// Records are sharded across commit threads by network so writes to one
+	// object are never reordered. An update to a record that is still waiting
+	// replaces it in place, so a burst of changes costs one write.
+	struct _CommitShard
+	{
+		std::mutex lock;
+		std::condition_variable wake;
+		std::deque< std::pair<uint64_t,uint64_t> > order;
+		std::unordered_map< std::pair<uint64_t,uint64_t>,_PendingCommit,_PairHasher > pending;
+	};
+
+	_CommitShard _commitShards[ZT_CENTRAL_CONTROLLER_COMMIT_THREADS];
+
+	Ewma<64> _commitLatency;
+	uint64_t _committed, _coalesced, _commitFailed;
+	std::mutex _commitStats_l;
 
 	std::thread _heartbeatThread;
 	std::thread _membersDbWatcher;
@@ -0,0 +1,546 @@
+/*
+ * Copyright (c)2019 ZeroTier, Inc.
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file in the project's root directory.
+ *
+ * Change Date: 2025-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2.0 of the Apache License.
+ */
+/****/
+
+/*
+ * Load generator for the network controller
+ *
+ * An EmbeddedNetworkController is run over a local FileDB or LogDB (or
+ * PostgreSQL in builds with ZT_CONTROLLER_USE_LIBPQ) and fed network config
+ * requests from synthetic members spread across several networks, while
+ * authorization changes, rule edits and member churn go through the JSON API
+ * as they would from an operator. Configs are signed the way Node signs them
+ * and handed to an in-memory Sender, so the figures cover request handling,
+ * signing and the DB layers but nothing on the wire.
+ *
+ * Synthetic members share one key pair under different addresses. The
+ * controller keys members by address and does not validate their identities,
+ * and generating a real identity per member would take longer than the run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <random>
+
+#ifdef __APPLE__
+#include <sys/resource.h>
+#endif
+
+#include "node/Constants.hpp"
+#include "node/Identity.hpp"
+#include "node/InetAddress.hpp"
+#include "node/Utils.hpp"
+#include "node/Buffer.hpp"
+#include "node/Packet.hpp"
+#include "node/Dictionary.hpp"
+#include "node/NetworkConfig.hpp"
+#include "node/NetworkController.hpp"
+
+#include "osdep/OSUtils.hpp"
+
+#include "controller/EmbeddedNetworkController.hpp"
+
+#include "version.h"
+
+// A member with no answer after this long is counted as unanswered and may be asked again (ms)
+#define ZT_CONTROLLERBENCH_REQUEST_TIMEOUT 10000
+
+// Members are not asked again sooner than this, so no request falls inside the controller's minimum request period (ms)
+#define ZT_CONTROLLERBENCH_REQUEST_PERIOD 1100
+
+// Controller queue depths are sampled this often (ms)
+#define ZT_CONTROLLERBENCH_SAMPLE_INTERVAL 100
+
+using namespace ZeroTier;
+
+namespace {
+
+typedef std::chrono::steady_clock BenchClock;
+
+struct BenchMember
+{
+	BenchMember() : nwid(0),lastRequest(0),outstanding(false),authorized(true) {}
+	uint64_t nwid;
+	Identity identity;
+	int64_t lastRequest;
+	BenchClock::time_point sent;
+	bool outstanding;
+	bool authorized;
+};
+
+/**
+ * Signs configs like Node and records when each member's answer arrives
+ */
+class BenchSender : public NetworkController::Sender
+{
+public:
+	BenchSender(const Identity &signingId) :
+		configs(0),
+		errors(0),
+		pushed(0),
+		revocations(0),
+		unanswered(0),
+		_signingId(signingId),
+		_configUpdateId(0)
+	{
+	}
+
+	virtual bool ncSignConfig(uint64_t nwid,const NetworkConfig &nc,bool sendLegacyFormatConfig,std::vector< std::vector<uint8_t> > &chunks)
+	{
+		Dictionary<ZT_NETWORKCONFIG_DICT_CAPACITY> *dconf = new Dictionary<ZT_NETWORKCONFIG_DICT_CAPACITY>();
+		if (!nc.toDictionary(*dconf,sendLegacyFormatConfig)) {
+			delete dconf;
+			return false;
+		}
+		uint64_t configUpdateId;
+		{
+			std::lock_guard<std::mutex> l(lock);
+			configUpdateId = ++_configUpdateId;
+		}
+		Buffer<ZT_PROTO_MAX_PACKET_LENGTH> chunk;
+		const unsigned int totalSize = dconf->sizeBytes();
+		unsigned int chunkIndex = 0;
+		while (chunkIndex < totalSize) {
+			const unsigned int chunkLen = std::min(totalSize - chunkIndex,(unsigned int)(ZT_PROTO_MAX_PACKET_LENGTH - (ZT_PACKET_IDX_PAYLOAD + 256)));
+			chunk.clear();
+			chunk.append(nwid);
+			chunk.append((uint16_t)chunkLen);
+			chunk.append((const void *)(dconf->data() + chunkIndex),chunkLen);
+			chunk.append((uint8_t)0);
+			chunk.append((uint64_t)configUpdateId);
+			chunk.append((uint32_t)totalSize);
+			chunk.append((uint32_t)chunkIndex);
+			C25519::Signature sig(_signingId.sign(reinterpret_cast<const uint8_t *>(chunk.data()),chunk.size()));
+			chunk.append((uint8_t)1);
+			chunk.append((uint16_t)ZT_C25519_SIGNATURE_LEN);
+			chunk.append(sig.data,ZT_C25519_SIGNATURE_LEN);
+			chunks.push_back(std::vector<uint8_t>(reinterpret_cast<const uint8_t *>(chunk.data()),reinterpret_cast<const uint8_t *>(chunk.data()) + chunk.size()));
+			chunkIndex += chunkLen;
+		}
+		delete dconf;
+		return true;
+	}
+
+	virtual void ncSendConfigChunks(uint64_t nwid,uint64_t requestPacketId,const Address &destination,const std::vector< std::vector<uint8_t> > &chunks)
+	{
+		_answered(destination,false);
+	}
+
+	virtual void ncSendConfig(uint64_t nwid,uint64_t requestPacketId,const Address &destination,const NetworkConfig &nc,bool sendLegacyFormatConfig)
+	{
+		std::vector< std::vector<uint8_t> > chunks;
+		if (ncSignConfig(nwid,nc,sendLegacyFormatConfig,chunks))
+			ncSendConfigChunks(nwid,requestPacketId,destination,chunks);
+	}
+
+	virtual void ncSendRevocation(const Address &destination,const Revocation &rev)
+	{
+		std::lock_guard<std::mutex> l(lock);
+		++revocations;
+	}
+
+	virtual void ncSendError(uint64_t nwid,uint64_t requestPacketId,const Address &destination,NetworkController::ErrorCode errorCode)
+	{
+		_answered(destination,true);
+	}
+
+	// Everything below is guarded by lock
+	std::mutex lock;
+	std::vector<BenchMember> members;
+	std::unordered_map<uint64_t,unsigned long> byAddress; // synthetic addresses are unique across networks
+	std::vector<uint32_t> latencies; // microseconds
+	uint64_t configs;
+	uint64_t errors;
+	uint64_t pushed;
+	uint64_t revocations;
+	uint64_t unanswered;
+
+private:
+	void _answered(const Address &destination,bool error)
+	{
+		const BenchClock::time_point now(BenchClock::now());
+		std::lock_guard<std::mutex> l(lock);
+		auto m = byAddress.find(destination.toInt());
+		if ((m != byAddress.end())&&(members[m->second].outstanding)) {
+			BenchMember &bm = members[m->second];
+			bm.outstanding = false;
+			latencies.push_back((uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(now - bm.sent).count());
+			if (error) {
+				++errors;
+			} else {
+				++configs;
+			}
+		} else {
+			++pushed; // sent after a change without being asked
+		}
+	}
+
+	const Identity _signingId;
+	uint64_t _configUpdateId;
+};
+
+static uint64_t residentBytes()
+{
+#ifdef __LINUX__
+	FILE *f = fopen("/proc/self/statm","r");
+	if (f) {
+		unsigned long size = 0,resident = 0;
+		const int n = fscanf(f,"%lu %lu",&size,&resident);
+		fclose(f);
+		if (n == 2)
+			return (uint64_t)resident * (uint64_t)sysconf(_SC_PAGESIZE);
+	}
+#endif
+#ifdef __APPLE__
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF,&ru) == 0)
+		return (uint64_t)ru.ru_maxrss; // peak, in bytes on Mac
+#endif
+	return 0;
+}
+
+static double percentile(std::vector<uint32_t> &v,const double p)
+{
+	if (v.empty())
+		return 0.0;
+	std::vector<uint32_t>::iterator i(v.begin() + std::min((size_t)((double)v.size() * p),v.size() - 1));
+	std::nth_element(v.begin(),i,v.end());
+	return (double)*i / 1000.0;
+}
+
+static void printHelp(const char *cn)
+{
+	printf("Usage: %s [-options]" ZT_EOL_S,cn);
+	printf(ZT_EOL_S "Options:" ZT_EOL_S);
+	printf("  -h                - Display this help" ZT_EOL_S);
+	printf("  -n <members>      - Synthetic members (default: 10000)" ZT_EOL_S);
+	printf("  -N <networks>     - Networks to spread members across (default: 10)" ZT_EOL_S);
+	printf("  -t <seconds>      - Load duration (default: 30)" ZT_EOL_S);
+	printf("  -r <requests/s>   - Request rate, or 0 to keep -o requests outstanding (default: 0)" ZT_EOL_S);
+	printf("  -o <requests>     - Outstanding requests when -r is 0 (default: 256)" ZT_EOL_S);
+	printf("  -a <changes/s>    - Member authorization changes (default: 1)" ZT_EOL_S);
+	printf("  -e <edits/s>      - Network rule edits (default: 0.2)" ZT_EOL_S);
+	printf("  -c <members/s>    - Members replaced by new ones (default: 1)" ZT_EOL_S);
+#ifdef ZT_CONTROLLER_USE_LIBPQ
+	printf("  -D <database>     - file, log, or postgres:<connection> (default: file)" ZT_EOL_S);
+#else
+	printf("  -D <database>     - file or log (default: file)" ZT_EOL_S);
+#endif
+	printf("  -d <path>         - Working directory, emptied first (default: controllerbench.d)" ZT_EOL_S);
+	printf("  -k                - Keep the working directory afterwards" ZT_EOL_S);
+	printf("  -L                - Request configs as old nodes that do not accept replayed configs" ZT_EOL_S);
+}
+
+} // anonymous namespace
+
+int main(int argc,char **argv)
+{
+	unsigned long memberCount = 10000;
+	unsigned long networkCount = 10;
+	double duration = 30.0;
+	double requestRate = 0.0;
+	unsigned long maxOutstanding = 256;
+	double authRate = 1.0;
+	double editRate = 0.2;
+	double churnRate = 1.0;
+	std::string db("file");
+	std::string path("controllerbench.d");
+	bool keep = false;
+	bool legacy = false;
+
+	for(int i=1;i<argc;++i) {
+		const std::string a(argv[i]);
+		const bool hasArg = ((i + 1) < argc);
+		if ((a == "-n")&&(hasArg)) {
+			memberCount = Utils::strToULong(argv[++i]);
+		} else if ((a == "-N")&&(hasArg)) {
+			networkCount = Utils::strToULong(argv[++i]);
+		} else if ((a == "-t")&&(hasArg)) {
+			duration = strtod(argv[++i],(char **)0);
+		} else if ((a == "-r")&&(hasArg)) {
+			requestRate = strtod(argv[++i],(char **)0);
+		} else if ((a == "-o")&&(hasArg)) {
+			maxOutstanding = Utils::strToULong(argv[++i]);
+		} else if ((a == "-a")&&(hasArg)) {
+			authRate = strtod(argv[++i],(char **)0);
+		} else if ((a == "-e")&&(hasArg)) {
+			editRate = strtod(argv[++i],(char **)0);
+		} else if ((a == "-c")&&(hasArg)) {
+			churnRate = strtod(argv[++i],(char **)0);
+		} else if ((a == "-D")&&(hasArg)) {
+			db = argv[++i];
+		} else if ((a == "-d")&&(hasArg)) {
+			path = argv[++i];
+		} else if (a == "-k") {
+			keep = true;
+		} else if (a == "-L") {
+			legacy = true;
+		} else {
+			printHelp(argv[0]);
+			return ((a == "-h") ? 0 : 1);
+		}
+	}
+#ifdef ZT_CONTROLLER_USE_LIBPQ
+	const bool postgres = (db.substr(0,9) == "postgres:");
+#else
+	const bool postgres = false;
+#endif
+	if ((memberCount == 0)||(networkCount == 0)||(networkCount > memberCount)||(duration <= 0.0)||(requestRate < 0.0)||(maxOutstanding == 0)||(authRate < 0.0)||(editRate < 0.0)||(churnRate < 0.0)||((db != "file")&&(db != "log")&&(!postgres))) {
+		printHelp(argv[0]);
+		return 1;
+	}
+
+	OSUtils::rmDashRf(path.c_str());
+	OSUtils::mkdir(path);
+	if (db == "log") {
+		const std::string conf("{\"settings\":{\"controllerDb\":{\"type\":\"log\"}}}\n");
+		OSUtils::writeFile((path + ZT_PATH_SEPARATOR_S "local.conf").c_str(),conf);
+	}
+	const std::string dbPath((postgres) ? db : (path + ZT_PATH_SEPARATOR_S "controller.d"));
+
+	printf("Generating identities..." ZT_EOL_S);
+	Identity signingId;
+	signingId.generate();
+	std::string memberPublic;
+	{
+		Identity shared;
+		shared.generate();
+		char tmp[ZT_IDENTITY_STRING_BUFFER_LENGTH];
+		memberPublic = shared.toString(false,tmp);
+		memberPublic = memberPublic.substr(memberPublic.find(':')); // ":0:<public key>", reused under each synthetic address
+	}
+
+	BenchSender sender(signingId);
+	const uint64_t rssBefore = residentBytes();
+	EmbeddedNetworkController *const controller = new EmbeddedNetworkController((Node *)0,path.c_str(),dbPath.c_str(),0,(RedisConfig *)0);
+	controller->init(signingId,&sender);
+
+	std::vector<std::string> httpPath;
+	std::map<std::string,std::string> httpArgs,httpHeaders;
+	std::string responseBody,responseType;
+	char tmp[256];
+
+	std::vector<uint64_t> networks;
+	std::vector<unsigned int> ruleEdits;
+	const auto postNetwork = [&](const unsigned long n) {
+		nlohmann::json nw;
+		OSUtils::ztsnprintf(tmp,sizeof(tmp),"bench%lu",n);
+		nw["name"] = tmp;
+		nw["private"] = true;
+		OSUtils::ztsnprintf(tmp,sizeof(tmp),"10.%lu.0.0/16",n & 0xff);
+		nw["routes"] = nlohmann::json::array({ { { "target",tmp } } });
+		OSUtils::ztsnprintf(tmp,sizeof(tmp),"10.%lu.0.1",n & 0xff);
+		const std::string first(tmp);
+		OSUtils::ztsnprintf(tmp,sizeof(tmp),"10.%lu.255.254",n & 0xff);
+		nw["ipAssignmentPools"] = nlohmann::json::array({ { { "ipRangeStart",first },{ "ipRangeEnd",tmp } } });
+		nw["v4AssignMode"] = { { "zt",true } };
+		nlohmann::json rules = nlohmann::json::array();
+		for(unsigned int r=0;r<16;++r) {
+			rules.push_back({ { "type","MATCH_IP_DEST_PORT_RANGE" },{ "start",(ruleEdits[n] * 16) + 1000 + r },{ "end",(ruleEdits[n] * 16) + 1000 + r },{ "not",false },{ "or",false } });
+			rules.push_back({ { "type","ACTION_DROP" } });
+		}
+		rules.push_back({ { "type","ACTION_ACCEPT" } });
+		nw["rules"] = rules;
+		httpPath = { "network",Utils::hex(networks[n],tmp) };
+		controller->handleControlPlaneHttpPOST(httpPath,httpArgs,httpHeaders,nw.dump(),responseBody,responseType);
+	};
+	uint64_t nextAddress = 0x1000000000ULL;
+	const auto postMember = [&](const unsigned long m,const bool authorized) {
+		BenchMember &bm = sender.members[m];
+		httpPath = { "network",Utils::hex(bm.nwid,tmp),"member",bm.identity.address().toString(tmp + 32) };
+		controller->handleControlPlaneHttpPOST(httpPath,httpArgs,httpHeaders,(authorized) ? "{\"authorized\":true}" : "{\"authorized\":false}",responseBody,responseType);
+	};
+	const auto newIdentity = [&]() -> Identity {
+		OSUtils::ztsnprintf(tmp,sizeof(tmp),"%.10llx",(unsigned long long)(nextAddress++));
+		return Identity((std::string(tmp) + memberPublic).c_str());
+	};
+
+	printf("Creating %lu networks and %lu members..." ZT_EOL_S,networkCount,memberCount);
+	const int64_t setupStart = OSUtils::now();
+	for(unsigned long n=0;n<networkCount;++n) {
+		networks.push_back((signingId.address().toInt() << 24) | (uint64_t)(n + 1));
+		ruleEdits.push_back(0);
+		postNetwork(n);
+	}
+	sender.members.resize(memberCount);
+	for(unsigned long m=0;m<memberCount;++m) {
+		BenchMember &bm = sender.members[m];
+		bm.nwid = networks[m % networkCount];
+		bm.identity = newIdentity();
+		sender.byAddress[bm.identity.address().toInt()] = m;
+		postMember(m,true);
+	}
+	const int64_t setupTime = OSUtils::now() - setupStart;
+	const uint64_t rssSetup = residentBytes();
+
+	Dictionary<ZT_NETWORKCONFIG_METADATA_DICT_CAPACITY> metaData;
+	metaData.add(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_VERSION,(uint64_t)ZT_NETWORKCONFIG_VERSION);
+	metaData.add(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_NODE_VENDOR,(uint64_t)ZT_VENDOR_ZEROTIER);
+	metaData.add(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_PROTOCOL_VERSION,(uint64_t)ZT_PROTO_VERSION);
+	metaData.add(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_NODE_MAJOR_VERSION,(uint64_t)ZEROTIER_ONE_VERSION_MAJOR);
+	metaData.add(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_NODE_MINOR_VERSION,(uint64_t)ZEROTIER_ONE_VERSION_MINOR);
+	metaData.add(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_NODE_REVISION,(uint64_t)ZEROTIER_ONE_VERSION_REVISION);
+	metaData.add(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_MAX_NETWORK_RULES,(uint64_t)ZT_MAX_NETWORK_RULES);
+	metaData.add(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_MAX_NETWORK_CAPABILITIES,(uint64_t)ZT_MAX_NETWORK_CAPABILITIES);
+	metaData.add(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_MAX_CAPABILITY_RULES,(uint64_t)ZT_MAX_CAPABILITY_RULES);
+	metaData.add(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_MAX_NETWORK_TAGS,(uint64_t)ZT_MAX_NETWORK_TAGS);
+	if (!legacy)
+		metaData.add(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_FLAGS,(uint64_t)ZT_NETWORKCONFIG_REQUEST_FLAG_ACCEPTS_REPLAY);
+	metaData.add(ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_RULES_ENGINE_REV,(uint64_t)ZT_RULES_ENGINE_REVISION);
+
+	printf("Running for %.1fs at ",duration);
+	if (requestRate > 0.0) {
+		printf("%.0f requests/s",requestRate);
+	} else {
+		printf("up to %lu outstanding requests",maxOutstanding);
+	}
+	printf(", %.1f auth changes/s, %.1f rule edits/s, %.1f members replaced/s" ZT_EOL_S,authRate,editRate,churnRate);
+
+	// Members are asked in turn, and changes pick members and networks from a
+	// fixed sequence so that runs with the same options are comparable.
+	std::mt19937 prng(1);
+	uint64_t sent = 0,authChanges = 0,edits = 0,churned = 0;
+	uint64_t packetId = 0;
+	unsigned long cursor = 0,outstanding = 0;
+	uint64_t samples = 0,requestDepthSum = 0,requestDepthMax = 0,commitDepthSum = 0,commitDepthMax = 0;
+	bool commitQueue = false;
+	int64_t lastSample = 0;
+	const BenchClock::time_point start(BenchClock::now());
+	for(;;) {
+		const double elapsed = std::chrono::duration<double>(BenchClock::now() - start).count();
+		if (elapsed >= duration)
+			break;
+		const int64_t now = OSUtils::now();
+
+		std::vector<unsigned long> ask;
+		{
+			std::lock_guard<std::mutex> l(sender.lock);
+			outstanding = 0;
+			for(std::vector<BenchMember>::iterator bm(sender.members.begin());bm!=sender.members.end();++bm) {
+				if (bm->outstanding) {
+					if ((now - bm->lastRequest) >= ZT_CONTROLLERBENCH_REQUEST_TIMEOUT) {
+						bm->outstanding = false;
+						++sender.unanswered;
+					} else {
+						++outstanding;
+					}
+				}
+			}
+			uint64_t due = (requestRate > 0.0) ? (uint64_t)std::max((elapsed * requestRate) - (double)sent,0.0) : (uint64_t)((outstanding < maxOutstanding) ? (maxOutstanding - outstanding) : 0);
+			for(unsigned long tries=0;(due)&&(tries<memberCount);++tries) {
+				BenchMember &bm = sender.members[cursor];
+				if ((!bm.outstanding)&&((now - bm.lastRequest) >= ZT_CONTROLLERBENCH_REQUEST_PERIOD)) {
+					bm.outstanding = true;
+					bm.lastRequest = now;
+					bm.sent = BenchClock::now();
+					ask.push_back(cursor);
+					--due;
+				}
+				cursor = (cursor + 1) % memberCount;
+			}
+		}
+		for(std::vector<unsigned long>::iterator m(ask.begin());m!=ask.end();++m) {
+			const BenchMember &bm = sender.members[*m]; // only this thread resizes or replaces members
+			controller->request(bm.nwid,InetAddress(),++packetId,bm.identity,metaData);
+			++sent;
+		}
+
+		while ((double)authChanges < (elapsed * authRate)) {
+			const unsigned long m = (unsigned long)(prng() % memberCount);
+			bool authorized;
+			{
+				std::lock_guard<std::mutex> l(sender.lock);
+				authorized = (sender.members[m].authorized = !sender.members[m].authorized);
+			}
+			postMember(m,authorized);
+			++authChanges;
+		}
+		while ((double)edits < (elapsed * editRate)) {
+			const unsigned long n = (unsigned long)(prng() % networkCount);
+			++ruleEdits[n];
+			postNetwork(n);
+			++edits;
+		}
+		while ((double)churned < (elapsed * churnRate)) {
+			const unsigned long m = (unsigned long)(prng() % memberCount);
+			httpPath = { "network",Utils::hex(sender.members[m].nwid,tmp),"member",sender.members[m].identity.address().toString(tmp + 32) };
+			controller->handleControlPlaneHttpDELETE(httpPath,httpArgs,httpHeaders,std::string(),responseBody,responseType);
+			{
+				std::lock_guard<std::mutex> l(sender.lock);
+				BenchMember &bm = sender.members[m];
+				sender.byAddress.erase(bm.identity.address().toInt());
+				bm.identity = newIdentity();
+				bm.outstanding = false;
+				bm.lastRequest = 0;
+				bm.authorized = true;
+				sender.byAddress[bm.identity.address().toInt()] = m;
+			}
+			postMember(m,true);
+			++churned;
+		}
+
+		if ((now - lastSample) >= ZT_CONTROLLERBENCH_SAMPLE_INTERVAL) {
+			lastSample = now;
+			httpPath.clear();
+			controller->handleControlPlaneHttpGET(httpPath,httpArgs,httpHeaders,std::string(),responseBody,responseType);
+			try {
+				nlohmann::json status(OSUtils::jsonParse(responseBody));
+				const uint64_t rd = OSUtils::jsonInt(status["requestQueue"]["depth"],0ULL);
+				requestDepthSum += rd;
+				requestDepthMax = std::max(requestDepthMax,rd);
+				if (status["commitQueue"].is_object()) {
+					const uint64_t cd = OSUtils::jsonInt(status["commitQueue"]["depth"],0ULL);
+					commitDepthSum += cd;
+					commitDepthMax = std::max(commitDepthMax,cd);
+					commitQueue = true;
+				}
+				++samples;
+			} catch ( ... ) {}
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	const double elapsed = std::chrono::duration<double>(BenchClock::now() - start).count();
+	const uint64_t rssEnd = residentBytes();
+
+	std::lock_guard<std::mutex> l(sender.lock);
+	const uint64_t answered = sender.configs + sender.errors;
+	printf("Setup:        %lu members in %.1fs" ZT_EOL_S,memberCount,(double)setupTime / 1000.0);
+	printf("Requests:     %llu sent, %llu answered (%llu configs, %llu errors), %llu unanswered" ZT_EOL_S,(unsigned long long)sent,(unsigned long long)answered,(unsigned long long)sender.configs,(unsigned long long)sender.errors,(unsigned long long)sender.unanswered);
+	printf("Throughput:   %.0f answers/s" ZT_EOL_S,(double)answered / elapsed);
+	printf("Latency:      p50 %.2fms, p99 %.2fms, max %.2fms" ZT_EOL_S,percentile(sender.latencies,0.5),percentile(sender.latencies,0.99),percentile(sender.latencies,1.0));
+	printf("Changes:      %llu authorizations, %llu rule edits, %llu members replaced" ZT_EOL_S,(unsigned long long)authChanges,(unsigned long long)edits,(unsigned long long)churned);
+	printf("Pushed:       %llu configs and %llu revocations after changes" ZT_EOL_S,(unsigned long long)sender.pushed,(unsigned long long)sender.revocations);
+	if (rssSetup > rssBefore)
+		printf("Memory:       %.0f bytes per member after setup, %.1f MiB resident at end" ZT_EOL_S,(double)(rssSetup - rssBefore) / (double)memberCount,(double)rssEnd / 1048576.0);
+	if (samples) {
+		printf("Queue depth:  requests avg %.1f max %llu",(double)requestDepthSum / (double)samples,(unsigned long long)requestDepthMax);
+		if (commitQueue)
+			printf(", DB commits avg %.1f max %llu",(double)commitDepthSum / (double)samples,(unsigned long long)commitDepthMax);
+		printf(ZT_EOL_S);
+	}
+
+	delete controller;
+	if (!keep)
+		OSUtils::rmDashRf(path.c_str());
+	return 0;
+}
@@ -1543,6 +1543,119 @@ typedef struct
 	unsigned long peerCount;
 } ZT_PeerList;
 
+/**
+ * Queueing statistics for one QoS bucket of a network's fq_codel scheduler
+ *
+ * Counters are cumulative since the scheduler for this network was created.
+ * Delays are packet sojourn times in milliseconds.
+ */
+typedef struct
+{
+	/**
+	 * QoS bucket (as assigned by network rules)
+	 */
+	unsigned int bucket;
+
+	/**
+	 * Packets accepted into the queue
+	 */
+	uint64_t enqueued;
+
+	/**
+	 * Packets dequeued and sent
+	 */
+	uint64_t sent;
+
+	/**
+	 * Packets dropped by CoDel because their queue stayed above target delay
+	 */
+	uint64_t codelDrops;
+
+	/**
+	 * Packets dropped because the scheduler was full
+	 */
+	uint64_t overflowDrops;
+
+	/**
+	 * Sum of sojourn times of all sent packets (divide by sent for mean)
+	 */
+	uint64_t totalDelay;
+
+	/**
+	 * Largest sojourn time of any sent packet
+	 */
+	unsigned int maxDelay;
+
+	/**
+	 * Packets currently queued
+	 */
+	unsigned int backlogPackets;
+
+	/**
+	 * Payload bytes currently queued
+	 */
+	unsigned int backlogBytes;
+} ZT_QoSBucketStats;
+
+/**
+ * QoS scheduler statistics for a network
+ */
+typedef struct
+{
+	uint64_t nwid;
+	ZT_QoSBucketStats *buckets;
+	unsigned long bucketCount;
+} ZT_QoSStats;
+
+/**
+ * Counters for packets held while waiting for WHOIS, decode info, or pacing
+ *
+ * Counters marked cumulative count since the node was created; the rest
+ * describe what is queued right now.
+ */
+typedef struct
+{
+	/**
+	 * Packets queued to send once a destination's identity is known (cumulative)
+	 */
+	uint64_t txQueued;
+
+	/**
+	 * Queued packets dropped because of the per-destination cap, memory budget, or timeout (cumulative)
+	 */
+	uint64_t txDropped;
+
+	/**
+	 * Received packets held for a later decode attempt (cumulative)
+	 */
+	uint64_t rxQueued;
+
+	/**
+	 * Held received packets dropped because of the per-source cap or timeout (cumulative)
+	 */
+	uint64_t rxDropped;
+
+	/**
+	 * Frames dropped because a paced path was too far behind (cumulative)
+	 */
+	uint64_t txPacedDropped;
+
+	/**
+	 * Packets currently queued to send
+	 */
+	unsigned long txPending;
+
+	/**
+	 * Memory in bytes currently used by packets queued to send
+	 */
+	unsigned long txPendingBytes;
+
+	/**
+	 * Frames currently held for paced paths
+	 */
+	unsigned long txPaced;
+} ZT_PendingQueueStats;
+
 /**
  * ZeroTier core state objects
  */
@@ -2098,6 +2211,26 @@ ZT_SDK_API ZT_VirtualNetworkConfig *ZT_Node_networkConfig(ZT_Node *node,uint64_t
  */
 ZT_SDK_API ZT_VirtualNetworkList *ZT_Node_networks(ZT_Node *node);
 
+/**
+ * Get QoS scheduler statistics for a network
+ *
+ * The pointer returned here must be freed with freeQueryResult()
+ * when you are done with it.
+ *
+ * @param node Node instance
+ * @param nwid 64-bit network ID
+ * @return Statistics or NULL if no QoS scheduling has taken place on this network
+ */
+ZT_SDK_API ZT_QoSStats *ZT_Node_qosStats(ZT_Node *node,uint64_t nwid);
+
+/**
+ * Get counters for packets held while waiting for WHOIS, decode info, or pacing
+ *
+ * @param node Node instance
+ * @param stats Buffer to fill with current counters
+ */
+ZT_SDK_API void ZT_Node_pendingQueueStats(ZT_Node *node,ZT_PendingQueueStats *stats);
+
 /**
  * Free a query result buffer
  *
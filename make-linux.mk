@@ -331,13 +331,25 @@ selftest:	$(CORE_OBJS) $(ONE_OBJS) selftest.o
 
 zerotier-selftest: selftest
 
+bondsim:	$(CORE_OBJS) $(ONE_OBJS) bondsim.o
+	$(CXX) $(CXXFLAGS) $(LDFLAGS) -o zerotier-bondsim bondsim.o $(CORE_OBJS) $(ONE_OBJS) $(LDLIBS)
+	$(STRIP) zerotier-bondsim
+
+zerotier-bondsim: bondsim
+
+controllerbench:	$(CORE_OBJS) $(ONE_OBJS) controllerbench.o
+	$(CXX) $(CXXFLAGS) $(LDFLAGS) -o zerotier-controllerbench controllerbench.o $(CORE_OBJS) $(ONE_OBJS) $(LDLIBS)
+	$(STRIP) zerotier-controllerbench
+
+zerotier-controllerbench: controllerbench
+
 manpages:	FORCE
 	cd doc ; ./build.sh
 
 doc:	manpages
 
 clean: FORCE
-	rm -rf *.a *.so *.o node/*.o controller/*.o osdep/*.o service/*.o ext/http-parser/*.o ext/miniupnpc/*.o ext/libnatpmp/*.o $(CORE_OBJS) $(ONE_OBJS) zerotier-one zerotier-idtool zerotier-cli zerotier-selftest build-* ZeroTierOneInstaller-* *.deb *.rpm .depend debian/files debian/zerotier-one*.debhelper debian/zerotier-one.substvars debian/*.log debian/zerotier-one doc/node_modules ext/misc/*.o debian/.debhelper debian/debhelper-build-stamp docker/zerotier-one
+	rm -rf *.a *.so *.o node/*.o controller/*.o osdep/*.o service/*.o ext/http-parser/*.o ext/miniupnpc/*.o ext/libnatpmp/*.o $(CORE_OBJS) $(ONE_OBJS) zerotier-one zerotier-idtool zerotier-cli zerotier-selftest zerotier-bondsim zerotier-controllerbench build-* ZeroTierOneInstaller-* *.deb *.rpm .depend debian/files debian/zerotier-one*.debhelper debian/zerotier-one.substvars debian/*.log debian/zerotier-one doc/node_modules ext/misc/*.o debian/.debhelper debian/debhelper-build-stamp docker/zerotier-one
 
 distclean:	clean
 
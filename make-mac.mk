@@ -138,6 +138,18 @@ selftest: $(CORE_OBJS) $(ONE_OBJS) selftest.o
 
 zerotier-selftest: selftest
 
+bondsim: $(CORE_OBJS) $(ONE_OBJS) bondsim.o
+	$(CXX) $(CXXFLAGS) -o zerotier-bondsim bondsim.o $(CORE_OBJS) $(ONE_OBJS) $(LIBS)
+	$(STRIP) zerotier-bondsim
+
+zerotier-bondsim: bondsim
+
+controllerbench: $(CORE_OBJS) $(ONE_OBJS) controllerbench.o
+	$(CXX) $(CXXFLAGS) -o zerotier-controllerbench controllerbench.o $(CORE_OBJS) $(ONE_OBJS) $(LIBS)
+	$(STRIP) zerotier-controllerbench
+
+zerotier-controllerbench: controllerbench
+
 # Requires Packages: http://s.sudre.free.fr/Software/Packages/about.html
 mac-dist-pkg: FORCE
 	packagesbuild "ext/installfiles/mac/ZeroTier One.pkgproj"
@@ -160,7 +172,7 @@ central-controller-docker: FORCE
 	docker build --no-cache -t registry.zerotier.com/zerotier-central/ztcentral-controller:${TIMESTAMP} -f ext/central-controller-docker/Dockerfile --build-arg git_branch=$(shell git name-rev --name-only HEAD) .
 
 clean:
-	rm -rf MacEthernetTapAgent *.dSYM build-* *.a *.pkg *.dmg *.o node/*.o controller/*.o service/*.o osdep/*.o ext/http-parser/*.o $(CORE_OBJS) $(ONE_OBJS) zerotier-one zerotier-idtool zerotier-selftest zerotier-cli zerotier doc/node_modules macui/build zt1_update_$(ZT_BUILD_PLATFORM)_$(ZT_BUILD_ARCHITECTURE)_*
+	rm -rf MacEthernetTapAgent *.dSYM build-* *.a *.pkg *.dmg *.o node/*.o controller/*.o service/*.o osdep/*.o ext/http-parser/*.o $(CORE_OBJS) $(ONE_OBJS) zerotier-one zerotier-idtool zerotier-selftest zerotier-bondsim zerotier-controllerbench zerotier-cli zerotier doc/node_modules macui/build zt1_update_$(ZT_BUILD_PLATFORM)_$(ZT_BUILD_ARCHITECTURE)_*
 
 distclean:	clean
 
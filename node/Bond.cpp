@@ -12,6 +12,7 @@
 /****/
 
 #include <cmath>
+#include <atomic>
 
 #include "../osdep/OSUtils.hpp"
 
@@ -20,11 +21,35 @@
 #include "Switch.hpp"
 #include "Flow.hpp"
 #include "Path.hpp"
+#include "Network.hpp"
 
 namespace ZeroTier {
 
+/**
+ * Hands frames released by a bond's resequencer to the tap
+ */
+struct _ResequencedFrameSink
+{
+	_ResequencedFrameSink(const RuntimeEnvironment *renv,void *tp) : RR(renv),tPtr(tp),nwid(0) {}
+	inline void operator()(uint64_t frameNwid,const MAC &from,const MAC &to,unsigned int etherType,const void *data,unsigned int len)
+	{
+		if (frameNwid != nwid) {
+			nwid = frameNwid;
+			network = RR->node->network(nwid);
+		}
+		if (network)
+			RR->node->putFrame(tPtr,nwid,network->userPtr(),from,to,etherType,0,data,len);
+	}
+	const RuntimeEnvironment *RR;
+	void *tPtr;
+	uint64_t nwid;
+	SharedPtr<Network> network;
+};
+
 Bond::Bond(const RuntimeEnvironment *renv, int policy, const SharedPtr<Peer>& peer) :
 	RR(renv),
+	_flowTable((FlowTable *)0),
+	_flowCount(0),
 	_peer(peer),
 	_qosCutoffCount(0),
 	_ackCutoffCount(0),
@@ -40,9 +65,11 @@ Bond::Bond(const RuntimeEnvironment *renv, int policy, const SharedPtr<Peer>& pe
 	_lastFlowStatReset(0),
 	_lastFlowExpirationCheck(0),
 	_lastFlowRebalance(0),
+	_lastFlowRateCheck(0),
 	_lastFrame(0),
 	_lastActiveBackupPathChange(0)
 {
+	memset((void *)_pathPtrs, 0, sizeof(_pathPtrs));
 	setReasonableDefaults(policy, SharedPtr<Bond>(), false);
 	_policyAlias = BondController::getPolicyStrByCode(policy);
 }
@@ -50,13 +77,18 @@ Bond::Bond(const RuntimeEnvironment *renv, int policy, const SharedPtr<Peer>& pe
 Bond::Bond(const RuntimeEnvironment *renv, std::string& basePolicy, std::string& policyAlias, const SharedPtr<Peer>& peer) :
 	RR(renv),
 	_policyAlias(policyAlias),
+	_flowTable((FlowTable *)0),
+	_flowCount(0),
 	_peer(peer)
 {
+	memset((void *)_pathPtrs, 0, sizeof(_pathPtrs));
 	setReasonableDefaults(BondController::getPolicyCodeByStr(basePolicy), SharedPtr<Bond>(), false);
 }
 
 Bond::Bond(const RuntimeEnvironment *renv, SharedPtr<Bond> originalBond, const SharedPtr<Peer>& peer) :
 	RR(renv),
+	_flowTable((FlowTable *)0),
+	_flowCount(0),
 	_peer(peer),
 	_lastAckRateCheck(0),
 	_lastQoSRateCheck(0),
@@ -69,16 +101,26 @@ Bond::Bond(const RuntimeEnvironment *renv, SharedPtr<Bond> originalBond, const S
 	_lastFlowStatReset(0),
 	_lastFlowExpirationCheck(0),
 	_lastFlowRebalance(0),
+	_lastFlowRateCheck(0),
 	_lastFrame(0)
 {
+	memset((void *)_pathPtrs, 0, sizeof(_pathPtrs));
 	setReasonableDefaults(originalBond->_bondingPolicy, originalBond, true);
 }
 
+Bond::~Bond()
+{
+	delete _flowTable;
+	for (std::vector<FlowTable *>::iterator t(_outgrownFlowTables.begin()); t != _outgrownFlowTables.end(); ++t) {
+		delete *t;
+	}
+}
+
 void Bond::nominatePath(const SharedPtr<Path>& path, int64_t now)
 {
-	char traceMsg[256]; char pathStr[128]; path->address().toString(pathStr);
 	Mutex::Lock _l(_paths_m);
-	if (!RR->bc->linkAllowed(_policyAlias, getLink(path))) {
+	SharedPtr<Link> link = getLink(path);
+	if (!RR->bc->linkAllowed(_policyAlias, link)) {
 		return;
 	}
 	bool alreadyPresent = false;
@@ -92,10 +134,9 @@ void Bond::nominatePath(const SharedPtr<Path>& path, int64_t now)
 	if (!alreadyPresent) {
 		for (int i=0; i<ZT_MAX_PEER_NETWORK_PATHS; ++i) {
 			if (!_paths[i]) {
-				_paths[i] = path;
-				sprintf(traceMsg, "%s (bond) Nominating link %s/%s to peer %llx. It has now entered its trial period",
-					OSUtils::humanReadableTimestamp().c_str(), getLink(path)->ifname().c_str(), pathStr, _peer->_id.address().toInt());
-				RR->t->bondStateMessage(NULL, traceMsg);
+				_pathLinks[i] = link; // bound once here so later lookups avoid BondController
+				_setPath(i, path, now);
+				_event(EVENT_PATH_NOMINATED, i, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW);
 				_paths[i]->startTrial(now);
 				break;
 			}
@@ -107,6 +148,23 @@ void Bond::nominatePath(const SharedPtr<Path>& path, int64_t now)
 
 SharedPtr<Path> Bond::getAppropriatePath(int64_t now, int32_t flowId)
 {
+	/**
+	 * Flows that already have a path are looked up without locking _flows_m,
+	 * and the path comes from _pathPtrs without locking _paths_m.
+	 */
+	if ((_bondingPolicy == ZT_BONDING_POLICY_BALANCE_XOR || _bondingPolicy == ZT_BONDING_POLICY_BALANCE_AWARE)
+		&& _allowFlowHashing && _numBondedPaths) {
+		Flow *const flow = _touchFlow(flowId, now);
+		if (flow) {
+			const unsigned int idx = flow->assignedPath();
+			if (idx < ZT_MAX_PEER_NETWORK_PATHS) {
+				Path *const p = _pathPtrs[idx];
+				if (p) {
+					return SharedPtr<Path>(p);
+				}
+			}
+		}
+	}
 	Mutex::Lock _l(_paths_m);
 	/**
 	 * active-backup
@@ -170,20 +228,19 @@ SharedPtr<Path> Bond::getAppropriatePath(int64_t now, int32_t flowId)
 			return _paths[_bondedIdx[_freeRandomByte % _numBondedPaths]]; // TODO: Optimize
 		}
 		else if (_allowFlowHashing) {
-			// TODO: Optimize
 			Mutex::Lock _l(_flows_m);
-			SharedPtr<Flow> flow;
-			if (_flows.count(flowId)) {
-				flow = _flows[flowId];
+			Flow *flow = _findFlow(flowId);
+			if (flow) {
 				flow->updateActivity(now);
 			}
 			else {
-				unsigned char entropy;
-				Utils::getSecureRandom(&entropy, 1);
-				flow = createFlow(SharedPtr<Path>(), flowId, entropy, now);
+				flow = createFlow(SharedPtr<Path>(), flowId, now);
 			}
-			if (flow) {
-				return flow->assignedPath();
+			if ((flow)&&(flow->assignedPath() >= ZT_MAX_PEER_NETWORK_PATHS)) {
+				assignFlowToBondedPath(flow, now);
+			}
+			if ((flow)&&(flow->assignedPath() < ZT_MAX_PEER_NETWORK_PATHS)) {
+				return _paths[flow->assignedPath()];
 			}
 		}
 	}
@@ -199,7 +256,7 @@ void Bond::recordIncomingInvalidPacket(const SharedPtr<Path>& path)
 	Mutex::Lock _l(_paths_m);
 	for (int i=0; i<ZT_MAX_PEER_NETWORK_PATHS; ++i) {
 		if (_paths[i] == path) {
-			_paths[i]->packetValiditySamples.push(false);
+			_paths[i]->packetValidityStats.push(0.0f);
 		}
 	}
 }
@@ -221,22 +278,28 @@ void Bond::recordOutgoingPacket(const SharedPtr<Path> &path, const uint64_t pack
 		&& (verb != Packet::VERB_QOS_MEASUREMENT));
 	if (isFrame || shouldRecord) {
 		Mutex::Lock _l(_paths_m);
-		if (isFrame) {
-			++(path->_packetsOut);
-			_lastFrame=now;
-		}
-		if (shouldRecord) {
-			path->_unackedBytes += payloadLength;
-			// Take note that we're expecting a VERB_ACK on this path as of a specific time
-			if (path->qosStatsOut.size() < ZT_QOS_MAX_OUTSTANDING_RECORDS) {
-				path->qosStatsOut[packetId] = now;
-			}
-		}
+		_recordOutgoingPathStats(path, packetId, payloadLength, isFrame, shouldRecord, now);
 	}
 	if (_allowFlowHashing && (flowId != ZT_QOS_NO_FLOW)) {
 		Mutex::Lock _l(_flows_m);
-		if (_flows.count(flowId)) {
-			_flows[flowId]->recordOutgoingBytes(payloadLength);
+		Flow *const flow = _findFlow(flowId);
+		if (flow) {
+			flow->recordOutgoingBytes(payloadLength);
+		}
+	}
+}
+
+void Bond::_recordOutgoingPathStats(const SharedPtr<Path> &path, uint64_t packetId, uint16_t payloadLength, bool isFrame, bool shouldRecord, int64_t now)
+{
+	if (isFrame) {
+		++(path->_packetsOut);
+		_lastFrame=now;
+	}
+	if (shouldRecord) {
+		path->_unackedBytes += payloadLength;
+		// Take note that we're expecting a VERB_ACK on this path as of a specific time
+		if (path->qosStatsOut.size() < ZT_QOS_MAX_OUTSTANDING_RECORDS) {
+			path->qosStatsOut[packetId] = now;
 		}
 	}
 }
@@ -263,7 +326,7 @@ void Bond::recordIncomingPacket(const SharedPtr<Path>& path, uint64_t packetId,
 			++(path->_packetsReceivedSinceLastAck);
 			path->qosStatsIn[packetId] = now;
 			++(path->_packetsReceivedSinceLastQoS);
-			path->packetValiditySamples.push(true);
+			path->packetValidityStats.push(1.0f);
 		}
 	}
 	/**
@@ -276,11 +339,9 @@ void Bond::recordIncomingPacket(const SharedPtr<Path>& path, uint64_t packetId,
 			|| _bondingPolicy == ZT_BONDING_POLICY_BALANCE_XOR
 			|| _bondingPolicy == ZT_BONDING_POLICY_BALANCE_AWARE)) {
 		Mutex::Lock _l(_flows_m);
-		SharedPtr<Flow> flow;
-		if (!_flows.count(flowId)) {
-			flow = createFlow(path, flowId, 0, now);
-		} else {
-			flow = _flows[flowId];
+		Flow *flow = _findFlow(flowId);
+		if (!flow) {
+			flow = createFlow(path, flowId, now);
 		}
 		if (flow) {
 			flow->recordIncomingBytes(payloadLength);
@@ -300,11 +361,11 @@ void Bond::receivedQoS(const SharedPtr<Path>& path, int64_t now, int count, uint
 	for (int j=0; j<count; j++) {
 		it = path->qosStatsOut.find(rx_id[j]);
 		if (it != path->qosStatsOut.end()) {
-			path->latencySamples.push(((uint16_t)(now - it->second) - rx_ts[j]) / 2);
+			path->latencyStats.push((float)(((uint16_t)(now - it->second) - rx_ts[j]) / 2));
+			path->qosRecordLossStats.push(0.0f);
 			path->qosStatsOut.erase(it);
 		}
 	}
-	path->qosRecordSize.push(count);
 }
 
 void Bond::receivedAck(const SharedPtr<Path>& path, int64_t now, int32_t ackedBytes)
@@ -316,19 +377,81 @@ void Bond::receivedAck(const SharedPtr<Path>& path, int64_t now, int32_t ackedBy
 	//RR->t->bondStateMessage(NULL, traceMsg);
 	path->_lastAckReceived = now;
 	path->_unackedBytes = (ackedBytes > path->_unackedBytes) ? 0 : path->_unackedBytes - ackedBytes;
+	if (ackedBytes > 0) {
+		path->_bytesAckedSinceLastThroughputEstimation += ackedBytes;
+	}
+	if (!path->_lastThroughputEstimation) {
+		// Nothing to measure the first ACK's bytes against
+		path->_lastThroughputEstimation = now;
+		path->_bytesAckedSinceLastThroughputEstimation = 0;
+		return;
+	}
 	int64_t timeSinceThroughputEstimate = (now - path->_lastThroughputEstimation);
 	if (timeSinceThroughputEstimate >= throughputMeasurementInterval) {
-		// TODO: See if this floating point math can be reduced
-		uint64_t throughput = (uint64_t)((float)(path->_bytesAckedSinceLastThroughputEstimation) / ((float)timeSinceThroughputEstimate / (float)1000));
-		throughput /= 1000;
-		if (throughput > 0.0) {
-			path->throughputSamples.push(throughput);
-			path->_throughputMax = throughput > path->_throughputMax ? throughput : path->_throughputMax;
+		// Bytes per ms times 8 is kbit/s
+		uint64_t throughput = (path->_bytesAckedSinceLastThroughputEstimation * 8) / (uint64_t)timeSinceThroughputEstimate;
+		if (throughput > 0) {
+			path->throughputStats.push((float)throughput);
 		}
 		path->_lastThroughputEstimation = now;
 		path->_bytesAckedSinceLastThroughputEstimation = 0;
+	}
+}
+
+void Bond::receivedProbe(void *tPtr, const SharedPtr<Path>& path, int64_t now, uint16_t train, unsigned int index, unsigned int count, unsigned int len)
+{
+	uint32_t bytes = 0;
+	uint32_t dispersion = 0;
+	{
+		Mutex::Lock _l(_paths_m);
+		if ((!path->_probeRxActive)||(path->_probeRxTrain != train)) {
+			path->_probeRxActive = true;
+			path->_probeRxTrain = train;
+			path->_probeRxFirst = now;
+			path->_probeRxBytes = 0;
+		} else {
+			path->_probeRxBytes += len;
+		}
+		path->_probeRxLast = now;
+		if ((index + 1) < count) {
+			return;
+		}
+		path->_probeRxActive = false;
+		bytes = path->_probeRxBytes;
+		dispersion = (uint32_t)(path->_probeRxLast - path->_probeRxFirst);
+	}
+	if (bytes && path->address()) {
+		Packet outp(_peer->_id.address(),RR->identity.address(),Packet::VERB_BOND_PROBE);
+		outp.append((uint8_t)1);
+		outp.append(train);
+		outp.append(bytes);
+		outp.append(dispersion);
+		outp.armor(_peer->key(),false,_peer->aesKeysIfSupported());
+		RR->node->putPacket(tPtr,path->localSocket(),path->address(),outp.data(),outp.size());
+	}
+}
+
+void Bond::receivedProbeReport(const SharedPtr<Path>& path, int64_t now, uint16_t train, uint32_t bytes, uint32_t dispersion)
+{
+	Mutex::Lock _l(_paths_m);
+	if ((!bytes)||(!path->_probeTrain)||(train != path->_probeTrain)) {
+		return;
+	}
+	path->_probeTrain = 0;
+	path->_probeUnanswered = 0;
+	const uint64_t estimate = ((uint64_t)bytes * 8) / (uint64_t)std::max(dispersion,(uint32_t)1);
+	if (dispersion >= ZT_BOND_CAPACITY_PROBE_MIN_DISPERSION) {
+		path->_probedCapacity = path->_probedCapacity ? ((path->_probedCapacity + estimate) / 2) : estimate;
+		if ((dispersion > (ZT_BOND_CAPACITY_PROBE_MIN_DISPERSION * 4)) && (path->_probeTrainLength > ZT_BOND_CAPACITY_PROBE_MIN_TRAIN)) {
+			path->_probeTrainLength /= 2;
+		}
 	} else {
-		path->_bytesAckedSinceLastThroughputEstimation += ackedBytes;
+		// The train arrived too quickly to time, so this is only a lower bound
+		path->_probedCapacity = std::max(path->_probedCapacity,estimate);
+		if (path->_probeTrainLength < ZT_BOND_CAPACITY_PROBE_MAX_TRAIN) {
+			path->_probeTrainLength = std::min(path->_probeTrainLength * 2,(unsigned int)ZT_BOND_CAPACITY_PROBE_MAX_TRAIN);
+			path->_lastCapacityProbe = now - ZT_BOND_CAPACITY_PROBE_INTERVAL + ZT_BOND_CAPACITY_PROBE_RETRY;
+		}
 	}
 }
 
@@ -352,118 +475,214 @@ int32_t Bond::generateQoSPacket(const SharedPtr<Path>& path, int64_t now, char *
 	return len;
 }
 
-bool Bond::assignFlowToBondedPath(SharedPtr<Flow> &flow, int64_t now)
+bool Bond::assignFlowToBondedPath(Flow *flow, int64_t now)
 {
-	char traceMsg[256];
-	char curPathStr[128];
 	unsigned int idx = ZT_MAX_PEER_NETWORK_PATHS;
 	if (_bondingPolicy == ZT_BONDING_POLICY_BALANCE_XOR) {
-		idx = abs((int)(flow->id() % (_numBondedPaths)));
-		SharedPtr<Link> link = RR->bc->getLinkBySocket(_policyAlias, _paths[_bondedIdx[idx]]->localSocket());
-		_paths[_bondedIdx[idx]]->address().toString(curPathStr);
-		sprintf(traceMsg, "%s (balance-xor) Assigned outgoing flow %x to peer %llx to link %s/%s, %lu active flow(s)",
-			OSUtils::humanReadableTimestamp().c_str(), flow->id(), _peer->_id.address().toInt(), link->ifname().c_str(), curPathStr, _flows.size());
-		RR->t->bondStateMessage(NULL, traceMsg);
-		flow->assignPath(_paths[_bondedIdx[idx]],now);
-		++(_paths[_bondedIdx[idx]]->_assignedFlowCount);
+		idx = _bondedIdx[abs((int)(flow->id() % (_numBondedPaths)))];
+		flow->assignPath(idx,now);
+		++(_paths[idx]->_assignedFlowCount);
 	}
 	if (_bondingPolicy == ZT_BONDING_POLICY_BALANCE_AWARE) {
-		unsigned char entropy;
-		Utils::getSecureRandom(&entropy, 1);
-		if (_totalBondUnderload) {
-			entropy %= _totalBondUnderload;
-		}
 		if (!_numBondedPaths) {
-			sprintf(traceMsg, "%s (balance-aware) There are no bonded paths, cannot assign flow %x\n",
-				OSUtils::humanReadableTimestamp().c_str(), flow->id());
-			RR->t->bondStateMessage(NULL, traceMsg);
+			_event(EVENT_FLOW_UNASSIGNABLE, ZT_MAX_PEER_NETWORK_PATHS, ZT_MAX_PEER_NETWORK_PATHS, flow->id(), 0);
 			return false;
 		}
-		/* Since there may be scenarios where a path is removed before we can re-estimate
-		relative qualities (and thus allocations) we need to down-modulate the entropy
-		value that we use to randomly assign among the surviving paths, otherwise we risk
-		not being able to find a path to assign this flow to. */
-		int totalIncompleteAllocation = 0;
-		for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
-			if (_paths[i] && _paths[i]->bonded()) {
-				totalIncompleteAllocation += _paths[i]->_allocation;
-			}
-		}
-		entropy %= totalIncompleteAllocation;
-		for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
-			if (_paths[i] && _paths[i]->bonded()) {
-				SharedPtr<Link> link = RR->bc->getLinkBySocket(_policyAlias, _paths[i]->localSocket());
-				_paths[i]->address().toString(curPathStr);
-				uint8_t probabilitySegment = (_totalBondUnderload > 0) ? _paths[i]->_affinity : _paths[i]->_allocation;
-				if (entropy <= probabilitySegment) {
-					idx = i;
-					break;
-				}
-				entropy -= probabilitySegment;
-			}
-		}
+		idx = flow->elephant() ? _elephantPath(flow) : _rendezvousPath(flow->id());
 		if (idx < ZT_MAX_PEER_NETWORK_PATHS) {
-			if (flow->_assignedPath) {
-				flow->_previouslyAssignedPath = flow->_assignedPath;
+			if (flow->assignedPath() < ZT_MAX_PEER_NETWORK_PATHS) {
+				flow->_previouslyAssignedPath = flow->assignedPath();
 			}
-			flow->assignPath(_paths[idx],now);
+			flow->assignPath(idx,now);
 			++(_paths[idx]->_assignedFlowCount);
 		}
 		else {
-			fprintf(stderr, "could not assign flow?\n"); exit(0); // TODO: Remove for production
+			_event(EVENT_FLOW_UNASSIGNABLE, ZT_MAX_PEER_NETWORK_PATHS, ZT_MAX_PEER_NETWORK_PATHS, flow->id(), 0);
 			return false;
 		}
 	}
 	if (_bondingPolicy == ZT_BONDING_POLICY_ACTIVE_BACKUP) {
-		if (_abOverflowEnabled) {
-				flow->assignPath(_abPath, now);
+		if (_abOverflowEnabled && (_pathIndex(_abPath) < ZT_MAX_PEER_NETWORK_PATHS)) {
+				flow->assignPath(_pathIndex(_abPath), now);
 		} else {
-			sprintf(traceMsg, "%s (bond) Unable to assign outgoing flow %x to peer %llx, no active overflow link",
-				OSUtils::humanReadableTimestamp().c_str(), flow->id(), _peer->_id.address().toInt());
-			RR->t->bondStateMessage(NULL, traceMsg);
+			_event(EVENT_FLOW_UNASSIGNABLE, ZT_MAX_PEER_NETWORK_PATHS, ZT_MAX_PEER_NETWORK_PATHS, flow->id(), 1);
 			return false;
 		}
 	}
-	flow->assignedPath()->address().toString(curPathStr);
-	SharedPtr<Link> link = RR->bc->getLinkBySocket(_policyAlias, flow->assignedPath()->localSocket());
-	sprintf(traceMsg, "%s (bond) Assigned outgoing flow %x to peer %llx to link %s/%s, %lu active flow(s)",
-		OSUtils::humanReadableTimestamp().c_str(), flow->id(), _peer->_id.address().toInt(), link->ifname().c_str(), curPathStr, _flows.size());
-	RR->t->bondStateMessage(NULL, traceMsg);
+	idx = flow->assignedPath();
+	if (idx >= ZT_MAX_PEER_NETWORK_PATHS) {
+		return false;
+	}
+	_event(EVENT_FLOW_ASSIGNED, idx, ZT_MAX_PEER_NETWORK_PATHS, flow->id(), (int64_t)_flowCount, 0);
 	return true;
 }
 
-SharedPtr<Flow> Bond::createFlow(const SharedPtr<Path> &path, int32_t flowId, unsigned char entropy, int64_t now)
+unsigned int Bond::_rendezvousPath(int32_t flowId) const
+{
+	/**
+	 * Weighted rendezvous hashing: every bonded path draws a score from a hash of
+	 * the flow ID and its own index, scaled by its share of the bond, and the flow
+	 * goes to the highest score. Paths win flows in proportion to their share, a
+	 * flow lands on the same path every time, and adding or removing a path only
+	 * moves the flows that it gains or loses.
+	 */
+	unsigned int best = ZT_MAX_PEER_NETWORK_PATHS;
+	float bestScore = 0.0f;
+	for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
+		if (!_paths[i] || !_paths[i]->bonded()) {
+			continue;
+		}
+		const float weight = (float)((_totalBondUnderload > 0) ? _paths[i]->_affinity : _paths[i]->_allocation) + 1.0f;
+		uint32_t h = ((uint32_t)flowId * 0x9e3779b1U) ^ ((i + 1) * 0x85ebca77U);
+		h ^= h >> 16;
+		h *= 0x45d9f3bU;
+		h ^= h >> 16;
+		const float u = ((float)(h >> 8) + 0.5f) / 16777216.0f; // in (0,1)
+		const float score = weight / -logf(u);
+		if ((best == ZT_MAX_PEER_NETWORK_PATHS) || (score > bestScore)) {
+			best = i;
+			bestScore = score;
+		}
+	}
+	return best;
+}
+
+unsigned int Bond::_elephantPath(const Flow *flow) const
+{
+	unsigned int best = ZT_MAX_PEER_NETWORK_PATHS;
+	float bestScore = 0.0f;
+	for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
+		if (!_paths[i] || !_paths[i]->bonded()) {
+			continue;
+		}
+		const float score = _elephantScore(flow, i);
+		if ((best == ZT_MAX_PEER_NETWORK_PATHS) || (score > bestScore)) {
+			best = i;
+			bestScore = score;
+		}
+	}
+	return best;
+}
+
+bool Bond::_mayMigrateFlow(const Flow *flow, unsigned int toIdx, int64_t now) const
+{
+	const unsigned int fromIdx = flow->assignedPath();
+	if ((fromIdx >= ZT_MAX_PEER_NETWORK_PATHS) || !_paths[fromIdx] || _resequence) {
+		return true;
+	}
+	/**
+	 * Packets sent on the new path may overtake those still in flight on the
+	 * old one by up to the difference in latency. Move when that is small, or
+	 * when the flow has been idle for at least that long so nothing is left to
+	 * overtake.
+	 */
+	const float overtake = _paths[fromIdx]->latencyMean() - _paths[toIdx]->latencyMean();
+	return ((overtake <= (float)ZT_FLOW_MIGRATION_MAX_REORDER) || ((float)flow->age(now) >= overtake));
+}
+
+void Bond::_placeElephantFlows(int64_t now)
+{
+	const int64_t elapsed = now - _lastFlowRateCheck;
+	_lastFlowRateCheck = now;
+	memset(_elephantCount, 0, sizeof(_elephantCount));
+	for (unsigned int f=0; (_flowTable) && (f<=_flowTable->mask); ++f) {
+		Flow *const flow = _flowTable->slots + f;
+		if (flow->inUse()) {
+			flow->updateRate(elapsed, ZT_FLOW_ELEPHANT_THRESHOLD);
+			if (flow->elephant() && (flow->assignedPath() < ZT_MAX_PEER_NETWORK_PATHS)) {
+				++_elephantCount[flow->assignedPath()];
+			}
+		}
+	}
+	/**
+	 * A rendezvous hash spreads flows by count, which is fine for mice but can
+	 * stack a few large flows onto one slow link. Elephants are instead placed
+	 * by capacity, and are only moved when another path has clearly more room
+	 * for them and the move would not reorder them by more than the bond can
+	 * tolerate.
+	 */
+	for (unsigned int f=0; (_flowTable) && (f<=_flowTable->mask); ++f) {
+		Flow *const flow = _flowTable->slots + f;
+		const unsigned int fromIdx = flow->assignedPath();
+		if (!flow->inUse() || !flow->elephant() || (fromIdx >= ZT_MAX_PEER_NETWORK_PATHS) || !_paths[fromIdx]) {
+			continue;
+		}
+		if ((now - flow->_lastPathReassignment) < ZT_FLOW_MIN_REBALANCE_INTERVAL) {
+			continue;
+		}
+		const unsigned int toIdx = _elephantPath(flow);
+		if ((toIdx >= ZT_MAX_PEER_NETWORK_PATHS) || (toIdx == fromIdx)) {
+			continue;
+		}
+		if (_paths[fromIdx]->bonded() && (_elephantScore(flow, toIdx) < (_elephantScore(flow, fromIdx) * ZT_FLOW_ELEPHANT_MIGRATION_GAIN))) {
+			continue;
+		}
+		if (!_mayMigrateFlow(flow, toIdx, now)) {
+			continue;
+		}
+		flow->_previouslyAssignedPath = (uint8_t)fromIdx;
+		flow->assignPath(toIdx, now);
+		--(_paths[fromIdx]->_assignedFlowCount);
+		++(_paths[toIdx]->_assignedFlowCount);
+		--_elephantCount[fromIdx];
+		++_elephantCount[toIdx];
+		_peer->pathSelectionChanged();
+		_event(EVENT_FLOW_PINNED, fromIdx, toIdx, flow->id(), (int64_t)flow->rate());
+	}
+}
+
+Flow *Bond::createFlow(const SharedPtr<Path> &path, int32_t flowId, int64_t now)
 {
-	char traceMsg[256];
-	char curPathStr[128];
-	// ---
 	if (!_numBondedPaths) {
-		sprintf(traceMsg, "%s (bond) There are no bonded paths to peer %llx, cannot assign flow %x\n",
-			OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt(), flowId);
-		RR->t->bondStateMessage(NULL, traceMsg);
-		return SharedPtr<Flow>();
-	}
-	if (_flows.size() >= ZT_FLOW_MAX_COUNT) {
-		sprintf(traceMsg, "%s (bond) Maximum number of flows on bond to peer %llx reached (%d), forcibly forgetting oldest flow\n",
-			OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt(), ZT_FLOW_MAX_COUNT);
-		RR->t->bondStateMessage(NULL, traceMsg);
-		forgetFlowsWhenNecessary(0, true, now);
-	}
-	SharedPtr<Flow> flow = new Flow(flowId, now);
-	_flows[flowId] = flow;
+		_event(EVENT_FLOW_UNASSIGNABLE, ZT_MAX_PEER_NETWORK_PATHS, ZT_MAX_PEER_NETWORK_PATHS, flowId, 0);
+		return (Flow *)0;
+	}
+	if (flowId == ZT_QOS_NO_FLOW) {
+		return (Flow *)0;
+	}
+	if (!_flowTable) {
+		_flowTable = new FlowTable(ZT_FLOW_TABLE_MIN_SIZE);
+	}
+	else if ((((_flowCount + 1) * 2) > _flowTable->size()) && (_flowTable->size() < ZT_FLOW_MAX_COUNT)) {
+		_growFlowTable();
+	}
+	/**
+	 * Take the first free slot near the flow's home slot. If there is none, the
+	 * least recently active flow among them is forgotten to make room.
+	 */
+	FlowTable *const t = _flowTable;
+	const unsigned int home = _flowHash(flowId);
+	Flow *flow = (Flow *)0;
+	Flow *oldestFlow = (Flow *)0;
+	for (unsigned int k=0; k<ZT_FLOW_TABLE_MAX_PROBE; ++k) {
+		Flow *const f = t->slots + ((home + k) & t->mask);
+		if (!f->inUse()) {
+			flow = f;
+			break;
+		}
+		if ((!oldestFlow) || (f->_lastActivity < oldestFlow->_lastActivity)) {
+			oldestFlow = f;
+		}
+	}
+	if (!flow) {
+		_event(EVENT_FLOW_EVICTED, oldestFlow->assignedPath(), ZT_MAX_PEER_NETWORK_PATHS, flowId, (int64_t)oldestFlow->id());
+		_eraseFlow(oldestFlow);
+		flow = oldestFlow;
+	}
+	flow->init(flowId, now);
+	++_flowCount;
 	/**
 	 * Add a flow with a given Path already provided. This is the case when a packet
 	 * is received on a path but no flow exists, in this case we simply assign the path
 	 * that the remote peer chose for us.
 	 */
 	if (path) {
-		flow->assignPath(path,now);
-		path->address().toString(curPathStr);
-		path->_assignedFlowCount++;
-		SharedPtr<Link> link = RR->bc->getLinkBySocket(_policyAlias, flow->assignedPath()->localSocket());
-		sprintf(traceMsg, "%s (bond) Assigned incoming flow %x from peer %llx to link %s/%s, %lu active flow(s)",
-			OSUtils::humanReadableTimestamp().c_str(), flow->id(), _peer->_id.address().toInt(), link->ifname().c_str(), curPathStr, _flows.size());
-		RR->t->bondStateMessage(NULL, traceMsg);
+		const unsigned int idx = _pathIndex(path);
+		if (idx < ZT_MAX_PEER_NETWORK_PATHS) {
+			flow->assignPath(idx,now);
+			path->_assignedFlowCount++;
+			_event(EVENT_FLOW_ASSIGNED, idx, ZT_MAX_PEER_NETWORK_PATHS, flow->id(), (int64_t)_flowCount, 1);
+		}
 	}
 	/**
 	 * Add a flow when no path was provided. This means that it is an outgoing packet
@@ -475,83 +694,130 @@ SharedPtr<Flow> Bond::createFlow(const SharedPtr<Path> &path, int32_t flowId, un
 	return flow;
 }
 
+void Bond::_growFlowTable()
+{
+	/**
+	 * Flows are copied into a table twice the size, which is then published
+	 * for lock-free readers. The old table is kept since a reader may still
+	 * be looking at it.
+	 */
+	FlowTable *const from = _flowTable;
+	FlowTable *const to = new FlowTable(from->size() * 2);
+	for (unsigned int i=0; i<=from->mask; ++i) {
+		Flow *const f = from->slots + i;
+		if (!f->inUse()) {
+			continue;
+		}
+		const unsigned int home = _flowHash(f->id());
+		Flow *slot = (Flow *)0;
+		for (unsigned int k=0; k<ZT_FLOW_TABLE_MAX_PROBE; ++k) {
+			Flow *const s = to->slots + ((home + k) & to->mask);
+			if (!s->inUse()) {
+				slot = s;
+				break;
+			}
+		}
+		if (slot) {
+			*slot = *f;
+		}
+		else {
+			_eraseFlow(f);
+		}
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	_flowTable = to;
+	_outgrownFlowTables.push_back(from);
+	/**
+	 * A lock-free reader may have recorded activity on the old copy of a flow
+	 * after it was copied. Either it sees the new table and tries again there
+	 * (see _touchFlow()), or we see its update here.
+	 */
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	for (unsigned int i=0; i<=from->mask; ++i) {
+		Flow *const f = from->slots + i;
+		if (!f->inUse()) {
+			continue;
+		}
+		Flow *const moved = _findFlow(to, f->id());
+		if ((moved) && (f->_lastActivity > moved->_lastActivity)) {
+			moved->_lastActivity = f->_lastActivity;
+		}
+	}
+}
+
+void Bond::_setPath(unsigned int i, const SharedPtr<Path> &path, int64_t now)
+{
+	while ((!_retiredPaths.empty()) && ((now - _retiredPaths.front().first) >= ZT_BOND_RETIRED_PATH_TTL)) {
+		_retiredPaths.pop_front();
+	}
+	if ((_paths[i]) && (_paths[i] != path)) {
+		_retiredPaths.push_back(std::pair< int64_t,SharedPtr<Path> >(now, _paths[i]));
+	}
+	_paths[i] = path;
+	std::atomic_thread_fence(std::memory_order_release);
+	_pathPtrs[i] = path.ptr();
+}
+
+void Bond::_eraseFlow(Flow *flow)
+{
+	const unsigned int idx = flow->assignedPath();
+	if ((idx < ZT_MAX_PEER_NETWORK_PATHS) && (_paths[idx])) {
+		_paths[idx]->_assignedFlowCount--;
+	}
+	flow->clear();
+	--_flowCount;
+	_peer->pathSelectionChanged();
+}
+
 void Bond::forgetFlowsWhenNecessary(uint64_t age, bool oldest, int64_t now)
 {
-	char traceMsg[256];
-	std::map<int32_t,SharedPtr<Flow> >::iterator it = _flows.begin();
-	std::map<int32_t,SharedPtr<Flow> >::iterator oldestFlow = _flows.end();
-	SharedPtr<Flow> expiredFlow;
+	if (!_flowTable) {
+		return;
+	}
 	if (age) { // Remove by specific age
-		while (it != _flows.end()) {
-			if (it->second->age(now) > age) {
-				sprintf(traceMsg, "%s (bond) Forgetting flow %x between this node and peer %llx, %lu active flow(s)",
-					OSUtils::humanReadableTimestamp().c_str(), it->first, _peer->_id.address().toInt(), (_flows.size()-1));
-				RR->t->bondStateMessage(NULL, traceMsg);
-				it->second->assignedPath()->_assignedFlowCount--;
-				it = _flows.erase(it);
-			} else {
-				++it;
+		for (unsigned int i=0; i<=_flowTable->mask; ++i) {
+			Flow *const f = _flowTable->slots + i;
+			if (f->inUse() && (f->age(now) > (int64_t)age)) {
+				_event(EVENT_FLOW_FORGOTTEN, f->assignedPath(), ZT_MAX_PEER_NETWORK_PATHS, f->id(), f->age(now), (int64_t)(_flowCount-1));
+				_eraseFlow(f);
 			}
 		}
 	}
 	else if (oldest) { // Remove single oldest by natural expiration
-		uint64_t maxAge = 0;
-		while (it != _flows.end()) {
-			if (it->second->age(now) > maxAge) {
-				maxAge = (now - it->second->age(now));
-				oldestFlow = it;
+		Flow *oldestFlow = (Flow *)0;
+		for (unsigned int i=0; i<=_flowTable->mask; ++i) {
+			Flow *const f = _flowTable->slots + i;
+			if (f->inUse() && ((!oldestFlow) || (f->age(now) > oldestFlow->age(now)))) {
+				oldestFlow = f;
 			}
-			++it;
 		}
-		if (oldestFlow != _flows.end()) {
-			sprintf(traceMsg, "%s (bond) Forgetting oldest flow %x (of age %llu) between this node and peer %llx, %lu active flow(s)",
-				OSUtils::humanReadableTimestamp().c_str(), oldestFlow->first, oldestFlow->second->age(now), _peer->_id.address().toInt(), (_flows.size()-1));
-			RR->t->bondStateMessage(NULL, traceMsg);
-			oldestFlow->second->assignedPath()->_assignedFlowCount--;
-			_flows.erase(oldestFlow);
+		if (oldestFlow) {
+			_event(EVENT_FLOW_FORGOTTEN, oldestFlow->assignedPath(), ZT_MAX_PEER_NETWORK_PATHS, oldestFlow->id(), oldestFlow->age(now), (int64_t)(_flowCount-1));
+			_eraseFlow(oldestFlow);
 		}
 	}
 }
 
 void Bond::processIncomingPathNegotiationRequest(uint64_t now, SharedPtr<Path> &path, int16_t remoteUtility)
 {
-	char traceMsg[256];
 	if (_abLinkSelectMethod != ZT_MULTIPATH_RESELECTION_POLICY_OPTIMIZE) {
 		return;
 	}
 	Mutex::Lock _l(_paths_m);
-	char pathStr[128];
-	path->address().toString(pathStr);
 	if (!_lastPathNegotiationCheck) {
 		return;
 	}
-	SharedPtr<Link> link = RR->bc->getLinkBySocket(_policyAlias, path->localSocket());
+	bool accepted = false;
 	if (remoteUtility > _localUtility) {
-		char pathStr[128]; path->address().toString(pathStr);
-		sprintf(traceMsg, "%s (bond) Peer %llx suggests using alternate link %s/%s. Remote utility (%d) is GREATER than local utility (%d), switching to said link\n",
-			OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt(), link->ifname().c_str(), pathStr, remoteUtility, _localUtility);
-		RR->t->bondStateMessage(NULL, traceMsg);
-		negotiatedPath = path;
-	}
-	if (remoteUtility < _localUtility) {
-		sprintf(traceMsg, "%s (bond) Peer %llx suggests using alternate link %s/%s. Remote utility (%d) is LESS than local utility (%d), not switching\n",
-			OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt(), link->ifname().c_str(), pathStr, remoteUtility, _localUtility);
-		RR->t->bondStateMessage(NULL, traceMsg);
+		accepted = true;
 	}
 	if (remoteUtility == _localUtility) {
-		sprintf(traceMsg, "%s (bond) Peer %llx suggests using alternate link %s/%s. Remote utility (%d) is equal to local utility (%d)\n",
-			OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt(), link->ifname().c_str(), pathStr, remoteUtility, _localUtility);
-		RR->t->bondStateMessage(NULL, traceMsg);
-		if (_peer->_id.address().toInt() > RR->node->identity().address().toInt()) {
-			sprintf(traceMsg, "%s (bond) Agreeing with peer %llx to use alternate link %s/%s\n",
-				OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt(), link->ifname().c_str(), pathStr);
-			RR->t->bondStateMessage(NULL, traceMsg);
-			negotiatedPath = path;
-		} else {
-			sprintf(traceMsg, "%s (bond) Ignoring petition from peer %llx to use alternate link %s/%s\n",
-				OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt(), link->ifname().c_str(), pathStr);
-			RR->t->bondStateMessage(NULL, traceMsg);
-		}
+		// Break ties in favor of the peer with the greater address
+		accepted = (_peer->_id.address().toInt() > RR->node->identity().address().toInt());
+	}
+	_event(EVENT_NEGOTIATION_RECEIVED, _pathIndex(path), ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, remoteUtility, _localUtility, accepted ? 1 : 0);
+	if (accepted) {
+		negotiatedPath = path;
 	}
 }
 
@@ -598,7 +864,7 @@ void Bond::pathNegotiationCheck(void *tPtr, const int64_t now)
 				++_numSentPathNegotiationRequests;
 				_lastSentPathNegotiationRequest = now;
 				_paths[maxOutPathIdx]->address().toString(pathStr);
-				SharedPtr<Link> link =RR->bc->getLinkBySocket(_policyAlias, _paths[maxOutPathIdx]->localSocket());
+				SharedPtr<Link> link = _pathLinks[maxOutPathIdx];
 				//fprintf(stderr, "sending request to use %s on %s, ls=%llx, utility=%d\n", pathStr, link->ifname().c_str(), _paths[maxOutPathIdx]->localSocket(), _localUtility);
 			}
 		}
@@ -617,10 +883,7 @@ void Bond::pathNegotiationCheck(void *tPtr, const int64_t now)
 
 void Bond::sendPATH_NEGOTIATION_REQUEST(void *tPtr, const SharedPtr<Path> &path)
 {
-	char traceMsg[256]; char pathStr[128]; path->address().toString(pathStr);
-	sprintf(traceMsg, "%s (bond) Sending link negotiation request to peer %llx via link %s/%s, local utility is %d",
-		OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt(), getLink(path)->ifname().c_str(), pathStr, _localUtility);
-	RR->t->bondStateMessage(NULL, traceMsg);
+	_event(EVENT_NEGOTIATION_SENT, _pathIndex(path), ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, _localUtility);
 	if (_abLinkSelectMethod != ZT_MULTIPATH_RESELECTION_POLICY_OPTIMIZE) {
 		return;
 	}
@@ -658,6 +921,33 @@ void Bond::sendACK(void *tPtr, const SharedPtr<Path> &path,const int64_t localSo
 	path->_lastAckSent = now;
 }
 
+void Bond::sendCapacityProbe(void *tPtr, const SharedPtr<Path> &path, int64_t now)
+{
+	if (!path->address()) {
+		return;
+	}
+	if (!++_probeTrain) {
+		++_probeTrain; // zero means no train is outstanding
+	}
+	const unsigned int count = path->_probeTrainLength;
+	if (path->_probeTrain) {
+		++path->_probeUnanswered;
+	}
+	path->_probeTrain = _probeTrain;
+	path->_lastCapacityProbe = now;
+	for(unsigned int i=0;i<count;++i) {
+		Packet outp(_peer->_id.address(),RR->identity.address(),Packet::VERB_BOND_PROBE);
+		outp.append((uint8_t)0);
+		outp.append(_probeTrain);
+		outp.append((uint8_t)i);
+		outp.append((uint8_t)count);
+		const unsigned int pad = ZT_BOND_CAPACITY_PROBE_SIZE - outp.size();
+		memset(outp.appendField(pad),0,pad);
+		outp.armor(_peer->key(),false,_peer->aesKeysIfSupported());
+		RR->node->putPacket(tPtr,path->localSocket(),path->address(),outp.data(),outp.size());
+	}
+}
+
 void Bond::sendQOS_MEASUREMENT(void *tPtr,const SharedPtr<Path> &path,const int64_t localSocket,
 	const InetAddress &atAddress,int64_t now)
 {
@@ -684,11 +974,56 @@ void Bond::sendQOS_MEASUREMENT(void *tPtr,const SharedPtr<Path> &path,const int6
 void Bond::processBackgroundTasks(void *tPtr, const int64_t now)
 {
 	Mutex::Lock _l(_paths_m);
-	if (!_peer->_canUseMultipath || (now - _lastBackgroundTaskCheck) < ZT_BOND_BACKGROUND_TASK_MIN_INTERVAL) {
+	if (!_peer->_canUseMultipath) {
+		return;
+	}
+	// Liveness runs on its own, possibly much shorter, interval
+	if (_livenessInterval) {
+		processLivenessTasks(tPtr, now);
+	}
+	if ((now - _lastBackgroundTaskCheck) < ZT_BOND_BACKGROUND_TASK_MIN_INTERVAL) {
 		return;
 	}
 	_lastBackgroundTaskCheck = now;
 
+	// Hold reordered frames for about twice the latency spread between bonded links
+	{
+		float minLatency = -1.0f;
+		float maxLatency = 0.0f;
+		for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
+			if (_paths[i] && _paths[i]->bonded()) {
+				const float l = _paths[i]->latencyMean();
+				if ((minLatency < 0.0f)||(l < minLatency))
+					minLatency = l;
+				if (l > maxLatency)
+					maxLatency = l;
+			}
+		}
+		_resequencer.setTimeout((minLatency < 0.0f) ? ZT_BOND_RESEQUENCE_MAX_TIMEOUT : ((int64_t)(2.0f * (maxLatency - minLatency)) + ZT_BOND_RESEQUENCE_MIN_TIMEOUT));
+		_ResequencedFrameSink sink(RR,tPtr);
+		_resequencer.expire(now,sink);
+	}
+
+	// Send parity for a group that traffic stopped filling. This can't go through
+	// Switch::send() since that would take _paths_m (held here) to pick a path, so
+	// stats that Peer::recordOutgoingPacket() would record are recorded directly.
+	if (_fec && _numBondedPaths) {
+		Mutex::Lock _lf(_fec_m);
+		if (_fecEncoder.pending() && ((now - _fecEncoder.opened()) >= ZT_BOND_FEC_FLUSH_INTERVAL)) {
+			const SharedPtr<Path> path(_parityPath());
+			if (path) {
+				Packet outp(_peer->_id.address(),RR->identity.address(),Packet::VERB_BOND_PARITY);
+				_fecEncoder.parity(outp);
+				++_fecParitySent;
+				outp.armor(_peer->key(),true,_peer->aesKeysIfSupported());
+				if (_shouldCollectPathStatistics) {
+					_recordOutgoingPathStats(path, outp.packetId(), outp.payloadLength(), false, (outp.packetId() & (ZT_QOS_ACK_DIVISOR - 1)) != 0, now);
+				}
+				path->send(RR,tPtr,outp.data(),outp.size(),now);
+			}
+		}
+	}
+
 	// Compute dynamic path monitor timer interval
 	if (_linkMonitorStrategy == ZT_MULTIPATH_SLAVE_MONITOR_STRATEGY_DYNAMIC) {
 		int suggestedMonitorInterval  = (now - _lastFrame) / 100;
@@ -704,6 +1039,10 @@ void Bond::processBackgroundTasks(void *tPtr, const int64_t now)
 		// Required for real-time balancing
 		_shouldCollectPathStatistics = true;
 	}
+	if (_fec) {
+		// Required for sizing FEC groups to link loss
+		_shouldCollectPathStatistics = true;
+	}
 	if (_bondingPolicy == ZT_BONDING_POLICY_ACTIVE_BACKUP) {
 		if (_abLinkSelectMethod == ZT_MULTIPATH_RESELECTION_POLICY_BETTER) {
 			// Required for judging suitability of primary link after recovery
@@ -739,6 +1078,20 @@ void Bond::processBackgroundTasks(void *tPtr, const int64_t now)
 			}
 		}
 	}
+	// Measure the capacity of bonded paths. Peers older than protocol 13 never answer probes.
+	if (_capacityProbing && (_peer->remoteVersionProtocol() >= 13)) {
+		for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
+			if (!(_paths[i] && _paths[i]->bonded())) {
+				continue;
+			}
+			// A train that went unanswered is retried sooner if there is no estimate yet,
+			// until enough in a row have gone unanswered that the path seems to drop them
+			const int64_t interval = (_paths[i]->_probeTrain && !_paths[i]->_probedCapacity && (_paths[i]->_probeUnanswered < ZT_BOND_CAPACITY_PROBE_MAX_UNANSWERED)) ? ZT_BOND_CAPACITY_PROBE_RETRY : ZT_BOND_CAPACITY_PROBE_INTERVAL;
+			if ((now - _paths[i]->_lastCapacityProbe) >= interval) {
+				sendCapacityProbe(tPtr, _paths[i], now);
+			}
+		}
+	}
 	// Perform periodic background tasks unique to each bonding policy
 	switch (_bondingPolicy)
 	{
@@ -762,6 +1115,92 @@ void Bond::processBackgroundTasks(void *tPtr, const int64_t now)
 	}
 }
 
+void Bond::processLivenessTasks(void *tPtr, const int64_t now)
+{
+	// Peers older than protocol 13 never answer liveness requests
+	if (_peer->remoteVersionProtocol() < 13) {
+		return;
+	}
+	const int64_t detectTime = (int64_t)_livenessInterval * (int64_t)_livenessMultiplier;
+	for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
+		const SharedPtr<Path> &path = _paths[i];
+		if (!path || !path->allowed() || !path->address()) {
+			continue;
+		}
+		if ((now - path->_lastLivenessOut) >= _livenessInterval) {
+			path->_lastLivenessOut = now;
+			Packet outp(_peer->_id.address(),RR->identity.address(),Packet::VERB_BOND_LIVENESS);
+			outp.append((uint8_t)0);
+			outp.append((uint64_t)now);
+			outp.armor(_peer->key(),false,_peer->aesKeysIfSupported());
+			RR->node->putPacket(tPtr,path->localSocket(),path->address(),outp.data(),outp.size());
+		}
+		// Paths that have never answered are left to the ordinary eligibility checks
+		if (path->_lastLivenessIn && !path->_livenessDown && ((now - path->_lastLivenessIn) > detectTime)) {
+			path->_livenessDown = true;
+			livenessChanged(tPtr, i, now, now - path->_lastLivenessIn);
+		}
+	}
+}
+
+void Bond::livenessChanged(void *tPtr, const unsigned int pathIdx, const int64_t now, const int64_t silence)
+{
+	const SharedPtr<Path> path(_paths[pathIdx]);
+	_event(EVENT_LIVENESS_CHANGED, pathIdx, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, path->_livenessDown ? 1 : 0, silence);
+	curateBond(now, false);
+	if (path->_livenessDown && (_bondingPolicy == ZT_BONDING_POLICY_ACTIVE_BACKUP) && (path == _abPath)) {
+		// Fail over now rather than on the next active-backup pass
+		for (std::list<SharedPtr<Path> >::iterator it(_abFailoverQueue.begin()); it!=_abFailoverQueue.end();) {
+			if ((*it) && !(*it)->eligible(now,_ackSendInterval)) {
+				it = _abFailoverQueue.erase(it);
+			} else {
+				++it;
+			}
+		}
+		_event(EVENT_AB_LINK_FAILED, pathIdx, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, (int64_t)_abFailoverQueue.size());
+		if (!_abFailoverQueue.empty()) {
+			const int prevFScore = path->_failoverScore;
+			dequeueNextActiveBackupPath(now);
+			_event(EVENT_AB_SWITCHED, pathIdx, _pathIndex(_abPath), ZT_QOS_NO_FLOW, AB_SWITCH_FAILOVER, prevFScore, _abPath->_failoverScore);
+		}
+	}
+}
+
+void Bond::receivedLivenessReply(void *tPtr, const SharedPtr<Path>& path, const int64_t now, const int64_t timestamp)
+{
+	Mutex::Lock _l(_paths_m);
+	if ((!_livenessInterval)||(timestamp <= path->_livenessEcho)||(timestamp > now)) {
+		return; // stale, replayed or from the future
+	}
+	const int64_t silence = now - path->_lastLivenessIn;
+	path->_livenessEcho = timestamp;
+	path->_lastLivenessIn = now;
+	if (path->_livenessDown) {
+		path->_livenessDown = false;
+		const unsigned int idx = _pathIndex(path);
+		if (idx < ZT_MAX_PEER_NETWORK_PATHS) {
+			livenessChanged(tPtr, idx, now, silence);
+		}
+	}
+}
+
+void Bond::setLiveness(int interval, unsigned int multiplier)
+{
+	_livenessInterval = (interval > 0) ? std::max(interval, ZT_BOND_LIVENESS_MIN_INTERVAL) : 0;
+	_livenessMultiplier = multiplier ? multiplier : ZT_BOND_LIVENESS_DEFAULT_MULTIPLIER;
+	if (_livenessInterval) {
+		BondController::setMinLivenessInterval(_livenessInterval);
+	} else {
+		Mutex::Lock _l(_paths_m);
+		for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
+			if (_paths[i]) {
+				_paths[i]->_lastLivenessIn = 0;
+				_paths[i]->_livenessDown = false;
+			}
+		}
+	}
+}
+
 void Bond::applyUserPrefs()
 {
 	for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
@@ -775,10 +1214,10 @@ void Bond::applyUserPrefs()
 			}
 			RR->bc->setMinReqPathMonitorInterval((sl->monitorInterval() < RR->bc->minReqPathMonitorInterval()) ? sl->monitorInterval() : RR->bc->minReqPathMonitorInterval());
 			bool bFoundCommonLink = false;
-			SharedPtr<Link> commonLink =RR->bc->getLinkBySocket(_policyAlias, _paths[i]->localSocket());
+			SharedPtr<Link> commonLink = _pathLinks[i];
 			for(unsigned int j=0;j<ZT_MAX_PEER_NETWORK_PATHS;++j) {
 				if (_paths[j] && _paths[j].ptr() != _paths[i].ptr()) {
-					if (RR->bc->getLinkBySocket(_policyAlias, _paths[j]->localSocket()) == commonLink) {
+					if (_pathLinks[j] == commonLink) {
 						bFoundCommonLink = true;
 					}
 				}
@@ -800,7 +1239,6 @@ void Bond::applyUserPrefs()
 
 void Bond::curateBond(const int64_t now, bool rebuildBond)
 {
-	char traceMsg[256];
 	char pathStr[128];
 	uint8_t tmpNumAliveLinks = 0;
 	uint8_t tmpNumTotalLinks = 0;
@@ -817,28 +1255,16 @@ void Bond::curateBond(const int64_t now, bool rebuildBond)
 		}
 		bool currEligibility = _paths[i]->eligible(now,_ackSendInterval);
 		if (currEligibility != _paths[i]->_lastEligibilityState) {
-			_paths[i]->address().toString(pathStr);
-			char traceMsg[256]; _paths[i]->address().toString(pathStr);
-			sprintf(traceMsg, "%s (bond) Eligibility of link %s/%s to peer %llx has changed from %d to %d",
-				OSUtils::humanReadableTimestamp().c_str(), getLink(_paths[i])->ifname().c_str(), pathStr, _peer->_id.address().toInt(), _paths[i]->_lastEligibilityState, currEligibility);
-			RR->t->bondStateMessage(NULL, traceMsg);
+			_event(EVENT_ELIGIBILITY_CHANGED, i, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, _paths[i]->_lastEligibilityState, currEligibility, ((!currEligibility)&&(_paths[i]->bonded())) ? 1 : 0);
 			if (currEligibility) {
 				rebuildBond = true;
 			}
 			if (!currEligibility) {
 				_paths[i]->adjustRefractoryPeriod(now, _defaultPathRefractoryPeriod, !currEligibility);
 				if (_paths[i]->bonded()) {
-					char pathStr[128]; _paths[i]->address().toString(pathStr);
-					sprintf(traceMsg, "%s (bond) Link %s/%s to peer %llx was bonded, reallocation of its flows will occur soon",
-						OSUtils::humanReadableTimestamp().c_str(), getLink(_paths[i])->ifname().c_str(), pathStr, _peer->_id.address().toInt());
-					RR->t->bondStateMessage(NULL, traceMsg);
 					rebuildBond = true;
 					_paths[i]->_shouldReallocateFlows = _paths[i]->bonded();
 					_paths[i]->setBonded(false);
-				} else {
-					sprintf(traceMsg, "%s (bond) Link %s/%s to peer %llx was not bonded, no allocation consequences",
-						OSUtils::humanReadableTimestamp().c_str(), getLink(_paths[i])->ifname().c_str(), pathStr, _peer->_id.address().toInt());
-					RR->t->bondStateMessage(NULL, traceMsg);
 				}
 			}
 		}
@@ -885,15 +1311,7 @@ void Bond::curateBond(const int64_t now, bool rebuildBond)
 		}
 	}
 	if (tmpHealthStatus != _isHealthy) {
-		std::string healthStatusStr;
-		if (tmpHealthStatus == true) {
-			healthStatusStr = "HEALTHY";
-		} else {
-			healthStatusStr = "DEGRADED";
-		}
-		sprintf(traceMsg, "%s (bond) Bond to peer %llx is in a %s state (%d/%d links)",
-			OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt(), healthStatusStr.c_str(), _numAliveLinks, _numTotalLinks);
-		RR->t->bondStateMessage(NULL, traceMsg);
+		_event(EVENT_HEALTH_CHANGED, ZT_MAX_PEER_NETWORK_PATHS, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, tmpHealthStatus ? 1 : 0, _numAliveLinks, _numTotalLinks);
 	}
 
 	_isHealthy = tmpHealthStatus;
@@ -914,7 +1332,7 @@ void Bond::curateBond(const int64_t now, bool rebuildBond)
 			std::map<SharedPtr<Link>,int> linkMap;
 			for (int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
 				if (_paths[i] && _paths[i]->allowed() && (_paths[i]->eligible(now,_ackSendInterval) || !_numBondedPaths)) {
-					SharedPtr<Link> link =RR->bc->getLinkBySocket(_policyAlias, _paths[i]->localSocket());
+					SharedPtr<Link> link = _pathLinks[i];
 					if (!linkMap.count(link)) {
 						linkMap[link] = i;
 					}
@@ -967,6 +1385,7 @@ void Bond::curateBond(const int64_t now, bool rebuildBond)
 				}
 			}
 			_numBondedPaths = updatedBondedPathCount;
+			_peer->pathSelectionChanged();
 			if (_bondingPolicy == ZT_BONDING_POLICY_BALANCE_RR) {
 				// Cause a RR reset since the currently used index might no longer be valid
 				_rrPacketsSentOnCurrLink = _packetsPerLink;
@@ -981,13 +1400,13 @@ void Bond::estimatePathQuality(const int64_t now)
 	uint32_t totUserSpecifiedLinkSpeed = 0;
 	if (_numBondedPaths) { // Compute relative user-specified speeds of links
 		for(unsigned int i=0;i<_numBondedPaths;++i) {
-			SharedPtr<Link> link =RR->bc->getLinkBySocket(_policyAlias, _paths[i]->localSocket());
+			SharedPtr<Link> link = _pathLinks[i];
 			if (_paths[i] && _paths[i]->allowed()) {
 				totUserSpecifiedLinkSpeed += link->speed();
 			}
 		}
 		for(unsigned int i=0;i<_numBondedPaths;++i) {
-				SharedPtr<Link> link =RR->bc->getLinkBySocket(_policyAlias, _paths[i]->localSocket());
+				SharedPtr<Link> link = _pathLinks[i];
 			if (_paths[i] && _paths[i]->allowed()) {
 				link->setRelativeSpeed(round( ((float)link->speed() / (float)totUserSpecifiedLinkSpeed) * 255));
 			}
@@ -1022,18 +1441,18 @@ void Bond::estimatePathQuality(const int64_t now)
 			continue;
 		}
 		// Compute/Smooth average of real-world observations
-		_paths[i]->_latencyMean = _paths[i]->latencySamples.mean();
-		_paths[i]->_latencyVariance = _paths[i]->latencySamples.stddev();
-		_paths[i]->_packetErrorRatio = 1.0 - (_paths[i]->packetValiditySamples.count() ? _paths[i]->packetValiditySamples.mean() : 1.0);
-
-		if (userHasSpecifiedLinkSpeeds()) {
-			// Use user-reported metrics
-			SharedPtr<Link> link =RR->bc->getLinkBySocket(_policyAlias, _paths[i]->localSocket());
-			if (link) {
-				_paths[i]->_throughputMean = link->speed();
-				_paths[i]->_throughputVariance = 0;
-			}
-		}
+		_paths[i]->_latencyMean = _paths[i]->latencyStats.mean();
+		_paths[i]->_latencyVariance = _paths[i]->latencyStats.stddev();
+		_paths[i]->_packetErrorRatio = _paths[i]->packetValidityStats.count() ? (1.0f - _paths[i]->packetValidityStats.mean()) : 0.0f;
+		_paths[i]->_packetLossRatio = _paths[i]->qosRecordLossStats.mean();
+		_paths[i]->_throughputMean = (uint64_t)_paths[i]->throughputStats.mean();
+		_paths[i]->_throughputMax = (uint64_t)_paths[i]->throughputStats.peak();
+		// Delivered throughput follows offered load, so on its own it would starve lightly used
+		// paths. It only raises a probed capacity that turned out to be too low.
+		_paths[i]->_capacity = _paths[i]->_probedCapacity ? std::max(_paths[i]->_probedCapacity, _paths[i]->_throughputMax) : 0;
+		// Pace onto the path no faster than it can carry. Delivered throughput alone is not
+		// used since pacing to it would keep it from ever growing.
+		_paths[i]->_paceRate = _pacing ? _paths[i]->_capacity : 0;
 		// Drain unacknowledged QoS records
 		std::map<uint64_t,uint64_t>::iterator it = _paths[i]->qosStatsOut.begin();
 		uint64_t currentLostRecords = 0;
@@ -1042,6 +1461,7 @@ void Bond::estimatePathQuality(const int64_t now)
 			if ((now - it->second) >= qosRecordTimeout) {
 				// Packet was lost
 				it = _paths[i]->qosStatsOut.erase(it);
+				_paths[i]->qosRecordLossStats.push(1.0f);
 				++currentLostRecords;
 			} else { ++it; }
 		}
@@ -1069,18 +1489,53 @@ void Bond::estimatePathQuality(const int64_t now)
 			totQuality += quality[i];
 		}
 	}
+	// When every bonded path's speed is known, declared or measured, allocate in proportion
+	// to speed scaled down for poorer quality. Otherwise allocate by quality alone.
+	float speed[ZT_MAX_PEER_NETWORK_PATHS];
+	float totSpeed = 0.0f;
+	float maxQuality = 0.0f;
+	bool haveSpeeds = true;
+	memset(&speed, 0, sizeof(speed));
+	for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
+		if (_paths[i] && _paths[i]->bonded()) {
+			SharedPtr<Link> link = _pathLinks[i];
+			speed[i] = (userHasSpecifiedLinkSpeeds() && link) ? (float)link->speed() : (float)_paths[i]->_capacity;
+			haveSpeeds = haveSpeeds && (speed[i] > 0.0f);
+			maxQuality = quality[i] > maxQuality ? quality[i] : maxQuality;
+		}
+	}
+	if (haveSpeeds && (maxQuality > 0.0f)) {
+		for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
+			speed[i] *= quality[i] / maxQuality;
+			totSpeed += speed[i];
+		}
+	}
 	// Normalize to 8-bit allocation values
 	for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
 		if (_paths[i] && _paths[i]->bonded()) {
-			alloc[i] = std::ceil((quality[i] / totQuality) * (float)255);
+			alloc[i] = (totSpeed > 0.0f) ? std::ceil((speed[i] / totSpeed) * (float)255) : std::ceil((quality[i] / totQuality) * (float)255);
 			_paths[i]->_allocation = alloc[i];
 		}
 	}
+	// Size FEC groups so that one parity packet can usually repair the worst link's losses
+	if (_fec) {
+		float maxLoss = 0.0f;
+		for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
+			if (_paths[i] && _paths[i]->bonded() && (_paths[i]->_packetLossRatio > maxLoss)) {
+				maxLoss = _paths[i]->_packetLossRatio;
+			}
+		}
+		unsigned int groupSize = ZT_BOND_FEC_MAX_GROUP;
+		if (maxLoss > 0.0f) {
+			groupSize = (unsigned int)std::max((float)ZT_BOND_FEC_MIN_GROUP, std::min((float)ZT_BOND_FEC_MAX_GROUP, ZT_BOND_FEC_GROUP_LOSS / maxLoss));
+		}
+		_fecGroupSize = groupSize;
+	}
+	_peer->pathSelectionChanged();
 }
 
 void Bond::processBalanceTasks(const int64_t now)
 {
-	char curPathStr[128];
 	// TODO: Generalize
 	int totalAllocation = 0;
 	for (int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
@@ -1105,10 +1560,9 @@ void Bond::processBalanceTasks(const int64_t now)
 		if ((now - _lastFlowStatReset) > ZT_FLOW_STATS_RESET_INTERVAL) {
 			Mutex::Lock _l(_flows_m);
 			_lastFlowStatReset = now;
-			std::map<int32_t,SharedPtr<Flow> >::iterator it = _flows.begin();
-			while (it != _flows.end()) {
-				it->second->resetByteCounts();
-				++it;
+			FlowTable *const t = _flowTable;
+			for (unsigned int f=0; (t) && (f<=t->mask); ++f) {
+				t->slots[f].resetByteCounts();
 			}
 		}
 		/**
@@ -1121,18 +1575,15 @@ void Bond::processBalanceTasks(const int64_t now)
 					continue;
 				}
 				if (!_paths[i]->eligible(now,_ackSendInterval) && _paths[i]->_shouldReallocateFlows) {
-					char traceMsg[256]; char pathStr[128]; _paths[i]->address().toString(pathStr);
-					sprintf(traceMsg, "%s (balance-*) Reallocating flows to peer %llx from dead link %s/%s to surviving links",
-						OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt(), getLink(_paths[i])->ifname().c_str(), pathStr);
-					RR->t->bondStateMessage(NULL, traceMsg);
-					std::map<int32_t,SharedPtr<Flow> >::iterator flow_it = _flows.begin();
-					while (flow_it != _flows.end()) {
-						if (flow_it->second->assignedPath() == _paths[i]) {
-							if(assignFlowToBondedPath(flow_it->second, now)) {
+					_event(EVENT_FLOWS_REALLOCATED, i, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, 0);
+					for (unsigned int f=0; (_flowTable) && (f<=_flowTable->mask); ++f) {
+						Flow *const flow = _flowTable->slots + f;
+						if (flow->inUse() && (flow->assignedPath() == (unsigned int)i)) {
+							if(assignFlowToBondedPath(flow, now)) {
 								_paths[i]->_assignedFlowCount--;
 							}
+							_peer->pathSelectionChanged();
 						}
-						++flow_it;
 					}
 					_paths[i]->_shouldReallocateFlows = false;
 				}
@@ -1149,19 +1600,15 @@ void Bond::processBalanceTasks(const int64_t now)
 					continue;
 				}
 				if (_paths[i] && _paths[i]->bonded() && _paths[i]->eligible(now,_ackSendInterval) && (_paths[i]->_allocation < minimumAllocationValue) && _paths[i]->_assignedFlowCount) {
-					_paths[i]->address().toString(curPathStr);
-					char traceMsg[256]; char pathStr[128]; _paths[i]->address().toString(pathStr);
-					sprintf(traceMsg, "%s (balance-*) Reallocating flows to peer %llx from under-performing link %s/%s\n",
-						OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt(), getLink(_paths[i])->ifname().c_str(), pathStr);
-					RR->t->bondStateMessage(NULL, traceMsg);
-					std::map<int32_t,SharedPtr<Flow> >::iterator flow_it = _flows.begin();
-					while (flow_it != _flows.end()) {
-						if (flow_it->second->assignedPath() == _paths[i]) {
-							if(assignFlowToBondedPath(flow_it->second, now)) {
+					_event(EVENT_FLOWS_REALLOCATED, i, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, 1);
+					for (unsigned int f=0; (_flowTable) && (f<=_flowTable->mask); ++f) {
+						Flow *const flow = _flowTable->slots + f;
+						if (flow->inUse() && (flow->assignedPath() == (unsigned int)i)) {
+							if(assignFlowToBondedPath(flow, now)) {
 								_paths[i]->_assignedFlowCount--;
 							}
+							_peer->pathSelectionChanged();
 						}
-						++flow_it;
 					}
 					_paths[i]->_shouldReallocateFlows = false;
 				}
@@ -1186,6 +1633,9 @@ void Bond::processBalanceTasks(const int64_t now)
 	if (_bondingPolicy == ZT_BONDING_POLICY_BALANCE_AWARE) {
 		if (_allowFlowHashing) {
 			Mutex::Lock _l(_flows_m);
+			if ((now - _lastFlowRateCheck) >= ZT_FLOW_RATE_CHECK_INTERVAL) {
+				_placeElephantFlows(now);
+			}
 			if (_flowRebalanceStrategy == ZT_MULTIPATH_FLOW_REBALANCE_STRATEGY_PASSIVE) {
 				// Do nothing here, this is taken care of in the more general case above.
 			}
@@ -1197,16 +1647,18 @@ void Bond::processBalanceTasks(const int64_t now)
 				 * Return flows to the original path if it has once again become available
 				 */
 				if ((now - _lastFlowRebalance) > ZT_FLOW_REBALANCE_INTERVAL) {
-					std::map<int32_t,SharedPtr<Flow> >::iterator flow_it = _flows.begin();
-					while (flow_it != _flows.end()) {
-						if (flow_it->second->_previouslyAssignedPath && flow_it->second->_previouslyAssignedPath->eligible(now, _ackSendInterval)
-								&& (flow_it->second->_previouslyAssignedPath->_allocation >= (minimumAllocationValue * 2))) {
+					for (unsigned int f=0; (_flowTable) && (f<=_flowTable->mask); ++f) {
+						Flow *const flow = _flowTable->slots + f;
+						const unsigned int prevIdx = flow->_previouslyAssignedPath;
+						if (flow->inUse() && !flow->elephant() && (prevIdx < ZT_MAX_PEER_NETWORK_PATHS) && (flow->assignedPath() < ZT_MAX_PEER_NETWORK_PATHS)
+								&& _paths[prevIdx]->eligible(now, _ackSendInterval)
+								&& (_paths[prevIdx]->_allocation >= (minimumAllocationValue * 2))) {
 							//fprintf(stderr, "moving flow back onto its previous path assignment (based on eligibility)\n");
-							(flow_it->second->_assignedPath->_assignedFlowCount)--;
-							flow_it->second->assignPath(flow_it->second->_previouslyAssignedPath,now);
-							(flow_it->second->_previouslyAssignedPath->_assignedFlowCount)++;
+							(_paths[flow->assignedPath()]->_assignedFlowCount)--;
+							flow->assignPath(prevIdx,now);
+							_peer->pathSelectionChanged();
+							(_paths[prevIdx]->_assignedFlowCount)++;
 						}
-						++flow_it;
 					}
 					_lastFlowRebalance = now;
 				}
@@ -1214,16 +1666,18 @@ void Bond::processBalanceTasks(const int64_t now)
 				 * Return flows to the original path if it has once again become (performant)
 				 */
 				if ((now - _lastFlowRebalance) > ZT_FLOW_REBALANCE_INTERVAL) {
-					std::map<int32_t,SharedPtr<Flow> >::iterator flow_it = _flows.begin();
-					while (flow_it != _flows.end()) {
-						if (flow_it->second->_previouslyAssignedPath && flow_it->second->_previouslyAssignedPath->eligible(now, _ackSendInterval)
-								&& (flow_it->second->_previouslyAssignedPath->_allocation >= (minimumAllocationValue * 2))) {
+					for (unsigned int f=0; (_flowTable) && (f<=_flowTable->mask); ++f) {
+						Flow *const flow = _flowTable->slots + f;
+						const unsigned int prevIdx = flow->_previouslyAssignedPath;
+						if (flow->inUse() && !flow->elephant() && (prevIdx < ZT_MAX_PEER_NETWORK_PATHS) && (flow->assignedPath() < ZT_MAX_PEER_NETWORK_PATHS)
+								&& _paths[prevIdx]->eligible(now, _ackSendInterval)
+								&& (_paths[prevIdx]->_allocation >= (minimumAllocationValue * 2))) {
 							//fprintf(stderr, "moving flow back onto its previous path assignment (based on performance)\n");
-							(flow_it->second->_assignedPath->_assignedFlowCount)--;
-							flow_it->second->assignPath(flow_it->second->_previouslyAssignedPath,now);
-							(flow_it->second->_previouslyAssignedPath->_assignedFlowCount)++;
+							(_paths[flow->assignedPath()]->_assignedFlowCount)--;
+							flow->assignPath(prevIdx,now);
+							_peer->pathSelectionChanged();
+							(_paths[prevIdx]->_assignedFlowCount)++;
 						}
-						++flow_it;
 					}
 					_lastFlowRebalance = now;
 				}
@@ -1242,6 +1696,7 @@ void Bond::dequeueNextActiveBackupPath(const uint64_t now)
 	}
 	_abPath = _abFailoverQueue.front();
 	_abFailoverQueue.pop_front();
+	_peer->pathSelectionChanged();
 	_lastActiveBackupPathChange = now;
 	for (int i=0; i<ZT_MAX_PEER_NETWORK_PATHS; ++i) {
 		if (_paths[i]) {
@@ -1252,22 +1707,10 @@ void Bond::dequeueNextActiveBackupPath(const uint64_t now)
 
 bool Bond::abForciblyRotateLink()
 {
-	char traceMsg[256];
-	char prevPathStr[128];
-	char curPathStr[128];
 	if (_bondingPolicy == ZT_BONDING_POLICY_ACTIVE_BACKUP) {
 		SharedPtr<Path> prevPath = _abPath;
-		_abPath->address().toString(prevPathStr);
 		dequeueNextActiveBackupPath(RR->node->now());
-		_abPath->address().toString(curPathStr);
-		sprintf(traceMsg, "%s (active-backup) Forcibly rotating peer %llx link from %s/%s to %s/%s",
-			OSUtils::humanReadableTimestamp().c_str(),
-			_peer->_id.address().toInt(),
-			getLink(prevPath)->ifname().c_str(),
-			prevPathStr,
-			getLink(_abPath)->ifname().c_str(),
-			curPathStr);
-		RR->t->bondStateMessage(NULL, traceMsg);
+		_event(EVENT_AB_SWITCHED, _pathIndex(prevPath), _pathIndex(_abPath), ZT_QOS_NO_FLOW, AB_SWITCH_FORCED, (prevPath) ? prevPath->_failoverScore : 0, (_abPath) ? _abPath->_failoverScore : 0);
 		return true;
 	}
 	return false;
@@ -1275,11 +1718,6 @@ bool Bond::abForciblyRotateLink()
 
 void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 {
-	char traceMsg[256];
-	char pathStr[128];
-	char prevPathStr[128];
-	char curPathStr[128];
-
 	SharedPtr<Path> prevActiveBackupPath = _abPath;
 	SharedPtr<Path> nonPreferredPath;
 	bool bFoundPrimaryLink = false;
@@ -1289,21 +1727,7 @@ void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 	 */
 	if ((now - _lastBondStatusLog) > ZT_MULTIPATH_BOND_STATUS_INTERVAL) {
 		_lastBondStatusLog = now;
-		if (_abPath) {
-			_abPath->address().toString(curPathStr);
-			sprintf(traceMsg, "%s (active-backup) Active link to peer %llx is %s/%s, failover queue size is %zu",
-				OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt(), getLink(_abPath)->ifname().c_str(), curPathStr, _abFailoverQueue.size());
-			RR->t->bondStateMessage(NULL, traceMsg);
-		} else {
-			sprintf(traceMsg, "%s (active-backup) No active link to peer %llx",
-				OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt());
-			RR->t->bondStateMessage(NULL, traceMsg);
-		}
-		if (_abFailoverQueue.empty()) {
-			sprintf(traceMsg, "%s (active-backup) Failover queue is empty, bond to peer %llx is NOT currently fault-tolerant",
-				OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt());
-				RR->t->bondStateMessage(NULL, traceMsg);
-		}
+		_event(EVENT_AB_STATUS, _pathIndex(_abPath), ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, (int64_t)_abFailoverQueue.size());
 	}
 	/**
 	 * Select initial "active" active-backup link
@@ -1318,17 +1742,9 @@ void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 		 * simply find the next eligible path.
 		 */
 		if (!userHasSpecifiedLinks()) {
-			sprintf(traceMsg, "%s (active-backup) No links to peer %llx specified. Searching...",
-				OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt()); RR->t->bondStateMessage(NULL, traceMsg);
 			for (int i=0; i<ZT_MAX_PEER_NETWORK_PATHS; ++i) {
 				if (_paths[i] && _paths[i]->eligible(now,_ackSendInterval)) {
-					_paths[i]->address().toString(curPathStr);
-					SharedPtr<Link> link =RR->bc->getLinkBySocket(_policyAlias, _paths[i]->localSocket());
-					if (link) {
-						sprintf(traceMsg, "%s (active-backup) Found eligible link %s/%s to peer %llx",
-							OSUtils::humanReadableTimestamp().c_str(), getLink(_paths[i])->ifname().c_str(), curPathStr, _peer->_id.address().toInt());
-						RR->t->bondStateMessage(NULL, traceMsg);
-					}
+					_event(EVENT_AB_LINK_SELECTED, i, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, AB_SELECT_FIRST_ELIGIBLE);
 					_abPath = _paths[i];
 					break;
 				}
@@ -1345,52 +1761,36 @@ void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 					if (!_paths[i]) {
 						continue;
 					}
-					SharedPtr<Link> link =RR->bc->getLinkBySocket(_policyAlias, _paths[i]->localSocket());
+					SharedPtr<Link> link = _pathLinks[i];
 					if (_paths[i]->eligible(now,_ackSendInterval) && link->primary()) {
 						if (!_paths[i]->preferred()) {
-							_paths[i]->address().toString(curPathStr);
 							// Found path on primary link, take note in case we don't find a preferred path
 							nonPreferredPath = _paths[i];
 							bFoundPrimaryLink = true;
 						}
 						if (_paths[i]->preferred()) {
 							_abPath = _paths[i];
-							_abPath->address().toString(curPathStr);
-							SharedPtr<Link> link = RR->bc->getLinkBySocket(_policyAlias, _paths[i]->localSocket());
 							bFoundPrimaryLink = true;
 							break; // Found preferred path %s on primary link
 						}
 					}
 				}
 				if (_abPath) {
-					_abPath->address().toString(curPathStr);
-					SharedPtr<Link> link =RR->bc->getLinkBySocket(_policyAlias, _abPath->localSocket());
-					if (link) {
-						sprintf(traceMsg, "%s (active-backup) Found preferred primary link %s/%s to peer %llx",
-							OSUtils::humanReadableTimestamp().c_str(), getLink(_abPath)->ifname().c_str(), curPathStr, _peer->_id.address().toInt());
-						RR->t->bondStateMessage(NULL, traceMsg);
-					}
+					_event(EVENT_AB_LINK_SELECTED, _pathIndex(_abPath), ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, AB_SELECT_PREFERRED_PRIMARY);
 				}
 				else {
 					if (bFoundPrimaryLink && nonPreferredPath) {
-						sprintf(traceMsg, "%s (active-backup) Found non-preferred primary link to peer %llx",
-							OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt());
-						RR->t->bondStateMessage(NULL, traceMsg);
 						_abPath = nonPreferredPath;
+						_event(EVENT_AB_LINK_SELECTED, _pathIndex(_abPath), ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, AB_SELECT_NON_PREFERRED_PRIMARY);
 					}
 				}
 				if (!_abPath) {
-					sprintf(traceMsg, "%s (active-backup) Designated primary link to peer %llx is not yet ready",
-						OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt());
-					RR->t->bondStateMessage(NULL, traceMsg);
+					_event(EVENT_AB_PRIMARY_NOT_READY, ZT_MAX_PEER_NETWORK_PATHS, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW);
 					// TODO: Should wait for some time (failover interval?) and then swtich to spare link
 				}
 			}
 			else if (!userHasSpecifiedPrimaryLink()) {
 				int _abIdx = ZT_MAX_PEER_NETWORK_PATHS;
-				sprintf(traceMsg, "%s (active-backup) User did not specify a primary link to peer %llx, selecting first available link",
-					OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt());
-				RR->t->bondStateMessage(NULL, traceMsg);
 				for (int i=0; i<ZT_MAX_PEER_NETWORK_PATHS; ++i) {
 					if (_paths[i] && _paths[i]->eligible(now,_ackSendInterval)) {
 						_abIdx = i;
@@ -1402,13 +1802,7 @@ void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 				}
 				else {
 					_abPath = _paths[_abIdx];
-					SharedPtr<Link> link =RR->bc->getLinkBySocket(_policyAlias, _abPath->localSocket());
-					if (link) {
-						_abPath->address().toString(curPathStr);
-						sprintf(traceMsg, "%s (active-backup) Selected non-primary link %s/%s to peer %llx",
-							OSUtils::humanReadableTimestamp().c_str(), getLink(_abPath)->ifname().c_str(), curPathStr, _peer->_id.address().toInt());
-						RR->t->bondStateMessage(NULL, traceMsg);
-					}
+					_event(EVENT_AB_LINK_SELECTED, _abIdx, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, AB_SELECT_NON_PRIMARY);
 				}
 			}
 		}
@@ -1421,14 +1815,9 @@ void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 		// Remove ineligible paths from the failover link queue
 		for (std::list<SharedPtr<Path> >::iterator it(_abFailoverQueue.begin()); it!=_abFailoverQueue.end();) {
 			if ((*it) && !(*it)->eligible(now,_ackSendInterval)) {
-				(*it)->address().toString(curPathStr);
-				SharedPtr<Link> link =RR->bc->getLinkBySocket(_policyAlias, (*it)->localSocket());
+				const unsigned int idx = _pathIndex(*it);
 				it = _abFailoverQueue.erase(it);
-				if (link) {
-					sprintf(traceMsg, "%s (active-backup) Link %s/%s to peer %llx is now ineligible, removing from failover queue, there are %zu links in the queue",
-						OSUtils::humanReadableTimestamp().c_str(), getLink(_abPath)->ifname().c_str(), curPathStr, _peer->_id.address().toInt(), _abFailoverQueue.size());
-					RR->t->bondStateMessage(NULL, traceMsg);
-				}
+				_event(EVENT_AB_QUEUE_REMOVED, idx, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, (int64_t)_abFailoverQueue.size());
 			} else {
 				++it;
 			}
@@ -1451,8 +1840,7 @@ void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 				if (!_paths[i] || !_paths[i]->allowed() || !_paths[i]->eligible(now,_ackSendInterval)) {
 					continue;
 				}
-				SharedPtr<Link> link =RR->bc->getLinkBySocket(_policyAlias, _paths[i]->localSocket());
-				_paths[i]->address().toString(pathStr);
+				SharedPtr<Link> link = _pathLinks[i];
 
 				int failoverScoreHandicap = _paths[i]->_failoverScore;
 				if (_paths[i]->preferred()) {
@@ -1474,7 +1862,6 @@ void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 				if (failoverLink) {
 					for (int j=0; j<ZT_MAX_PEER_NETWORK_PATHS; j++) {
 						if (_paths[j] && getLink(_paths[j]) == failoverLink.ptr()) {
-							_paths[j]->address().toString(pathStr);
 							int inheritedHandicap = failoverScoreHandicap - 10;
 							int newHandicap = _paths[j]->_failoverScore > inheritedHandicap ? _paths[j]->_failoverScore : inheritedHandicap;
 							if (!_paths[j]->preferred()) {
@@ -1493,9 +1880,7 @@ void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 					}
 					if (!bFoundPathInQueue) {
 						_abFailoverQueue.push_front(_paths[i]);
-						_paths[i]->address().toString(curPathStr); sprintf(traceMsg, "%s (active-backup) Added link %s/%s to peer %llx to failover queue, there are %zu links in the queue",
-							OSUtils::humanReadableTimestamp().c_str(), getLink(_abPath)->ifname().c_str(), curPathStr, _peer->_id.address().toInt(), _abFailoverQueue.size());
-						RR->t->bondStateMessage(NULL, traceMsg);
+						_event(EVENT_AB_QUEUE_ADDED, i, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, (int64_t)_abFailoverQueue.size());
 					}
 				}
 			}
@@ -1539,10 +1924,7 @@ void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 					}
 					if (!bFoundPathInQueue) {
 						_abFailoverQueue.push_front(_paths[i]);
-						_paths[i]->address().toString(curPathStr);
-						sprintf(traceMsg, "%s (active-backup) Added link %s/%s to peer %llx to failover queue, there are %zu links in the queue",
-							OSUtils::humanReadableTimestamp().c_str(), getLink(_paths[i])->ifname().c_str(), curPathStr, _peer->_id.address().toInt(), _abFailoverQueue.size());
-						RR->t->bondStateMessage(NULL, traceMsg);
+						_event(EVENT_AB_QUEUE_ADDED, i, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, (int64_t)_abFailoverQueue.size());
 					}
 				}
 			}
@@ -1553,42 +1935,37 @@ void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 	 * Short-circuit if we have no queued paths
 	 */
 	if (_abFailoverQueue.empty()) {
+		if (prevActiveBackupPath != _abPath) {
+			_peer->pathSelectionChanged();
+		}
 		return;
 	}
 	/**
 	 * Fulfill primary reselect obligations
 	 */
 	if (_abPath && !_abPath->eligible(now,_ackSendInterval)) { // Implicit ZT_MULTIPATH_RESELECTION_POLICY_FAILURE
-		_abPath->address().toString(curPathStr);
-		sprintf(traceMsg, "%s (active-backup) Link %s/%s to peer %llx has failed. Selecting new link from failover queue, there are %zu links in the queue",
-			OSUtils::humanReadableTimestamp().c_str(), getLink(_abPath)->ifname().c_str(), curPathStr, _peer->_id.address().toInt(), _abFailoverQueue.size());
-		RR->t->bondStateMessage(NULL, traceMsg);
+		const unsigned int failedIdx = _pathIndex(_abPath);
+		_event(EVENT_AB_LINK_FAILED, failedIdx, ZT_MAX_PEER_NETWORK_PATHS, ZT_QOS_NO_FLOW, (int64_t)_abFailoverQueue.size());
 		if (!_abFailoverQueue.empty()) {
+			const int prevFScore = _abPath->_failoverScore;
 			dequeueNextActiveBackupPath(now);
-			_abPath->address().toString(curPathStr);
-			sprintf(traceMsg, "%s (active-backup) Active link to peer %llx has been switched to %s/%s",
-				OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt(), getLink(_abPath)->ifname().c_str(), curPathStr);
-			RR->t->bondStateMessage(NULL, traceMsg);
-		} else {
-			sprintf(traceMsg, "%s (active-backup) Failover queue is empty. No links to peer %llx to choose from",
-				OSUtils::humanReadableTimestamp().c_str(), _peer->_id.address().toInt());
-			RR->t->bondStateMessage(NULL, traceMsg);
+			_event(EVENT_AB_SWITCHED, failedIdx, _pathIndex(_abPath), ZT_QOS_NO_FLOW, AB_SWITCH_FAILOVER, prevFScore, _abPath->_failoverScore);
 		}
 	}
 	/**
 	 * Detect change to prevent flopping during later optimization step.
 	 */
 	if (prevActiveBackupPath != _abPath) {
+		_peer->pathSelectionChanged();
 		_lastActiveBackupPathChange = now;
 	}
 	if (_abLinkSelectMethod == ZT_MULTIPATH_RESELECTION_POLICY_ALWAYS) {
 		if (_abPath && !getLink(_abPath)->primary()
 			&& getLink(_abFailoverQueue.front())->primary()) {
+			const unsigned int prevIdx = _pathIndex(_abPath);
+			const int prevFScore = _abPath->_failoverScore;
 			dequeueNextActiveBackupPath(now);
-			_abPath->address().toString(curPathStr);
-			sprintf(traceMsg, "%s (active-backup) Switching back to available primary link %s/%s to peer %llx [linkSelectionMethod = always]",
-				OSUtils::humanReadableTimestamp().c_str(), getLink(_abPath)->ifname().c_str(), curPathStr, _peer->_id.address().toInt());
-			RR->t->bondStateMessage(NULL, traceMsg);
+			_event(EVENT_AB_SWITCHED, prevIdx, _pathIndex(_abPath), ZT_QOS_NO_FLOW, AB_SWITCH_ALWAYS, prevFScore, _abPath->_failoverScore);
 		}
 	}
 	if (_abLinkSelectMethod == ZT_MULTIPATH_RESELECTION_POLICY_BETTER) {
@@ -1596,11 +1973,10 @@ void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 			// Active backup has switched to "better" primary link according to re-select policy.
 			if (getLink(_abFailoverQueue.front())->primary()
 				&& (_abFailoverQueue.front()->_failoverScore > _abPath->_failoverScore)) {
+				const unsigned int prevIdx = _pathIndex(_abPath);
+				const int prevFScore = _abPath->_failoverScore;
 				dequeueNextActiveBackupPath(now);
-				_abPath->address().toString(curPathStr);
-				sprintf(traceMsg, "%s (active-backup) Switching back to user-defined primary link %s/%s to peer %llx [linkSelectionMethod = better]",
-					OSUtils::humanReadableTimestamp().c_str(), getLink(_abPath)->ifname().c_str(), curPathStr, _peer->_id.address().toInt());
-				RR->t->bondStateMessage(NULL, traceMsg);
+				_event(EVENT_AB_SWITCHED, prevIdx, _pathIndex(_abPath), ZT_QOS_NO_FLOW, AB_SWITCH_BETTER, prevFScore, _abPath->_failoverScore);
 			}
 		}
 	}
@@ -1609,13 +1985,11 @@ void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 		 * Implement link negotiation that was previously-decided
 		 */
 		if (_abFailoverQueue.front()->_negotiated) {
+			const unsigned int prevIdx = _pathIndex(_abPath);
+			const int prevFScore = (_abPath) ? _abPath->_failoverScore : 0;
 			dequeueNextActiveBackupPath(now);
-			_abPath->address().toString(prevPathStr);
 			_lastPathNegotiationCheck = now;
-			_abPath->address().toString(curPathStr);
-			sprintf(traceMsg, "%s (active-backup) Switching negotiated link %s/%s to peer %llx [linkSelectionMethod = optimize]",
-				OSUtils::humanReadableTimestamp().c_str(), getLink(_abPath)->ifname().c_str(), curPathStr, _peer->_id.address().toInt());
-			RR->t->bondStateMessage(NULL, traceMsg);
+			_event(EVENT_AB_SWITCHED, prevIdx, _pathIndex(_abPath), ZT_QOS_NO_FLOW, AB_SWITCH_NEGOTIATED, prevFScore, _abPath->_failoverScore);
 		}
 		else {
 			// Try to find a better path and automatically switch to it -- not too often, though.
@@ -1627,13 +2001,9 @@ void Bond::processActiveBackupTasks(void *tPtr, const int64_t now)
 					int failoverScoreDifference = _abFailoverQueue.front()->_failoverScore - _abPath->_failoverScore;
 					int thresholdQuantity = (ZT_MULTIPATH_ACTIVE_BACKUP_OPTIMIZE_MIN_THRESHOLD * (float)_abPath->_allocation);
 					if ((failoverScoreDifference > 0) && (failoverScoreDifference > thresholdQuantity)) {
-						SharedPtr<Path> oldPath = _abPath;
-						_abPath->address().toString(prevPathStr);
+						const unsigned int prevIdx = _pathIndex(_abPath);
 						dequeueNextActiveBackupPath(now);
-						_abPath->address().toString(curPathStr);
-						sprintf(traceMsg, "%s (active-backup) Switching from %s/%s (fscore=%d) to better link %s/%s (fscore=%d) for peer %llx [linkSelectionMethod = optimize]",
-							OSUtils::humanReadableTimestamp().c_str(), getLink(oldPath)->ifname().c_str(), prevPathStr, prevFScore, getLink(_abPath)->ifname().c_str(), curPathStr, newFScore, _peer->_id.address().toInt());
-						RR->t->bondStateMessage(NULL, traceMsg);
+						_event(EVENT_AB_SWITCHED, prevIdx, _pathIndex(_abPath), ZT_QOS_NO_FLOW, AB_SWITCH_OPTIMIZE, prevFScore, newFScore);
 					}
 				}
 			}
@@ -1656,6 +2026,7 @@ void Bond::setReasonableDefaults(int policy, SharedPtr<Bond> templateBond, bool
 	}
 
 	_freeRandomByte = 0;
+	memset(_elephantCount, 0, sizeof(_elephantCount));
 
 	_userHasSpecifiedPrimaryLink = false;
 	_userHasSpecifiedFailoverInstructions = false;
@@ -1686,6 +2057,15 @@ void Bond::setReasonableDefaults(int policy, SharedPtr<Bond> templateBond, bool
 	_maxAcceptablePacketLossRatio = 0.10;
 	_maxAcceptablePacketErrorRatio = 0.10;
 	_userHasSpecifiedLinkSpeeds=0;
+	_resequence = false;
+	_fec = false;
+	_fecGroupSize = ZT_BOND_FEC_INITIAL_GROUP;
+	_fecParitySent = 0;
+	_probeTrain = 0;
+	_capacityProbing = false;
+	_pacing = false;
+	_livenessInterval = 0;
+	_livenessMultiplier = ZT_BOND_LIVENESS_DEFAULT_MULTIPLIER;
 
 	/* ZT_MULTIPATH_FLOW_REBALANCE_STRATEGY_PASSIVE is the most conservative strategy and is
 	least likely to cause unexpected behavior */
@@ -1788,6 +2168,12 @@ void Bond::setReasonableDefaults(int policy, SharedPtr<Bond> templateBond, bool
 			//fprintf(stderr, "warning: passive path monitoring was specified, this will prevent failovers from happening in a timely manner.\n");
 		}
 		_abLinkSelectMethod = templateBond->_abLinkSelectMethod;
+		_resequence = templateBond->_resequence;
+		_fec = templateBond->_fec;
+		_capacityProbing = templateBond->_capacityProbing;
+		_pacing = templateBond->_pacing;
+		_livenessInterval = templateBond->_livenessInterval;
+		_livenessMultiplier = templateBond->_livenessMultiplier;
 		memcpy(_qualityWeights, templateBond->_qualityWeights, ZT_QOS_WEIGHT_SIZE * sizeof(float));
 	}
 	/* Set timer geometries */
@@ -1822,9 +2208,216 @@ bool Bond::relevant() {
 
 SharedPtr<Link> Bond::getLink(const SharedPtr<Path>& path)
 {
+	for (int i=0; i<ZT_MAX_PEER_NETWORK_PATHS; ++i) {
+		if ((_paths[i].ptr() == path.ptr())&&(_pathLinks[i])) {
+			return _pathLinks[i];
+		}
+	}
 	return RR->bc->getLinkBySocket(_policyAlias, path->localSocket());
 }
 
+void Bond::resequenceFrame(void *tPtr, unsigned int stream, uint32_t seq, uint64_t nwid, const MAC &from, const MAC &to, unsigned int etherType, const void *data, unsigned int len, int64_t now)
+{
+	_ResequencedFrameSink sink(RR,tPtr);
+	_resequencer.receive(stream,seq,now,nwid,from,to,etherType,data,len,sink);
+}
+
+bool Bond::fecProtectFrame(Packet &outp, unsigned int fecAt, Packet &parity, int64_t now)
+{
+	Mutex::Lock _l(_fec_m);
+	if (!_fecEncoder.add(outp, fecAt, _fecGroupSize, now)) {
+		return false;
+	}
+	_fecEncoder.parity(parity);
+	++_fecParitySent;
+	return true;
+}
+
+SharedPtr<Path> Bond::_parityPath()
+{
+	/**
+	 * Parity is only useful if it arrives, so it goes over the bonded path least
+	 * likely to lose it rather than whichever path the group's last frame took.
+	 */
+	SharedPtr<Path> best;
+	for (int i=0; i<_numBondedPaths; ++i) {
+		const int idx = _bondedIdx[i];
+		if ((idx < 0) || (idx >= ZT_MAX_PEER_NETWORK_PATHS) || (!_paths[idx]) || (!_paths[idx]->address())) {
+			continue;
+		}
+		if ((!best) || (_paths[idx]->packetLossRatio() < best->packetLossRatio())) {
+			best = _paths[idx];
+		}
+	}
+	return best;
+}
+
+void Bond::_event(unsigned int type, unsigned int path, unsigned int path2, int32_t flowId, int64_t a0, int64_t a1, int64_t a2)
+{
+	const uint32_t seq = (uint32_t)(++_eventCounter);
+	_EventSlot &s = _events[seq & (ZT_BOND_EVENT_RING_SIZE - 1)];
+	s.seq = 0;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	s.e.seq = seq;
+	s.e.timestamp = RR->node->now();
+	s.e.type = (uint16_t)type;
+	s.e.path = (path < ZT_MAX_PEER_NETWORK_PATHS) ? (uint8_t)path : 0xff;
+	s.e.path2 = (path2 < ZT_MAX_PEER_NETWORK_PATHS) ? (uint8_t)path2 : 0xff;
+	s.e.flowId = flowId;
+	s.e.args[0] = a0;
+	s.e.args[1] = a1;
+	s.e.args[2] = a2;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	s.seq = seq;
+#ifdef ZT_TRACE
+	_traceEvent(s.e);
+#endif
+}
+
+uint32_t Bond::events(uint32_t since, std::vector<Event> &events) const
+{
+	const uint32_t newest = (uint32_t)const_cast<AtomicCounter &>(_eventCounter).load();
+	uint32_t seq = ((newest - since) > ZT_BOND_EVENT_RING_SIZE) ? (newest - ZT_BOND_EVENT_RING_SIZE + 1) : (since + 1);
+	for(;seq!=(newest + 1);++seq) {
+		const _EventSlot &s = _events[seq & (ZT_BOND_EVENT_RING_SIZE - 1)];
+		if (s.seq != seq) {
+			continue; // still being written or already overwritten
+		}
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		Event e;
+		memcpy(&e, (const void *)&(s.e), sizeof(Event));
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (s.seq == seq) {
+			events.push_back(e);
+		}
+	}
+	return newest;
+}
+
+const char *Bond::eventTypeName(unsigned int type)
+{
+	switch(type) {
+		case EVENT_PATH_NOMINATED: return "PATH_NOMINATED";
+		case EVENT_FLOW_ASSIGNED: return "FLOW_ASSIGNED";
+		case EVENT_FLOW_UNASSIGNABLE: return "FLOW_UNASSIGNABLE";
+		case EVENT_FLOW_EVICTED: return "FLOW_EVICTED";
+		case EVENT_FLOW_FORGOTTEN: return "FLOW_FORGOTTEN";
+		case EVENT_NEGOTIATION_SENT: return "NEGOTIATION_SENT";
+		case EVENT_NEGOTIATION_RECEIVED: return "NEGOTIATION_RECEIVED";
+		case EVENT_ELIGIBILITY_CHANGED: return "ELIGIBILITY_CHANGED";
+		case EVENT_HEALTH_CHANGED: return "HEALTH_CHANGED";
+		case EVENT_FLOWS_REALLOCATED: return "FLOWS_REALLOCATED";
+		case EVENT_AB_STATUS: return "AB_STATUS";
+		case EVENT_AB_LINK_SELECTED: return "AB_LINK_SELECTED";
+		case EVENT_AB_PRIMARY_NOT_READY: return "AB_PRIMARY_NOT_READY";
+		case EVENT_AB_QUEUE_ADDED: return "AB_QUEUE_ADDED";
+		case EVENT_AB_QUEUE_REMOVED: return "AB_QUEUE_REMOVED";
+		case EVENT_AB_LINK_FAILED: return "AB_LINK_FAILED";
+		case EVENT_AB_SWITCHED: return "AB_SWITCHED";
+		case EVENT_LIVENESS_CHANGED: return "LIVENESS_CHANGED";
+		case EVENT_FLOW_PINNED: return "FLOW_PINNED";
+	}
+	return "UNKNOWN";
+}
+
+std::string Bond::eventToString(const Event &e)
+{
+	Mutex::Lock _l(_paths_m);
+	return _eventToString(e);
+}
+
+std::string Bond::_eventToString(const Event &e) const
+{
+	static const char *selectReasons[4] = { "first eligible", "preferred primary", "non-preferred primary", "non-primary" };
+	static const char *switchReasons[6] = { "failover", "forced rotation", "linkSelectionMethod = always", "linkSelectionMethod = better", "linkSelectionMethod = optimize, negotiated", "linkSelectionMethod = optimize" };
+	char link[2][160];
+	char tmp[128];
+	const unsigned int idx[2] = { e.path, e.path2 };
+	for(unsigned int k=0;k<2;++k) {
+		if ((idx[k] < ZT_MAX_PEER_NETWORK_PATHS)&&(_paths[idx[k]])) {
+			_paths[idx[k]]->address().toString(tmp);
+			OSUtils::ztsnprintf(link[k],sizeof(link[k]),"%s/%s",(_pathLinks[idx[k]]) ? _pathLinks[idx[k]]->ifname().c_str() : "?",tmp);
+		} else {
+			Utils::scopy(link[k],sizeof(link[k]),"(none)");
+		}
+	}
+	const unsigned long long peer = (unsigned long long)_peer->_id.address().toInt();
+	char msg[384];
+	switch(e.type) {
+		case EVENT_PATH_NOMINATED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(bond) Nominating link %s to peer %.10llx. It has now entered its trial period",link[0],peer);
+			break;
+		case EVENT_FLOW_ASSIGNED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(bond) Assigned %s flow %x %s peer %.10llx to link %s, %lld active flow(s)",(e.args[1]) ? "incoming" : "outgoing",e.flowId,(e.args[1]) ? "from" : "to",peer,link[0],(long long)e.args[0]);
+			break;
+		case EVENT_FLOW_UNASSIGNABLE:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(bond) Unable to assign flow %x to peer %.10llx, %s",e.flowId,peer,(e.args[0]) ? "no active overflow link" : "there are no bonded paths");
+			break;
+		case EVENT_FLOW_EVICTED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(bond) Flow table slots for flow %x on bond to peer %.10llx are full, forcibly forgetting oldest flow %x",e.flowId,peer,(unsigned int)e.args[0]);
+			break;
+		case EVENT_FLOW_FORGOTTEN:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(bond) Forgetting flow %x (of age %lld) between this node and peer %.10llx, %lld active flow(s)",e.flowId,(long long)e.args[0],peer,(long long)e.args[1]);
+			break;
+		case EVENT_NEGOTIATION_SENT:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(bond) Sending link negotiation request to peer %.10llx via link %s, local utility is %lld",peer,link[0],(long long)e.args[0]);
+			break;
+		case EVENT_NEGOTIATION_RECEIVED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(bond) Peer %.10llx suggests using alternate link %s. Remote utility is %lld, local utility is %lld, %s",peer,link[0],(long long)e.args[0],(long long)e.args[1],(e.args[2]) ? "switching to said link" : "not switching");
+			break;
+		case EVENT_ELIGIBILITY_CHANGED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(bond) Eligibility of link %s to peer %.10llx has changed from %lld to %lld%s",link[0],peer,(long long)e.args[0],(long long)e.args[1],(e.args[2]) ? ", it was bonded and its flows will be reallocated soon" : "");
+			break;
+		case EVENT_HEALTH_CHANGED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(bond) Bond to peer %.10llx is in a %s state (%lld/%lld links)",peer,(e.args[0]) ? "HEALTHY" : "DEGRADED",(long long)e.args[1],(long long)e.args[2]);
+			break;
+		case EVENT_FLOWS_REALLOCATED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(balance-*) Reallocating flows to peer %.10llx from %s link %s",peer,(e.args[0]) ? "under-performing" : "dead",link[0]);
+			break;
+		case EVENT_AB_STATUS:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(active-backup) Active link to peer %.10llx is %s, failover queue size is %lld%s",peer,link[0],(long long)e.args[0],(e.args[0]) ? "" : ", bond is NOT currently fault-tolerant");
+			break;
+		case EVENT_AB_LINK_SELECTED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(active-backup) Selected %s link %s to peer %.10llx",((e.args[0] >= 0)&&(e.args[0] < 4)) ? selectReasons[e.args[0]] : "?",link[0],peer);
+			break;
+		case EVENT_AB_PRIMARY_NOT_READY:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(active-backup) Designated primary link to peer %.10llx is not yet ready",peer);
+			break;
+		case EVENT_AB_QUEUE_ADDED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(active-backup) Added link %s to peer %.10llx to failover queue, there are %lld links in the queue",link[0],peer,(long long)e.args[0]);
+			break;
+		case EVENT_AB_QUEUE_REMOVED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(active-backup) Link %s to peer %.10llx is now ineligible, removing from failover queue, there are %lld links in the queue",link[0],peer,(long long)e.args[0]);
+			break;
+		case EVENT_AB_LINK_FAILED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(active-backup) Link %s to peer %.10llx has failed, there are %lld links in the failover queue",link[0],peer,(long long)e.args[0]);
+			break;
+		case EVENT_AB_SWITCHED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(active-backup) Switching peer %.10llx from link %s (fscore=%lld) to %s (fscore=%lld) [%s]",peer,link[0],(long long)e.args[1],link[1],(long long)e.args[2],((e.args[0] >= 0)&&(e.args[0] < 6)) ? switchReasons[e.args[0]] : "?");
+			break;
+		case EVENT_LIVENESS_CHANGED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(bond) Link %s to peer %.10llx is %s after %lldms without a liveness reply",link[0],peer,(e.args[0]) ? "DOWN" : "UP",(long long)e.args[1]);
+			break;
+		case EVENT_FLOW_PINNED:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(balance-aware) Pinning elephant flow %x (%lld kbit/s) to peer %.10llx from link %s to %s",e.flowId,(long long)e.args[0],peer,link[0],link[1]);
+			break;
+		default:
+			OSUtils::ztsnprintf(msg,sizeof(msg),"(bond) Unknown event %u",(unsigned int)e.type);
+			break;
+	}
+	return std::string(msg);
+}
+
+#ifdef ZT_TRACE
+void Bond::_traceEvent(const Event &e)
+{
+	// Called with _paths_m already held or from code that cannot race with nominatePath()
+	char traceMsg[512];
+	OSUtils::ztsnprintf(traceMsg,sizeof(traceMsg),"%s %s",OSUtils::humanReadableTimestamp().c_str(),_eventToString(e).c_str());
+	RR->t->bondStateMessage(NULL, traceMsg);
+}
+#endif
+
 void Bond::dumpInfo(const int64_t now)
 {
 	// Omitted
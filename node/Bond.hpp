@@ -15,11 +15,15 @@
 #define ZT_BOND_HPP
 
 #include <map>
+#include <deque>
+#include <atomic>
 
 #include "Path.hpp"
 #include "Peer.hpp"
 #include "../osdep/Link.hpp"
 #include "Flow.hpp"
+#include "Resequencer.hpp"
+#include "Fec.hpp"
 
 namespace ZeroTier {
 
@@ -81,6 +85,8 @@ public:
 	 */
 	Bond(const RuntimeEnvironment *renv, SharedPtr<Bond> originalBond, const SharedPtr<Peer>& peer);
 
+	~Bond();
+
 	/**
 	 * @return The human-readable name of the bonding policy
 	 */
@@ -157,6 +163,40 @@ public:
 	 */
 	void receivedAck(const SharedPtr<Path>& path, int64_t now, int32_t ackedBytes);
 
+	/**
+	 * Time a received capacity probe and report on its train once the last probe arrives.
+	 *
+	 * @param tPtr Thread pointer to be handed through to any callbacks called as a result of this call
+	 * @param path Path over which probe was received
+	 * @param now Current time
+	 * @param train Train ID
+	 * @param index Index of this probe in its train
+	 * @param count Number of probes in train
+	 * @param len Size of this probe
+	 */
+	void receivedProbe(void *tPtr, const SharedPtr<Path>& path, int64_t now, uint16_t train, unsigned int index, unsigned int count, unsigned int len);
+
+	/**
+	 * Estimate a path's capacity from a report on a probe train sent over it.
+	 *
+	 * @param path Path over which report was received
+	 * @param now Current time
+	 * @param train Train ID
+	 * @param bytes Bytes received after the first probe of the train
+	 * @param dispersion Time between first and last probe of the train (ms)
+	 */
+	void receivedProbeReport(const SharedPtr<Path>& path, int64_t now, uint16_t train, uint32_t bytes, uint32_t dispersion);
+
+	/**
+	 * Record a reply to a liveness request sent over a path.
+	 *
+	 * @param tPtr Thread pointer to be handed through to any callbacks called as a result of this call
+	 * @param path Path over which reply was received
+	 * @param now Current time
+	 * @param timestamp Timestamp of the request being answered
+	 */
+	void receivedLivenessReply(void *tPtr, const SharedPtr<Path>& path, int64_t now, int64_t timestamp);
+
 	/**
 	 * Generate the contents of a VERB_QOS_MEASUREMENT packet.
 	 *
@@ -194,11 +234,10 @@ public:
 	 *
 	 * @param path Path over which flow shall be handled
 	 * @param flowId Flow ID
-	 * @param entropy A byte of entropy to be used by the bonding algorithm
 	 * @param now Current time
-	 * @return Pointer to newly-created Flow
+	 * @return Pointer to newly-created Flow (valid while _flows_m is held) or NULL
 	 */
-	SharedPtr<Flow> createFlow(const SharedPtr<Path> &path, int32_t flowId, unsigned char entropy, int64_t now);
+	Flow *createFlow(const SharedPtr<Path> &path, int32_t flowId, int64_t now);
 
 	/**
 	 * Removes flow records that are past a certain age limit.
@@ -215,7 +254,7 @@ public:
 	 * @param flow Flow to be assigned
 	 * @param now Current time
 	 */
-	bool assignFlowToBondedPath(SharedPtr<Flow> &flow, int64_t now);
+	bool assignFlowToBondedPath(Flow *flow, int64_t now);
 
 	/**
 	 * Determine whether a path change should occur given the remote peer's reported utility and our
@@ -249,6 +288,33 @@ public:
 	void sendACK(void *tPtr, const SharedPtr<Path> &path,int64_t localSocket,
 			const InetAddress &atAddress,int64_t now);
 
+	/**
+	 * Sends a train of VERB_BOND_PROBE packets back to back over a path.
+	 *
+	 * @param tPtr Thread pointer to be handed through to any callbacks called as a result of this call
+	 * @param path Path to probe
+	 * @param now Current time
+	 */
+	void sendCapacityProbe(void *tPtr, const SharedPtr<Path> &path, int64_t now);
+
+	/**
+	 * Sends liveness requests that are due and declares silent paths down.
+	 *
+	 * @param tPtr Thread pointer to be handed through to any callbacks called as a result of this call
+	 * @param now Current time
+	 */
+	void processLivenessTasks(void *tPtr, int64_t now);
+
+	/**
+	 * Handles a path that has just been declared down or up by liveness monitoring.
+	 *
+	 * @param tPtr Thread pointer to be handed through to any callbacks called as a result of this call
+	 * @param pathIdx Index of path
+	 * @param now Current time
+	 * @param silence Time between the last two replies, or since the last reply if now down
+	 */
+	void livenessChanged(void *tPtr, unsigned int pathIdx, int64_t now, int64_t silence);
+
 	/**
 	 * Sends a VERB_QOS_MEASUREMENT to the remote peer.
 	 *
@@ -559,6 +625,179 @@ public:
 	 */
 	inline bool allowPathNegotiation() { return _allowPathNegotiation; }
 
+	/**
+	 * @param resequence Whether frames sent through this bond should carry sequence numbers
+	 */
+	inline void setResequencing(bool resequence) { _resequence = resequence; }
+
+	/**
+	 * @return True if frames sent through this bond carry sequence numbers so the remote bond can restore their order
+	 */
+	inline bool resequencing() const { return ((_resequence)&&((_bondingPolicy == ZT_BONDING_POLICY_BALANCE_RR)||(_bondingPolicy == ZT_BONDING_POLICY_BALANCE_AWARE))); }
+
+	/**
+	 * Claim the next outgoing sequence number for a flow's frames
+	 *
+	 * @param flowId Flow ID
+	 * @param stream Set to the stream the sequence number belongs to
+	 * @return Sequence number
+	 */
+	inline uint32_t nextFrameSequence(const int32_t flowId, unsigned int &stream)
+	{
+		stream = Resequencer::streamForFlow(flowId);
+		return (uint32_t)(++_txFrameSequence[stream]);
+	}
+
+	/**
+	 * Deliver a received frame that carries a bond sequence number
+	 *
+	 * The frame goes to the tap now if it is next in its stream, otherwise it
+	 * is held until the frames before it arrive or a timeout derived from the
+	 * latency spread between links expires.
+	 *
+	 * @param tPtr Thread pointer to be handed through to any callbacks called as a result of this call
+	 * @param stream Stream number from frame
+	 * @param seq Sequence number from frame
+	 * @param nwid Network ID
+	 * @param from Source MAC
+	 * @param to Destination MAC
+	 * @param etherType Ethernet frame type
+	 * @param data Frame payload
+	 * @param len Length of frame payload
+	 * @param now Current time
+	 */
+	void resequenceFrame(void *tPtr, unsigned int stream, uint32_t seq, uint64_t nwid, const MAC &from, const MAC &to, unsigned int etherType, const void *data, unsigned int len, int64_t now);
+
+	/**
+	 * @return Counters describing how received frames were resequenced
+	 */
+	inline Resequencer::Counters resequenceCounters() const { return _resequencer.counters(); }
+
+	/**
+	 * @return Current time in ms a reordered frame may be held
+	 */
+	inline int64_t resequenceTimeout() const { return _resequencer.timeout(); }
+
+	/**
+	 * @param fec Whether frames sent through this bond should be protected by parity
+	 */
+	inline void setFec(bool fec) { _fec = fec; }
+
+	/**
+	 * @return True if frames sent through this bond are grouped and followed by parity
+	 */
+	inline bool fec() const { return ((_fec)&&((_bondingPolicy == ZT_BONDING_POLICY_BALANCE_RR)||(_bondingPolicy == ZT_BONDING_POLICY_BALANCE_XOR)||(_bondingPolicy == ZT_BONDING_POLICY_BALANCE_AWARE))); }
+
+	/**
+	 * Add an outgoing frame to the current FEC group
+	 *
+	 * @param outp EXT_FRAME with zeroed FEC fields, which are filled in
+	 * @param fecAt Offset of FEC fields in payload
+	 * @param parity BOND_PARITY packet to append the group's parity to if the group is complete
+	 * @param now Current time
+	 * @return True if parity was appended and should be sent after outp
+	 */
+	bool fecProtectFrame(Packet &outp, unsigned int fecAt, Packet &parity, int64_t now);
+
+	/**
+	 * @return Bonded path with the lowest estimated loss, which all parity is sent over, or NULL if none
+	 */
+	inline SharedPtr<Path> parityPath()
+	{
+		Mutex::Lock _l(_paths_m);
+		return _parityPath();
+	}
+
+	/**
+	 * Accept a received FEC-protected frame
+	 *
+	 * @param group Group from frame
+	 * @param index Index from frame
+	 * @param payload EXT_FRAME payload
+	 * @param len Length of payload
+	 * @param fecAt Offset of FEC fields in payload
+	 * @param out Buffer of ZT_FEC_MAX_BLOCK bytes to receive a rebuilt EXT_FRAME payload
+	 * @param outLen Set to length of rebuilt payload
+	 * @return -1 to drop frame as a duplicate, 0 to accept it, 1 to accept it and process out as well
+	 */
+	inline int fecReceiveFrame(uint32_t group, unsigned int index, const uint8_t *payload, unsigned int len, unsigned int fecAt, uint8_t *out, unsigned int &outLen)
+	{
+		Mutex::Lock _l(_fec_m);
+		return _fecDecoder.frame(group, index, payload, len, fecAt, out, outLen);
+	}
+
+	/**
+	 * Accept a received parity packet
+	 *
+	 * @param group Group from parity packet
+	 * @param size Number of frames in group
+	 * @param data Parity data
+	 * @param len Length of parity data
+	 * @param out Buffer of ZT_FEC_MAX_BLOCK bytes to receive a rebuilt EXT_FRAME payload
+	 * @param outLen Set to length of rebuilt payload
+	 * @return 1 if out contains a rebuilt payload to process, otherwise 0
+	 */
+	inline int fecReceiveParity(uint32_t group, unsigned int size, const uint8_t *data, unsigned int len, uint8_t *out, unsigned int &outLen)
+	{
+		Mutex::Lock _l(_fec_m);
+		return _fecDecoder.parity(group, size, data, len, out, outLen);
+	}
+
+	/**
+	 * @return Counters describing how received parity was used
+	 */
+	inline Fec::Decoder::Counters fecCounters() const
+	{
+		Mutex::Lock _l(_fec_m);
+		return _fecDecoder.counters();
+	}
+
+	/**
+	 * @return Number of frames currently covered by each parity packet sent
+	 */
+	inline unsigned int fecGroupSize() const { return _fecGroupSize; }
+
+	/**
+	 * @return Number of parity packets sent
+	 */
+	inline uint64_t fecParitySent() const { return _fecParitySent; }
+
+	/**
+	 * @param probe Whether the capacity of bonded paths should be measured with probe trains
+	 */
+	inline void setCapacityProbing(bool probe) { _capacityProbing = probe; }
+
+	/**
+	 * @return True if the capacity of bonded paths is measured with probe trains
+	 */
+	inline bool capacityProbing() const { return _capacityProbing; }
+
+	/**
+	 * @param pacing Whether frames should be paced onto each path at its measured capacity
+	 */
+	inline void setPacing(bool pacing) { _pacing = pacing; }
+
+	/**
+	 * @return True if frames are paced onto each path at its measured capacity
+	 */
+	inline bool pacing() const { return _pacing; }
+
+	/**
+	 * @param interval Interval between liveness requests on each path, 0 to disable (ms)
+	 * @param multiplier Number of unanswered intervals after which a path is declared down
+	 */
+	void setLiveness(int interval, unsigned int multiplier);
+
+	/**
+	 * @return Interval between liveness requests on each path, 0 if disabled (ms)
+	 */
+	inline int livenessInterval() const { return _livenessInterval; }
+
+	/**
+	 * @return Number of unanswered intervals after which a path is declared down
+	 */
+	inline unsigned int livenessMultiplier() const { return _livenessMultiplier; }
+
 	/**
 	 * Forcibly rotates the currently active link used in an active-backup bond to the next link in the failover queue
 	 *
@@ -568,8 +807,151 @@ public:
 
 	SharedPtr<Peer> getPeer() { return _peer; }
 
+	/**
+	 * Types of events recorded by a bond
+	 */
+	enum EventType
+	{
+		EVENT_PATH_NOMINATED = 1,
+		EVENT_FLOW_ASSIGNED = 2,             // args: active flows, incoming (0/1)
+		EVENT_FLOW_UNASSIGNABLE = 3,         // args: active-backup without overflow (0/1)
+		EVENT_FLOW_EVICTED = 4,              // args: evicted flow ID
+		EVENT_FLOW_FORGOTTEN = 5,            // args: age, active flows
+		EVENT_NEGOTIATION_SENT = 6,          // args: local utility
+		EVENT_NEGOTIATION_RECEIVED = 7,      // args: remote utility, local utility, accepted (0/1)
+		EVENT_ELIGIBILITY_CHANGED = 8,       // args: previous, current, was bonded (0/1)
+		EVENT_HEALTH_CHANGED = 9,            // args: healthy (0/1), alive links, total links
+		EVENT_FLOWS_REALLOCATED = 10,        // args: link under-performing rather than dead (0/1)
+		EVENT_AB_STATUS = 11,                // args: failover queue size
+		EVENT_AB_LINK_SELECTED = 12,         // args: AB_SELECT_* reason
+		EVENT_AB_PRIMARY_NOT_READY = 13,
+		EVENT_AB_QUEUE_ADDED = 14,           // args: failover queue size
+		EVENT_AB_QUEUE_REMOVED = 15,         // args: failover queue size
+		EVENT_AB_LINK_FAILED = 16,           // args: failover queue size
+		EVENT_AB_SWITCHED = 17,              // args: AB_SWITCH_* reason, previous score, new score
+		EVENT_LIVENESS_CHANGED = 18,         // args: down (0/1), time since last reply
+		EVENT_FLOW_PINNED = 19               // args: rate (kbit/s)
+	};
+
+	enum ActiveBackupSelectReason
+	{
+		AB_SELECT_FIRST_ELIGIBLE = 0,
+		AB_SELECT_PREFERRED_PRIMARY = 1,
+		AB_SELECT_NON_PREFERRED_PRIMARY = 2,
+		AB_SELECT_NON_PRIMARY = 3
+	};
+
+	enum ActiveBackupSwitchReason
+	{
+		AB_SWITCH_FAILOVER = 0,
+		AB_SWITCH_FORCED = 1,
+		AB_SWITCH_ALWAYS = 2,
+		AB_SWITCH_BETTER = 3,
+		AB_SWITCH_NEGOTIATED = 4,
+		AB_SWITCH_OPTIMIZE = 5
+	};
+
+	/**
+	 * A fixed-size record of something that happened to this bond
+	 *
+	 * Events are recorded in binary form and only turned into text when
+	 * something asks for them, so recording is cheap enough for the data path.
+	 */
+	struct Event
+	{
+		uint32_t seq;       // sequence number, starts at 1
+		int64_t timestamp;
+		uint16_t type;      // EventType
+		uint8_t path;       // index of path or 0xff if none
+		uint8_t path2;      // index of second path (switches) or 0xff if none
+		int32_t flowId;
+		int64_t args[3];
+	};
+
+	/**
+	 * Get recent events, oldest first
+	 *
+	 * @param since Only return events with a sequence number greater than this
+	 * @param events Vector to append events to
+	 * @return Sequence number of the newest event recorded so far
+	 */
+	uint32_t events(uint32_t since, std::vector<Event> &events) const;
+
+	/**
+	 * @param e Event recorded by this bond
+	 * @return Human-readable description of event
+	 */
+	std::string eventToString(const Event &e);
+
+	/**
+	 * @param type Event type
+	 * @return Short name of event type
+	 */
+	static const char *eventTypeName(unsigned int type);
+
 private:
 
+	struct _EventSlot
+	{
+		_EventSlot() : seq(0) {}
+		volatile uint32_t seq; // zero while the slot is being written
+		Event e;
+	};
+
+	/**
+	 * Record an event without taking any locks
+	 *
+	 * Any number of threads may record at once, each claims its own slot. Text is
+	 * only produced here in ZT_TRACE builds.
+	 */
+	void _event(unsigned int type, unsigned int path, unsigned int path2, int32_t flowId, int64_t a0 = 0, int64_t a1 = 0, int64_t a2 = 0);
+
+#ifdef ZT_TRACE
+	void _traceEvent(const Event &e);
+#endif
+
+	/**
+	 * Format an event, caller must make sure _paths cannot change
+	 */
+	std::string _eventToString(const Event &e) const;
+
+	_EventSlot _events[ZT_BOND_EVENT_RING_SIZE];
+	AtomicCounter _eventCounter;
+
+	/**
+	 * Frame resequencing (balance-rr, balance-aware)
+	 */
+	Resequencer _resequencer;
+	AtomicCounter _txFrameSequence[ZT_BOND_RESEQUENCE_STREAMS];
+	bool _resequence;
+
+	/**
+	 * Forward error correction (balance-rr, balance-xor, balance-aware)
+	 */
+	Fec::Encoder _fecEncoder;
+	Fec::Decoder _fecDecoder;
+	Mutex _fec_m;
+	volatile unsigned int _fecGroupSize;
+	uint64_t _fecParitySent;
+	bool _fec;
+
+	/**
+	 * Active capacity measurement (see VERB_BOND_PROBE)
+	 */
+	uint16_t _probeTrain;
+	bool _capacityProbing;
+
+	/**
+	 * Pace frames onto paths with a known capacity (see Path::paceTake)
+	 */
+	bool _pacing;
+
+	/**
+	 * Liveness monitoring (see VERB_BOND_LIVENESS)
+	 */
+	int _livenessInterval;
+	unsigned int _livenessMultiplier;
+
 	const RuntimeEnvironment *RR;
 	AtomicCounter __refCount;
 
@@ -584,6 +966,15 @@ private:
 	 */
 	SharedPtr<Path> _paths[ZT_MAX_PEER_NETWORK_PATHS];
 
+	/**
+	 * Raw pointers to the paths in _paths for the lock-free flow fast path,
+	 * set by _setPath() after the slot in _paths. A path replaced in its slot
+	 * is kept in _retiredPaths for ZT_BOND_RETIRED_PATH_TTL so that a reader
+	 * that loaded the old pointer can still take a reference to it.
+	 */
+	Path *volatile _pathPtrs[ZT_MAX_PEER_NETWORK_PATHS];
+	std::deque< std::pair< int64_t,SharedPtr<Path> > > _retiredPaths; // guarded by _paths_m
+
 	/**
 	 * Set of indices corresponding to paths currently included in the bond proper. This
 	 * may only be updated during a call to curateBond(). The reason for this is so that
@@ -597,9 +988,144 @@ private:
 	int _numBondedPaths;
 
 	/**
-	 * Flows hashed according to port and protocol
+	 * Link for each path in _paths, bound once when the path is nominated.
+	 */
+	SharedPtr<Link> _pathLinks[ZT_MAX_PEER_NETWORK_PATHS];
+
+	/**
+	 * Flows hashed according to port and protocol. This is an open-addressed
+	 * table of ZT_FLOW_TABLE_MIN_SIZE slots allocated when the first flow is
+	 * seen, doubled whenever it becomes half full up to ZT_FLOW_MAX_COUNT.
+	 * A flow lives within ZT_FLOW_TABLE_MAX_PROBE slots of its home slot.
+	 * Lookups are lock-free, changes require _flows_m. Outgrown tables are
+	 * kept for lock-free readers until the bond is destroyed; together they
+	 * are never larger than the current table.
+	 */
+	struct FlowTable
+	{
+		FlowTable(unsigned int size) : mask(size - 1), slots(new Flow[size]) {}
+		~FlowTable() { delete [] slots; }
+		inline unsigned int size() const { return mask + 1; }
+		const unsigned int mask;
+		Flow *const slots;
+	private:
+		FlowTable(const FlowTable &) : mask(0), slots((Flow *)0) {}
+		const FlowTable &operator=(const FlowTable &) { return *this; }
+	};
+	FlowTable *volatile _flowTable;
+	std::vector<FlowTable *> _outgrownFlowTables;
+	unsigned long _flowCount;
+
+	static inline unsigned int _flowHash(const int32_t flowId)
+	{
+		uint32_t h = (uint32_t)flowId;
+		h ^= h >> 16;
+		h *= 0x45d9f3bU;
+		h ^= h >> 16;
+		return (unsigned int)h;
+	}
+
+	inline Flow *_findFlow(const int32_t flowId) const { return _findFlow(_flowTable, flowId); }
+
+	static inline Flow *_findFlow(FlowTable *const table, const int32_t flowId)
+	{
+		if ((table)&&(flowId != ZT_QOS_NO_FLOW)) {
+			const unsigned int home = _flowHash(flowId);
+			for (unsigned int k=0; k<ZT_FLOW_TABLE_MAX_PROBE; ++k) {
+				Flow *const f = table->slots + ((home + k) & table->mask);
+				if (f->_flowId == flowId) {
+					return f;
+				}
+			}
+		}
+		return (Flow *)0;
+	}
+
+	inline unsigned int _pathIndex(const SharedPtr<Path> &path) const
+	{
+		for (unsigned int i=0; i<ZT_MAX_PEER_NETWORK_PATHS; ++i) {
+			if ((path)&&(_paths[i].ptr() == path.ptr())) {
+				return i;
+			}
+		}
+		return ZT_MAX_PEER_NETWORK_PATHS;
+	}
+
+	void _recordOutgoingPathStats(const SharedPtr<Path> &path, uint64_t packetId, uint16_t payloadLength, bool isFrame, bool shouldRecord, int64_t now); // caller must hold _paths_m
+	void _growFlowTable();
+	void _setPath(unsigned int i, const SharedPtr<Path> &path, int64_t now); // caller must hold _paths_m
+	SharedPtr<Path> _parityPath(); // caller must hold _paths_m
+
+	/**
+	 * Find a flow without locking _flows_m and record activity on it
+	 *
+	 * If the table grew meanwhile, the flow is looked up again in the new table,
+	 * since activity recorded on a flow in an outgrown table would be lost.
+	 *
+	 * @param flowId Flow ID
+	 * @param now Current time
+	 * @return Flow in the current table or NULL if there is none
+	 */
+	inline Flow *_touchFlow(const int32_t flowId, const int64_t now)
+	{
+		for (;;) {
+			FlowTable *const table = _flowTable;
+			Flow *const f = _findFlow(table, flowId);
+			if (!f) {
+				return f;
+			}
+			f->updateActivity(now);
+			std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in _growFlowTable()
+			if (_flowTable == table) {
+				return f;
+			}
+		}
+	}
+	void _eraseFlow(Flow *flow);
+
+	/**
+	 * @param flowId Flow ID
+	 * @return Index of the bonded path this flow hashes to, or ZT_MAX_PEER_NETWORK_PATHS if none
+	 */
+	unsigned int _rendezvousPath(int32_t flowId) const;
+
+	/**
+	 * How attractive a path is to an elephant flow: its share of the bond split
+	 * among the elephants already on it
+	 */
+	inline float _elephantScore(const Flow *flow, unsigned int pathIdx) const
+	{
+		unsigned int elephants = _elephantCount[pathIdx];
+		if ((flow->assignedPath() == pathIdx) && (elephants)) {
+			--elephants;
+		}
+		return ((float)_paths[pathIdx]->_allocation + 1.0f) / (float)(elephants + 1);
+	}
+
+	/**
+	 * @param flow Elephant flow
+	 * @return Index of the bonded path with the most room for it, or ZT_MAX_PEER_NETWORK_PATHS if none
+	 */
+	unsigned int _elephantPath(const Flow *flow) const;
+
+	/**
+	 * @param flow Flow to move
+	 * @param toIdx Index of path it would move to
+	 * @param now Current time
+	 * @return True if moving the flow now would reorder it by no more than ZT_FLOW_MIGRATION_MAX_REORDER
+	 */
+	bool _mayMigrateFlow(const Flow *flow, unsigned int toIdx, int64_t now) const;
+
+	/**
+	 * Check flow rates, then pin new elephants and move existing ones when a path
+	 * has clearly more room for them
+	 */
+	void _placeElephantFlows(int64_t now);
+
+	/**
+	 * Number of elephant flows on each path as of the last rate check
 	 */
-	std::map<int32_t,SharedPtr<Flow> > _flows;
+	unsigned int _elephantCount[ZT_MAX_PEER_NETWORK_PATHS];
 
 	float _qualityWeights[ZT_QOS_WEIGHT_SIZE]; // How much each factor contributes to the "quality" score of a path.
 
@@ -706,6 +1232,7 @@ private:
 	uint64_t _lastFlowStatReset;
 	uint64_t _lastFlowExpirationCheck;
 	uint64_t _lastFlowRebalance;
+	uint64_t _lastFlowRateCheck;
 	uint64_t _lastFrame;
 	uint64_t _lastActiveBackupPathChange;
 
@@ -20,6 +20,7 @@
 namespace ZeroTier {
 
 int BondController::_minReqPathMonitorInterval;
+int BondController::_minLivenessInterval;
 uint8_t BondController::_defaultBondingPolicy;
 
 BondController::BondController(const RuntimeEnvironment *renv) :
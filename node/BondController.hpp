@@ -50,6 +50,16 @@ public:
 	 */
 	static void setMinReqPathMonitorInterval(int minReqPathMonitorInterval) { _minReqPathMonitorInterval = minReqPathMonitorInterval; }
 
+	/**
+	 * @return The shortest liveness interval of any bond, or 0 if no bond monitors liveness.
+	 */
+	int minLivenessInterval() { return _minLivenessInterval; }
+
+	/**
+	 * @param livenessInterval Liveness interval of a bond, kept if shorter than any seen before.
+	 */
+	static void setMinLivenessInterval(int livenessInterval) { if ((!_minLivenessInterval) || (livenessInterval < _minLivenessInterval)) { _minLivenessInterval = livenessInterval; } }
+
 	/**
 	 * @return Whether the bonding layer is currently set up to be used.
 	 */
@@ -195,6 +205,11 @@ private:
 	 */
 	static int _minReqPathMonitorInterval;
 
+	/**
+	 * The shortest liveness interval of any bond.
+	 */
+	static int _minLivenessInterval;
+
 	/**
 	 * The default bonding policy used for new bonds unless otherwise specified.
 	 */
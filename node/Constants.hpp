@@ -221,6 +221,23 @@
  */
 #define ZT_TX_QUEUE_SIZE 32
 
+/**
+ * Maximum packets queued for one destination while waiting for its identity
+ */
+#define ZT_TX_QUEUE_MAX_PER_ADDRESS 32
+
+/**
+ * Maximum memory used by packets queued while waiting for identities
+ *
+ * Each queued packet is charged its full buffer size, not its length.
+ */
+#define ZT_TX_QUEUE_MAX_BYTES 4194304
+
+/**
+ * Maximum RX queue entries one source may hold while waiting for its identity
+ */
+#define ZT_RX_QUEUE_MAX_PER_ADDRESS 8
+
 /**
  * Minimum delay between timer task checks to prevent thrashing
  */
@@ -253,6 +270,29 @@
  */
 #define ZT_RELAY_MAX_HOPS 3
 
+/**
+ * Number of slots in the relay fast path destination cache (must be a power of two)
+ *
+ * This is only allocated on roots and moons, and only once they relay something.
+ */
+#define ZT_RELAY_CACHE_SIZE 16384
+
+/**
+ * How long a relay fast path cache entry is trusted before it's looked up again
+ *
+ * This bounds how long relayed traffic can keep flowing to a path after the
+ * destination peer's best path has changed.
+ */
+#define ZT_RELAY_CACHE_TTL 1000
+
+/**
+ * Maximum number of replaced paths the relay cache keeps alive for readers
+ *
+ * While this many are waiting out 2*ZT_RELAY_CACHE_TTL, cache entries whose
+ * path changed are left alone and expire instead of being replaced.
+ */
+#define ZT_RELAY_CACHE_MAX_RETIRED 4096
+
 /**
  * Expire time for multicast 'likes' and indirect multicast memberships in ms
  */
@@ -275,6 +315,25 @@
  */
 #define ZT_MULTICAST_TRANSMIT_TIMEOUT 5000
 
+/**
+ * Fan-out used when originating a tree-replicated multicast
+ *
+ * Only networks with ZT_NETWORKCONFIG_FLAG_MULTICAST_TREE set use trees.
+ * Each member receiving a tree multicast re-replicates it to at most this
+ * many children, so sender cost is O(fan-out) and depth is O(log n).
+ */
+#define ZT_MULTICAST_TREE_FANOUT 8
+
+/**
+ * Largest fan-out a tree member will honor when re-replicating
+ */
+#define ZT_MULTICAST_TREE_MAX_FANOUT 32
+
+/**
+ * Groups smaller than this are replicated directly by the sender even in tree mode
+ */
+#define ZT_MULTICAST_TREE_MIN_MEMBERS (ZT_MULTICAST_TREE_FANOUT * 2)
+
 /**
  * Delay between checks of peer pings, etc., and also related housekeeping tasks
  */
@@ -305,6 +364,20 @@
  */
 #define ZT_PEER_PATH_EXPIRATION ((ZT_PEER_PING_PERIOD * 4) + 3000)
 
+/**
+ * How long a peer's cached best path remains valid if nothing invalidates it
+ *
+ * Path learning, expiration, latency updates, and bond curation invalidate
+ * the cache immediately. This bound only covers time-dependent inputs such
+ * as path quality decaying when a link goes quiet.
+ */
+#define ZT_PEER_BEST_PATH_CACHE_TTL 1000
+
+/**
+ * Number of per-flow path selections cached by each peer (must be a power of two)
+ */
+#define ZT_PEER_FLOW_PATH_CACHE_SIZE 16
+
 /**
  * How often to retry expired paths that we're still remembering
  */
@@ -408,6 +481,16 @@
  */
 #define ZT_AQM_DEFAULT_BUCKET 0
 
+/**
+ * Number of hashed per-flow queues in each network's fq_codel scheduler
+ */
+#define ZT_AQM_NUM_FLOW_QUEUES 1024
+
+/**
+ * Maximum number of packets released per network during one AQM cycle
+ */
+#define ZT_AQM_DEQUEUE_BURST 2
+
 /**
  * How often we emit a one-liner bond summary for each peer
  */
@@ -437,10 +520,151 @@
 #define ZT_FLOW_STATS_RESET_INTERVAL ZT_MULTIPATH_FLOW_EXPIRATION_INTERVAL
 
 /**
- * Maximum number of flows allowed before we start forcibly forgetting old ones
+ * Initial number of slots in each bond's flow table (must be a power of two)
+ *
+ * The table is allocated the first time a bond sees a flow.
+ */
+#define ZT_FLOW_TABLE_MIN_SIZE 64
+
+/**
+ * Largest number of slots a bond's flow table may grow to (must be a power of two)
  */
 #define ZT_FLOW_MAX_COUNT (1024*64)
 
+/**
+ * Number of flow table slots searched for a flow before the least recently
+ * active flow among them is forgotten to make room
+ */
+#define ZT_FLOW_TABLE_MAX_PROBE 16
+
+/**
+ * How long a path replaced in a bond's path slot is kept alive for lock-free readers (ms)
+ */
+#define ZT_BOND_RETIRED_PATH_TTL 10000
+
+/**
+ * Number of recent events each bond keeps for inspection (must be a power of two)
+ */
+#define ZT_BOND_EVENT_RING_SIZE 128
+
+/**
+ * Number of independent sequence streams a bond resequences frames in
+ *
+ * Flows are hashed onto streams so one stalled flow does not hold back others.
+ */
+#define ZT_BOND_RESEQUENCE_STREAMS 64
+
+/**
+ * Maximum number of frames ahead of the next expected one held per stream (must be a power of two)
+ */
+#define ZT_BOND_RESEQUENCE_WINDOW 32
+
+/**
+ * Minimum time a frame is held waiting for an earlier one (ms)
+ */
+#define ZT_BOND_RESEQUENCE_MIN_TIMEOUT 5
+
+/**
+ * Maximum time a frame is held waiting for an earlier one (ms)
+ */
+#define ZT_BOND_RESEQUENCE_MAX_TIMEOUT 250
+
+/**
+ * Smallest number of frames covered by one FEC parity packet
+ */
+#define ZT_BOND_FEC_MIN_GROUP 2
+
+/**
+ * Largest number of frames covered by one FEC parity packet (at most 32)
+ */
+#define ZT_BOND_FEC_MAX_GROUP 16
+
+/**
+ * Number of frames covered by one FEC parity packet before loss is known
+ */
+#define ZT_BOND_FEC_INITIAL_GROUP 4
+
+/**
+ * FEC groups are sized so that group size times worst link loss stays below this
+ *
+ * One parity packet repairs one loss per group, so frames are lost for good
+ * at roughly this fraction of the link loss rate.
+ */
+#define ZT_BOND_FEC_GROUP_LOSS 0.1f
+
+/**
+ * Number of recent FEC groups a receiving bond keeps for repair
+ *
+ * This must cover the groups sent during the latency difference between the
+ * fastest and slowest link, or frames on the slow link arrive after their
+ * group has been forgotten.
+ */
+#define ZT_BOND_FEC_DECODE_GROUPS 256
+
+/**
+ * Send parity for a partly filled FEC group once it has been open this long (ms)
+ */
+#define ZT_BOND_FEC_FLUSH_INTERVAL 20
+
+/**
+ * How often the capacity of each bonded path is probed when probing is enabled (ms)
+ */
+#define ZT_BOND_CAPACITY_PROBE_INTERVAL 30000
+
+/**
+ * Size of each packet in a capacity probe train, small enough to avoid fragmentation
+ */
+#define ZT_BOND_CAPACITY_PROBE_SIZE 1400
+
+/**
+ * Shortest and longest capacity probe trains (packets, at most 255)
+ */
+#define ZT_BOND_CAPACITY_PROBE_MIN_TRAIN 8
+#define ZT_BOND_CAPACITY_PROBE_MAX_TRAIN 64
+
+/**
+ * Shortest probe train dispersion taken as a measurement rather than a lower bound (ms)
+ *
+ * Arrival times only have millisecond resolution, so trains are lengthened
+ * until they take at least this long to arrive or reach the maximum length.
+ */
+#define ZT_BOND_CAPACITY_PROBE_MIN_DISPERSION 4
+
+/**
+ * How soon a path is probed again with a longer train after one arrived too quickly to time (ms)
+ */
+#define ZT_BOND_CAPACITY_PROBE_RETRY 1000
+
+/**
+ * Unanswered probe trains in a row after which a path is only probed every ZT_BOND_CAPACITY_PROBE_INTERVAL
+ */
+#define ZT_BOND_CAPACITY_PROBE_MAX_UNANSWERED 3
+
+/**
+ * Shortest allowed interval between liveness requests on a bonded path (ms)
+ */
+#define ZT_BOND_LIVENESS_MIN_INTERVAL 10
+
+/**
+ * Number of unanswered liveness intervals after which a path is declared down
+ */
+#define ZT_BOND_LIVENESS_DEFAULT_MULTIPLIER 3
+
+/**
+ * Traffic a paced path may send back to back after being idle (ms)
+ */
+#define ZT_BOND_PACING_BURST 5
+
+/**
+ * Traffic held for a paced path beyond which new frames are dropped (ms)
+ */
+#define ZT_BOND_PACING_MAX_DELAY 100
+
+/**
+ * How often frames held for paced paths are released (ms)
+ */
+#define ZT_BOND_PACING_INTERVAL 1
+
 /**
  * How often flows are rebalanced across link (if at all)
  */
@@ -451,6 +675,27 @@
  */
 #define ZT_FLOW_REBALANCE_INTERVAL 5000
 
+/**
+ * How often the rate of each flow is measured to find elephant flows (ms)
+ */
+#define ZT_FLOW_RATE_CHECK_INTERVAL 1000
+
+/**
+ * Outgoing rate at which a flow becomes an elephant and is placed by link capacity (kbit/s)
+ */
+#define ZT_FLOW_ELEPHANT_THRESHOLD 10000
+
+/**
+ * How much more room another path must offer before an elephant flow is moved to it
+ */
+#define ZT_FLOW_ELEPHANT_MIGRATION_GAIN 1.25f
+
+/**
+ * Latency difference by which a migrating flow may be reordered without waiting
+ * for it to go idle (ms)
+ */
+#define ZT_FLOW_MIGRATION_MAX_REORDER 5
+
 /**
  * A defensive timer to prevent path quality metrics from being
  * processed too often.
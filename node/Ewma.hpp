@@ -0,0 +1,113 @@
+/*
+ * Copyright (c)2013-2020 ZeroTier, Inc.
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file in the project's root directory.
+ *
+ * Change Date: 2025-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2.0 of the Apache License.
+ */
+/****/
+
+#ifndef ZT_EWMA_HPP
+#define ZT_EWMA_HPP
+
+#include <stdint.h>
+#include <math.h>
+
+namespace ZeroTier {
+
+/**
+ * Exponentially weighted mean and variance of a stream of samples
+ *
+ * Samples are folded in as they arrive so reading any statistic is O(1) and
+ * no history is kept. A smoothing factor of 2/(N+1) gives the mean about the
+ * same lag as a plain average of the last N samples. The first sample seeds
+ * the estimate so it does not start out biased toward zero.
+ *
+ * @tparam N Equivalent window size in samples
+ */
+template<unsigned int N>
+class Ewma
+{
+public:
+	Ewma() :
+		_mean(0.0f),
+		_variance(0.0f),
+		_peak(0.0f),
+		_count(0)
+	{
+	}
+
+	/**
+	 * @param x New sample
+	 */
+	inline void push(const float x)
+	{
+		if (!_count) {
+			_mean = x;
+			_variance = 0.0f;
+			_peak = x;
+		} else {
+			const float a = 2.0f / (float)(N + 1);
+			const float d = x - _mean;
+			_mean += a * d;
+			_variance = (1.0f - a) * (_variance + (a * d * d));
+			_peak -= a * (_peak - _mean);
+			if (x > _peak) {
+				_peak = x;
+			}
+		}
+		if (_count < N) {
+			++_count;
+		}
+	}
+
+	/**
+	 * Forget all samples
+	 */
+	inline void reset()
+	{
+		_mean = 0.0f;
+		_variance = 0.0f;
+		_peak = 0.0f;
+		_count = 0;
+	}
+
+	/**
+	 * @return Number of samples seen, saturating at N
+	 */
+	inline unsigned int count() const { return _count; }
+
+	/**
+	 * @return Weighted mean, or zero if there are no samples
+	 */
+	inline float mean() const { return _mean; }
+
+	/**
+	 * @return Weighted variance
+	 */
+	inline float variance() const { return _variance; }
+
+	/**
+	 * @return Weighted standard deviation
+	 */
+	inline float stddev() const { return sqrtf(_variance); }
+
+	/**
+	 * @return Largest recent sample, decaying toward the mean as newer samples arrive
+	 */
+	inline float peak() const { return _peak; }
+
+private:
+	float _mean;
+	float _variance;
+	float _peak;
+	unsigned int _count;
+};
+
+} // namespace ZeroTier
+
+#endif
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c)2013-2020 ZeroTier, Inc.
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file in the project's root directory.
+ *
+ * Change Date: 2025-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2.0 of the Apache License.
+ */
+/****/
+
+#ifndef ZT_FEC_HPP
+#define ZT_FEC_HPP
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "Constants.hpp"
+#include "Packet.hpp"
+
+/**
+ * Offset of the flags byte in an EXT_FRAME payload
+ */
+#define ZT_FEC_FLAGS_OFFSET (ZT_PROTO_VERB_EXT_FRAME_IDX_FLAGS - ZT_PACKET_IDX_PAYLOAD)
+
+/**
+ * Largest encoded frame: a 16-bit length and a payload without its FEC fields
+ */
+#define ZT_FEC_MAX_BLOCK (2 + ZT_PROTO_MAX_PACKET_LENGTH - ZT_PACKET_IDX_PAYLOAD)
+
+namespace ZeroTier {
+
+/**
+ * XOR parity over groups of EXT_FRAME payloads (see VERB_BOND_PARITY)
+ *
+ * A payload is passed with fecAt giving the offset of its FEC fields. The
+ * encoding XORed into parity leaves those fields out and clears their flag
+ * so that a rebuilt payload is an ordinary EXT_FRAME.
+ */
+class Fec
+{
+public:
+	/**
+	 * XOR the encoding of a payload into a block
+	 *
+	 * @param block Block of at least ZT_FEC_MAX_BLOCK bytes
+	 * @param payload EXT_FRAME payload
+	 * @param len Length of payload
+	 * @param fecAt Offset of FEC fields in payload
+	 * @return Length of encoding
+	 */
+	static inline unsigned int encode(uint8_t *block,const uint8_t *payload,const unsigned int len,const unsigned int fecAt)
+	{
+		const unsigned int plen = len - ZT_PROTO_VERB_EXT_FRAME_LEN_BOND_FEC;
+		block[0] ^= (uint8_t)(plen >> 8);
+		block[1] ^= (uint8_t)plen;
+		uint8_t *b = block + 2;
+		for(unsigned int i=0;i<fecAt;++i)
+			*(b++) ^= payload[i];
+		block[2 + ZT_FEC_FLAGS_OFFSET] ^= (payload[ZT_FEC_FLAGS_OFFSET] & 0x40);
+		for(unsigned int i=fecAt+ZT_PROTO_VERB_EXT_FRAME_LEN_BOND_FEC;i<len;++i)
+			*(b++) ^= payload[i];
+		return plen + 2;
+	}
+
+	/**
+	 * Sends parity after every groupSize frames
+	 */
+	class Encoder
+	{
+	public:
+		Encoder() :
+			_group(0),
+			_count(0),
+			_size(0),
+			_len(0),
+			_opened(0),
+			_block((uint8_t *)0)
+		{
+		}
+
+		~Encoder() { delete [] _block; }
+
+		/**
+		 * Add a frame to the current group and fill in its FEC fields
+		 *
+		 * @param outp EXT_FRAME with room for FEC fields
+		 * @param fecAt Offset of FEC fields in payload
+		 * @param groupSize Group size to use if this frame starts a group
+		 * @param now Current time
+		 * @return True if the group is now complete and parity() should be called
+		 */
+		inline bool add(Packet &outp,const unsigned int fecAt,const unsigned int groupSize,const int64_t now)
+		{
+			if (!_block)
+				_block = new uint8_t[ZT_FEC_MAX_BLOCK]();
+			if (!_count) {
+				_size = groupSize;
+				_opened = now;
+			}
+			outp.setAt<uint32_t>(ZT_PACKET_IDX_PAYLOAD + fecAt,_group);
+			outp.setAt<uint8_t>(ZT_PACKET_IDX_PAYLOAD + fecAt + 4,(uint8_t)_count);
+			const unsigned int l = encode(_block,reinterpret_cast<const uint8_t *>(outp.data()) + ZT_PACKET_IDX_PAYLOAD,outp.size() - ZT_PACKET_IDX_PAYLOAD,fecAt);
+			if (l > _len)
+				_len = l;
+			return (++_count >= _size);
+		}
+
+		/**
+		 * @return True if some frames have been sent without parity
+		 */
+		inline bool pending() const { return (_count != 0); }
+
+		/**
+		 * @return Time the current group got its first frame
+		 */
+		inline int64_t opened() const { return _opened; }
+
+		/**
+		 * Append the current group's parity to a BOND_PARITY packet and start a new group
+		 *
+		 * @param outp Packet to append to
+		 */
+		inline void parity(Packet &outp)
+		{
+			outp.append(_group);
+			outp.append((uint8_t)_count);
+			outp.append(_block,_len);
+			memset(_block,0,_len);
+			++_group;
+			_count = 0;
+			_len = 0;
+		}
+
+	private:
+		Encoder(const Encoder &) {}
+		const Encoder &operator=(const Encoder &) { return *this; }
+
+		uint32_t _group;
+		unsigned int _count;
+		unsigned int _size;
+		unsigned int _len;
+		int64_t _opened;
+		uint8_t *_block; // allocated when the first frame is sent
+	};
+
+	/**
+	 * Tracks recent groups and rebuilds a frame when parity and all others have arrived
+	 */
+	class Decoder
+	{
+	public:
+		struct Counters
+		{
+			uint64_t parity;     // parity packets received
+			uint64_t recovered;  // frames rebuilt from parity
+			uint64_t duplicates; // frames dropped because they had already been rebuilt
+		};
+
+		Decoder() :
+			_groups((_Group *)0)
+		{
+			memset(&_counters,0,sizeof(_counters));
+		}
+
+		~Decoder() { delete [] _groups; }
+
+		/**
+		 * Accept a received FEC-protected frame
+		 *
+		 * @param group Group from frame
+		 * @param index Index from frame
+		 * @param payload EXT_FRAME payload
+		 * @param len Length of payload
+		 * @param fecAt Offset of FEC fields in payload
+		 * @param out Buffer of ZT_FEC_MAX_BLOCK bytes to receive a rebuilt EXT_FRAME payload
+		 * @param outLen Set to length of rebuilt payload
+		 * @return -1 to drop frame as a duplicate, 0 to accept it, 1 to accept it and process out as well
+		 */
+		inline int frame(const uint32_t group,const unsigned int index,const uint8_t *payload,const unsigned int len,const unsigned int fecAt,uint8_t *out,unsigned int &outLen)
+		{
+			if ((index >= 32)||(len < (fecAt + ZT_PROTO_VERB_EXT_FRAME_LEN_BOND_FEC)))
+				return 0;
+			_Group *const g = _group(group);
+			if (!g)
+				return 0;
+			if ((g->received & (1U << index)) != 0) {
+				++_counters.duplicates;
+				return -1;
+			}
+			g->received |= (1U << index);
+			_grow(*g,len + 2);
+			encode(g->block.data(),payload,len,fecAt);
+			return _recover(*g,out,outLen);
+		}
+
+		/**
+		 * Accept a received parity packet
+		 *
+		 * @param group Group from parity packet
+		 * @param size Number of frames in group
+		 * @param data Parity data
+		 * @param len Length of parity data
+		 * @param out Buffer of ZT_FEC_MAX_BLOCK bytes to receive a rebuilt EXT_FRAME payload
+		 * @param outLen Set to length of rebuilt payload
+		 * @return 1 if out contains a rebuilt payload to process, otherwise 0
+		 */
+		inline int parity(const uint32_t group,const unsigned int size,const uint8_t *data,const unsigned int len,uint8_t *out,unsigned int &outLen)
+		{
+			if ((size == 0)||(size > 32)||(len > ZT_FEC_MAX_BLOCK))
+				return 0;
+			_Group *const g = _group(group);
+			if ((!g)||(g->size))
+				return 0;
+			++_counters.parity;
+			g->size = size;
+			_grow(*g,len);
+			uint8_t *const b = g->block.data();
+			for(unsigned int i=0;i<len;++i)
+				b[i] ^= data[i];
+			return _recover(*g,out,outLen);
+		}
+
+		inline const Counters &counters() const { return _counters; }
+
+	private:
+		Decoder(const Decoder &) {}
+		const Decoder &operator=(const Decoder &) { return *this; }
+
+		struct _Group
+		{
+			uint32_t id;
+			uint32_t received;
+			unsigned int size; // from parity, 0 until parity arrives
+			unsigned int len;  // bytes of block in use, the rest is zero
+			bool used;
+			std::vector<uint8_t> block;
+		};
+
+		static inline void _grow(_Group &g,const unsigned int len)
+		{
+			if (len > g.len) {
+				if (len > g.block.size())
+					g.block.resize(len,0);
+				g.len = len;
+			}
+		}
+
+		// Returns the slot for a group, recycling it if it belongs to an older group, or NULL if the group is too old
+		inline _Group *_group(const uint32_t group)
+		{
+			if (!_groups)
+				_groups = new _Group[ZT_BOND_FEC_DECODE_GROUPS]();
+			_Group &g = _groups[group % ZT_BOND_FEC_DECODE_GROUPS];
+			if ((!g.used)||(g.id != group)) {
+				if ((g.used)&&((int32_t)(group - g.id) < 0))
+					return (_Group *)0;
+				if (g.len)
+					memset(g.block.data(),0,g.len);
+				g.id = group;
+				g.received = 0;
+				g.size = 0;
+				g.len = 0;
+				g.used = true;
+			}
+			return &g;
+		}
+
+		inline int _recover(_Group &g,uint8_t *out,unsigned int &outLen)
+		{
+			if ((!g.size)||(g.len < 2))
+				return 0;
+			const uint32_t all = (g.size >= 32) ? 0xffffffffU : ((1U << g.size) - 1);
+			const uint32_t missing = all & ~g.received;
+			if ((!missing)||((missing & (missing - 1)) != 0))
+				return 0; // nothing or more than one frame missing
+			g.received |= missing;
+			const unsigned int plen = ((unsigned int)g.block[0] << 8) | (unsigned int)g.block[1];
+			if ((plen + 2 > g.len)||(plen + 2 > ZT_FEC_MAX_BLOCK)||(plen < (ZT_PROTO_VERB_EXT_FRAME_IDX_PAYLOAD - ZT_PACKET_IDX_PAYLOAD)))
+				return 0;
+			memcpy(out,g.block.data() + 2,plen);
+			outLen = plen;
+			++_counters.recovered;
+			return 1;
+		}
+
+		_Group *_groups; // allocated when the first FEC frame arrives
+		Counters _counters;
+	};
+};
+
+} // namespace ZeroTier
+
+#endif
@@ -107,6 +107,9 @@ bool IncomingPacket::tryDecode(const RuntimeEnvironment *RR,void *tPtr,int32_t f
 				case Packet::VERB_USER_MESSAGE:               r = _doUSER_MESSAGE(RR,tPtr,peer); break;
 				case Packet::VERB_REMOTE_TRACE:               r = _doREMOTE_TRACE(RR,tPtr,peer); break;
 				case Packet::VERB_PATH_NEGOTIATION_REQUEST:   r = _doPATH_NEGOTIATION_REQUEST(RR,tPtr,peer); break;
+				case Packet::VERB_BOND_PARITY:                r = _doBOND_PARITY(RR,tPtr,peer); break;
+				case Packet::VERB_BOND_PROBE:                 r = _doBOND_PROBE(RR,tPtr,peer); break;
+				case Packet::VERB_BOND_LIVENESS:              r = _doBOND_LIVENESS(RR,tPtr,peer); break;
 			}
 			if (r) {
 				RR->node->statsLogVerb((unsigned int)v,(unsigned int)size());
@@ -500,6 +503,7 @@ bool IncomingPacket::_doOK(const RuntimeEnvironment *RR,void *tPtr,const SharedP
 				SharedPtr<Bond> bond = peer->bond();
 				if (!bond) {
 					_path->updateLatency((unsigned int)latency,RR->node->now());
+					peer->pathSelectionChanged();
 				}
 			}
 
@@ -626,35 +630,6 @@ bool IncomingPacket::_doRENDEZVOUS(const RuntimeEnvironment *RR,void *tPtr,const
 	return true;
 }
 
-// Returns true if packet appears valid; pos and proto will be set
-static bool _ipv6GetPayload(const uint8_t *frameData,unsigned int frameLen,unsigned int &pos,unsigned int &proto)
-{
-	if (frameLen < 40)
-		return false;
-	pos = 40;
-	proto = frameData[6];
-	while (pos <= frameLen) {
-		switch(proto) {
-			case 0: // hop-by-hop options
-			case 43: // routing
-			case 60: // destination options
-			case 135: // mobility options
-				if ((pos + 8) > frameLen)
-					return false; // invalid!
-				proto = frameData[pos];
-				pos += ((unsigned int)frameData[pos + 1] * 8) + 8;
-				break;
-
-			//case 44: // fragment -- we currently can't parse these and they are deprecated in IPv6 anyway
-			//case 50:
-			//case 51: // IPSec ESP and AH -- we have to stop here since this is encrypted stuff
-			default:
-				return true;
-		}
-	}
-	return false; // overflow == invalid
-}
-
 bool IncomingPacket::_doFRAME(const RuntimeEnvironment *RR,void *tPtr,const SharedPtr<Peer> &peer,int32_t flowId)
 {
 	int32_t _flowId = ZT_QOS_NO_FLOW;
@@ -665,61 +640,7 @@ bool IncomingPacket::_doFRAME(const RuntimeEnvironment *RR,void *tPtr,const Shar
 			const unsigned int frameLen = size() - ZT_PROTO_VERB_FRAME_IDX_PAYLOAD;
 			const uint8_t *const frameData = reinterpret_cast<const uint8_t *>(data()) + ZT_PROTO_VERB_FRAME_IDX_PAYLOAD;
 
-			if (etherType == ZT_ETHERTYPE_IPV4 && (frameLen >= 20)) {
-				uint16_t srcPort = 0;
-				uint16_t dstPort = 0;
-				uint8_t proto = (reinterpret_cast<const uint8_t *>(frameData)[9]);
-				const unsigned int headerLen = 4 * (reinterpret_cast<const uint8_t *>(frameData)[0] & 0xf);
-				switch(proto) {
-					case 0x01: // ICMP
-						//flowId = 0x01;
-						break;
-					// All these start with 16-bit source and destination port in that order
-					case 0x06: // TCP
-					case 0x11: // UDP
-					case 0x84: // SCTP
-					case 0x88: // UDPLite
-						if (frameLen > (headerLen + 4)) {
-							unsigned int pos = headerLen + 0;
-							srcPort = (reinterpret_cast<const uint8_t *>(frameData)[pos++]) << 8;
-							srcPort |= (reinterpret_cast<const uint8_t *>(frameData)[pos]);
-							pos++;
-							dstPort = (reinterpret_cast<const uint8_t *>(frameData)[pos++]) << 8;
-							dstPort |= (reinterpret_cast<const uint8_t *>(frameData)[pos]);
-							_flowId = dstPort ^ srcPort ^ proto;
-						}
-						break;
-				}
-			}
-
-			if (etherType == ZT_ETHERTYPE_IPV6 && (frameLen >= 40)) {
-				uint16_t srcPort = 0;
-				uint16_t dstPort = 0;
-				unsigned int pos;
-				unsigned int proto;
-				_ipv6GetPayload((const uint8_t *)frameData, frameLen, pos, proto);
-				switch(proto) {
-					case 0x3A: // ICMPv6
-						//flowId = 0x3A;
-						break;
-					// All these start with 16-bit source and destination port in that order
-					case 0x06: // TCP
-					case 0x11: // UDP
-					case 0x84: // SCTP
-					case 0x88: // UDPLite
-						if (frameLen > (pos + 4)) {
-							srcPort = (reinterpret_cast<const uint8_t *>(frameData)[pos++]) << 8;
-							srcPort |= (reinterpret_cast<const uint8_t *>(frameData)[pos]);
-							pos++;
-							dstPort = (reinterpret_cast<const uint8_t *>(frameData)[pos++]) << 8;
-							dstPort |= (reinterpret_cast<const uint8_t *>(frameData)[pos]);
-							_flowId = dstPort ^ srcPort ^ proto;
-						}
-						break;
-					default:
-						break;
-				}
-			}
+			_flowId = Flow::hashFrame(etherType,frameData,frameLen);
 		}
 	}
 
@@ -754,7 +675,7 @@ bool IncomingPacket::_doEXT_FRAME(const RuntimeEnvironment *RR,void *tPtr,const
 	if (network) {
 		const unsigned int flags = (*this)[ZT_PROTO_VERB_EXT_FRAME_IDX_FLAGS];
 
-		unsigned int comLen = 0;
+		unsigned int comLen = 0; // length of optional fields before the MACs
 		if ((flags & 0x01) != 0) { // inline COM with EXT_FRAME is deprecated but still used with old peers
 			CertificateOfMembership com;
 			comLen = com.deserialize(*this,ZT_PROTO_VERB_EXT_FRAME_IDX_COM);
@@ -762,13 +683,51 @@ bool IncomingPacket::_doEXT_FRAME(const RuntimeEnvironment *RR,void *tPtr,const
 				network->addCredential(tPtr,com);
 		}
 
+		// Sequenced frames come from a bond that stripes flows and will be put back in order by ours
+		bool sequenced = false;
+		unsigned int seqStream = 0;
+		uint32_t seq = 0;
+		if ((flags & 0x20) != 0) {
+			sequenced = true;
+			seqStream = (*this)[comLen + ZT_PROTO_VERB_EXT_FRAME_IDX_BOND_SEQUENCE];
+			seq = at<uint32_t>(comLen + ZT_PROTO_VERB_EXT_FRAME_IDX_BOND_SEQUENCE + 1);
+			comLen += ZT_PROTO_VERB_EXT_FRAME_LEN_BOND_SEQUENCE;
+		}
+
+		// FEC-protected frames are grouped by a bond that follows each group with parity
+		bool fec = false;
+		uint32_t fecGroup = 0;
+		unsigned int fecIndex = 0;
+		const unsigned int fecAt = comLen + ZT_PROTO_VERB_EXT_FRAME_IDX_BOND_SEQUENCE - ZT_PACKET_IDX_PAYLOAD;
+		if ((flags & 0x40) != 0) {
+			fec = true;
+			fecGroup = at<uint32_t>(comLen + ZT_PROTO_VERB_EXT_FRAME_IDX_BOND_SEQUENCE);
+			fecIndex = (*this)[comLen + ZT_PROTO_VERB_EXT_FRAME_IDX_BOND_SEQUENCE + 4];
+			comLen += ZT_PROTO_VERB_EXT_FRAME_LEN_BOND_FEC;
+		}
+
 		if (!network->gate(tPtr,peer)) {
 			RR->t->incomingNetworkAccessDenied(tPtr,network,_path,packetId(),size(),peer->address(),Packet::VERB_EXT_FRAME,true);
 			_sendErrorNeedCredentials(RR,tPtr,peer,nwid);
 			return false;
 		}
 
-		if (size() > ZT_PROTO_VERB_EXT_FRAME_IDX_PAYLOAD) {
+		if ((fec)&&(size() > (comLen + ZT_PROTO_VERB_EXT_FRAME_IDX_PAYLOAD))) {
+			const SharedPtr<Bond> bond(peer->bond());
+			if (bond) {
+				uint8_t recovered[ZT_FEC_MAX_BLOCK];
+				unsigned int recoveredLen = 0;
+				const int r = bond->fecReceiveFrame(fecGroup,fecIndex,reinterpret_cast<const uint8_t *>(data()) + ZT_PACKET_IDX_PAYLOAD,size() - ZT_PACKET_IDX_PAYLOAD,fecAt,recovered,recoveredLen);
+				if (r < 0) { // already rebuilt from parity
+					peer->received(tPtr,_path,hops(),packetId(),payloadLength(),Packet::VERB_EXT_FRAME,0,Packet::VERB_NOP,true,nwid,flowId);
+					return true;
+				}
+				if (r > 0) // this frame completed a group whose parity is here, rebuild the one still missing
+					_doRecoveredEXT_FRAME(RR,tPtr,peer,recovered,recoveredLen);
+			}
+		}
+
+		if (size() > (comLen + ZT_PROTO_VERB_EXT_FRAME_IDX_PAYLOAD)) {
 			const unsigned int etherType = at<uint16_t>(comLen + ZT_PROTO_VERB_EXT_FRAME_IDX_ETHERTYPE);
 			const MAC to(field(comLen + ZT_PROTO_VERB_EXT_FRAME_IDX_TO,ZT_PROTO_VERB_EXT_FRAME_LEN_TO),ZT_PROTO_VERB_EXT_FRAME_LEN_TO);
 			const MAC from(field(comLen + ZT_PROTO_VERB_EXT_FRAME_IDX_FROM,ZT_PROTO_VERB_EXT_FRAME_LEN_FROM),ZT_PROTO_VERB_EXT_FRAME_LEN_FROM);
@@ -804,9 +763,16 @@ bool IncomingPacket::_doEXT_FRAME(const RuntimeEnvironment *RR,void *tPtr,const
 						}
 					}
 					// fall through -- 2 means accept regardless of bridging checks or other restrictions
-				case 2:
-					RR->node->putFrame(tPtr,nwid,network->userPtr(),from,to,etherType,0,(const void *)frameData,frameLen);
-					break;
+				case 2: {
+					SharedPtr<Bond> bond;
+					if (sequenced)
+						bond = peer->bond();
+					if (bond) {
+						bond->resequenceFrame(tPtr,seqStream,seq,nwid,from,to,etherType,(const void *)frameData,frameLen,RR->node->now());
+					} else {
+						RR->node->putFrame(tPtr,nwid,network->userPtr(),from,to,etherType,0,(const void *)frameData,frameLen);
+					}
+				}	break;
 			}
 		}
 
@@ -1134,6 +1100,30 @@ bool IncomingPacket::_doMULTICAST_FRAME(const RuntimeEnvironment *RR,void *tPtr,
 			from.fromAddress(peer->address(),nwid);
 		}
 
+		// Tree replicated multicasts carry their origin, the part the origin
+		// signed, the range of it we should replicate to, and the signature.
+		Address origin(peer->address());
+		unsigned int treeFanout = 0,treeCount = 0,treeStart = 0,treeEnd = 0,treeSignatureLen = 0;
+		uint64_t treeCounter = 0;
+		const uint8_t *treeMembers = (const uint8_t *)0;
+		const uint8_t *treeSignature = (const uint8_t *)0;
+		if ((flags & 0x10) != 0) {
+			origin.setTo(field(offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_TREE_ORIGIN,ZT_ADDRESS_LENGTH),ZT_ADDRESS_LENGTH);
+			treeFanout = (*this)[offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_TREE_ORIGIN + ZT_ADDRESS_LENGTH];
+			treeCounter = at<uint64_t>(offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_TREE_ORIGIN + ZT_ADDRESS_LENGTH + 1);
+			treeCount = at<uint16_t>(offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_TREE_ORIGIN + ZT_ADDRESS_LENGTH + 9);
+			offset += ZT_ADDRESS_LENGTH + 11;
+			treeMembers = (const uint8_t *)field(offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_TREE_ORIGIN,treeCount * ZT_ADDRESS_LENGTH);
+			offset += treeCount * ZT_ADDRESS_LENGTH;
+			treeStart = at<uint16_t>(offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_TREE_ORIGIN);
+			treeEnd = at<uint16_t>(offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_TREE_ORIGIN + 2);
+			offset += 4;
+			treeSignatureLen = at<uint16_t>(offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_TREE_ORIGIN);
+			offset += 2;
+			treeSignature = (const uint8_t *)field(offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_TREE_ORIGIN,treeSignatureLen);
+			offset += treeSignatureLen;
+		}
+
 		const MulticastGroup to(MAC(field(offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_DEST_MAC,6),6),at<uint32_t>(offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_DEST_ADI));
 		const unsigned int etherType = at<uint16_t>(offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_ETHERTYPE);
 		const unsigned int frameLen = size() - (offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_FRAME);
@@ -1158,12 +1148,55 @@ bool IncomingPacket::_doMULTICAST_FRAME(const RuntimeEnvironment *RR,void *tPtr,
 
 			const uint8_t *const frameData = (const uint8_t *)field(offset + ZT_PROTO_VERB_MULTICAST_FRAME_IDX_FRAME,frameLen);
 
+			SharedPtr<Peer> originPeer(peer);
+			if ((flags & 0x10) != 0) {
+				if ((!network->config().multicastTree())||((flags & 0x04) == 0)||(!origin)||(origin == RR->identity.address())||(treeStart == 0)||(treeStart > treeEnd)||(treeEnd > treeCount)||(Address(treeMembers + ((treeStart - 1) * ZT_ADDRESS_LENGTH),ZT_ADDRESS_LENGTH) != RR->identity.address())) {
+					RR->t->incomingNetworkFrameDropped(tPtr,network,_path,packetId(),size(),peer->address(),Packet::VERB_MULTICAST_FRAME,from,to.mac(),"unexpected multicast tree frame");
+					peer->received(tPtr,_path,hops(),packetId(),payloadLength(),Packet::VERB_MULTICAST_FRAME,0,Packet::VERB_NOP,true,nwid,ZT_QOS_NO_FLOW);
+					return true;
+				}
+				if (origin != peer->address()) {
+					originPeer = RR->topology->getPeer(tPtr,origin);
+					if (!originPeer) {
+						RR->sw->requestWhois(tPtr,RR->node->now(),origin);
+						peer->received(tPtr,_path,hops(),packetId(),payloadLength(),Packet::VERB_MULTICAST_FRAME,0,Packet::VERB_NOP,true,nwid,ZT_QOS_NO_FLOW);
+						return true;
+					}
+				}
+				Buffer<ZT_PROTO_MAX_PACKET_LENGTH> signedPortion;
+				Multicaster::treeSignatureInput(signedPortion,nwid,from,to,etherType,treeFanout,treeCounter,treeMembers,treeCount,frameData,frameLen);
+				if (!originPeer->identity().verify(signedPortion.data(),signedPortion.size(),treeSignature,treeSignatureLen)) {
+					RR->t->incomingPacketInvalid(tPtr,_path,packetId(),source(),hops(),Packet::VERB_MULTICAST_FRAME,"multicast tree signature invalid");
+					peer->received(tPtr,_path,hops(),packetId(),payloadLength(),Packet::VERB_MULTICAST_FRAME,0,Packet::VERB_NOP,true,nwid,ZT_QOS_NO_FLOW);
+					return true;
+				}
+				// The forwarder was gated above, but the frame is delivered as the origin's,
+				// so the origin must be a member too or a revoked member could get frames
+				// onto the network through anyone still authorized.
+				if ((originPeer != peer)&&(!network->gate(tPtr,originPeer))) {
+					RR->t->incomingNetworkFrameDropped(tPtr,network,_path,packetId(),size(),peer->address(),Packet::VERB_MULTICAST_FRAME,from,to.mac(),"multicast tree origin not a member");
+					Packet outp(origin,RR->identity.address(),Packet::VERB_ERROR);
+					outp.append((uint8_t)Packet::VERB_MULTICAST_FRAME);
+					outp.append((uint64_t)0);
+					outp.append((uint8_t)Packet::ERROR_NEED_MEMBERSHIP_CERTIFICATE);
+					outp.append(nwid);
+					RR->sw->send(tPtr,outp,true,ZT_QOS_NO_FLOW);
+					peer->received(tPtr,_path,hops(),packetId(),payloadLength(),Packet::VERB_MULTICAST_FRAME,0,Packet::VERB_NOP,true,nwid,ZT_QOS_NO_FLOW);
+					return true;
+				}
+				if (!RR->mc->treeCheckReplay(origin,treeCounter,RR->node->now())) {
+					RR->t->incomingNetworkFrameDropped(tPtr,network,_path,packetId(),size(),peer->address(),Packet::VERB_MULTICAST_FRAME,from,to.mac(),"multicast tree frame replayed");
+					peer->received(tPtr,_path,hops(),packetId(),payloadLength(),Packet::VERB_MULTICAST_FRAME,0,Packet::VERB_NOP,true,nwid,ZT_QOS_NO_FLOW);
+					return true;
+				}
+			}
+
 			if ((flags & 0x08)&&(network->config().isMulticastReplicator(RR->identity.address())))
 				RR->mc->send(tPtr,RR->node->now(),network,peer->address(),to,from,etherType,frameData,frameLen);
 
-			if (from != MAC(peer->address(),nwid)) {
-				if (network->config().permitsBridging(peer->address())) {
-					network->learnBridgeRoute(from,peer->address());
+			if (from != MAC(origin,nwid)) {
+				if (network->config().permitsBridging(origin)) {
+					network->learnBridgeRoute(from,origin);
 				} else {
 					RR->t->incomingNetworkFrameDropped(tPtr,network,_path,packetId(),size(),peer->address(),Packet::VERB_MULTICAST_FRAME,from,to.mac(),"bridging not allowed (remote)");
 					peer->received(tPtr,_path,hops(),packetId(),payloadLength(),Packet::VERB_MULTICAST_FRAME,0,Packet::VERB_NOP,true,nwid,ZT_QOS_NO_FLOW); // trustEstablished because COM is okay
@@ -1171,8 +1204,12 @@ bool IncomingPacket::_doMULTICAST_FRAME(const RuntimeEnvironment *RR,void *tPtr,
 				}
 			}
 
-			if (network->filterIncomingPacket(tPtr,peer,RR->identity.address(),from,to.mac(),frameData,frameLen,etherType,0) > 0)
+			// Frames our rules reject are neither delivered nor replicated onward
+			if (network->filterIncomingPacket(tPtr,originPeer,RR->identity.address(),from,to.mac(),frameData,frameLen,etherType,0) > 0) {
+				if (treeEnd > treeStart)
+					RR->mc->replicate(tPtr,RR->node->now(),network,origin,to,from,etherType,frameData,frameLen,treeFanout,treeCounter,treeMembers,treeCount,treeStart,treeEnd,treeSignature,treeSignatureLen);
 				RR->node->putFrame(tPtr,nwid,network->userPtr(),from,to.mac(),etherType,0,(const void *)frameData,frameLen);
+			}
 		}
 
 		if (gatherLimit) {
@@ -1320,6 +1357,67 @@ bool IncomingPacket::_doPATH_NEGOTIATION_REQUEST(const RuntimeEnvironment *RR,vo
 	return true;
 }
 
+bool IncomingPacket::_doBOND_PARITY(const RuntimeEnvironment *RR,void *tPtr,const SharedPtr<Peer> &peer)
+{
+	if (size() > (ZT_PACKET_IDX_PAYLOAD + 5)) {
+		const SharedPtr<Bond> bond(peer->bond());
+		if (bond) {
+			uint8_t recovered[ZT_FEC_MAX_BLOCK];
+			unsigned int recoveredLen = 0;
+			const unsigned int parityLen = size() - (ZT_PACKET_IDX_PAYLOAD + 5);
+			if (bond->fecReceiveParity(at<uint32_t>(ZT_PACKET_IDX_PAYLOAD),(*this)[ZT_PACKET_IDX_PAYLOAD + 4],reinterpret_cast<const uint8_t *>(field(ZT_PACKET_IDX_PAYLOAD + 5,parityLen)),parityLen,recovered,recoveredLen) > 0)
+				_doRecoveredEXT_FRAME(RR,tPtr,peer,recovered,recoveredLen);
+		}
+	}
+	peer->received(tPtr,_path,hops(),packetId(),payloadLength(),Packet::VERB_BOND_PARITY,0,Packet::VERB_NOP,false,0,ZT_QOS_NO_FLOW);
+	return true;
+}
+
+bool IncomingPacket::_doBOND_PROBE(const RuntimeEnvironment *RR,void *tPtr,const SharedPtr<Peer> &peer)
+{
+	const SharedPtr<Bond> bond(peer->bond());
+	if ((bond)&&(size() >= (ZT_PACKET_IDX_PAYLOAD + 5))) {
+		const uint16_t train = at<uint16_t>(ZT_PACKET_IDX_PAYLOAD + 1);
+		if ((*this)[ZT_PACKET_IDX_PAYLOAD] == 0) {
+			bond->receivedProbe(tPtr,_path,RR->node->now(),train,(*this)[ZT_PACKET_IDX_PAYLOAD + 3],(*this)[ZT_PACKET_IDX_PAYLOAD + 4],size());
+		} else if (((*this)[ZT_PACKET_IDX_PAYLOAD] == 1)&&(size() >= (ZT_PACKET_IDX_PAYLOAD + 11))) {
+			bond->receivedProbeReport(_path,RR->node->now(),train,at<uint32_t>(ZT_PACKET_IDX_PAYLOAD + 3),at<uint32_t>(ZT_PACKET_IDX_PAYLOAD + 7));
+		}
+	}
+	peer->received(tPtr,_path,hops(),packetId(),payloadLength(),Packet::VERB_BOND_PROBE,0,Packet::VERB_NOP,false,0,ZT_QOS_NO_FLOW);
+	return true;
+}
+
+bool IncomingPacket::_doBOND_LIVENESS(const RuntimeEnvironment *RR,void *tPtr,const SharedPtr<Peer> &peer)
+{
+	if (size() >= (ZT_PACKET_IDX_PAYLOAD + 9)) {
+		const int64_t now = RR->node->now();
+		if ((*this)[ZT_PACKET_IDX_PAYLOAD] == 0) {
+			// Answer at once and on the same path so the sender can time it
+			Packet outp(peer->address(),RR->identity.address(),Packet::VERB_BOND_LIVENESS);
+			outp.append((uint8_t)1);
+			outp.append(at<uint64_t>(ZT_PACKET_IDX_PAYLOAD + 1));
+			outp.armor(peer->key(),false,peer->aesKeysIfSupported());
+			_path->send(RR,tPtr,outp.data(),outp.size(),now);
+		} else {
+			const SharedPtr<Bond> bond(peer->bond());
+			if (bond)
+				bond->receivedLivenessReply(tPtr,_path,now,(int64_t)at<uint64_t>(ZT_PACKET_IDX_PAYLOAD + 1));
+		}
+	}
+	peer->received(tPtr,_path,hops(),packetId(),payloadLength(),Packet::VERB_BOND_LIVENESS,0,Packet::VERB_NOP,false,0,ZT_QOS_NO_FLOW);
+	return true;
+}
+
+void IncomingPacket::_doRecoveredEXT_FRAME(const RuntimeEnvironment *RR,void *tPtr,const SharedPtr<Peer> &peer,const uint8_t *payload,unsigned int len)
+{
+	// Rebuilt from authenticated packets, so it is handled as if it had arrived with this packet's header
+	IncomingPacket rp(data(),ZT_PACKET_IDX_PAYLOAD,_path,_receiveTime);
+	rp.setVerb(Packet::VERB_EXT_FRAME);
+	rp.append(payload,len);
+	rp._doEXT_FRAME(RR,tPtr,peer,ZT_QOS_NO_FLOW);
+}
+
 void IncomingPacket::_sendErrorNeedCredentials(const RuntimeEnvironment *RR,void *tPtr,const SharedPtr<Peer> &peer,const uint64_t nwid)
 {
 	Packet outp(source(),RR->identity.address(),Packet::VERB_ERROR);
@@ -29,7 +29,9 @@ namespace ZeroTier {
 
 Multicaster::Multicaster(const RuntimeEnvironment *renv) :
 	RR(renv),
-	_groups(32)
+	_groups(32),
+	_treeCounter(0),
+	_treeReplay(32)
 {
 }
 
@@ -226,6 +228,11 @@ void Multicaster::send(
 		const unsigned int activeBridgeCount = network->config().activeBridges(activeBridges);
 		const unsigned int limit = network->config().multicastLimit;
 
+		// In tree mode members are collected here and replicated to by the tree
+		// after bridges (which must always be sent to directly) are handled.
+		const bool tree = ((!origin)&&(network->config().multicastTree()));
+		std::vector<Address> treeMembers;
+
 		if (gs.members.size() >= limit) {
 			// Skip queue if we already have enough members to complete the send operation
 			OutboundMulticast out;
@@ -257,10 +264,19 @@ void Multicaster::send(
 			while ((count < limit)&&(idx < gs.members.size())) {
 				const Address ma(gs.members[indexes[idx++]].address);
 				if ((std::find(activeBridges,activeBridges + activeBridgeCount,ma) == (activeBridges + activeBridgeCount))&&(ma != origin)) {
-					out.sendOnly(RR,tPtr,ma); // optimization: don't use dedup log if it's a one-pass send
+					if (tree)
+						treeMembers.push_back(ma);
+					else out.sendOnly(RR,tPtr,ma); // optimization: don't use dedup log if it's a one-pass send
 					++count;
 				}
 			}
+
+			if (tree) {
+				std::vector<Address> direct;
+				_originateTree(tPtr,now,network,mg,src,etherType,data,len,treeMembers,direct);
+				for(std::vector<Address>::const_iterator ma(direct.begin());ma!=direct.end();++ma)
+					out.sendOnly(RR,tPtr,*ma);
+			}
 		} else {
 			while (gs.txQueue.size() >= ZT_TX_QUEUE_SIZE) {
 				gs.txQueue.pop_front();
@@ -356,10 +372,23 @@ void Multicaster::send(
 			while ((count < limit)&&(idx < gs.members.size())) {
 				Address ma(gs.members[indexes[idx++]].address);
 				if (std::find(activeBridges,activeBridges + activeBridgeCount,ma) == (activeBridges + activeBridgeCount)) {
-					out.sendAndLog(RR,tPtr,ma);
+					if (tree)
+						treeMembers.push_back(ma);
+					else out.sendAndLog(RR,tPtr,ma);
 					++count;
 				}
 			}
+
+			if (tree) {
+				// Members reached by the tree are logged so later gather results
+				// only cause sends to newly discovered members.
+				std::vector<Address> direct;
+				_originateTree(tPtr,now,network,mg,src,etherType,data,len,treeMembers,direct);
+				for(std::vector<Address>::const_iterator ma(treeMembers.begin());ma!=treeMembers.end();++ma)
+					out.logAsSent(*ma);
+				for(std::vector<Address>::const_iterator ma(direct.begin());ma!=direct.end();++ma)
+					out.sendAndLog(RR,tPtr,*ma);
+			}
 		}
 	} catch ( ... ) {} // this is a sanity check to catch any failures and make sure indexes[] still gets deleted
 
@@ -368,6 +397,73 @@ void Multicaster::send(
 		delete [] indexes;
 }
 
+void Multicaster::replicate(
+	void *tPtr,
+	int64_t now,
+	const SharedPtr<Network> &network,
+	const Address &origin,
+	const MulticastGroup &mg,
+	const MAC &src,
+	unsigned int etherType,
+	const void *data,
+	unsigned int len,
+	unsigned int fanout,
+	uint64_t counter,
+	const uint8_t *part,
+	unsigned int partCount,
+	unsigned int start,
+	unsigned int end,
+	const void *signature,
+	unsigned int signatureLen)
+{
+	if ((start >= end)||(end > partCount))
+		return;
+	if (fanout < 2)
+		fanout = 2;
+	else if (fanout > ZT_MULTICAST_TREE_MAX_FANOUT)
+		fanout = ZT_MULTICAST_TREE_MAX_FANOUT;
+
+	// Pieces only ever shrink below the part the origin fit in one packet
+	const unsigned int count = end - start;
+	const unsigned int chunk = treeChunkSize(count,fanout,count);
+	for(unsigned int i=start;i<end;i+=chunk)
+		_sendTree(tPtr,now,network,origin,mg,src,etherType,data,len,fanout,counter,part,partCount,i,std::min(i + chunk,end),signature,signatureLen);
+}
+
+bool Multicaster::treeCheckReplay(const Address &origin,uint64_t counter,int64_t now)
+{
+	Mutex::Lock _l(_treeReplay_m);
+	TreeReplayWindow &w = _treeReplay[origin];
+	if (counter > w.highest) {
+		const uint64_t shift = counter - w.highest;
+		w.seen = (shift < 64) ? ((w.seen << shift) | 1ULL) : 1ULL;
+		w.highest = counter;
+	} else {
+		const uint64_t age = w.highest - counter;
+		if ((age >= 64)||((w.seen & (1ULL << age)) != 0))
+			return false;
+		w.seen |= 1ULL << age;
+	}
+	w.timestamp = now;
+	return true;
+}
+
+void Multicaster::treeOrder(const MulticastGroup &mg,Address *members,unsigned int count)
+{
+	const uint64_t g = mg.mac().toInt() ^ ((uint64_t)mg.adi() << 16);
+	std::vector< std::pair<uint64_t,uint64_t> > keyed(count);
+	for(unsigned int i=0;i<count;++i) {
+		const uint64_t a = members[i].toInt();
+		uint64_t h = (a ^ g) * 0x9e3779b97f4a7c15ULL;
+		h ^= h >> 29;
+		keyed[i].first = h;
+		keyed[i].second = a;
+	}
+	std::sort(keyed.begin(),keyed.end());
+	for(unsigned int i=0;i<count;++i)
+		members[i] = keyed[i].second;
+}
+
 void Multicaster::clean(int64_t now)
 {
 	Mutex::Lock _l(_groups_m);
@@ -403,6 +499,103 @@ void Multicaster::clean(int64_t now)
 			s->members.clear();
 		}
 	}
+
+	Mutex::Lock _l2(_treeReplay_m);
+	Address *a = (Address *)0;
+	TreeReplayWindow *w = (TreeReplayWindow *)0;
+	Hashtable<Address,TreeReplayWindow>::Iterator rw(_treeReplay);
+	while (rw.next(a,w)) {
+		if ((now - w->timestamp) >= ZT_MULTICAST_LIKE_EXPIRE)
+			_treeReplay.erase(*a);
+	}
+}
+
+void Multicaster::_originateTree(void *tPtr,int64_t now,const SharedPtr<Network> &network,const MulticastGroup &mg,const MAC &src,unsigned int etherType,const void *data,unsigned int len,std::vector<Address> &members,std::vector<Address> &direct)
+{
+	// Peers too old to understand tree frames (or not yet known) are sent to directly
+	std::vector<Address> capable;
+	for(std::vector<Address>::const_iterator ma(members.begin());ma!=members.end();++ma) {
+		const SharedPtr<Peer> p(RR->topology->getPeer(tPtr,*ma));
+		if ((p)&&(p->remoteVersionProtocol() >= 13))
+			capable.push_back(*ma);
+		else direct.push_back(*ma);
+	}
+	const unsigned int maxPart = treeMaxPart(ZT_C25519_SIGNATURE_LEN,len);
+	if ((capable.size() < ZT_MULTICAST_TREE_MIN_MEMBERS)||(maxPart < 2)) {
+		direct.insert(direct.end(),capable.begin(),capable.end());
+		members.clear();
+		return;
+	}
+	members.swap(capable);
+
+	treeOrder(mg,&(members[0]),(unsigned int)members.size());
+	std::vector<uint8_t> raw(members.size() * ZT_ADDRESS_LENGTH);
+	for(unsigned long i=0;i<members.size();++i)
+		members[i].copyTo(&(raw[i * ZT_ADDRESS_LENGTH]),ZT_ADDRESS_LENGTH);
+
+	// The counter starts from the clock so it keeps increasing across restarts
+	if (!_treeCounter)
+		_treeCounter = (uint64_t)now << 16;
+	const uint64_t counter = ++_treeCounter;
+
+	// Each part is signed on its own so it fits in one packet along with the frame
+	const MAC from((src) ? src : MAC(RR->identity.address(),network->id()));
+	const unsigned int count = (unsigned int)members.size();
+	const unsigned int chunk = treeChunkSize(count,ZT_MULTICAST_TREE_FANOUT,maxPart - 1);
+	for(unsigned int start=0;start<count;start+=chunk) {
+		const uint8_t *const part = &(raw[start * ZT_ADDRESS_LENGTH]);
+		const unsigned int partCount = std::min(start + chunk,count) - start;
+		Buffer<ZT_PROTO_MAX_PACKET_LENGTH> signedPortion;
+		treeSignatureInput(signedPortion,network->id(),from,mg,etherType,ZT_MULTICAST_TREE_FANOUT,counter,part,partCount,data,len);
+		const C25519::Signature sig(RR->identity.sign(signedPortion.data(),signedPortion.size()));
+		_sendTree(tPtr,now,network,RR->identity.address(),mg,from,etherType,data,len,ZT_MULTICAST_TREE_FANOUT,counter,part,partCount,0,partCount,sig.data,ZT_C25519_SIGNATURE_LEN);
+	}
+}
+
+bool Multicaster::_sendTree(void *tPtr,int64_t now,const SharedPtr<Network> &network,const Address &origin,const MulticastGroup &mg,const MAC &src,unsigned int etherType,const void *data,unsigned int len,unsigned int fanout,uint64_t counter,const uint8_t *part,unsigned int partCount,unsigned int start,unsigned int end,const void *signature,unsigned int signatureLen)
+{
+	// The first member of this piece that our rules allow sending to and
+	// that speaks the tree protocol becomes the child, so one filtered
+	// member doesn't orphan a subtree.
+	Address child;
+	unsigned int i = start;
+	while (i < end) {
+		child.setTo(part + (i++ * ZT_ADDRESS_LENGTH),ZT_ADDRESS_LENGTH);
+		uint8_t qosBucket = 255; // Dummy value
+		if ((child != RR->identity.address())&&(network->filterOutgoingPacket(tPtr,true,RR->identity.address(),child,src,mg.mac(),(const uint8_t *)data,len,etherType,0,qosBucket))) {
+			const SharedPtr<Peer> p(RR->topology->getPeer(tPtr,child));
+			if ((!p)||(p->remoteVersionProtocol() >= 13))
+				break;
+		}
+		child.zero();
+	}
+	if (!child)
+		return false;
+
+	network->pushCredentialsIfNeeded(tPtr,child,now);
+
+	Packet outp(child,RR->identity.address(),Packet::VERB_MULTICAST_FRAME);
+	outp.append((uint64_t)network->id());
+	outp.append((uint8_t)0x14); // includes source MAC | tree replication
+	src.appendTo(outp);
+	origin.appendTo(outp);
+	outp.append((uint8_t)fanout);
+	outp.append(counter);
+	outp.append((uint16_t)partCount);
+	outp.append(part,partCount * ZT_ADDRESS_LENGTH);
+	outp.append((uint16_t)i);
+	outp.append((uint16_t)end);
+	outp.append((uint16_t)signatureLen);
+	outp.append(signature,signatureLen);
+	mg.mac().appendTo(outp);
+	outp.append((uint32_t)mg.adi());
+	outp.append((uint16_t)etherType);
+	outp.append(data,len);
+	if (!network->config().disableCompression())
+		outp.compress();
+	RR->node->expectReplyTo(outp.packetId());
+	RR->sw->send(tPtr,outp,true);
+	return true;
 }
 
 void Multicaster::_add(void *tPtr,int64_t now,uint64_t nwid,const MulticastGroup &mg,MulticastGroupStatus &gs,const Address &member)
@@ -137,6 +137,137 @@ public:
 		const void *data,
 		unsigned int len);
 
+	/**
+	 * Replicate a multicast to a subtree of members (tree replication mode)
+	 *
+	 * The subtree is the range [start,end) of a part signed by the origin. It
+	 * is split into at most fanout contiguous pieces and the first member of
+	 * each piece is sent the frame along with the rest of its piece as its
+	 * own subtree.
+	 *
+	 * @param tPtr Thread pointer to be handed through to any callbacks called as a result of this call
+	 * @param now Current time
+	 * @param network Network
+	 * @param origin Node that originated and signed this multicast
+	 * @param mg Multicast group
+	 * @param src Source Ethernet MAC address
+	 * @param etherType Ethernet frame type
+	 * @param data Packet data
+	 * @param len Length of packet data
+	 * @param fanout Maximum number of children
+	 * @param counter Origin's tree counter for this multicast
+	 * @param part Signed part members in tree order as a series of 5-byte addresses
+	 * @param partCount Number of members in signed part
+	 * @param start Index of first subtree member within part
+	 * @param end Index after last subtree member within part
+	 * @param signature Origin's signature (see treeSignatureInput())
+	 * @param signatureLen Length of signature in bytes
+	 */
+	void replicate(
+		void *tPtr,
+		int64_t now,
+		const SharedPtr<Network> &network,
+		const Address &origin,
+		const MulticastGroup &mg,
+		const MAC &src,
+		unsigned int etherType,
+		const void *data,
+		unsigned int len,
+		unsigned int fanout,
+		uint64_t counter,
+		const uint8_t *part,
+		unsigned int partCount,
+		unsigned int start,
+		unsigned int end,
+		const void *signature,
+		unsigned int signatureLen);
+
+	/**
+	 * Check a tree multicast's counter against those recently seen from its origin
+	 *
+	 * Counters may arrive somewhat out of order since each multicast takes
+	 * a different path through the tree, so the last 64 are remembered.
+	 *
+	 * @param origin Node that originated the multicast
+	 * @param counter Origin's tree counter (already verified by signature)
+	 * @param now Current time
+	 * @return True if counter is new, false if it's a replay or too old
+	 */
+	bool treeCheckReplay(const Address &origin,uint64_t counter,int64_t now);
+
+	/**
+	 * Sort members into tree order for a multicast group
+	 *
+	 * The order is a deterministic function of the group and member list,
+	 * so different groups spread replication work over different members.
+	 *
+	 * @param mg Multicast group
+	 * @param members Members to sort in place
+	 * @param count Number of members
+	 */
+	static void treeOrder(const MulticastGroup &mg,Address *members,unsigned int count);
+
+	/**
+	 * Compute how many members each child's part of a subtree contains
+	 *
+	 * @param count Number of members in subtree
+	 * @param fanout Desired maximum number of children
+	 * @param maxSubtree Maximum number of subtree members that fit in a packet to a child
+	 * @return Members per part (child plus its subtree), the last part may be smaller
+	 */
+	static inline unsigned int treeChunkSize(unsigned int count,unsigned int fanout,unsigned int maxSubtree)
+	{
+		if (!fanout)
+			fanout = 1;
+		unsigned int chunk = (count / fanout) + (((count % fanout) != 0) ? 1 : 0);
+		if (chunk > (maxSubtree + 1))
+			chunk = maxSubtree + 1;
+		return (chunk) ? chunk : 1;
+	}
+
+	/**
+	 * Compute the largest signed part that fits in one tree MULTICAST_FRAME
+	 *
+	 * @param signatureLen Length of origin signature in bytes
+	 * @param len Length of packet data
+	 * @return Maximum number of part members or 0 if frame is too large for tree mode
+	 */
+	static inline unsigned int treeMaxPart(unsigned int signatureLen,unsigned int len)
+	{
+		// Everything in a tree MULTICAST_FRAME except the part member addresses
+		const unsigned int overhead = ZT_PROTO_VERB_MULTICAST_FRAME_IDX_FRAME + 6 + ZT_ADDRESS_LENGTH + 1 + 8 + 2 + 2 + 2 + 2 + signatureLen + len;
+		return (overhead < ZT_PROTO_MAX_PACKET_LENGTH) ? ((ZT_PROTO_MAX_PACKET_LENGTH - overhead) / ZT_ADDRESS_LENGTH) : 0;
+	}
+
+	/**
+	 * Compose the data a tree multicast's origin signs for one part
+	 *
+	 * @param b Buffer to append to
+	 * @param nwid Network ID
+	 * @param src Source Ethernet MAC address
+	 * @param mg Multicast group
+	 * @param etherType Ethernet frame type
+	 * @param fanout Fan-out chosen by origin
+	 * @param counter Origin's tree counter for this multicast
+	 * @param part Part members as a series of 5-byte addresses
+	 * @param partCount Number of members in part
+	 * @param data Packet data
+	 * @param len Length of packet data
+	 */
+	static inline void treeSignatureInput(Buffer<ZT_PROTO_MAX_PACKET_LENGTH> &b,uint64_t nwid,const MAC &src,const MulticastGroup &mg,unsigned int etherType,unsigned int fanout,uint64_t counter,const uint8_t *part,unsigned int partCount,const void *data,unsigned int len)
+	{
+		b.append(nwid);
+		src.appendTo(b);
+		mg.mac().appendTo(b);
+		b.append((uint32_t)mg.adi());
+		b.append((uint16_t)etherType);
+		b.append((uint8_t)fanout);
+		b.append(counter);
+		b.append((uint16_t)partCount);
+		b.append(part,partCount * ZT_ADDRESS_LENGTH);
+		b.append(data,len);
+	}
+
 	/**
 	 * Clean database
 	 *
@@ -184,12 +315,27 @@ private:
 		std::vector<MulticastGroupMember> members; // members of this group
 	};
 
+	struct TreeReplayWindow
+	{
+		TreeReplayWindow() : highest(0),seen(0),timestamp(0) {}
+
+		uint64_t highest; // highest counter seen
+		uint64_t seen; // bit N set if (highest - N) has been seen
+		int64_t timestamp; // time of last accepted counter
+	};
+
+	void _originateTree(void *tPtr,int64_t now,const SharedPtr<Network> &network,const MulticastGroup &mg,const MAC &src,unsigned int etherType,const void *data,unsigned int len,std::vector<Address> &members,std::vector<Address> &direct);
+	bool _sendTree(void *tPtr,int64_t now,const SharedPtr<Network> &network,const Address &origin,const MulticastGroup &mg,const MAC &src,unsigned int etherType,const void *data,unsigned int len,unsigned int fanout,uint64_t counter,const uint8_t *part,unsigned int partCount,unsigned int start,unsigned int end,const void *signature,unsigned int signatureLen);
 	void _add(void *tPtr,int64_t now,uint64_t nwid,const MulticastGroup &mg,MulticastGroupStatus &gs,const Address &member);
 
 	const RuntimeEnvironment *const RR;
 
 	Hashtable<Multicaster::Key,MulticastGroupStatus> _groups;
 	Mutex _groups_m;
+
+	uint64_t _treeCounter; // guarded by _groups_m
+	Hashtable<Address,TreeReplayWindow> _treeReplay;
+	Mutex _treeReplay_m;
 };
 
 } // namespace ZeroTier
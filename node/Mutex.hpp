@@ -45,6 +45,12 @@ public:
 		}
 	}
 
+	inline bool tryLock() const
+	{
+		const uint16_t serving = nowServing;
+		return __sync_bool_compare_and_swap(&(const_cast<Mutex *>(this)->nextTicket),serving,(uint16_t)(serving + 1));
+	}
+
 	inline void unlock() const
 	{
 		++(const_cast<Mutex *>(this)->nowServing);
@@ -106,6 +112,11 @@ public:
 		pthread_mutex_lock(&((const_cast <Mutex *> (this))->_mh));
 	}
 
+	inline bool tryLock() const
+	{
+		return (pthread_mutex_trylock(&((const_cast <Mutex *> (this))->_mh)) == 0);
+	}
+
 	inline void unlock() const
 	{
 		pthread_mutex_unlock(&((const_cast <Mutex *> (this))->_mh));
@@ -184,6 +195,11 @@ public:
 		(const_cast <Mutex *> (this))->lock();
 	}
 
+	inline bool tryLock() const
+	{
+		return (TryEnterCriticalSection(&((const_cast <Mutex *> (this))->_cs)) != FALSE);
+	}
+
 	inline void unlock() const
 	{
 		(const_cast <Mutex *> (this))->unlock();
@@ -280,7 +280,7 @@ public:
 	/**
 	 * @return True if QoS is in effect for this network
 	 */
-	inline bool qosEnabled() { return false; }
+	inline bool qosEnabled() const { return _config.qos(); }
 
 	/**
 	 * Set a bridge route
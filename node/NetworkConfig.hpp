@@ -76,6 +76,16 @@
  */
 #define ZT_NETWORKCONFIG_FLAG_DISABLE_COMPRESSION 0x0000000000000010ULL
 
+/**
+ * Flag: members re-replicate multicasts to each other through a fan-out tree
+ */
+#define ZT_NETWORKCONFIG_FLAG_MULTICAST_TREE 0x0000000000000020ULL
+
+/**
+ * Flag: schedule outgoing frames through the fq_codel QoS scheduler
+ */
+#define ZT_NETWORKCONFIG_FLAG_QOS 0x0000000000000040ULL
+
 /**
  * Device can bridge to other Ethernet networks and gets unknown recipient multicasts
  */
@@ -131,6 +141,9 @@ namespace ZeroTier {
 // Network configuration meta-data flags
 #define ZT_NETWORKCONFIG_REQUEST_METADATA_KEY_FLAGS "f"
 
+// Requester counts a replay of the config it already has as a refresh, so a controller may answer it from a cache
+#define ZT_NETWORKCONFIG_REQUEST_FLAG_ACCEPTS_REPLAY 0x0000000000000001ULL
+
 // These dictionary keys are short so they don't take up much room.
 // By convention we use upper case for binary blobs, but it doesn't really matter.
 
@@ -270,6 +283,16 @@ public:
 	 */
 	inline bool ndpEmulation() const { return ((this->flags & ZT_NETWORKCONFIG_FLAG_ENABLE_IPV6_NDP_EMULATION) != 0); }
 
+	/**
+	 * @return True if multicasts should be replicated through a fan-out tree of members
+	 */
+	inline bool multicastTree() const { return ((this->flags & ZT_NETWORKCONFIG_FLAG_MULTICAST_TREE) != 0); }
+
+	/**
+	 * @return True if outgoing frames should go through the QoS scheduler
+	 */
+	inline bool qos() const { return ((this->flags & ZT_NETWORKCONFIG_FLAG_QOS) != 0); }
+
 	/**
 	 * @return True if frames should not be compressed
 	 */
@@ -16,6 +16,8 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 #include "Constants.hpp"
 #include "Dictionary.hpp"
 #include "NetworkConfig.hpp"
@@ -58,6 +60,32 @@ public:
 		 */
 		virtual void ncSendConfig(uint64_t nwid,uint64_t requestPacketId,const Address &destination,const NetworkConfig &nc,bool sendLegacyFormatConfig) = 0;
 
+		/**
+		 * Serialize and sign a configuration for a remote peer without sending it
+		 *
+		 * Each chunk is the signed part of one network config chunk, from the
+		 * network ID through the signature. Nothing in it depends on the request
+		 * being answered, so the same chunks can be sent again later with
+		 * ncSendConfigChunks() to answer a repeat of the same request.
+		 *
+		 * @param nwid Network ID
+		 * @param nc Network configuration to serialize
+		 * @param sendLegacyFormatConfig If true, serialize an old-format network config
+		 * @param chunks Vector to fill with signed chunks
+		 * @return True if config was serialized and signed
+		 */
+		virtual bool ncSignConfig(uint64_t nwid,const NetworkConfig &nc,bool sendLegacyFormatConfig,std::vector< std::vector<uint8_t> > &chunks) = 0;
+
+		/**
+		 * Send chunks produced by ncSignConfig() to a remote peer
+		 *
+		 * @param nwid Network ID
+		 * @param requestPacketId Request packet ID to send OK(NETWORK_CONFIG_REQUEST) or 0 to send NETWORK_CONFIG (push)
+		 * @param destination Destination peer Address
+		 * @param chunks Signed chunks
+		 */
+		virtual void ncSendConfigChunks(uint64_t nwid,uint64_t requestPacketId,const Address &destination,const std::vector< std::vector<uint8_t> > &chunks) = 0;
+
 		/**
 		 * Send revocation to a node
 		 *
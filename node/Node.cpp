@@ -162,6 +162,7 @@ ZT_ResultCode Node::processWirePacket(
 {
 	_now = now;
 	RR->sw->onRemotePacket(tptr,localSocket,*(reinterpret_cast<const InetAddress *>(remoteAddress)),packetData,packetLength);
+	_pullDeadlineForPacing(now,nextBackgroundTaskDeadline);
 	return ZT_RESULT_OK;
 }
 
@@ -181,10 +182,17 @@ ZT_ResultCode Node::processVirtualNetworkFrame(
 	SharedPtr<Network> nw(this->network(nwid));
 	if (nw) {
 		RR->sw->onLocalEthernet(tptr,nw,MAC(sourceMac),MAC(destMac),etherType,vlanId,frameData,frameLength);
+		_pullDeadlineForPacing(now,nextBackgroundTaskDeadline);
 		return ZT_RESULT_OK;
 	} else return ZT_RESULT_ERROR_NETWORK_NOT_FOUND;
 }
 
+void Node::_pullDeadlineForPacing(int64_t now,volatile int64_t *nextBackgroundTaskDeadline)
+{
+	if ((nextBackgroundTaskDeadline)&&(RR->sw->pacing())&&(*nextBackgroundTaskDeadline > (now + ZT_BOND_PACING_INTERVAL)))
+		*nextBackgroundTaskDeadline = now + ZT_BOND_PACING_INTERVAL;
+}
+
 // Closure used to ping upstream and active/online peers
 class _PingPeersThatNeedPing
 {
@@ -374,7 +382,16 @@ ZT_ResultCode Node::processBackgroundTasks(void *tptr,int64_t now,volatile int64
 	}
 
 	try {
-		*nextBackgroundTaskDeadline = now + (int64_t)std::max(std::min(bondCheckInterval,std::min(timeUntilNextPingCheck,RR->sw->doTimerTasks(tptr,now))),(unsigned long)ZT_CORE_TIMER_TASK_GRANULARITY);
+		unsigned long timeUntilNextTask = std::max(std::min(bondCheckInterval,std::min(timeUntilNextPingCheck,RR->sw->doTimerTasks(tptr,now))),(unsigned long)ZT_CORE_TIMER_TASK_GRANULARITY);
+		if (RR->bc->inUse() && RR->bc->minLivenessInterval()) {
+			// Bond liveness requests may be due more often than the core timer runs
+			timeUntilNextTask = std::min(timeUntilNextTask,(unsigned long)RR->bc->minLivenessInterval());
+		}
+		if (RR->sw->pacing()) {
+			// Frames are being held for paced bond paths
+			timeUntilNextTask = std::min(timeUntilNextTask,(unsigned long)ZT_BOND_PACING_INTERVAL);
+		}
+		*nextBackgroundTaskDeadline = now + (int64_t)timeUntilNextTask;
 	} catch ( ... ) {
 		return ZT_RESULT_FATAL_ERROR_INTERNAL;
 	}
@@ -554,6 +571,16 @@ ZT_VirtualNetworkList *Node::networks() const
 	return nl;
 }
 
+ZT_QoSStats *Node::qosStats(uint64_t nwid) const
+{
+	return RR->sw->qosStats(nwid);
+}
+
+void Node::pendingQueueStats(ZT_PendingQueueStats *stats) const
+{
+	RR->sw->pendingQueueStats(stats);
+}
+
 void Node::freeQueryResult(void *qr)
 {
 	if (qr)
@@ -660,56 +687,81 @@ std::vector<World> Node::moons() const
 
 void Node::ncSendConfig(uint64_t nwid,uint64_t requestPacketId,const Address &destination,const NetworkConfig &nc,bool sendLegacyFormatConfig)
 {
-	_localControllerAuthorizations_m.lock();
-	_localControllerAuthorizations[_LocalControllerAuth(nwid,destination)] = now();
-	_localControllerAuthorizations_m.unlock();
-
 	if (destination == RR->identity.address()) {
+		_localControllerAuthorizations_m.lock();
+		_localControllerAuthorizations[_LocalControllerAuth(nwid,destination)] = now();
+		_localControllerAuthorizations_m.unlock();
+
 		SharedPtr<Network> n(network(nwid));
 		if (!n) return;
 		n->setConfiguration((void *)0,nc,true);
 	} else {
-		Dictionary<ZT_NETWORKCONFIG_DICT_CAPACITY> *dconf = new Dictionary<ZT_NETWORKCONFIG_DICT_CAPACITY>();
-		try {
-			if (nc.toDictionary(*dconf,sendLegacyFormatConfig)) {
-				uint64_t configUpdateId = prng();
-				if (!configUpdateId) ++configUpdateId;
-
-				const unsigned int totalSize = dconf->sizeBytes();
-				unsigned int chunkIndex = 0;
-				while (chunkIndex < totalSize) {
-					const unsigned int chunkLen = std::min(totalSize - chunkIndex,(unsigned int)(ZT_PROTO_MAX_PACKET_LENGTH - (ZT_PACKET_IDX_PAYLOAD + 256)));
-					Packet outp(destination,RR->identity.address(),(requestPacketId) ? Packet::VERB_OK : Packet::VERB_NETWORK_CONFIG);
-					if (requestPacketId) {
-						outp.append((unsigned char)Packet::VERB_NETWORK_CONFIG_REQUEST);
-						outp.append(requestPacketId);
-					}
+		std::vector< std::vector<uint8_t> > chunks;
+		if (ncSignConfig(nwid,nc,sendLegacyFormatConfig,chunks))
+			ncSendConfigChunks(nwid,requestPacketId,destination,chunks);
+	}
+}
 
-					const unsigned int sigStart = outp.size();
-					outp.append(nwid);
-					outp.append((uint16_t)chunkLen);
-					outp.append((const void *)(dconf->data() + chunkIndex),chunkLen);
+bool Node::ncSignConfig(uint64_t nwid,const NetworkConfig &nc,bool sendLegacyFormatConfig,std::vector< std::vector<uint8_t> > &chunks)
+{
+	Dictionary<ZT_NETWORKCONFIG_DICT_CAPACITY> *dconf = new Dictionary<ZT_NETWORKCONFIG_DICT_CAPACITY>();
+	try {
+		if (!nc.toDictionary(*dconf,sendLegacyFormatConfig)) {
+			delete dconf;
+			return false;
+		}
 
-					outp.append((uint8_t)0); // no flags
-					outp.append((uint64_t)configUpdateId);
-					outp.append((uint32_t)totalSize);
-					outp.append((uint32_t)chunkIndex);
+		uint64_t configUpdateId = prng();
+		if (!configUpdateId) ++configUpdateId;
 
-					C25519::Signature sig(RR->identity.sign(reinterpret_cast<const uint8_t *>(outp.data()) + sigStart,outp.size() - sigStart));
-					outp.append((uint8_t)1);
-					outp.append((uint16_t)ZT_C25519_SIGNATURE_LEN);
-					outp.append(sig.data,ZT_C25519_SIGNATURE_LEN);
+		Buffer<ZT_PROTO_MAX_PACKET_LENGTH> chunk;
+		const unsigned int totalSize = dconf->sizeBytes();
+		unsigned int chunkIndex = 0;
+		while (chunkIndex < totalSize) {
+			const unsigned int chunkLen = std::min(totalSize - chunkIndex,(unsigned int)(ZT_PROTO_MAX_PACKET_LENGTH - (ZT_PACKET_IDX_PAYLOAD + 256)));
 
-					outp.compress();
-					RR->sw->send((void *)0,outp,true);
-					chunkIndex += chunkLen;
-				}
-			}
-			delete dconf;
-		} catch ( ... ) {
-			delete dconf;
-			throw;
+			chunk.clear();
+			chunk.append(nwid);
+			chunk.append((uint16_t)chunkLen);
+			chunk.append((const void *)(dconf->data() + chunkIndex),chunkLen);
+
+			chunk.append((uint8_t)0); // no flags
+			chunk.append((uint64_t)configUpdateId);
+			chunk.append((uint32_t)totalSize);
+			chunk.append((uint32_t)chunkIndex);
+
+			C25519::Signature sig(RR->identity.sign(reinterpret_cast<const uint8_t *>(chunk.data()),chunk.size()));
+			chunk.append((uint8_t)1);
+			chunk.append((uint16_t)ZT_C25519_SIGNATURE_LEN);
+			chunk.append(sig.data,ZT_C25519_SIGNATURE_LEN);
+
+			chunks.push_back(std::vector<uint8_t>(reinterpret_cast<const uint8_t *>(chunk.data()),reinterpret_cast<const uint8_t *>(chunk.data()) + chunk.size()));
+			chunkIndex += chunkLen;
+		}
+
+		delete dconf;
+		return true;
+	} catch ( ... ) {
+		delete dconf;
+		throw;
+	}
+}
+
+void Node::ncSendConfigChunks(uint64_t nwid,uint64_t requestPacketId,const Address &destination,const std::vector< std::vector<uint8_t> > &chunks)
+{
+	_localControllerAuthorizations_m.lock();
+	_localControllerAuthorizations[_LocalControllerAuth(nwid,destination)] = now();
+	_localControllerAuthorizations_m.unlock();
+
+	for(std::vector< std::vector<uint8_t> >::const_iterator c(chunks.begin());c!=chunks.end();++c) {
+		Packet outp(destination,RR->identity.address(),(requestPacketId) ? Packet::VERB_OK : Packet::VERB_NETWORK_CONFIG);
+		if (requestPacketId) {
+			outp.append((unsigned char)Packet::VERB_NETWORK_CONFIG_REQUEST);
+			outp.append(requestPacketId);
 		}
+		outp.append(c->data(),(unsigned int)c->size());
+		outp.compress();
+		RR->sw->send((void *)0,outp,true);
 	}
 }
 
@@ -949,6 +1001,22 @@ ZT_VirtualNetworkList *ZT_Node_networks(ZT_Node *node)
 	}
 }
 
+ZT_QoSStats *ZT_Node_qosStats(ZT_Node *node,uint64_t nwid)
+{
+	try {
+		return reinterpret_cast<ZeroTier::Node *>(node)->qosStats(nwid);
+	} catch ( ... ) {
+		return (ZT_QoSStats *)0;
+	}
+}
+
+void ZT_Node_pendingQueueStats(ZT_Node *node,ZT_PendingQueueStats *stats)
+{
+	try {
+		reinterpret_cast<ZeroTier::Node *>(node)->pendingQueueStats(stats);
+	} catch ( ... ) {}
+}
+
 void ZT_Node_freeQueryResult(ZT_Node *node,void *qr)
 {
 	try {
@@ -94,6 +94,8 @@ public:
 	ZT_PeerList *peers() const;
 	ZT_VirtualNetworkConfig *networkConfig(uint64_t nwid) const;
 	ZT_VirtualNetworkList *networks() const;
+	ZT_QoSStats *qosStats(uint64_t nwid) const;
+	void pendingQueueStats(ZT_PendingQueueStats *stats) const;
 	void freeQueryResult(void *qr);
 	int addLocalInterfaceAddress(const struct sockaddr_storage *addr);
 	void clearLocalInterfaceAddresses();
@@ -244,6 +246,8 @@ public:
 	}
 
 	virtual void ncSendConfig(uint64_t nwid,uint64_t requestPacketId,const Address &destination,const NetworkConfig &nc,bool sendLegacyFormatConfig);
+	virtual bool ncSignConfig(uint64_t nwid,const NetworkConfig &nc,bool sendLegacyFormatConfig,std::vector< std::vector<uint8_t> > &chunks);
+	virtual void ncSendConfigChunks(uint64_t nwid,uint64_t requestPacketId,const Address &destination,const std::vector< std::vector<uint8_t> > &chunks);
 	virtual void ncSendRevocation(const Address &destination,const Revocation &rev);
 	virtual void ncSendError(uint64_t nwid,uint64_t requestPacketId,const Address &destination,NetworkController::ErrorCode errorCode);
 
@@ -267,6 +271,9 @@ public:
 	}
 
 private:
+	// Frames held for paced bond paths must be released sooner than the next scheduled background run
+	void _pullDeadlineForPacing(int64_t now,volatile int64_t *nextBackgroundTaskDeadline);
+
 	RuntimeEnvironment _RR;
 	RuntimeEnvironment *RR;
 	void *_uPtr; // _uptr (lower case) is reserved in Visual Studio :P
@@ -59,10 +59,14 @@
  * 10 - 1.4.0 ... 1.4.6
  * 11 - 1.4.7 ... 1.4.8
  *    + Multipath capability and load balancing (beta)
- * 12 - 1.4.8 ... CURRENT (1.4 series)
+ * 12 - 1.4.8 ... 1.4.x
  *    + AES-GMAC-SIV backported for faster peer-to-peer crypto
+ * 13 - CURRENT
+ *    + Tree replicated MULTICAST_FRAME (flag 0x10)
+ *    + Bond sequence fields in EXT_FRAME (flag 0x20)
+ *    + Bond FEC fields in EXT_FRAME (flag 0x40) and VERB_BOND_PARITY
  */
-#define ZT_PROTO_VERSION 12
+#define ZT_PROTO_VERSION 13
 
 /**
  * Minimum supported protocol version
@@ -296,6 +300,9 @@
 #define ZT_PROTO_VERB_EXT_FRAME_IDX_FLAGS (ZT_PROTO_VERB_EXT_FRAME_IDX_NETWORK_ID + ZT_PROTO_VERB_EXT_FRAME_LEN_NETWORK_ID)
 #define ZT_PROTO_VERB_EXT_FRAME_LEN_FLAGS 1
 #define ZT_PROTO_VERB_EXT_FRAME_IDX_COM (ZT_PROTO_VERB_EXT_FRAME_IDX_FLAGS + ZT_PROTO_VERB_EXT_FRAME_LEN_FLAGS)
+#define ZT_PROTO_VERB_EXT_FRAME_IDX_BOND_SEQUENCE (ZT_PROTO_VERB_EXT_FRAME_IDX_FLAGS + ZT_PROTO_VERB_EXT_FRAME_LEN_FLAGS)
+#define ZT_PROTO_VERB_EXT_FRAME_LEN_BOND_SEQUENCE 5
+#define ZT_PROTO_VERB_EXT_FRAME_LEN_BOND_FEC 5
 #define ZT_PROTO_VERB_EXT_FRAME_IDX_TO (ZT_PROTO_VERB_EXT_FRAME_IDX_FLAGS + ZT_PROTO_VERB_EXT_FRAME_LEN_FLAGS)
 #define ZT_PROTO_VERB_EXT_FRAME_LEN_TO 6
 #define ZT_PROTO_VERB_EXT_FRAME_IDX_FROM (ZT_PROTO_VERB_EXT_FRAME_IDX_TO + ZT_PROTO_VERB_EXT_FRAME_LEN_TO)
@@ -321,6 +328,7 @@
 #define ZT_PROTO_VERB_MULTICAST_FRAME_IDX_COM (ZT_PROTO_VERB_MULTICAST_FRAME_IDX_FLAGS + 1)
 #define ZT_PROTO_VERB_MULTICAST_FRAME_IDX_GATHER_LIMIT (ZT_PROTO_VERB_MULTICAST_FRAME_IDX_FLAGS + 1)
 #define ZT_PROTO_VERB_MULTICAST_FRAME_IDX_SOURCE_MAC (ZT_PROTO_VERB_MULTICAST_FRAME_IDX_FLAGS + 1)
+#define ZT_PROTO_VERB_MULTICAST_FRAME_IDX_TREE_ORIGIN (ZT_PROTO_VERB_MULTICAST_FRAME_IDX_FLAGS + 1)
 #define ZT_PROTO_VERB_MULTICAST_FRAME_IDX_DEST_MAC (ZT_PROTO_VERB_MULTICAST_FRAME_IDX_FLAGS + 1)
 #define ZT_PROTO_VERB_MULTICAST_FRAME_IDX_DEST_ADI (ZT_PROTO_VERB_MULTICAST_FRAME_IDX_DEST_MAC + 6)
 #define ZT_PROTO_VERB_MULTICAST_FRAME_IDX_ETHERTYPE (ZT_PROTO_VERB_MULTICAST_FRAME_IDX_DEST_ADI + 4)
@@ -661,6 +669,11 @@ public:
 		 * Full Ethernet frame with MAC addressing and optional fields:
 		 *   <[8] 64-bit network ID>
 		 *   <[1] flags>
+		 *  [<[...] certificate of network membership>]
+		 *  [<[1] bond sequence stream>]
+		 *  [<[4] 32-bit bond sequence number>]
+		 *  [<[4] 32-bit bond FEC group>]
+		 *  [<[1] index of frame in bond FEC group>]
 		 *   <[6] destination MAC or all zero for destination node>
 		 *   <[6] source MAC or all zero for node of origin>
 		 *   <[2] 16-bit ethertype>
@@ -672,6 +685,8 @@ public:
 		 *   0x04 - Middle bit of subtype (see below)
 		 *   0x08 - Least significant bit of subtype (see below)
 		 *   0x10 - ACK requested in the form of OK(EXT_FRAME)
+		 *   0x20 - Bond sequence fields are present (protocol 13+ peers only)
+		 *   0x40 - Bond FEC fields are present (protocol 13+ peers only)
 		 *
 		 * Subtypes (0..7):
 		 *   0x0 - Normal frame (bridging can be determined by checking MAC)
@@ -689,6 +704,16 @@ public:
 		 * be used for multicast though MULTICAST_FRAME exists for that
 		 * purpose and has additional options and capabilities.
 		 *
+		 * Bonds that stripe one flow across several links (balance-rr and
+		 * balance-aware with resequencing enabled) send unicast frames as
+		 * EXT_FRAME with bond sequence fields so the receiving bond can put
+		 * them back in order before they reach the tap. Sequence numbers
+		 * increase by one per frame within each stream.
+		 *
+		 * Bonds with FEC enabled number frames into groups and follow each
+		 * group with a BOND_PARITY packet. See BOND_PARITY for how frames
+		 * are encoded for parity.
+		 *
 		 * OK payload (if ACK flag is set):
 		 *   <[8] 64-bit network ID>
 		 */
@@ -870,6 +895,15 @@ public:
 		 *   <[1] flags>
 		 *  [<[4] 32-bit implicit gather limit>]
 		 *  [<[6] source MAC>]
+		 *  [<[5] ZeroTier address of tree origin>]
+		 *  [<[1] tree fan-out>]
+		 *  [<[8] 64-bit origin tree counter>]
+		 *  [<[2] 16-bit number of members in signed part>]
+		 *  [<[...] series of 5-byte ZeroTier addresses of part members>]
+		 *  [<[2] 16-bit index of first member of recipient's subtree>]
+		 *  [<[2] 16-bit index after last member of recipient's subtree>]
+		 *  [<[2] 16-bit length of origin signature>]
+		 *  [<[...] origin signature>]
 		 *   <[6] destination MAC (multicast address)>
 		 *   <[4] 32-bit multicast ADI (multicast address extension)>
 		 *   <[2] 16-bit ethertype>
@@ -880,6 +914,19 @@ public:
 		 *   0x02 - Implicit gather limit field is present
 		 *   0x04 - Source MAC is specified -- otherwise it's computed from sender
 		 *   0x08 - Please replicate (sent to multicast replicators)
+		 *   0x10 - Tree replication fields are present
+		 *
+		 * In tree replication mode (networks with the multicast tree flag) the
+		 * origin splits its recipients into at most fan-out parts and signs each
+		 * part separately. A recipient delivers the frame and then replicates it
+		 * to its subtree, a range within the part that directly follows its own
+		 * entry, by splitting the range into at most fan-out pieces and sending
+		 * to the first member of each with the rest of that piece as its subtree.
+		 * The origin signs the network ID, source MAC, destination MAC, ADI,
+		 * ethertype, fan-out, counter, part members, and payload, so frames can
+		 * be attributed to it and can't be replayed or sent to anyone outside
+		 * the part after any number of hops. Tree fields are only sent to peers
+		 * speaking protocol version 13 or newer.
 		 *
 		 * OK and ERROR responses are optional. OK may be generated if there are
 		 * implicit gather results or if the recipient wants to send its own
@@ -1043,7 +1090,60 @@ public:
 		 * that as a refusal by the remote peer, in this case if the utility is
 		 * negligible it will voluntarily switch to the remote peer's chosen path.
 		 */
-		VERB_PATH_NEGOTIATION_REQUEST = 0x16
+		VERB_PATH_NEGOTIATION_REQUEST = 0x16,
+
+		/**
+		 * Parity for a group of FEC-protected frames sent through a bond:
+		 *   <[4] 32-bit bond FEC group>
+		 *   <[1] number of frames in group>
+		 *   <[...] XOR of the group's encoded frames>
+		 *
+		 * Each frame in the group is an EXT_FRAME with bond FEC fields. For
+		 * parity a frame is encoded as a 16-bit length followed by its
+		 * EXT_FRAME payload without the FEC fields and with flag 0x40
+		 * cleared, and shorter encodings are padded with zeros. A receiver
+		 * holding the parity and all but one frame of a group can rebuild
+		 * the missing frame and process it as an ordinary EXT_FRAME.
+		 *
+		 * Groups are numbered sequentially. Group size adapts to the loss
+		 * the sending bond observes on its links.
+		 */
+		VERB_BOND_PARITY = 0x17,
+
+		/**
+		 * Capacity probe train packet or report for a bonded path:
+		 *   <[1] type: 0 for a probe, 1 for a report>
+		 *   <[2] 16-bit train ID>
+		 *   Probe:
+		 *   <[1] index of this packet in train>
+		 *   <[1] number of packets in train>
+		 *   <[...] padding>
+		 *   Report:
+		 *   <[4] 32-bit bytes received after the first packet of the train>
+		 *   <[4] 32-bit time between first and last packet of the train (ms)>
+		 *
+		 * A bond probing its paths sends a train of equal-sized probes back
+		 * to back over one path. The receiver times the train's arrival and
+		 * returns a report over the same path when the last probe arrives.
+		 * The sender divides bytes by time to estimate the path's capacity,
+		 * lengthening future trains if they arrived too quickly to time.
+		 */
+		VERB_BOND_PROBE = 0x18,
+
+		/**
+		 * Liveness echo for a bonded path:
+		 *   <[1] type: 0 for a request, 1 for a reply>
+		 *   <[8] 64-bit timestamp of request>
+		 *
+		 * A bond monitoring liveness sends a request over each of its paths
+		 * at a short fixed interval. The receiver immediately returns the
+		 * timestamp in a reply over the path the request arrived on. A path
+		 * that has answered before is declared down when no reply arrives
+		 * for a set number of intervals, and up again on the next reply.
+		 * Since only the monitoring side keeps timers, the other side needs
+		 * no configuration and a failure in either direction is detected.
+		 */
+		VERB_BOND_LIVENESS = 0x19
 	};
 
 	/**
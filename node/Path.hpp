@@ -27,7 +27,7 @@
 #include "AtomicCounter.hpp"
 #include "Utils.hpp"
 #include "Packet.hpp"
-#include "RingBuffer.hpp"
+#include "Ewma.hpp"
 
 #include "../osdep/Link.hpp"
 
@@ -126,6 +126,24 @@ public:
 		_packetsReceivedSinceLastAck(0),
 		_packetsReceivedSinceLastQoS(0),
 		_bytesAckedSinceLastThroughputEstimation(0),
+		_probedCapacity(0),
+		_capacity(0),
+		_lastCapacityProbe(0),
+		_probeTrain(0),
+		_probeTrainLength(ZT_BOND_CAPACITY_PROBE_MIN_TRAIN),
+		_probeUnanswered(0),
+		_probeRxTrain(0),
+		_probeRxFirst(0),
+		_probeRxLast(0),
+		_probeRxBytes(0),
+		_probeRxActive(false),
+		_lastLivenessOut(0),
+		_lastLivenessIn(0),
+		_livenessEcho(0),
+		_livenessDown(false),
+		_paceRate(0),
+		_paceTokens(0),
+		_lastPaceRefill(0),
 		_packetsIn(0),
 		_packetsOut(0)
 		{}
@@ -175,6 +193,24 @@ public:
 		_packetsReceivedSinceLastAck(0),
 		_packetsReceivedSinceLastQoS(0),
 		_bytesAckedSinceLastThroughputEstimation(0),
+		_probedCapacity(0),
+		_capacity(0),
+		_lastCapacityProbe(0),
+		_probeTrain(0),
+		_probeTrainLength(ZT_BOND_CAPACITY_PROBE_MIN_TRAIN),
+		_probeUnanswered(0),
+		_probeRxTrain(0),
+		_probeRxFirst(0),
+		_probeRxLast(0),
+		_probeRxBytes(0),
+		_probeRxActive(false),
+		_lastLivenessOut(0),
+		_lastLivenessIn(0),
+		_livenessEcho(0),
+		_livenessDown(false),
+		_paceRate(0),
+		_paceTokens(0),
+		_lastPaceRefill(0),
 		_packetsIn(0),
 		_packetsOut(0)
 	{}
@@ -411,7 +447,7 @@ public:
 		bool acceptableAckAge = ackAge(now) < (ackSendInterval); // Whether the remote peer is actually responding to our outgoing traffic or simply sending stuff to us
 		bool notTooEarly      = (now - _lastAliveToggle) >= _upDelay; // Whether we've waited long enough since the link last came online
 		bool inTrial          = (now - _lastTrialBegin) < _upDelay; // Whether this path is still in its trial period
-		bool currEligibility  = allowed() && (((acceptableAge || acceptableAckAge) && notTooEarly) || inTrial);
+		bool currEligibility  = allowed() && !_livenessDown && (((acceptableAge || acceptableAckAge) && notTooEarly) || inTrial);
 		return currEligibility;
 	}
 
@@ -493,6 +529,69 @@ public:
 	*/
 	uint8_t allocation() { return _allocation; }
 
+	/**
+	 * @return Mean throughput delivered over this path as reported by ACKs (kbit/s)
+	 */
+	uint64_t throughputMean() { return _throughputMean; }
+
+	/**
+	 * @return Greatest recent throughput delivered over this path (kbit/s)
+	 */
+	uint64_t throughputMax() { return _throughputMax; }
+
+	/**
+	 * @return Capacity measured by the most recent probe train, 0 if never probed (kbit/s)
+	 */
+	uint64_t probedCapacity() { return _probedCapacity; }
+
+	/**
+	 * @return Capacity used to allocate flows to this path, 0 if unknown (kbit/s)
+	 */
+	uint64_t capacity() { return _capacity; }
+
+	/**
+	 * @return Rate at which frames are paced onto this path, 0 if unpaced (kbit/s)
+	 */
+	uint64_t paceRate() const { return _paceRate; }
+
+	/**
+	 * Take tokens from this path's pacing bucket
+	 *
+	 * The bucket refills at the pacing rate and holds ZT_BOND_PACING_BURST ms
+	 * of traffic. A packet may go whenever the bucket is not empty, so the
+	 * balance can run negative by up to one packet. Callers must serialize
+	 * access (see Switch).
+	 *
+	 * @param bytes Size of packet
+	 * @param now Current time
+	 * @return True if the packet may be sent now
+	 */
+	inline bool paceTake(const unsigned int bytes,const int64_t now)
+	{
+		const int64_t rate = (int64_t)_paceRate; // kbit/s, which is also bits/ms
+		if (!rate)
+			return true;
+		if (now > _lastPaceRefill) {
+			const int64_t depth = std::max((rate * ZT_BOND_PACING_BURST) / 8,(int64_t)(2 * ZT_DEFAULT_PHYSMTU));
+			_paceTokens = std::min(_paceTokens + (((now - _lastPaceRefill) * rate) / 8),depth);
+			_lastPaceRefill = now;
+		}
+		if (_paceTokens <= 0)
+			return false;
+		_paceTokens -= (int64_t)bytes;
+		return true;
+	}
+
+	/**
+	 * @return True if this path has answered a liveness request (see VERB_BOND_LIVENESS)
+	 */
+	bool livenessMonitored() { return (_lastLivenessIn != 0); }
+
+	/**
+	 * @return True if this path has stopped answering liveness requests
+	 */
+	bool livenessDown() { return _livenessDown; }
+
 private:
 
 	volatile int64_t _lastOut;
@@ -508,12 +607,11 @@ private:
 	std::map<uint64_t,uint64_t> qosStatsIn; // id:now
 	std::map<uint64_t,uint16_t> ackStatsIn; // id:len
 
-	RingBuffer<int,ZT_QOS_SHORTTERM_SAMPLE_WIN_SIZE> qosRecordSize;
-	RingBuffer<float,ZT_QOS_SHORTTERM_SAMPLE_WIN_SIZE> qosRecordLossSamples;
-	RingBuffer<uint64_t,ZT_QOS_SHORTTERM_SAMPLE_WIN_SIZE> throughputSamples;
-	RingBuffer<bool,ZT_QOS_SHORTTERM_SAMPLE_WIN_SIZE> packetValiditySamples;
-	RingBuffer<float,ZT_QOS_SHORTTERM_SAMPLE_WIN_SIZE> _throughputVarianceSamples;
-	RingBuffer<uint16_t,ZT_QOS_SHORTTERM_SAMPLE_WIN_SIZE> latencySamples;
+	// Updated as samples arrive so that estimatePathQuality() is O(1) per path
+	Ewma<ZT_QOS_SHORTTERM_SAMPLE_WIN_SIZE> qosRecordLossStats; // 1 lost, 0 acknowledged
+	Ewma<ZT_QOS_SHORTTERM_SAMPLE_WIN_SIZE> throughputStats; // kbit/s
+	Ewma<ZT_QOS_SHORTTERM_SAMPLE_WIN_SIZE> packetValidityStats; // 1 valid, 0 invalid
+	Ewma<ZT_QOS_SHORTTERM_SAMPLE_WIN_SIZE> latencyStats; // ms
 
 	/**
 	 * Last time that a VERB_ACK was received on this path.
@@ -644,12 +742,12 @@ private:
 	float _packetErrorRatio;
 
 	/**
-	 * The estimated mean throughput of this path.
+	 * The mean throughput delivered over this path as reported by ACKs (kbit/s)
 	 */
 	uint64_t _throughputMean;
 
 	/**
-	 * The maximum observed throughput of this path.
+	 * The greatest recent throughput delivered over this path (kbit/s)
 	 */
 	uint64_t _throughputMax;
 
@@ -704,6 +802,48 @@ private:
 	 */
 	uint64_t _bytesAckedSinceLastThroughputEstimation;
 
+	/**
+	 * Capacity measured by the most recent probe train, 0 if never probed (kbit/s)
+	 */
+	uint64_t _probedCapacity;
+
+	/**
+	 * Capacity used to allocate flows to this path, 0 if unknown (kbit/s)
+	 */
+	uint64_t _capacity;
+
+	/**
+	 * Capacity probe trains sent over this path (see VERB_BOND_PROBE)
+	 */
+	int64_t _lastCapacityProbe;
+	uint16_t _probeTrain;
+	unsigned int _probeTrainLength;
+	unsigned int _probeUnanswered;
+
+	/**
+	 * Capacity probe train being received over this path
+	 */
+	uint16_t _probeRxTrain;
+	int64_t _probeRxFirst;
+	int64_t _probeRxLast;
+	uint32_t _probeRxBytes;
+	bool _probeRxActive;
+
+	/**
+	 * Liveness requests sent and answered over this path (see VERB_BOND_LIVENESS)
+	 */
+	int64_t _lastLivenessOut;
+	int64_t _lastLivenessIn;
+	int64_t _livenessEcho;
+	bool _livenessDown;
+
+	/**
+	 * Token bucket pacing frames onto this path, refilled at _paceRate (kbit/s)
+	 */
+	volatile uint64_t _paceRate;
+	int64_t _paceTokens;
+	int64_t _lastPaceRefill;
+
 	/**
 	 * Counters used for tracking path load.
 	 */
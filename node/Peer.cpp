@@ -112,6 +112,8 @@ void Peer::received(
 			for(unsigned int i=0;i<ZT_MAX_PEER_NETWORK_PATHS;++i) {
 				if (_paths[i].p) {
 					if (_paths[i].p == path) {
+						if ((now - _paths[i].lr) >= ZT_PEER_PATH_EXPIRATION)
+							++_pathsGeneration; // expired path came back to life
 						_paths[i].lr = now;
 						havePath = true;
 						break;
@@ -161,6 +163,7 @@ void Peer::received(
 						_paths[replacePath].lr = now;
 						_paths[replacePath].p = path;
 						_paths[replacePath].priority = 1;
+						++_pathsGeneration;
 					} else {
 						attemptToContact = true;
 					}
@@ -227,8 +230,11 @@ void Peer::received(
 
 SharedPtr<Path> Peer::getAppropriatePath(int64_t now, bool includeExpired, int32_t flowId)
 {
+	const int generation = _pathsGeneration.load();
 	if (!_bondToPeer) {
 		Mutex::Lock _l(_paths_m);
+		if ((!includeExpired)&&(_bestPath.generation == generation)&&(now < _bestPath.expires))
+			return _bestPath.p;
 		unsigned int bestPath = ZT_MAX_PEER_NETWORK_PATHS;
 		/**
 		 * Send traffic across the highest quality path only. This algorithm will still
@@ -247,11 +253,44 @@ SharedPtr<Path> Peer::getAppropriatePath(int64_t now, bool includeExpired, int32
 			} else break;
 		}
 		if (bestPath != ZT_MAX_PEER_NETWORK_PATHS) {
+			if (!includeExpired) {
+				_bestPath.generation = generation;
+				_bestPath.expires = std::min(now + ZT_PEER_BEST_PATH_CACHE_TTL,_paths[bestPath].lr + ZT_PEER_PATH_EXPIRATION);
+				_bestPath.p = _paths[bestPath].p;
+			}
 			return _paths[bestPath].p;
 		}
 		return SharedPtr<Path>();
 	}
-	return _bondToPeer->getAppropriatePath(now, flowId);
+
+	/**
+	 * Only active-backup and flow-hashed balance-xor/aware selections are stable
+	 * between packets. Other policies pick a path per packet and are not cached.
+	 * Cached flows are refreshed through the bond at least once per TTL so that
+	 * flow activity (and thus flow expiration) is still tracked.
+	 */
+	const uint8_t policy = _bondToPeer->getPolicy();
+	_PathSelection *ps = (_PathSelection *)0;
+	if (policy == ZT_BONDING_POLICY_ACTIVE_BACKUP) {
+		ps = &_bestPath;
+		flowId = -1;
+	} else if (((policy == ZT_BONDING_POLICY_BALANCE_XOR)||(policy == ZT_BONDING_POLICY_BALANCE_AWARE))&&(flowId != -1)&&(_bondToPeer->flowHashingEnabled())) {
+		ps = &(_flowPaths[(uint32_t)flowId & (ZT_PEER_FLOW_PATH_CACHE_SIZE - 1)]);
+	}
+	if (ps) {
+		Mutex::Lock _l(_paths_m);
+		if ((ps->generation == generation)&&(ps->flowId == flowId)&&(now < ps->expires)&&(ps->p))
+			return ps->p;
+	}
+	const SharedPtr<Path> p(_bondToPeer->getAppropriatePath(now, flowId));
+	if ((ps)&&(p)) {
+		Mutex::Lock _l(_paths_m);
+		ps->flowId = flowId;
+		ps->generation = generation;
+		ps->expires = now + ZT_PEER_BEST_PATH_CACHE_TTL;
+		ps->p = p;
+	}
+	return p;
 }
 
 void Peer::introduce(void *const tPtr,const int64_t now,const SharedPtr<Peer> &other) const
@@ -468,6 +507,7 @@ void Peer::performMultipathStateCheck(void *tPtr, int64_t now)
 	if (_canUseMultipath && !_bondToPeer) {
 		if (RR->bc) {
 			_bondToPeer = RR->bc->createTransportTriggeredBond(RR, this);
+			++_pathsGeneration;
 			/**
 			 * Allow new bond to retroactively learn all paths known to this peer
 			 */
@@ -517,6 +557,8 @@ unsigned int Peer::doPingAndKeepalive(void *tPtr,int64_t now)
 				if (i != j)
 					_paths[j] = _paths[i];
 				++j;
+			} else {
+				++_pathsGeneration;
 			}
 		} else break;
 	}
@@ -569,6 +611,7 @@ void Peer::clusterRedirect(void *tPtr,const SharedPtr<Path> &originatingPath,con
 				++j;
 			}
 		}
+		++_pathsGeneration;
 	}
 }
 
@@ -581,6 +624,7 @@ void Peer::resetWithinScope(void *tPtr,InetAddress::IpScope scope,int inetAddres
 				attemptToContactAt(tPtr,_paths[i].p->localSocket(),_paths[i].p->address(),now,false);
 				_paths[i].p->sent(now);
 				_paths[i].lr = 0; // path will not be used unless it speaks again
+				++_pathsGeneration;
 			}
 		} else break;
 	}
@@ -533,6 +533,14 @@ public:
 	 */
 	inline int8_t bondingPolicy() { return _bondingPolicy; }
 
+	/**
+	 * Invalidate any cached path selections for this peer
+	 *
+	 * Call this whenever something that getAppropriatePath() depends on
+	 * changes, such as a path's latency or a bond's flow assignments.
+	 */
+	inline void pathSelectionChanged() { ++_pathsGeneration; }
+
 	//const AES *aesKeysIfSupported() const
 	//{ return (const AES *)0; }
 
@@ -548,6 +556,15 @@ private:
 		long priority; // >= 1, higher is better
 	};
 
+	struct _PathSelection
+	{
+		_PathSelection() : flowId(-1),generation(-1),expires(0),p() {}
+		int32_t flowId;
+		int generation; // value of _pathsGeneration when this was computed
+		int64_t expires;
+		SharedPtr<Path> p;
+	};
+
 	uint8_t _key[ZT_SYMMETRIC_KEY_SIZE];
 	AES _aesKeys[2];
 
@@ -576,6 +593,12 @@ private:
 	_PeerPath _paths[ZT_MAX_PEER_NETWORK_PATHS];
 	Mutex _paths_m;
 
+	// Cached results of getAppropriatePath(), guarded by _paths_m and
+	// invalidated by bumping _pathsGeneration
+	_PathSelection _bestPath;
+	_PathSelection _flowPaths[ZT_PEER_FLOW_PATH_CACHE_SIZE];
+	AtomicCounter _pathsGeneration;
+
 	Identity _id;
 
 	unsigned int _directPathPushCutoffCount;
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c)2013-2020 ZeroTier, Inc.
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file in the project's root directory.
+ *
+ * Change Date: 2025-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2.0 of the Apache License.
+ */
+/****/
+
+#ifndef ZT_RESEQUENCER_HPP
+#define ZT_RESEQUENCER_HPP
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "Constants.hpp"
+#include "MAC.hpp"
+#include "Mutex.hpp"
+
+namespace ZeroTier {
+
+/**
+ * Puts frames that a remote bond striped across several links back in order
+ *
+ * Frames carry a stream number and a per-stream sequence number. A frame that
+ * is next in its stream is delivered at once along with any held frames it
+ * unblocks. Frames further ahead are held, up to ZT_BOND_RESEQUENCE_WINDOW
+ * per stream, until the gap before them is filled or the oldest of them has
+ * waited longer than the timeout. After that the gap is skipped and frames
+ * that fill it later are delivered as soon as they arrive.
+ *
+ * Delivery is done by a function object called as:
+ *   f(nwid,from,to,etherType,data,len)
+ *
+ * It is called with this object's lock held so that frames of one stream
+ * reach it in order.
+ */
+class Resequencer
+{
+public:
+	struct Counters
+	{
+		uint64_t inOrder;        // delivered immediately
+		uint64_t reordered;      // held until earlier frames arrived or timed out
+		uint64_t lateReleases;   // released with a gap before them (timeout or full window)
+		uint64_t late;           // arrived after their gap had already been skipped
+		uint64_t duplicates;     // dropped because an identical sequence number was held
+		unsigned int maxDepth;   // greatest distance ahead of the next expected frame seen
+	};
+
+	Resequencer() :
+		_timeout(ZT_BOND_RESEQUENCE_MAX_TIMEOUT)
+	{
+		memset(_streams,0,sizeof(_streams));
+		memset(&_counters,0,sizeof(_counters));
+	}
+
+	~Resequencer()
+	{
+		for(unsigned int i=0;i<ZT_BOND_RESEQUENCE_STREAMS;++i)
+			delete _streams[i];
+	}
+
+	/**
+	 * @param flowId Flow ID (may be ZT_QOS_NO_FLOW)
+	 * @return Stream used for this flow's frames
+	 */
+	static inline unsigned int streamForFlow(const int32_t flowId)
+	{
+		return (unsigned int)((((uint32_t)flowId) * 0x9e3779b1U) >> 16) % ZT_BOND_RESEQUENCE_STREAMS;
+	}
+
+	/**
+	 * @param timeout How long a frame may wait for earlier ones in ms (clamped to allowed range)
+	 */
+	inline void setTimeout(int64_t timeout)
+	{
+		_timeout = std::max(std::min(timeout,(int64_t)ZT_BOND_RESEQUENCE_MAX_TIMEOUT),(int64_t)ZT_BOND_RESEQUENCE_MIN_TIMEOUT);
+	}
+
+	inline int64_t timeout() const { return _timeout; }
+
+	/**
+	 * Accept a received frame
+	 *
+	 * @param stream Stream number from frame
+	 * @param seq Sequence number from frame
+	 * @param now Current time
+	 * @param f Function to deliver frames
+	 */
+	template<typename F>
+	inline void receive(unsigned int stream,uint32_t seq,int64_t now,uint64_t nwid,const MAC &from,const MAC &to,unsigned int etherType,const void *data,unsigned int len,F &f)
+	{
+		Mutex::Lock _l(_lock);
+		_Stream *&s = _streams[stream % ZT_BOND_RESEQUENCE_STREAMS];
+		if (!s)
+			s = new _Stream();
+		s->lastReceived = now;
+
+		if ((!s->started)||((int32_t)(seq - s->next) < -(int32_t)(ZT_BOND_RESEQUENCE_WINDOW * 4))) {
+			// First frame or far behind (sender restarted): start over from here
+			_flush(*s,f);
+			s->started = true;
+			s->next = seq;
+		}
+
+		if ((int32_t)(seq - s->next) < 0) {
+			++_counters.late;
+			f(nwid,from,to,etherType,data,len);
+			return;
+		}
+
+		while ((seq - s->next) >= ZT_BOND_RESEQUENCE_WINDOW)
+			_skip(*s,seq,f);
+
+		if (seq == s->next) {
+			++_counters.inOrder;
+			f(nwid,from,to,etherType,data,len);
+			++s->next;
+			_drain(*s,f);
+		} else {
+			_Frame &fr = s->frames[seq & (ZT_BOND_RESEQUENCE_WINDOW - 1)];
+			if ((fr.held)&&(fr.seq == seq)) {
+				++_counters.duplicates;
+				return;
+			}
+			fr.held = true;
+			fr.seq = seq;
+			fr.received = now;
+			fr.nwid = nwid;
+			fr.from = from;
+			fr.to = to;
+			fr.etherType = etherType;
+			fr.data.assign(reinterpret_cast<const uint8_t *>(data),reinterpret_cast<const uint8_t *>(data) + len);
+			++s->held;
+			++_counters.reordered;
+			const unsigned int depth = (unsigned int)(seq - s->next);
+			if (depth > _counters.maxDepth)
+				_counters.maxDepth = depth;
+		}
+
+		_expire(*s,now,f);
+	}
+
+	/**
+	 * Release frames that have waited too long and forget idle streams
+	 *
+	 * @param now Current time
+	 * @param f Function to deliver frames
+	 */
+	template<typename F>
+	inline void expire(int64_t now,F &f)
+	{
+		Mutex::Lock _l(_lock);
+		for(unsigned int i=0;i<ZT_BOND_RESEQUENCE_STREAMS;++i) {
+			_Stream *const s = _streams[i];
+			if (s) {
+				_expire(*s,now,f);
+				if ((!s->held)&&((now - s->lastReceived) > ZT_MULTIPATH_FLOW_EXPIRATION_INTERVAL)) {
+					delete s;
+					_streams[i] = (_Stream *)0;
+				}
+			}
+		}
+	}
+
+	inline Counters counters() const
+	{
+		Mutex::Lock _l(_lock);
+		return _counters;
+	}
+
+private:
+	struct _Frame
+	{
+		_Frame() : held(false),seq(0),received(0),nwid(0),etherType(0) {}
+		bool held;
+		uint32_t seq;
+		int64_t received;
+		uint64_t nwid;
+		MAC from;
+		MAC to;
+		unsigned int etherType;
+		std::vector<uint8_t> data;
+	};
+
+	struct _Stream
+	{
+		_Stream() : started(false),next(0),held(0),lastReceived(0) {}
+		bool started;
+		uint32_t next;
+		unsigned int held;
+		int64_t lastReceived;
+		_Frame frames[ZT_BOND_RESEQUENCE_WINDOW];
+	};
+
+	template<typename F>
+	inline void _deliver(_Frame &fr,F &f)
+	{
+		f(fr.nwid,fr.from,fr.to,fr.etherType,(const void *)fr.data.data(),(unsigned int)fr.data.size());
+		fr.held = false;
+	}
+
+	// Deliver held frames that are now next in sequence
+	template<typename F>
+	inline void _drain(_Stream &s,F &f)
+	{
+		while (s.held) {
+			_Frame &fr = s.frames[s.next & (ZT_BOND_RESEQUENCE_WINDOW - 1)];
+			if ((!fr.held)||(fr.seq != s.next))
+				break;
+			_deliver(fr,f);
+			--s.held;
+			++s.next;
+		}
+	}
+
+	// Give up on the gap before the first held frame, or if nothing is held move the window up to seq
+	template<typename F>
+	inline void _skip(_Stream &s,const uint32_t seq,F &f)
+	{
+		for(uint32_t k=1;(s.held)&&(k<ZT_BOND_RESEQUENCE_WINDOW);++k) {
+			_Frame &fr = s.frames[(s.next + k) & (ZT_BOND_RESEQUENCE_WINDOW - 1)];
+			if ((fr.held)&&(fr.seq == (s.next + k))) {
+				++_counters.lateReleases;
+				s.next += k;
+				_drain(s,f);
+				return;
+			}
+		}
+		for(unsigned int k=0;k<ZT_BOND_RESEQUENCE_WINDOW;++k)
+			s.frames[k].held = false;
+		s.held = 0;
+		s.next = seq - (ZT_BOND_RESEQUENCE_WINDOW - 1);
+	}
+
+	template<typename F>
+	inline void _expire(_Stream &s,const int64_t now,F &f)
+	{
+		while (s.held) {
+			uint32_t k = 1;
+			for(;k<ZT_BOND_RESEQUENCE_WINDOW;++k) {
+				_Frame &fr = s.frames[(s.next + k) & (ZT_BOND_RESEQUENCE_WINDOW - 1)];
+				if ((fr.held)&&(fr.seq == (s.next + k)))
+					break;
+			}
+			if ((k >= ZT_BOND_RESEQUENCE_WINDOW)||((now - s.frames[(s.next + k) & (ZT_BOND_RESEQUENCE_WINDOW - 1)].received) < _timeout))
+				break;
+			++_counters.lateReleases;
+			s.next += k;
+			_drain(s,f);
+		}
+	}
+
+	template<typename F>
+	inline void _flush(_Stream &s,F &f)
+	{
+		for(uint32_t k=1;(s.held)&&(k<ZT_BOND_RESEQUENCE_WINDOW);++k) {
+			_Frame &fr = s.frames[(s.next + k) & (ZT_BOND_RESEQUENCE_WINDOW - 1)];
+			if ((fr.held)&&(fr.seq == (s.next + k))) {
+				++_counters.lateReleases;
+				_deliver(fr,f);
+				--s.held;
+			}
+		}
+	}
+
+	_Stream *_streams[ZT_BOND_RESEQUENCE_STREAMS];
+	int64_t _timeout;
+	Counters _counters;
+	Mutex _lock;
+};
+
+} // namespace ZeroTier
+
+#endif
@@ -253,6 +253,22 @@ public:
 		return total;
 	}
 
+	/**
+	 * @return The largest element in the buffer, or zero if it is empty
+	 */
+	inline T max()
+	{
+		T m = 0;
+		size_t curr_cnt = count();
+		for (size_t i=0; i<curr_cnt; i++) {
+			const T v = *(buf + ((begin + i) % S));
+			if (v > m) {
+				m = v;
+			}
+		}
+		return m;
+	}
+
 	/**
 	 * @return The sample standard deviation of element values
 	 */
@@ -38,37 +38,17 @@ Switch::Switch(const RuntimeEnvironment *renv) :
 	RR(renv),
 	_lastBeaconResponse(0),
 	_lastCheckedQueues(0),
-	_lastUniteAttempt(8) // only really used on root servers and upstreams, and it'll grow there just fine
+	_txQueueCount(0),
+	_txQueueBytes(0),
+	_pacedCount(0),
+	_lastUniteAttempt(8), // only really used on root servers and upstreams, and it'll grow there just fine
+	_relayFastPath((RelayFastPath *)0)
 {
 }
 
-// Returns true if packet appears valid; pos and proto will be set
-static bool _ipv6GetPayload(const uint8_t *frameData,unsigned int frameLen,unsigned int &pos,unsigned int &proto)
+Switch::~Switch()
 {
-	if (frameLen < 40)
-		return false;
-	pos = 40;
-	proto = frameData[6];
-	while (pos <= frameLen) {
-		switch(proto) {
-			case 0: // hop-by-hop options
-			case 43: // routing
-			case 60: // destination options
-			case 135: // mobility options
-				if ((pos + 8) > frameLen)
-					return false; // invalid!
-				proto = frameData[pos];
-				pos += ((unsigned int)frameData[pos + 1] * 8) + 8;
-				break;
-
-			//case 44: // fragment -- we currently can't parse these and they are deprecated in IPv6 anyway
-			//case 50:
-			//case 51: // IPSec ESP and AH -- we have to stop here since this is encrypted stuff
-			default:
-				return true;
-		}
-	}
-	return false; // overflow == invalid
+	delete _relayFastPath;
 }
 
 void Switch::onRemotePacket(void *tPtr,const int64_t localSocket,const InetAddress &fromAddr,const void *data,unsigned int len)
@@ -105,20 +85,32 @@ void Switch::onRemotePacket(void *tPtr,const int64_t localSocket,const InetAddre
 			if (reinterpret_cast<const uint8_t *>(data)[ZT_PACKET_FRAGMENT_IDX_FRAGMENT_INDICATOR] == ZT_PACKET_FRAGMENT_INDICATOR) {
 				// Handle fragment ----------------------------------------------------
 
-				Packet::Fragment fragment(data,len);
-				const Address destination(fragment.destination());
+				const Address destination(reinterpret_cast<const uint8_t *>(data) + ZT_PACKET_FRAGMENT_IDX_DEST,ZT_ADDRESS_LENGTH);
 
 				if (destination != RR->identity.address()) {
 					if ( (!RR->topology->amUpstream()) && (!path->trustEstablished(now)) )
 						return;
 
+					// Roots and moons relay almost everything they see, so try to do that
+					// straight off the wire before building a Fragment or touching Topology.
+					if (_relayFast(tPtr,now,destination,data,len,ZT_PACKET_FRAGMENT_IDX_HOPS,true))
+						return;
+
+					Packet::Fragment fragment(data,len);
+
 					if (fragment.hops() < ZT_RELAY_MAX_HOPS) {
 						fragment.incrementHops();
 
 						// Note: we don't bother initiating NAT-t for fragments, since heads will set that off.
 						// It wouldn't hurt anything, just redundant and unnecessary.
 						SharedPtr<Peer> relayTo = RR->topology->getPeer(tPtr,destination);
-						if ((!relayTo)||(!relayTo->sendDirect(tPtr,fragment.data(),fragment.size(),now,false))) {
+						SharedPtr<Path> relayPath;
+						if (relayTo)
+							relayPath = relayTo->getAppropriatePath(now,false);
+						if ((relayPath)&&(relayPath->send(RR,tPtr,fragment.data(),fragment.size(),now))) {
+							if (RR->topology->amUpstream())
+								_relayCacheUpdate(destination,relayPath,now);
+						} else {
 							// Don't know peer or no direct path -- so relay via someone upstream
 							relayTo = RR->topology->getUpstreamPeer();
 							if (relayTo)
@@ -127,6 +119,7 @@ void Switch::onRemotePacket(void *tPtr,const int64_t localSocket,const InetAddre
 					}
 				} else {
 					// Fragment looks like ours
+					Packet::Fragment fragment(data,len);
 					const uint64_t fragmentPacketId = fragment.packetId();
 					const unsigned int fragmentNumber = fragment.fragmentNumber();
 					const unsigned int totalFragments = fragment.totalFragments();
@@ -165,6 +158,8 @@ void Switch::onRemotePacket(void *tPtr,const int64_t localSocket,const InetAddre
 									rq->timestamp = 0; // packet decoded, free entry
 								} else {
 									rq->complete = true; // set complete flag but leave entry since it probably needs WHOIS or something
+									if (!_rxWaitingAdd(rq,true))
+										rq->timestamp = 0;
 								}
 							}
 						} // else this is a duplicate fragment, ignore
@@ -185,12 +180,27 @@ void Switch::onRemotePacket(void *tPtr,const int64_t localSocket,const InetAddre
 					if ( (!RR->topology->amUpstream()) && (!path->trustEstablished(now)) && (source != RR->identity.address()) )
 						return;
 
+					if (_relayFast(tPtr,now,destination,data,len,ZT_PACKET_IDX_FLAGS,false)) {
+						if ((source != RR->identity.address())&&(!_relayUnitedRecently(now,source,destination))&&(_shouldUnite(now,source,destination))) {
+							const SharedPtr<Peer> relayTo(RR->topology->getPeer(tPtr,destination));
+							const SharedPtr<Peer> sourcePeer(RR->topology->getPeer(tPtr,source));
+							if ((relayTo)&&(sourcePeer))
+								relayTo->introduce(tPtr,now,sourcePeer);
+						}
+						return;
+					}
+
 					Packet packet(data,len);
 
 					if (packet.hops() < ZT_RELAY_MAX_HOPS) {
 						packet.incrementHops();
 						SharedPtr<Peer> relayTo = RR->topology->getPeer(tPtr,destination);
-						if ((relayTo)&&(relayTo->sendDirect(tPtr,packet.data(),packet.size(),now,false))) {
+						SharedPtr<Path> relayPath;
+						if (relayTo)
+							relayPath = relayTo->getAppropriatePath(now,false);
+						if ((relayPath)&&(relayPath->send(RR,tPtr,packet.data(),packet.size(),now))) {
+							if (RR->topology->amUpstream())
+								_relayCacheUpdate(destination,relayPath,now);
 							if ((source != RR->identity.address())&&(_shouldUnite(now,source,destination))) {
 								const SharedPtr<Peer> sourcePeer(RR->topology->getPeer(tPtr,source));
 								if (sourcePeer)
@@ -247,6 +257,8 @@ void Switch::onRemotePacket(void *tPtr,const int64_t localSocket,const InetAddre
 								rq->timestamp = 0; // packet decoded, free entry
 							} else {
 								rq->complete = true; // set complete flag but leave entry since it probably needs WHOIS or something
+								if (!_rxWaitingAdd(rq,true))
+									rq->timestamp = 0;
 							}
 						} else {
 							// Still waiting on more fragments, but keep the head
@@ -257,15 +269,21 @@ void Switch::onRemotePacket(void *tPtr,const int64_t localSocket,const InetAddre
 					// Packet is unfragmented, so just process it
 					IncomingPacket packet(data,len,path,now);
 					if (!packet.tryDecode(RR,tPtr,flowId)) {
-						RXQueueEntry *const rq = _nextRXQueueEntry();
-						Mutex::Lock rql(rq->lock);
-						rq->flowId = flowId;
-						rq->timestamp = now;
-						rq->packetId = packet.packetId();
-						rq->frag0 = packet;
-						rq->totalFragments = 1;
-						rq->haveFragments = 1;
-						rq->complete = true;
+						if (_rxWaitingHasRoom(source)) {
+							RXQueueEntry *const rq = _nextRXQueueEntry();
+							Mutex::Lock rql(rq->lock);
+							rq->flowId = flowId;
+							rq->timestamp = now;
+							rq->packetId = packet.packetId();
+							rq->frag0 = packet;
+							rq->totalFragments = 1;
+							rq->haveFragments = 1;
+							rq->complete = true;
+							if (!_rxWaitingAdd(rq,true))
+								rq->timestamp = 0;
+						} else {
+							++_rxDroppedCount;
+						}
 					}
 				}
 
@@ -294,70 +312,13 @@ void Switch::onLocalEthernet(void *tPtr,const SharedPtr<Network> &network,const
 	/**
 	 * A pseudo-unique identifier used by balancing and bonding policies to
 	 * categorize individual flows/conversations for assignment to a specific
-	 * physical path. This identifier consists of the source port and
-	 * destination port of the encapsulated frame.
+	 * physical path. This identifier is a symmetric hash of the addresses
+	 * and ports of the encapsulated frame (see Flow::hashFrame()).
 	 *
 	 * A flowId of -1 will indicate that there is no preference for how this
 	 * packet shall be sent. An example of this would be an ICMP packet.
 	 */
-
-	int32_t flowId = ZT_QOS_NO_FLOW;
-
-	if (etherType == ZT_ETHERTYPE_IPV4 && (len >= 20)) {
-		uint16_t srcPort = 0;
-		uint16_t dstPort = 0;
-		uint8_t proto = (reinterpret_cast<const uint8_t *>(data)[9]);
-		const unsigned int headerLen = 4 * (reinterpret_cast<const uint8_t *>(data)[0] & 0xf);
-		switch(proto) {
-			case 0x01: // ICMP
-				//flowId = 0x01;
-				break;
-			// All these start with 16-bit source and destination port in that order
-			case 0x06: // TCP
-			case 0x11: // UDP
-			case 0x84: // SCTP
-			case 0x88: // UDPLite
-				if (len > (headerLen + 4)) {
-					unsigned int pos = headerLen + 0;
-					srcPort = (reinterpret_cast<const uint8_t *>(data)[pos++]) << 8;
-					srcPort |= (reinterpret_cast<const uint8_t *>(data)[pos]);
-					pos++;
-					dstPort = (reinterpret_cast<const uint8_t *>(data)[pos++]) << 8;
-					dstPort |= (reinterpret_cast<const uint8_t *>(data)[pos]);
-					flowId = dstPort ^ srcPort ^ proto;
-				}
-				break;
-		}
-	}
-
-	if (etherType == ZT_ETHERTYPE_IPV6 && (len >= 40)) {
-		uint16_t srcPort = 0;
-		uint16_t dstPort = 0;
-		unsigned int pos;
-		unsigned int proto;
-		_ipv6GetPayload((const uint8_t *)data, len, pos, proto);
-		switch(proto) {
-			case 0x3A: // ICMPv6
-				//flowId = 0x3A;
-				break;
-			// All these start with 16-bit source and destination port in that order
-			case 0x06: // TCP
-			case 0x11: // UDP
-			case 0x84: // SCTP
-			case 0x88: // UDPLite
-				if (len > (pos + 4)) {
-					srcPort = (reinterpret_cast<const uint8_t *>(data)[pos++]) << 8;
-					srcPort |= (reinterpret_cast<const uint8_t *>(data)[pos]);
-					pos++;
-					dstPort = (reinterpret_cast<const uint8_t *>(data)[pos++]) << 8;
-					dstPort |= (reinterpret_cast<const uint8_t *>(data)[pos]);
-					flowId = dstPort ^ srcPort ^ proto;
-				}
-				break;
-			default:
-				break;
-		}
-	}
+	int32_t flowId = Flow::hashFrame(etherType,reinterpret_cast<const uint8_t *>(data),len);
 
 	if (to.isMulticast()) {
 		MulticastGroup multicastGroup(to,0);
@@ -507,7 +468,49 @@ void Switch::onLocalEthernet(void *tPtr,const SharedPtr<Network> &network,const
 
 		network->pushCredentialsIfNeeded(tPtr,toZT,RR->node->now());
 
-		if (!fromBridged) {
+		// Bonds that stripe flows across links number frames so the other side can restore their
+		// order, and bonds with FEC enabled group frames so the other side can repair losses.
+		// Peers older than protocol version 13 don't understand these fields and get plain frames.
+		SharedPtr<Bond> bond;
+		if (toPeer)
+			bond = toPeer->bond();
+		const bool sequenced = ((bond)&&(bond->resequencing())&&(toPeer->remoteVersionProtocol() >= 13));
+		const bool fec = ((bond)&&(bond->fec())&&(toPeer->remoteVersionProtocol() >= 13));
+
+		if ((sequenced)||(fec)) {
+			Packet outp(toZT,RR->identity.address(),Packet::VERB_EXT_FRAME);
+			outp.append(network->id());
+			outp.append((unsigned char)(((sequenced) ? 0x20 : 0x00)|((fec) ? 0x40 : 0x00)));
+			if (sequenced) {
+				unsigned int stream = 0;
+				const uint32_t seq = bond->nextFrameSequence(flowId,stream);
+				outp.append((uint8_t)stream);
+				outp.append(seq);
+			}
+			const unsigned int fecAt = outp.size() - ZT_PACKET_IDX_PAYLOAD;
+			if (fec) {
+				outp.append((uint32_t)0); // FEC group and index, filled in by bond
+				outp.append((uint8_t)0);
+			}
+			to.appendTo(outp);
+			from.appendTo(outp);
+			outp.append((uint16_t)etherType);
+			outp.append(data,len);
+			if (fec) {
+				Packet parity(toZT,RR->identity.address(),Packet::VERB_BOND_PARITY);
+				const bool groupComplete = bond->fecProtectFrame(outp,fecAt,parity,RR->node->now());
+				aqm_enqueue(tPtr,network,outp,true,qosBucket,flowId);
+				if (groupComplete) {
+					// Parity takes the same path as parity flushed by the bond, not the flow's path
+					const SharedPtr<Path> parityPath(bond->parityPath());
+					if (parityPath)
+						_sendViaSpecificPath(tPtr,toPeer,parityPath,RR->node->now(),parity,true,ZT_QOS_NO_FLOW);
+					else send(tPtr,parity,true,flowId);
+				}
+			} else {
+				aqm_enqueue(tPtr,network,outp,true,qosBucket,flowId);
+			}
+		} else if (!fromBridged) {
 			Packet outp(toZT,RR->identity.address(),Packet::VERB_FRAME);
 			outp.append(network->id());
 			outp.append((uint16_t)etherType);
@@ -592,99 +595,144 @@ void Switch::onLocalEthernet(void *tPtr,const SharedPtr<Network> &network,const
 	}
 }
 
-void Switch::aqm_enqueue(void *tPtr, const SharedPtr<Network> &network, Packet &packet,bool encrypt,int qosBucket,int32_t flowId)
+Switch::NetworkQoSControlBlock::NetworkQoSControlBlock() :
+	freeEntries((ManagedQueueEntry *)0),
+	allocatedEntries(0),
+	enqueuedPackets(0)
 {
-	if(!network->qosEnabled()) {
-		send(tPtr, packet, encrypt, flowId);
-		return;
-	}
-	NetworkQoSControlBlock *nqcb = _netQueueControlBlock[network->id()];
-	if (!nqcb) {
-		nqcb = new NetworkQoSControlBlock();
-		_netQueueControlBlock[network->id()] = nqcb;
-		// Initialize ZT_QOS_NUM_BUCKETS queues and place them in the INACTIVE list
-		// These queues will be shuffled between the new/old/inactive lists by the enqueue/dequeue algorithm
-		for (int i=0; i<ZT_AQM_NUM_BUCKETS; i++) {
-			nqcb->inactiveQueues.push_back(new ManagedQueue(i));
+	memset(stats,0,sizeof(stats));
+	for(unsigned int i=0;i<ZT_AQM_NUM_BUCKETS;++i)
+		stats[i].bucket = i;
+}
+
+Switch::NetworkQoSControlBlock::~NetworkQoSControlBlock()
+{
+	for(unsigned int i=0;i<ZT_AQM_NUM_FLOW_QUEUES;++i) {
+		while (queues[i].head) {
+			ManagedQueueEntry *const e = queues[i].head;
+			queues[i].head = e->next;
+			delete e;
 		}
 	}
-	// Don't apply QoS scheduling to ZT protocol traffic
-	if (packet.verb() != Packet::VERB_FRAME && packet.verb() != Packet::VERB_EXT_FRAME) {
-		send(tPtr, packet, encrypt, flowId);
+	while (freeEntries) {
+		ManagedQueueEntry *const e = freeEntries;
+		freeEntries = e->next;
+		delete e;
+	}
+}
+
+void Switch::NetworkQoSControlBlock::enqueue(const Packet &packet,bool encrypt,int qosBucket,int32_t flowId,uint64_t now)
+{
+	if ((qosBucket < 0)||(qosBucket >= ZT_AQM_NUM_BUCKETS))
+		qosBucket = ZT_AQM_DEFAULT_BUCKET;
+
+	ManagedQueueEntry *e = allocEntry();
+	if (!e) {
+		// Scheduler is full: drop from the head of the queue with the largest
+		// backlog and reuse its buffer (fq_codel's fat flow drop)
+		ManagedQueue *fattest = (ManagedQueue *)0;
+		for(unsigned int i=0;i<ZT_AQM_NUM_FLOW_QUEUES;++i) {
+			if ((queues[i].head)&&((!fattest)||(queues[i].byteLength > fattest->byteLength)))
+				fattest = &(queues[i]);
+		}
+		if (!fattest) {
+			// Every buffer is out being sent, so there is nothing to push out
+			++stats[qosBucket].overflowDrops;
+			return;
+		}
+		e = popEntry(fattest);
+		++stats[e->bucket].overflowDrops;
 	}
 
-	_aqm_m.lock();
+	e->next = (ManagedQueueEntry *)0;
+	e->creationTime = now;
+	e->length = packet.payloadLength();
+	e->bucket = qosBucket;
+	e->encrypt = encrypt;
+	e->flowId = flowId;
+	e->packet.copyFrom(packet.data(),packet.size());
+
+	const uint64_t fk = packet.destination().toInt() ^ ((uint64_t)((uint32_t)flowId) << 24) ^ ((uint64_t)qosBucket << 56);
+	ManagedQueue *const q = &(queues[(unsigned int)((fk * 0x9e3779b97f4a7c15ULL) >> 32) % ZT_AQM_NUM_FLOW_QUEUES]);
+	if (q->tail) q->tail->next = e; else q->head = e;
+	q->tail = e;
+	q->byteLength += (int)e->length;
+	++enqueuedPackets;
+
+	ZT_QoSBucketStats &st = stats[qosBucket];
+	++st.enqueued;
+	++st.backlogPackets;
+	st.backlogBytes += e->length;
+
+	if (!q->active) {
+		q->active = true;
+		q->byteCredit = ZT_AQM_QUANTUM;
+		newQueues.push(q);
+	}
+}
 
-	// Enqueue packet and move queue to appropriate list
+Switch::ManagedQueueEntry *Switch::NetworkQoSControlBlock::dequeue(uint64_t now)
+{
+	while (enqueuedPackets) {
+		// Serve NEW queues before OLD queues, deficit round robin within each
+		ManagedQueueList *list = &newQueues;
+		ManagedQueue *q = list->head;
+		if (!q) {
+			list = &oldQueues;
+			q = list->head;
+			if (!q)
+				break;
+		}
 
-	const Address dest(packet.destination());
-	TXQueueEntry *txEntry = new TXQueueEntry(dest,RR->node->now(),packet,encrypt,flowId);
+		if (q->byteCredit <= 0) {
+			q->byteCredit += ZT_AQM_QUANTUM;
+			list->pop();
+			oldQueues.push(q);
+			continue;
+		}
 
-	ManagedQueue *selectedQueue = nullptr;
-	for (size_t i=0; i<ZT_AQM_NUM_BUCKETS; i++) {
-		if (i < nqcb->oldQueues.size()) { // search old queues first (I think this is best since old would imply most recent usage of the queue)
-			if (nqcb->oldQueues[i]->id == qosBucket) {
-				selectedQueue = nqcb->oldQueues[i];
-			}
-		} if (i < nqcb->newQueues.size()) { // search new queues (this would imply not often-used queues)
-			if (nqcb->newQueues[i]->id == qosBucket) {
-				selectedQueue = nqcb->newQueues[i];
-			}
-		} if (i < nqcb->inactiveQueues.size()) { // search inactive queues
-			if (nqcb->inactiveQueues[i]->id == qosBucket) {
-				selectedQueue = nqcb->inactiveQueues[i];
-				// move queue to end of NEW queue list
-				selectedQueue->byteCredit = ZT_AQM_QUANTUM;
-				// DEBUG_INFO("moving q=%p from INACTIVE to NEW list", selectedQueue);
-				nqcb->newQueues.push_back(selectedQueue);
-				nqcb->inactiveQueues.erase(nqcb->inactiveQueues.begin() + i);
+		ManagedQueueEntry *const e = CoDelDequeue(this, q, now);
+		if (!e) {
+			list->pop();
+			if ((list == &newQueues)&&(oldQueues.head)) {
+				// An emptied NEW queue goes to the back of OLD to prevent starvation
+				oldQueues.push(q);
+			} else {
+				q->active = false;
 			}
+			continue;
 		}
+
+		q->byteCredit -= (int)e->length;
+		ZT_QoSBucketStats &st = stats[e->bucket];
+		const uint64_t sojourn = now - e->creationTime;
+		++st.sent;
+		st.totalDelay += sojourn;
+		if (sojourn > st.maxDelay)
+			st.maxDelay = (unsigned int)sojourn;
+		return e;
 	}
-	if (!selectedQueue) {
+	return (ManagedQueueEntry *)0;
+}
+
+void Switch::aqm_enqueue(void *tPtr, const SharedPtr<Network> &network, Packet &packet,bool encrypt,int qosBucket,int32_t flowId)
+{
+	if(!network->qosEnabled()) {
+		send(tPtr, packet, encrypt, flowId);
+		return;
+	}
+	// Don't apply QoS scheduling to ZT protocol traffic
+	if (packet.verb() != Packet::VERB_FRAME && packet.verb() != Packet::VERB_EXT_FRAME) {
+		send(tPtr, packet, encrypt, flowId);
 		return;
 	}
-
-	selectedQueue->q.push_back(txEntry);
-	selectedQueue->byteLength+=txEntry->packet.payloadLength();
-	nqcb->_currEnqueuedPackets++;
-
-	// DEBUG_INFO("nq=%2lu, oq=%2lu, iq=%2lu, nqcb.size()=%3d, bucket=%2d, q=%p", nqcb->newQueues.size(), nqcb->oldQueues.size(), nqcb->inactiveQueues.size(), nqcb->_currEnqueuedPackets, qosBucket, selectedQueue);
-
-	// Drop a packet if necessary
-	ManagedQueue *selectedQueueToDropFrom = nullptr;
-	if (nqcb->_currEnqueuedPackets > ZT_AQM_MAX_ENQUEUED_PACKETS)
 	{
-		// DEBUG_INFO("too many enqueued packets (%d), finding packet to drop", nqcb->_currEnqueuedPackets);
-		int maxQueueLength = 0;
-		for (size_t i=0; i<ZT_AQM_NUM_BUCKETS; i++) {
-			if (i < nqcb->oldQueues.size()) {
-				if (nqcb->oldQueues[i]->byteLength > maxQueueLength) {
-					maxQueueLength = nqcb->oldQueues[i]->byteLength;
-					selectedQueueToDropFrom = nqcb->oldQueues[i];
-				}
-			} if (i < nqcb->newQueues.size()) {
-				if (nqcb->newQueues[i]->byteLength > maxQueueLength) {
-					maxQueueLength = nqcb->newQueues[i]->byteLength;
-					selectedQueueToDropFrom = nqcb->newQueues[i];
-				}
-			} if (i < nqcb->inactiveQueues.size()) {
-				if (nqcb->inactiveQueues[i]->byteLength > maxQueueLength) {
-					maxQueueLength = nqcb->inactiveQueues[i]->byteLength;
-					selectedQueueToDropFrom = nqcb->inactiveQueues[i];
-				}
-			}
-		}
-		if (selectedQueueToDropFrom) {
-			// DEBUG_INFO("dropping packet from head of largest queue (%d payload bytes)", maxQueueLength);
-			int sizeOfDroppedPacket = selectedQueueToDropFrom->q.front()->packet.payloadLength();
-			delete selectedQueueToDropFrom->q.front();
-			selectedQueueToDropFrom->q.pop_front();
-			selectedQueueToDropFrom->byteLength-=sizeOfDroppedPacket;
-			nqcb->_currEnqueuedPackets--;
-		}
+		Mutex::Lock _l(_aqm_m);
+		SharedPtr<NetworkQoSControlBlock> &nqcb = _netQueueControlBlock[network->id()];
+		if (!nqcb)
+			nqcb.set(new NetworkQoSControlBlock());
+		nqcb->enqueue(packet,encrypt,qosBucket,flowId,RR->node->now());
 	}
-	_aqm_m.unlock();
 	aqm_dequeue(tPtr);
 }
 
@@ -697,14 +745,14 @@ Switch::dqr Switch::dodequeue(ManagedQueue *q, uint64_t now)
 {
 	dqr r;
 	r.ok_to_drop = false;
-	r.p = q->q.front();
+	r.p = q->head;
 
 	if (r.p == NULL) {
 		q->first_above_time = 0;
 		return r;
 	}
 	uint64_t sojourn_time = now - r.p->creationTime;
-	if (sojourn_time < ZT_AQM_TARGET || q->byteLength <= ZT_DEFAULT_MTU) {
+	if (sojourn_time < ZT_AQM_TARGET || (q->byteLength - (int)r.p->length) <= ZT_DEFAULT_MTU) {
 		// went below - stay below for at least interval
 		q->first_above_time = 0;
 	} else {
@@ -719,7 +767,7 @@ Switch::dqr Switch::dodequeue(ManagedQueue *q, uint64_t now)
 	return r;
 }
 
-Switch::TXQueueEntry * Switch::CoDelDequeue(ManagedQueue *q, bool isNew, uint64_t now)
+Switch::ManagedQueueEntry *Switch::CoDelDequeue(NetworkQoSControlBlock *nqcb, ManagedQueue *q, uint64_t now)
 {
 	dqr r = dodequeue(q, now);
 
@@ -728,7 +776,9 @@ Switch::TXQueueEntry * Switch::CoDelDequeue(ManagedQueue *q, bool isNew, uint64_
 			q->dropping = false;
 		}
 		while (now >= q->drop_next && q->dropping) {
-			q->q.pop_front(); // drop
+			ManagedQueueEntry *const d = nqcb->popEntry(q); // drop
+			++nqcb->stats[d->bucket].codelDrops;
+			nqcb->freeEntry(d);
 			r = dodequeue(q, now);
 			if (!r.ok_to_drop) {
 				// leave dropping state
@@ -740,110 +790,70 @@ Switch::TXQueueEntry * Switch::CoDelDequeue(ManagedQueue *q, bool isNew, uint64_
 			}
 		}
 	} else if (r.ok_to_drop) {
-		q->q.pop_front(); // drop
+		ManagedQueueEntry *const d = nqcb->popEntry(q); // drop
+		++nqcb->stats[d->bucket].codelDrops;
+		nqcb->freeEntry(d);
 		r = dodequeue(q, now);
 		q->dropping = true;
-		q->count = (q->count > 2 && now - q->drop_next < 8*ZT_AQM_INTERVAL)?
-		q->count - 2 : 1;
+		const uint32_t delta = q->count - q->lastcount;
+		q->count = (delta > 1 && now - q->drop_next < 16*ZT_AQM_INTERVAL) ? delta : 1;
 		q->drop_next = control_law(now, q->count);
+		q->lastcount = q->count;
 	}
+	if (r.p)
+		nqcb->popEntry(q);
 	return r.p;
 }
 
-void Switch::aqm_dequeue(void *tPtr)
+void Switch::aqm_dequeue(void *tPtr,unsigned int maxPackets)
 {
-	// Cycle through network-specific QoS control blocks
-	for(std::map<uint64_t,NetworkQoSControlBlock*>::iterator nqcb(_netQueueControlBlock.begin());nqcb!=_netQueueControlBlock.end();) {
-		if (!(*nqcb).second->_currEnqueuedPackets) {
-			return;
-		}
-
-		uint64_t now = RR->node->now();
-		TXQueueEntry *entryToEmit = nullptr;
-		std::vector<ManagedQueue*> *currQueues = &((*nqcb).second->newQueues);
-		std::vector<ManagedQueue*> *oldQueues = &((*nqcb).second->oldQueues);
-		std::vector<ManagedQueue*> *inactiveQueues = &((*nqcb).second->inactiveQueues);
-
-		_aqm_m.lock();
-
-		// Attempt dequeue from queues in NEW list
-		bool examiningNewQueues = true;
-		while (currQueues->size()) {
-			ManagedQueue *queueAtFrontOfList = currQueues->front();
-			if (queueAtFrontOfList->byteCredit < 0) {
-				queueAtFrontOfList->byteCredit += ZT_AQM_QUANTUM;
-				// Move to list of OLD queues
-				// DEBUG_INFO("moving q=%p from NEW to OLD list", queueAtFrontOfList);
-				oldQueues->push_back(queueAtFrontOfList);
-				currQueues->erase(currQueues->begin());
-			} else {
-				entryToEmit = CoDelDequeue(queueAtFrontOfList, examiningNewQueues, now);
-				if (!entryToEmit) {
-					// Move to end of list of OLD queues
-					// DEBUG_INFO("moving q=%p from NEW to OLD list", queueAtFrontOfList);
-					oldQueues->push_back(queueAtFrontOfList);
-					currQueues->erase(currQueues->begin());
-				}
-				else {
-					int len = entryToEmit->packet.payloadLength();
-					queueAtFrontOfList->byteLength -= len;
-					queueAtFrontOfList->byteCredit -= len;
-					// Send the packet!
-					queueAtFrontOfList->q.pop_front();
-					send(tPtr, entryToEmit->packet, entryToEmit->encrypt, entryToEmit->flowId);
-					(*nqcb).second->_currEnqueuedPackets--;
-				}
-				if (queueAtFrontOfList) {
-					//DEBUG_INFO("dequeuing from q=%p, len=%lu in NEW list (byteCredit=%d)", queueAtFrontOfList, queueAtFrontOfList->q.size(), queueAtFrontOfList->byteCredit);
-				}
-				break;
-			}
-		}
-
-		// Attempt dequeue from queues in OLD list
-		examiningNewQueues = false;
-		currQueues = &((*nqcb).second->oldQueues);
-		while (currQueues->size()) {
-			ManagedQueue *queueAtFrontOfList = currQueues->front();
-			if (queueAtFrontOfList->byteCredit < 0) {
-				queueAtFrontOfList->byteCredit += ZT_AQM_QUANTUM;
-				oldQueues->push_back(queueAtFrontOfList);
-				currQueues->erase(currQueues->begin());
-			} else {
-				entryToEmit = CoDelDequeue(queueAtFrontOfList, examiningNewQueues, now);
-				if (!entryToEmit) {
-					//DEBUG_INFO("moving q=%p from OLD to INACTIVE list", queueAtFrontOfList);
-					// Move to inactive list of queues
-					inactiveQueues->push_back(queueAtFrontOfList);
-					currQueues->erase(currQueues->begin());
-				}
-				else {
-					int len = entryToEmit->packet.payloadLength();
-					queueAtFrontOfList->byteLength -= len;
-					queueAtFrontOfList->byteCredit -= len;
-					queueAtFrontOfList->q.pop_front();
-					send(tPtr, entryToEmit->packet, entryToEmit->encrypt, entryToEmit->flowId);
-					(*nqcb).second->_currEnqueuedPackets--;
-				}
-				if (queueAtFrontOfList) {
-					//DEBUG_INFO("dequeuing from q=%p, len=%lu in OLD list (byteCredit=%d)", queueAtFrontOfList, queueAtFrontOfList->q.size(), queueAtFrontOfList->byteCredit);
-				}
-				break;
+	const uint64_t now = RR->node->now();
+	std::vector< std::pair< SharedPtr<NetworkQoSControlBlock>,ManagedQueueEntry * > > ready;
+	{
+		Mutex::Lock _l(_aqm_m);
+		for(std::map< uint64_t,SharedPtr<NetworkQoSControlBlock> >::iterator nqcb(_netQueueControlBlock.begin());nqcb!=_netQueueControlBlock.end();++nqcb) {
+			for(unsigned int i=0;i<maxPackets;++i) {
+				ManagedQueueEntry *const e = nqcb->second->dequeue(now);
+				if (!e)
+					break;
+				ready.push_back(std::pair< SharedPtr<NetworkQoSControlBlock>,ManagedQueueEntry * >(nqcb->second,e));
 			}
 		}
-		nqcb++;
-		_aqm_m.unlock();
 	}
+	if (ready.empty())
+		return;
+
+	// The reference to each control block keeps its buffers valid even if the
+	// network is left while we are sending.
+	for(std::vector< std::pair< SharedPtr<NetworkQoSControlBlock>,ManagedQueueEntry * > >::iterator r(ready.begin());r!=ready.end();++r)
+		send(tPtr, r->second->packet, r->second->encrypt, r->second->flowId);
+
+	Mutex::Lock _l(_aqm_m);
+	for(std::vector< std::pair< SharedPtr<NetworkQoSControlBlock>,ManagedQueueEntry * > >::iterator r(ready.begin());r!=ready.end();++r)
+		r->first->freeEntry(r->second);
 }
 
 void Switch::removeNetworkQoSControlBlock(uint64_t nwid)
 {
-	NetworkQoSControlBlock *nq = _netQueueControlBlock[nwid];
-	if (nq) {
-		_netQueueControlBlock.erase(nwid);
-		delete nq;
-		nq = NULL;
-	}
+	Mutex::Lock _l(_aqm_m);
+	_netQueueControlBlock.erase(nwid);
+}
+
+ZT_QoSStats *Switch::qosStats(uint64_t nwid)
+{
+	Mutex::Lock _l(_aqm_m);
+	std::map< uint64_t,SharedPtr<NetworkQoSControlBlock> >::iterator nq(_netQueueControlBlock.find(nwid));
+	if (nq == _netQueueControlBlock.end())
+		return (ZT_QoSStats *)0;
+	char *buf = (char *)::malloc(sizeof(ZT_QoSStats) + sizeof(nq->second->stats));
+	if (!buf)
+		return (ZT_QoSStats *)0;
+	ZT_QoSStats *qs = (ZT_QoSStats *)buf;
+	qs->nwid = nwid;
+	qs->buckets = (ZT_QoSBucketStats *)(buf + sizeof(ZT_QoSStats));
+	qs->bucketCount = ZT_AQM_NUM_BUCKETS;
+	memcpy(qs->buckets,nq->second->stats,sizeof(nq->second->stats));
+	return qs;
 }
 
 void Switch::send(void *tPtr,Packet &packet,bool encrypt,int32_t flowId)
@@ -852,13 +862,7 @@ void Switch::send(void *tPtr,Packet &packet,bool encrypt,int32_t flowId)
 	if (dest == RR->identity.address())
 		return;
 	if (!_trySend(tPtr,packet,encrypt,flowId)) {
-		{
-			Mutex::Lock _l(_txQueue_m);
-			if (_txQueue.size() >= ZT_TX_QUEUE_SIZE) {
-				_txQueue.pop_front();
-			}
-			_txQueue.push_back(TXQueueEntry(dest,RR->node->now(),packet,encrypt,flowId));
-		}
+		_txQueueAdd(dest,RR->node->now(),packet,encrypt,flowId);
 		if (!RR->topology->getPeer(tPtr,dest))
 			requestWhois(tPtr,RR->node->now(),dest);
 	}
@@ -894,63 +898,105 @@ void Switch::doAnythingWaitingForPeer(void *tPtr,const SharedPtr<Peer> &peer)
 	}
 
 	const int64_t now = RR->node->now();
-	for(unsigned int ptr=0;ptr<ZT_RX_QUEUE_SIZE;++ptr) {
-		RXQueueEntry *const rq = &(_rxQueue[ptr]);
-		Mutex::Lock rql(rq->lock);
-		if ((rq->timestamp)&&(rq->complete)) {
-			if ((rq->frag0.tryDecode(RR,tPtr,rq->flowId))||((now - rq->timestamp) > ZT_RECEIVE_QUEUE_TIMEOUT))
-				rq->timestamp = 0;
+	std::vector<_RXWaiting> rxWaiting;
+	{
+		Mutex::Lock _l(_rxWaiting_m);
+		std::vector<_RXWaiting> *const w = _rxWaiting.get(peer->address());
+		if (w) {
+			rxWaiting.swap(*w);
+			_rxWaiting.erase(peer->address());
 		}
 	}
-
-	{
-		Mutex::Lock _l(_txQueue_m);
-		for(std::list< TXQueueEntry >::iterator txi(_txQueue.begin());txi!=_txQueue.end();) {
-			if (txi->dest == peer->address()) {
-				if (_trySend(tPtr,txi->packet,txi->encrypt,txi->flowId)) {
-					_txQueue.erase(txi++);
-				} else {
-					++txi;
-				}
+	for(std::vector<_RXWaiting>::const_iterator w(rxWaiting.begin());w!=rxWaiting.end();++w) {
+		RXQueueEntry *const rq = &(_rxQueue[w->slot]);
+		Mutex::Lock rql(rq->lock);
+		if (_rxWaitingValid(*w)) {
+			if (rq->frag0.tryDecode(RR,tPtr,rq->flowId)) {
+				rq->timestamp = 0;
+			} else if ((now - rq->timestamp) > ZT_RECEIVE_QUEUE_TIMEOUT) {
+				rq->timestamp = 0;
+				++_rxDroppedCount;
 			} else {
-				++txi;
+				_rxWaitingAdd(rq,false); // still waiting on something else
 			}
 		}
 	}
+
+	_txQueueFlush(tPtr,peer->address());
+}
+
+void Switch::pendingQueueStats(ZT_PendingQueueStats *stats)
+{
+	stats->txQueued = (uint64_t)_txQueuedCount.load();
+	stats->txDropped = (uint64_t)_txDroppedCount.load();
+	stats->rxQueued = (uint64_t)_rxQueuedCount.load();
+	stats->rxDropped = (uint64_t)_rxDroppedCount.load();
+	stats->txPacedDropped = (uint64_t)_pacedDroppedCount.load();
+	stats->txPaced = _pacedCount.load();
+	Mutex::Lock _l(_txQueue_m);
+	stats->txPending = _txQueueCount;
+	stats->txPendingBytes = _txQueueBytes;
 }
 
 unsigned long Switch::doTimerTasks(void *tPtr,int64_t now)
 {
+	aqm_dequeue(tPtr,ZT_AQM_MAX_ENQUEUED_PACKETS); // release anything left behind when traffic stops
+	if (_pacedCount)
+		_pacedFlush(tPtr,now);
+
 	const uint64_t timeSinceLastCheck = now - _lastCheckedQueues;
 	if (timeSinceLastCheck < ZT_WHOIS_RETRY_DELAY)
 		return (unsigned long)(ZT_WHOIS_RETRY_DELAY - timeSinceLastCheck);
 	_lastCheckedQueues = now;
 
-	std::vector<Address> needWhois;
+	std::vector<Address> needWhois,canSend;
 	{
 		Mutex::Lock _l(_txQueue_m);
-
-		for(std::list< TXQueueEntry >::iterator txi(_txQueue.begin());txi!=_txQueue.end();) {
-			if (_trySend(tPtr,txi->packet,txi->encrypt,txi->flowId)) {
-				_txQueue.erase(txi++);
-			} else if ((now - txi->creationTime) > ZT_TRANSMIT_QUEUE_TIMEOUT) {
-				_txQueue.erase(txi++);
-			} else {
-				if (!RR->topology->getPeer(tPtr,txi->dest))
-					needWhois.push_back(txi->dest);
-				++txi;
+		Hashtable< Address,std::list< TXQueueEntry > >::Iterator i(_txQueue);
+		Address *dest = (Address *)0;
+		std::list< TXQueueEntry > *q = (std::list< TXQueueEntry > *)0;
+		while (i.next(dest,q)) {
+			if (RR->topology->getPeer(tPtr,*dest)) {
+				canSend.push_back(*dest);
+				continue;
+			}
+			while ((!q->empty())&&((now - q->front().creationTime) > ZT_TRANSMIT_QUEUE_TIMEOUT)) {
+				--_txQueueCount;
+				_txQueueBytes -= sizeof(TXQueueEntry);
+				q->pop_front();
+				++_txDroppedCount;
 			}
+			if (q->empty())
+				_txQueue.erase(*dest);
+			else needWhois.push_back(*dest);
 		}
 	}
+	for(std::vector<Address>::const_iterator i(canSend.begin());i!=canSend.end();++i)
+		_txQueueFlush(tPtr,*i);
 	for(std::vector<Address>::const_iterator i(needWhois.begin());i!=needWhois.end();++i)
 		requestWhois(tPtr,now,*i);
 
+	{
+		Mutex::Lock _l(_rxWaiting_m);
+		Hashtable< Address,std::vector<_RXWaiting> >::Iterator i(_rxWaiting);
+		Address *src = (Address *)0;
+		std::vector<_RXWaiting> *w = (std::vector<_RXWaiting> *)0;
+		while (i.next(src,w)) {
+			w->erase(std::remove_if(w->begin(),w->end(),_RXWaitingStale(this)),w->end());
+			if (w->empty())
+				_rxWaiting.erase(*src);
+		}
+	}
+
 	for(unsigned int ptr=0;ptr<ZT_RX_QUEUE_SIZE;++ptr) {
 		RXQueueEntry *const rq = &(_rxQueue[ptr]);
 		Mutex::Lock rql(rq->lock);
 		if ((rq->timestamp)&&(rq->complete)) {
-			if ((rq->frag0.tryDecode(RR,tPtr,rq->flowId))||((now - rq->timestamp) > ZT_RECEIVE_QUEUE_TIMEOUT)) {
+			if (rq->frag0.tryDecode(RR,tPtr,rq->flowId)) {
+				rq->timestamp = 0;
+			} else if ((now - rq->timestamp) > ZT_RECEIVE_QUEUE_TIMEOUT) {
 				rq->timestamp = 0;
+				++_rxDroppedCount;
 			} else {
 				const Address src(rq->frag0.source());
 				if (!RR->topology->getPeer(tPtr,src))
@@ -984,6 +1030,139 @@ unsigned long Switch::doTimerTasks(void *tPtr,int64_t now)
 	return ZT_WHOIS_RETRY_DELAY;
 }
 
+void Switch::_txQueueAdd(const Address &dest,int64_t now,const Packet &packet,bool encrypt,int32_t flowId)
+{
+	Mutex::Lock _l(_txQueue_m);
+	if ((_txQueueBytes + sizeof(TXQueueEntry)) > ZT_TX_QUEUE_MAX_BYTES) {
+		++_txDroppedCount;
+		return;
+	}
+	std::list< TXQueueEntry > &q = _txQueue[dest];
+	if (q.size() >= ZT_TX_QUEUE_MAX_PER_ADDRESS) {
+		--_txQueueCount;
+		_txQueueBytes -= sizeof(TXQueueEntry);
+		q.pop_front();
+		++_txDroppedCount;
+	}
+	q.push_back(TXQueueEntry(dest,now,packet,encrypt,flowId));
+	++_txQueueCount;
+	_txQueueBytes += sizeof(TXQueueEntry);
+	++_txQueuedCount;
+}
+
+void Switch::_txQueueFlush(void *tPtr,const Address &dest)
+{
+	std::list< TXQueueEntry > q;
+	{
+		Mutex::Lock _l(_txQueue_m);
+		std::list< TXQueueEntry > *const dq = _txQueue.get(dest);
+		if (!dq)
+			return;
+		q.swap(*dq);
+		_txQueue.erase(dest);
+		for(std::list< TXQueueEntry >::const_iterator txi(q.begin());txi!=q.end();++txi) {
+			--_txQueueCount;
+			_txQueueBytes -= sizeof(TXQueueEntry);
+		}
+	}
+	for(std::list< TXQueueEntry >::iterator txi(q.begin());txi!=q.end();++txi) {
+		if (!_trySend(tPtr,txi->packet,txi->encrypt,txi->flowId)) {
+			// Put it back without counting it as newly queued
+			Mutex::Lock _l(_txQueue_m);
+			_txQueue[dest].push_back(*txi);
+			++_txQueueCount;
+			_txQueueBytes += sizeof(TXQueueEntry);
+		}
+	}
+}
+
+bool Switch::_pace(void *tPtr,const SharedPtr<Peer> &peer,const SharedPtr<Path> &viaPath,int64_t now,Packet &packet,bool encrypt,int32_t flowId)
+{
+	Mutex::Lock _l(_paced_m);
+	std::list< _PacedQueue >::iterator pq(_paced.begin());
+	while ((pq != _paced.end())&&(pq->path != viaPath))
+		++pq;
+	if ((pq != _paced.end())&&(_pacedRelease(tPtr,*pq,now))) {
+		_paced.erase(pq);
+		pq = _paced.end();
+	}
+	if (pq == _paced.end()) {
+		// Nothing held for this path, so the frame can go now if there are tokens
+		if (viaPath->paceTake(packet.size(),now))
+			return false;
+		pq = _paced.insert(_paced.end(),_PacedQueue());
+		pq->peer = peer;
+		pq->path = viaPath;
+	}
+	// The delay budget is in wire bytes, but every entry holds a full packet buffer however
+	// small its frame is, so memory is also capped at what full size frames would need.
+	const unsigned long limit = std::max((unsigned long)((viaPath->paceRate() * ZT_BOND_PACING_MAX_DELAY) / 8),(unsigned long)(ZT_MAX_PACKET_FRAGMENTS * ZT_DEFAULT_PHYSMTU));
+	const unsigned long heldLimit = ((limit / ZT_DEFAULT_PHYSMTU) + 1) * sizeof(TXQueueEntry);
+	if (((pq->bytes + packet.size()) > limit)||((pq->held + sizeof(TXQueueEntry)) > heldLimit)) {
+		++_pacedDroppedCount;
+		if (pq->q.empty())
+			_paced.erase(pq);
+		return true;
+	}
+	pq->q.push_back(TXQueueEntry(peer->address(),now,packet,encrypt,flowId));
+	pq->bytes += packet.size();
+	pq->held += sizeof(TXQueueEntry);
+	++_pacedCount;
+	return true;
+}
+
+bool Switch::_pacedRelease(void *tPtr,_PacedQueue &pq,int64_t now)
+{
+	// Frames are sent with _paced_m held so that nothing can overtake them
+	while ((!pq.q.empty())&&(pq.path->paceTake(pq.q.front().packet.size(),now))) {
+		TXQueueEntry &e = pq.q.front();
+		pq.bytes -= e.packet.size();
+		pq.held -= sizeof(TXQueueEntry);
+		--_pacedCount;
+		_sendViaSpecificPath(tPtr,pq.peer,pq.path,now,e.packet,e.encrypt,e.flowId);
+		pq.q.pop_front();
+	}
+	return pq.q.empty();
+}
+
+void Switch::_pacedFlush(void *tPtr,int64_t now)
+{
+	Mutex::Lock _l(_paced_m);
+	std::list< _PacedQueue >::iterator pq(_paced.begin());
+	while (pq != _paced.end()) {
+		if (_pacedRelease(tPtr,*pq,now))
+			_paced.erase(pq++);
+		else ++pq;
+	}
+}
+
+bool Switch::_rxWaitingHasRoom(const Address &source)
+{
+	Mutex::Lock _l(_rxWaiting_m);
+	std::vector<_RXWaiting> *const w = _rxWaiting.get(source);
+	if (!w)
+		return true;
+	w->erase(std::remove_if(w->begin(),w->end(),_RXWaitingStale(this)),w->end());
+	return (w->size() < ZT_RX_QUEUE_MAX_PER_ADDRESS);
+}
+
+bool Switch::_rxWaitingAdd(const RXQueueEntry *rq,bool enforceCap)
+{
+	const Address source(rq->frag0.source());
+	Mutex::Lock _l(_rxWaiting_m);
+	std::vector<_RXWaiting> &w = _rxWaiting[source];
+	if (enforceCap) {
+		w.erase(std::remove_if(w.begin(),w.end(),_RXWaitingStale(this)),w.end());
+		if (w.size() >= ZT_RX_QUEUE_MAX_PER_ADDRESS) {
+			++_rxDroppedCount;
+			return false;
+		}
+		++_rxQueuedCount;
+	}
+	w.push_back(_RXWaiting((unsigned int)(rq - _rxQueue),rq->packetId));
+	return true;
+}
+
 bool Switch::_shouldUnite(const int64_t now,const Address &source,const Address &destination)
 {
 	Mutex::Lock _l(_lastUniteAttempt_m);
@@ -995,6 +1174,89 @@ bool Switch::_shouldUnite(const int64_t now,const Address &source,const Address
 	return false;
 }
 
+bool Switch::_relayFast(void *tPtr,const int64_t now,const Address &destination,const void *data,unsigned int len,unsigned int hopsIdx,bool isFragment)
+{
+	RelayFastPath *const rfp = _relayFastPath;
+	if ((!rfp)||(len > ZT_PROTO_MAX_PACKET_LENGTH))
+		return false;
+
+	const uint8_t hopsByte = reinterpret_cast<const uint8_t *>(data)[hopsIdx];
+	const unsigned int hops = (isFragment) ? (unsigned int)hopsByte : (unsigned int)(hopsByte & 0x07);
+	if (hops >= ZT_RELAY_MAX_HOPS)
+		return false;
+
+	// Sequence lock read: if a writer is active or got in while we were copying, just miss.
+	const uint64_t a = destination.toInt();
+	RelayCacheEntry &e = rfp->routes[_relaySlot(a)];
+	const int seq = e.seq.load();
+	if ((seq & 1) != 0)
+		return false;
+	const uint64_t ea = e.address;
+	const int64_t ets = e.timestamp;
+	Path *const ep = e.path;
+	if ((e.seq.load() != seq)||(ea != a)||(!ep)||((now - ets) >= ZT_RELAY_CACHE_TTL))
+		return false;
+
+	// The wire buffer is const, so the only copy made is this one into a stack buffer.
+	uint8_t buf[ZT_PROTO_MAX_PACKET_LENGTH];
+	memcpy(buf,data,len);
+	if (isFragment)
+		buf[hopsIdx] = (uint8_t)((hopsByte + 1) & ZT_PROTO_MAX_HOPS);
+	else buf[hopsIdx] = (uint8_t)((hopsByte & 0xf8) | ((hopsByte + 1) & 0x07));
+
+	return ep->send(RR,tPtr,buf,len,now);
+}
+
+void Switch::_relayCacheUpdate(const Address &destination,const SharedPtr<Path> &path,const int64_t now)
+{
+	Mutex::Lock _l(_relayFastPath_m);
+	if (!_relayFastPath) {
+		RelayFastPath *const rfp = new RelayFastPath();
+#ifdef __GNUC__
+		__sync_synchronize(); // make sure entries are visible before the pointer is
+#endif
+		_relayFastPath = rfp;
+	}
+	const uint64_t a = destination.toInt();
+	RelayCacheEntry &e = _relayFastPath->routes[_relaySlot(a)];
+
+	// A reader may have picked up the old pointer just before we replace it, so
+	// keep replaced paths alive until no reader can still be inside a send.
+	std::deque< std::pair< int64_t,SharedPtr<Path> > > &retired = _relayFastPath->retired;
+	while ((!retired.empty())&&((now - retired.front().first) >= (ZT_RELAY_CACHE_TTL * 2)))
+		retired.pop_front();
+	if ((e.ref)&&(e.ref != path)) {
+		// Nothing here is old enough to release yet, so let this entry time out
+		// rather than grow the list without bound under heavy path churn.
+		if (retired.size() >= ZT_RELAY_CACHE_MAX_RETIRED)
+			return;
+		retired.push_back(std::pair< int64_t,SharedPtr<Path> >(now,e.ref));
+	}
+
+	++e.seq;
+	e.address = a;
+	e.timestamp = now;
+	e.path = path.ptr();
+	++e.seq;
+	e.ref = path;
+}
+
+bool Switch::_relayUnitedRecently(const int64_t now,const Address &source,const Address &destination)
+{
+	RelayFastPath *const rfp = _relayFastPath;
+	if (!rfp)
+		return false;
+	const _LastUniteKey k(source,destination);
+	RelayUniteEntry &e = rfp->unite[_relaySlot(k.x ^ (k.y << 24) ^ (k.y >> 40))];
+	if ((e.x == k.x)&&(e.y == k.y)&&((now - e.timestamp) < ZT_MIN_UNITE_INTERVAL))
+		return true;
+	// Entries may tear under concurrent writes, which just sends us to the locked check in _shouldUnite().
+	e.x = k.x;
+	e.y = k.y;
+	e.timestamp = now;
+	return false;
+}
+
 bool Switch::_trySend(void *tPtr,Packet &packet,bool encrypt,int32_t flowId)
 {
 	SharedPtr<Path> viaPath;
@@ -1027,6 +1289,8 @@ bool Switch::_trySend(void *tPtr,Packet &packet,bool encrypt,int32_t flowId)
 				}
 			}
 			if (viaPath) {
+				if ((viaPath->paceRate())&&((packet.verb() == Packet::VERB_FRAME)||(packet.verb() == Packet::VERB_EXT_FRAME))&&(_pace(tPtr,peer,viaPath,now,packet,encrypt,flowId)))
+					return true;
 				_sendViaSpecificPath(tPtr,peer,viaPath,now,packet,encrypt,flowId);
 				return true;
 			}
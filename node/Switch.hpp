@@ -18,6 +18,8 @@
 #include <set>
 #include <vector>
 #include <list>
+#include <deque>
+#include <atomic>
 
 #include "Constants.hpp"
 #include "Mutex.hpp"
@@ -30,6 +32,7 @@
 #include "SharedPtr.hpp"
 #include "IncomingPacket.hpp"
 #include "Hashtable.hpp"
+#include "AtomicCounter.hpp"
 
 /* Ethernet frame types that might be relevant to us */
 #define ZT_ETHERTYPE_IPV4 0x0800
@@ -56,18 +59,24 @@ class Peer;
  */
 class Switch
 {
+public:
 	struct ManagedQueue;
+	struct ManagedQueueEntry;
+	struct NetworkQoSControlBlock;
+
+private:
 	struct TXQueueEntry;
 
 	friend class SharedPtr<Peer>;
 
 	typedef struct {
-		TXQueueEntry *p;
+		ManagedQueueEntry *p;
 		bool ok_to_drop;
 	} dqr;
 
 public:
 	Switch(const RuntimeEnvironment *renv);
+	~Switch();
 
 	/**
 	 * Called when a packet is received from the real network
@@ -105,20 +114,23 @@ public:
 	 * @param t Current time
 	 * @param count Number of packets dropped this round
 	 */
-	uint64_t control_law(uint64_t t, int count);
+	static uint64_t control_law(uint64_t t, int count);
 
 	/**
-	 * Selects a packet eligible for transmission from a TX queue. According to the control law, multiple packets
-	 * may be intentionally dropped before a packet is returned to the AQM scheduler.
+	 * Removes the packet at the head of a flow queue and decides whether CoDel may drop it
 	 *
-	 * @param q The TX queue that is being dequeued from
+	 * @param q The flow queue that is being dequeued from
 	 * @param now Current time
 	 */
-	dqr dodequeue(ManagedQueue *q, uint64_t now);
+	static dqr dodequeue(ManagedQueue *q, uint64_t now);
 
 	/**
 	 * Presents a packet to the AQM scheduler.
 	 *
+	 * Packets are hashed by QoS bucket, flow ID and destination into one of
+	 * ZT_AQM_NUM_FLOW_QUEUES queues which are served by deficit round robin
+	 * with CoDel applied to each queue (fq_codel, RFC 8290).
+	 *
 	 * @param tPtr Thread pointer to be handed through to any callbacks called as a result of this call
 	 * @param network Network that the packet shall be sent over
 	 * @param packet Packet to be sent
@@ -128,20 +140,27 @@ public:
 	void aqm_enqueue(void *tPtr, const SharedPtr<Network> &network, Packet &packet,bool encrypt,int qosBucket,int32_t flowId = ZT_QOS_NO_FLOW);
 
 	/**
-	 * Performs a single AQM cycle and dequeues and transmits all eligible packets on all networks
+	 * Performs a single AQM cycle and dequeues and transmits eligible packets on all networks
+	 *
+	 * Packets are taken off their queues under _aqm_m and sent after it is released.
 	 *
 	 * @param tPtr Thread pointer to be handed through to any callbacks called as a result of this call
+	 * @param maxPackets Maximum number of packets to release per network
 	 */
-	void aqm_dequeue(void *tPtr);
+	void aqm_dequeue(void *tPtr,unsigned int maxPackets = ZT_AQM_DEQUEUE_BURST);
 
 	/**
-	 * Calls the dequeue mechanism and adjust queue state variables
+	 * Dequeues from a flow queue according to CoDel, dropping packets as the control law requires
 	 *
-	 * @param q The TX queue that is being dequeued from
-	 * @param isNew Whether or not this queue is in the NEW list
+	 * The caller must hold _aqm_m. Dropped packets are returned to the
+	 * network's packet pool and counted in its per-bucket statistics.
+	 *
+	 * @param nqcb Network QoS control block that owns the queue
+	 * @param q The flow queue that is being dequeued from
 	 * @param now Current time
+	 * @return Packet to send or NULL if the queue is empty
 	 */
-	Switch::TXQueueEntry * CoDelDequeue(ManagedQueue *q, bool isNew, uint64_t now);
+	static ManagedQueueEntry *CoDelDequeue(NetworkQoSControlBlock *nqcb, ManagedQueue *q, uint64_t now);
 
 	/**
 	 * Removes QoS Queues and flow state variables for a specific network. These queues are created
@@ -155,6 +174,16 @@ public:
 	 */
 	void removeNetworkQoSControlBlock(uint64_t nwid);
 
+	/**
+	 * Get per-bucket AQM statistics for a network
+	 *
+	 * The result is allocated with malloc() and must be freed with free().
+	 *
+	 * @param nwid Network ID
+	 * @return Statistics or NULL if no QoS control block exists for this network
+	 */
+	ZT_QoSStats *qosStats(uint64_t nwid);
+
 	/**
 	 * Send a packet to a ZeroTier address (destination in packet)
 	 *
@@ -192,6 +221,16 @@ public:
 	 */
 	void doAnythingWaitingForPeer(void *tPtr,const SharedPtr<Peer> &peer);
 
+	/**
+	 * @param stats Buffer to fill with current pending TX/RX queue counters
+	 */
+	void pendingQueueStats(ZT_PendingQueueStats *stats);
+
+	/**
+	 * @return True if frames are being held for paced paths and doTimerTasks() should run every ZT_BOND_PACING_INTERVAL
+	 */
+	inline bool pacing() const { return (_pacedCount != 0); }
+
 	/**
 	 * Perform retries and other periodic timer tasks
 	 *
@@ -208,6 +247,13 @@ private:
 	bool _shouldUnite(const int64_t now,const Address &source,const Address &destination);
 	bool _trySend(void *tPtr,Packet &packet,bool encrypt,int32_t flowId = ZT_QOS_NO_FLOW); // packet is modified if return is true
 	void _sendViaSpecificPath(void *tPtr,SharedPtr<Peer> peer,SharedPtr<Path> viaPath,int64_t now,Packet &packet,bool encrypt,int32_t flowId);
+	bool _relayFast(void *tPtr,const int64_t now,const Address &destination,const void *data,unsigned int len,unsigned int hopsIdx,bool isFragment);
+	void _relayCacheUpdate(const Address &destination,const SharedPtr<Path> &path,const int64_t now);
+	void _txQueueAdd(const Address &dest,int64_t now,const Packet &packet,bool encrypt,int32_t flowId);
+	void _txQueueFlush(void *tPtr,const Address &dest);
+	bool _pace(void *tPtr,const SharedPtr<Peer> &peer,const SharedPtr<Path> &viaPath,int64_t now,Packet &packet,bool encrypt,int32_t flowId);
+	void _pacedFlush(void *tPtr,int64_t now);
+	bool _relayUnitedRecently(const int64_t now,const Address &source,const Address &destination);
 
 	const RuntimeEnvironment *const RR;
 	int64_t _lastBeaconResponse;
@@ -253,6 +299,42 @@ private:
 		return &(_rxQueue[static_cast<unsigned int>((++_rxQueuePtr) - 1) % ZT_RX_QUEUE_SIZE]);
 	}
 
+	// Complete RX queue entries that could not yet be decoded, indexed by
+	// source so learning a peer only retries that peer's packets. Slots can
+	// be recycled by the ring, so entries are checked against the packet ID.
+	struct _RXWaiting
+	{
+		_RXWaiting() : slot(0),packetId(0) {}
+		_RXWaiting(unsigned int s,uint64_t pid) : slot(s),packetId(pid) {}
+		unsigned int slot;
+		uint64_t packetId;
+	};
+	Hashtable< Address,std::vector<_RXWaiting> > _rxWaiting;
+	Mutex _rxWaiting_m;
+	bool _rxWaitingHasRoom(const Address &source); // prunes stale entries, locks _rxWaiting_m
+	bool _rxWaitingAdd(const RXQueueEntry *rq,bool enforceCap); // caller must hold rq->lock
+	inline bool _rxWaitingValid(const _RXWaiting &w) const // caller must hold the slot's lock
+	{
+		const RXQueueEntry *const rq = &(_rxQueue[w.slot]);
+		return ((rq->timestamp)&&(rq->complete)&&(rq->packetId == w.packetId));
+	}
+	// Pruning runs under _rxWaiting_m, which is taken while holding slot locks,
+	// so busy slots are skipped (kept) rather than waited on.
+	struct _RXWaitingStale
+	{
+		_RXWaitingStale(const Switch *s) : sw(s) {}
+		inline bool operator()(const _RXWaiting &w) const
+		{
+			const Mutex &l = sw->_rxQueue[w.slot].lock;
+			if (!l.tryLock())
+				return false;
+			const bool stale = !sw->_rxWaitingValid(w);
+			l.unlock();
+			return stale;
+		}
+		const Switch *sw;
+	};
+
 	// ZeroTier-layer TX queue entry
 	struct TXQueueEntry
 	{
@@ -270,8 +352,31 @@ private:
 		bool encrypt;
 		int32_t flowId;
 	};
-	std::list< TXQueueEntry > _txQueue;
+	Hashtable< Address,std::list< TXQueueEntry > > _txQueue; // indexed by destination
+	unsigned long _txQueueCount;
+	unsigned long _txQueueBytes;
 	Mutex _txQueue_m;
+
+	// Frames held in order for each paced path until its token bucket has room (see Path::paceTake)
+	struct _PacedQueue
+	{
+		_PacedQueue() : bytes(0),held(0) {}
+		SharedPtr<Peer> peer;
+		SharedPtr<Path> path;
+		std::list< TXQueueEntry > q;
+		unsigned long bytes; // wire bytes waiting, for the delay budget
+		unsigned long held; // memory held, charged as sizeof(TXQueueEntry) per frame
+	};
+	std::list< _PacedQueue > _paced;
+	std::atomic<unsigned long> _pacedCount;
+	AtomicCounter _pacedDroppedCount;
+	Mutex _paced_m;
+	bool _pacedRelease(void *tPtr,_PacedQueue &pq,int64_t now); // caller must hold _paced_m, returns true if emptied
+
+	AtomicCounter _txQueuedCount;
+	AtomicCounter _txDroppedCount;
+	AtomicCounter _rxQueuedCount;
+	AtomicCounter _rxDroppedCount;
 	Mutex _aqm_m;
 
 	// Tracks sending of VERB_RENDEZVOUS to relaying peers
@@ -295,34 +400,178 @@ private:
 	Hashtable< _LastUniteKey,uint64_t > _lastUniteAttempt; // key is always sorted in ascending order, for set-like behavior
 	Mutex _lastUniteAttempt_m;
 
-	// Queue with additional flow state variables
+	// Relay fast path: best direct path by destination, read without locks.
+	// Readers use seq as a sequence lock (odd while an update is in progress)
+	// and simply fall back to the slow path on any mismatch or race. The path
+	// reference is held by the writer; readers only ever see the raw pointer.
+	struct RelayCacheEntry
+	{
+		RelayCacheEntry() : address(0),timestamp(0),path((Path *)0) {}
+		AtomicCounter seq;
+		uint64_t address;
+		int64_t timestamp;
+		Path *volatile path;
+		SharedPtr<Path> ref;
+	};
+
+	// Lossy filter in front of _lastUniteAttempt so relaying doesn't take its lock per packet
+	struct RelayUniteEntry
+	{
+		RelayUniteEntry() : x(0),y(0),timestamp(0) {}
+		volatile uint64_t x,y;
+		volatile int64_t timestamp;
+	};
+
+	struct RelayFastPath
+	{
+		RelayCacheEntry routes[ZT_RELAY_CACHE_SIZE];
+		RelayUniteEntry unite[ZT_RELAY_CACHE_SIZE];
+		std::deque< std::pair< int64_t,SharedPtr<Path> > > retired; // replaced paths kept alive for readers still using them, oldest first
+	};
+	RelayFastPath *volatile _relayFastPath; // allocated on first relay by a root or moon
+	Mutex _relayFastPath_m; // serializes writers only
+
+	static inline unsigned int _relaySlot(const uint64_t k) { return (unsigned int)((k * 0x9e3779b97f4a7c15ULL) >> 32) & (ZT_RELAY_CACHE_SIZE - 1); }
+
+public:
+	// The fq_codel scheduler below only needs a clock, so selftest can drive
+	// a NetworkQoSControlBlock directly without a running node.
+
+	// Queued packet in a pooled buffer, linked into at most one flow queue or the free list
+	struct ManagedQueueEntry
+	{
+		ManagedQueueEntry *next;
+		uint64_t creationTime;
+		unsigned int length; // payload length, used for byte accounting
+		int bucket;
+		bool encrypt;
+		int32_t flowId;
+		Packet packet; // unencrypted/unMAC'd packet -- this is done at send time
+	};
+
+	// Flow queue with CoDel state, linked into the NEW or OLD list while active
 	struct ManagedQueue
 	{
-		ManagedQueue(int id) :
-			id(id),
-			byteCredit(ZT_AQM_QUANTUM),
+		ManagedQueue() :
+			head((ManagedQueueEntry *)0),
+			tail((ManagedQueueEntry *)0),
+			nextActive((ManagedQueue *)0),
+			byteCredit(0),
 			byteLength(0),
+			active(false),
+			first_above_time(0),
+			count(0),
+			lastcount(0),
+			drop_next(0),
 			dropping(false)
 		{}
-		int id;
+		ManagedQueueEntry *head;
+		ManagedQueueEntry *tail;
+		ManagedQueue *nextActive;
 		int byteCredit;
 		int byteLength;
+		bool active;
 		uint64_t first_above_time;
 		uint32_t count;
+		uint32_t lastcount;
 		uint64_t drop_next;
 		bool dropping;
-		uint64_t drop_next_time;
-		std::list< TXQueueEntry *> q;
 	};
-	// To implement fq_codel we need to maintain a queue of queues
+
+	// Singly linked FIFO of active flow queues
+	struct ManagedQueueList
+	{
+		ManagedQueueList() : head((ManagedQueue *)0),tail((ManagedQueue *)0) {}
+		inline void push(ManagedQueue *q)
+		{
+			q->nextActive = (ManagedQueue *)0;
+			if (tail) tail->nextActive = q; else head = q;
+			tail = q;
+		}
+		inline ManagedQueue *pop()
+		{
+			ManagedQueue *const q = head;
+			if (q) {
+				head = q->nextActive;
+				if (!head) tail = (ManagedQueue *)0;
+			}
+			return q;
+		}
+		ManagedQueue *head;
+		ManagedQueue *tail;
+	};
+
+	// fq_codel state for one network: flow queues, the NEW/OLD lists of active
+	// queues, a free list of packet buffers that grows on demand up to
+	// ZT_AQM_MAX_ENQUEUED_PACKETS, and statistics per QoS bucket. Entries
+	// handed out by dequeue() still count against that limit until they are
+	// given back with freeEntry().
 	struct NetworkQoSControlBlock
 	{
-		int _currEnqueuedPackets;
-		std::vector<ManagedQueue *> newQueues;
-		std::vector<ManagedQueue *> oldQueues;
-		std::vector<ManagedQueue *> inactiveQueues;
+		NetworkQoSControlBlock();
+		~NetworkQoSControlBlock();
+
+		/**
+		 * Queue a copy of a packet, dropping from the largest flow queue if full
+		 *
+		 * @param packet Packet to queue
+		 * @param encrypt Encrypt packet payload when it is sent?
+		 * @param qosBucket QoS bucket (out of range values select ZT_AQM_DEFAULT_BUCKET)
+		 * @param flowId Flow ID
+		 * @param now Current time
+		 */
+		void enqueue(const Packet &packet,bool encrypt,int qosBucket,int32_t flowId,uint64_t now);
+
+		/**
+		 * Pick the next packet to send by deficit round robin, NEW queues first, with CoDel on each queue
+		 *
+		 * @param now Current time
+		 * @return Entry to send (give back with freeEntry()) or NULL if nothing is queued
+		 */
+		ManagedQueueEntry *dequeue(uint64_t now);
+
+		inline ManagedQueueEntry *allocEntry()
+		{
+			ManagedQueueEntry *e = freeEntries;
+			if (e) {
+				freeEntries = e->next;
+			} else if (allocatedEntries < ZT_AQM_MAX_ENQUEUED_PACKETS) {
+				e = new ManagedQueueEntry();
+				++allocatedEntries;
+			}
+			return e;
+		}
+		inline void freeEntry(ManagedQueueEntry *e)
+		{
+			e->next = freeEntries;
+			freeEntries = e;
+		}
+		inline ManagedQueueEntry *popEntry(ManagedQueue *q)
+		{
+			ManagedQueueEntry *const e = q->head;
+			if (e) {
+				q->head = e->next;
+				if (!q->head) q->tail = (ManagedQueueEntry *)0;
+				q->byteLength -= (int)e->length;
+				--enqueuedPackets;
+				--stats[e->bucket].backlogPackets;
+				stats[e->bucket].backlogBytes -= e->length;
+			}
+			return e;
+		}
+
+		ManagedQueue queues[ZT_AQM_NUM_FLOW_QUEUES];
+		ManagedQueueList newQueues;
+		ManagedQueueList oldQueues;
+		ManagedQueueEntry *freeEntries;
+		unsigned int allocatedEntries;
+		unsigned int enqueuedPackets;
+		ZT_QoSBucketStats stats[ZT_AQM_NUM_BUCKETS];
+		AtomicCounter __refCount;
 	};
-	std::map<uint64_t,NetworkQoSControlBlock*> _netQueueControlBlock;
+
+private:
+	std::map< uint64_t,SharedPtr<NetworkQoSControlBlock> > _netQueueControlBlock; // guarded by _aqm_m
 };
 
 } // namespace ZeroTier
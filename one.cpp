@@ -674,6 +674,47 @@ static int cli(int argc,char **argv)
 				}
 				return 2;
 			}
+			if (arg2 == "events") { /* zerotier-cli bond <peerId> events */
+				const unsigned int scode = Http::GET(
+					1024 * 1024 * 16,60000,
+					(const struct sockaddr *)&addr,(std::string("/bond/") + arg2 + "/" + arg1).c_str(),
+					requestHeaders,
+					responseHeaders,
+					responseBody);
+				if (scode == 0) {
+					printf("Error connecting to the ZeroTier service: %s\n\nPlease check that the service is running and that TCP port 9993 can be contacted via 127.0.0.1." ZT_EOL_S, responseBody.c_str());
+					return 1;
+				}
+				nlohmann::json j;
+				try {
+					j = OSUtils::jsonParse(responseBody);
+				} catch (std::exception &exc) {
+					printf("%u %s invalid JSON response (%s)" ZT_EOL_S,scode,command.c_str(),exc.what());
+					return 1;
+				} catch ( ... ) {
+					printf("%u %s invalid JSON response (unknown exception)" ZT_EOL_S,scode,command.c_str());
+					return 1;
+				}
+				if (scode == 200) {
+					if (json) {
+						printf("%s" ZT_EOL_S,OSUtils::jsonDump(j).c_str());
+					} else {
+						nlohmann::json &e = j["events"];
+						if (e.is_array()) {
+							for (unsigned long i=0; i<e.size(); i++) {
+								printf("%8llu %13lld %s" ZT_EOL_S,
+									(unsigned long long)OSUtils::jsonInt(e[i]["seq"],0),
+									(long long)OSUtils::jsonInt(e[i]["timestamp"],0),
+									OSUtils::jsonString(e[i]["message"],"-").c_str());
+							}
+						}
+					}
+					return 0;
+				} else {
+					printf("%u %s %s" ZT_EOL_S,scode,command.c_str(),responseBody.c_str());
+					return 1;
+				}
+			}
 		}
 		/* zerotier-cli bond command was malformed in some way */
 		printf("(bond) command is missing required arugments" ZT_EOL_S);
@@ -20,6 +20,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <thread>
 
 #include "node/Constants.hpp"
@@ -41,8 +42,16 @@
 #include "node/CertificateOfMembership.hpp"
 #include "node/Node.hpp"
 #include "node/IncomingPacket.hpp"
+#include "node/Multicaster.hpp"
+#include "node/Resequencer.hpp"
+#include "node/Fec.hpp"
+#include "node/Ewma.hpp"
+#include "node/Flow.hpp"
+#include "node/Switch.hpp"
 
 #include "osdep/OSUtils.hpp"
+#include "controller/FileDB.hpp"
+#include "controller/LogDB.hpp"
 #include "osdep/Phy.hpp"
 #include "osdep/PortMapper.hpp"
 #include "osdep/Thread.hpp"
@@ -652,6 +661,598 @@ static int testPacket()
 	return 0;
 }
 
+// Walks a replication tree the way Multicaster::replicate() and the receive
+// path do, counting deliveries per member and tracking depth and fan-out.
+// Only the origin's split is limited by packet size; below it pieces only shrink.
+static void _simulateMulticastTree(const Address *members,unsigned int count,unsigned int fanout,unsigned int maxSubtree,unsigned int depth,Hashtable<Address,unsigned int> &deliveries,unsigned int &maxDepth,unsigned int &maxChildren)
+{
+	if (!count)
+		return;
+	const unsigned int chunk = Multicaster::treeChunkSize(count,fanout,(depth) ? count : maxSubtree);
+	unsigned int children = 0;
+	for(unsigned int start=0;start<count;start+=chunk) {
+		const unsigned int end = std::min(start + chunk,count);
+		++deliveries[members[start]];
+		++children;
+		if ((depth + 1) > maxDepth)
+			maxDepth = depth + 1;
+		_simulateMulticastTree(members + start + 1,end - (start + 1),fanout,maxSubtree,depth + 1,deliveries,maxDepth,maxChildren);
+	}
+	if (children > maxChildren)
+		maxChildren = children;
+}
+
+static int testMulticastTree()
+{
+	static const unsigned int FRAME_LEN = 1400;
+	static const unsigned int HOP_LATENCY = 20; // modeled one-way latency per hop in ms
+	static const unsigned int sizes[3] = { 100,1000,10000 };
+
+	const MulticastGroup mg(MAC(0x01,0x00,0x5e,0x00,0x00,0x01),0);
+	const unsigned int maxSubtree = Multicaster::treeMaxPart(ZT_C25519_SIGNATURE_LEN,FRAME_LEN) - 1;
+
+	std::cout << "[multicast] Testing tree replication coverage... ";
+	for(unsigned int s=0;s<3;++s) {
+		std::vector<Address> members;
+		for(unsigned int i=0;i<sizes[s];++i)
+			members.push_back(Address(((uint64_t)rand() << 20) ^ (uint64_t)i ^ 0x1000000000ULL));
+		Multicaster::treeOrder(mg,&(members[0]),(unsigned int)members.size());
+		std::vector<Address> reordered(members);
+		Multicaster::treeOrder(mg,&(reordered[0]),(unsigned int)reordered.size());
+		if (reordered != members) {
+			std::cout << "FAIL (tree order not deterministic)" << std::endl;
+			return -1;
+		}
+
+		Hashtable<Address,unsigned int> deliveries;
+		unsigned int maxDepth = 0,maxChildren = 0;
+		_simulateMulticastTree(&(members[0]),(unsigned int)members.size(),ZT_MULTICAST_TREE_FANOUT,maxSubtree,0,deliveries,maxDepth,maxChildren);
+		for(std::vector<Address>::const_iterator a(members.begin());a!=members.end();++a) {
+			const unsigned int *const d = deliveries.get(*a);
+			if ((!d)||(*d != 1)) {
+				std::cout << "FAIL (member " << a->toInt() << " reached " << ((d) ? *d : 0) << " times)" << std::endl;
+				return -1;
+			}
+		}
+		if (maxChildren > ((sizes[s] / (maxSubtree + 1)) + ZT_MULTICAST_TREE_FANOUT)) {
+			std::cout << "FAIL (fan-out " << maxChildren << " too high)" << std::endl;
+			return -1;
+		}
+		std::cout << sizes[s] << ":depth=" << maxDepth << ",fanout=" << maxChildren << " ";
+	}
+	std::cout << "PASS" << std::endl;
+
+	std::cout << "[multicast] Testing tree replay window... ";
+	{
+		Multicaster mc((const RuntimeEnvironment *)0);
+		const Address origin(0x1234567890ULL);
+		const uint64_t base = 1000000;
+		bool ok = mc.treeCheckReplay(origin,base,0);
+		ok &= !mc.treeCheckReplay(origin,base,0);
+		ok &= mc.treeCheckReplay(origin,base + 10,0);
+		ok &= mc.treeCheckReplay(origin,base + 5,0); // late but within the window
+		ok &= !mc.treeCheckReplay(origin,base + 5,0);
+		ok &= mc.treeCheckReplay(origin,base + 100,0);
+		ok &= !mc.treeCheckReplay(origin,base + 10,0); // fell out of the window
+		ok &= mc.treeCheckReplay(Address(0x0987654321ULL),base,0);
+		if (!ok) {
+			std::cout << "FAIL" << std::endl;
+			return -1;
+		}
+	}
+	std::cout << "PASS" << std::endl;
+
+	// Sender cost is dominated by per-recipient packet armoring, so measure
+	// that and the origin's signature and model each replication strategy.
+	// Each tree hop is modeled at the origin's cost (one signature per signed
+	// part or a verify, plus k sends) plus a fixed network latency.
+	unsigned char key[32];
+	for(unsigned int i=0;i<32;++i)
+		key[i] = (unsigned char)rand();
+	unsigned char frame[FRAME_LEN];
+	Utils::getSecureRandom(frame,sizeof(frame));
+	Packet p(Address(),Address(),Packet::VERB_MULTICAST_FRAME);
+	p.append(frame,sizeof(frame));
+	const Packet pristine(p);
+
+	std::cout << "[multicast] Benchmarking flat vs. tree replication (" << FRAME_LEN << " byte frames, k=" << ZT_MULTICAST_TREE_FANOUT << ")... ";
+	int64_t start = OSUtils::now();
+	for(unsigned int i=0;i<10000;++i) {
+		p = pristine;
+		p.armor(key,true,nullptr);
+	}
+	const double armorUs = ((double)(OSUtils::now() - start) * 1000.0) / 10000.0;
+	Identity id;
+	id.generate();
+	start = OSUtils::now();
+	for(unsigned int i=0;i<100;++i)
+		id.sign(frame,sizeof(frame));
+	const double signUs = ((double)(OSUtils::now() - start) * 1000.0) / 100.0;
+	std::cout << "(armor: " << armorUs << "us, sign: " << signUs << "us)" << std::endl;
+
+	for(unsigned int s=0;s<3;++s) {
+		unsigned int depth = 0;
+		for(unsigned int reach=0,level=1;reach<sizes[s];++depth) {
+			level *= ZT_MULTICAST_TREE_FANOUT;
+			reach += level;
+		}
+		const double flatCpu = armorUs * (double)sizes[s];
+		const unsigned int chunk = Multicaster::treeChunkSize(sizes[s],ZT_MULTICAST_TREE_FANOUT,maxSubtree);
+		const unsigned int parts = (sizes[s] / chunk) + (((sizes[s] % chunk) != 0) ? 1 : 0);
+		const double treeCpu = (signUs + armorUs) * (double)parts; // one signed part per child
+		std::cout << "[multicast]   " << sizes[s] << " members: sender CPU flat " << flatCpu << "us, tree " << treeCpu << "us; modeled last delivery flat " << ((flatCpu / 1000.0) + HOP_LATENCY) << "ms, tree " << (((treeCpu / 1000.0) + HOP_LATENCY) * (double)depth) << "ms (depth " << depth << ")" << std::endl;
+	}
+
+	return 0;
+}
+
+struct _ResequencerRecorder
+{
+	inline void operator()(uint64_t nwid,const MAC &from,const MAC &to,unsigned int etherType,const void *data,unsigned int len) { delivered.push_back(*reinterpret_cast<const uint32_t *>(data)); }
+	std::vector<uint32_t> delivered;
+};
+
+static int testResequencer()
+{
+	static const uint32_t order[10] = { 0,2,1,3,6,5,4,7,9,8 };
+
+	std::cout << "[resequencer] Testing in-order delivery of reordered frames... ";
+	Resequencer rs;
+	_ResequencerRecorder rec;
+	const MAC m;
+	for(unsigned int i=0;i<10;++i) {
+		const uint32_t seq = 1000 + order[i];
+		rs.receive(1,seq,100,1,m,m,0x0800,&seq,4,rec);
+	}
+	for(unsigned int i=0;i<10;++i) {
+		if ((rec.delivered.size() != 10)||(rec.delivered[i] != (1000 + i))) {
+			std::cout << "FAIL (frame " << i << " out of order)" << std::endl;
+			return -1;
+		}
+	}
+	std::cout << "PASS" << std::endl;
+
+	std::cout << "[resequencer] Testing gap release on timeout... ";
+	rec.delivered.clear();
+	rs.setTimeout(20);
+	uint32_t seq = 1011;
+	rs.receive(1,seq,200,1,m,m,0x0800,&seq,4,rec);
+	rs.expire(210,rec);
+	if (!rec.delivered.empty()) {
+		std::cout << "FAIL (released before timeout)" << std::endl;
+		return -1;
+	}
+	rs.expire(230,rec);
+	seq = 1010;
+	rs.receive(1,seq,240,1,m,m,0x0800,&seq,4,rec);
+	if ((rec.delivered.size() != 2)||(rec.delivered[0] != 1011)||(rec.delivered[1] != 1010)||(rs.counters().lateReleases != 1)||(rs.counters().late != 1)) {
+		std::cout << "FAIL (gap not skipped)" << std::endl;
+		return -1;
+	}
+	std::cout << "PASS" << std::endl;
+
+	return 0;
+}
+
+static int testAqm()
+{
+	uint8_t payload[1000];
+	memset(payload,0,sizeof(payload));
+	Packet outp(Address(0x1122334455ULL),Address(0x0102030405ULL),Packet::VERB_FRAME);
+	outp.append(payload,sizeof(payload));
+
+	std::cout << "[aqm] Testing deficit round robin between flows... ";
+	Switch::NetworkQoSControlBlock *cb = new Switch::NetworkQoSControlBlock();
+	for(unsigned int i=0;i<100;++i) {
+		cb->enqueue(outp,true,ZT_AQM_DEFAULT_BUCKET,1,0);
+		cb->enqueue(outp,true,ZT_AQM_DEFAULT_BUCKET,2,0);
+	}
+	unsigned int perFlow[3] = { 0,0,0 };
+	for(unsigned int i=0;i<60;++i) {
+		Switch::ManagedQueueEntry *const e = cb->dequeue(1);
+		if (!e) {
+			std::cout << "FAIL (queue ran dry)" << std::endl;
+			return -1;
+		}
+		++perFlow[e->flowId];
+		cb->freeEntry(e);
+	}
+	if ((perFlow[1] + perFlow[2] != 60)||(perFlow[1] > perFlow[2] + (ZT_AQM_QUANTUM / sizeof(payload)) + 1)||(perFlow[2] > perFlow[1] + (ZT_AQM_QUANTUM / sizeof(payload)) + 1)) {
+		std::cout << "FAIL (" << perFlow[1] << " vs " << perFlow[2] << " packets)" << std::endl;
+		return -1;
+	}
+	std::cout << perFlow[1] << "/" << perFlow[2] << " PASS" << std::endl;
+
+	std::cout << "[aqm] Testing that a new sparse flow goes first... ";
+	cb->enqueue(outp,true,ZT_AQM_DEFAULT_BUCKET,3,2);
+	Switch::ManagedQueueEntry *const sparse = cb->dequeue(2);
+	if ((!sparse)||(sparse->flowId != 3)) {
+		std::cout << "FAIL" << std::endl;
+		return -1;
+	}
+	cb->freeEntry(sparse);
+	if ((cb->stats[ZT_AQM_DEFAULT_BUCKET].codelDrops != 0)||(cb->stats[ZT_AQM_DEFAULT_BUCKET].backlogPackets != 140)) {
+		std::cout << "FAIL (unexpected drops or backlog)" << std::endl;
+		return -1;
+	}
+	std::cout << "PASS" << std::endl;
+	delete cb;
+
+	std::cout << "[aqm] Testing CoDel drops on a standing queue... ";
+	cb = new Switch::NetworkQoSControlBlock();
+	for(unsigned int i=0;i<300;++i)
+		cb->enqueue(outp,true,ZT_AQM_DEFAULT_BUCKET,1,0);
+	uint64_t now = 10;
+	unsigned int sent = 0;
+	for(;;) {
+		Switch::ManagedQueueEntry *const e = cb->dequeue(now);
+		if (!e)
+			break;
+		++sent;
+		cb->freeEntry(e);
+		now += 2;
+	}
+	const ZT_QoSBucketStats &st = cb->stats[ZT_AQM_DEFAULT_BUCKET];
+	if ((st.codelDrops == 0)||(sent + st.codelDrops != 300)||(st.sent != sent)||(st.backlogPackets != 0)||(now < (10 + ZT_AQM_INTERVAL))) {
+		std::cout << "FAIL (sent " << sent << ", dropped " << st.codelDrops << ")" << std::endl;
+		return -1;
+	}
+	std::cout << "sent " << sent << ", dropped " << st.codelDrops << " PASS" << std::endl;
+	delete cb;
+
+	std::cout << "[aqm] Testing overflow drops when the scheduler is full... ";
+	cb = new Switch::NetworkQoSControlBlock();
+	for(unsigned int i=0;i<(ZT_AQM_MAX_ENQUEUED_PACKETS + 10);++i)
+		cb->enqueue(outp,true,(int)(i % 2),(int32_t)(i % 2),0);
+	if ((cb->enqueuedPackets != ZT_AQM_MAX_ENQUEUED_PACKETS)||((cb->stats[0].overflowDrops + cb->stats[1].overflowDrops) != 10)) {
+		std::cout << "FAIL" << std::endl;
+		return -1;
+	}
+	std::cout << "PASS" << std::endl;
+	delete cb;
+
+	return 0;
+}
+
+struct _FecSimPacket
+{
+	double arrival;
+	bool parity;
+	unsigned int frame;
+	uint32_t group;
+	unsigned int index;
+	std::vector<uint8_t> payload;
+	inline bool operator<(const _FecSimPacket &p) const { return (arrival < p.arrival); }
+};
+
+static uint64_t _fecSimRandom(uint64_t &state)
+{
+	state = (state * 6364136223846793005ULL) + 1442695040888963407ULL;
+	return (state >> 33);
+}
+
+static int testFec()
+{
+	static const unsigned int FRAMES = 20000;
+	static const unsigned int FRAME_LEN = 1000;
+	static const unsigned int FEC_AT = ZT_PROTO_VERB_EXT_FRAME_IDX_BOND_SEQUENCE - ZT_PACKET_IDX_PAYLOAD;
+	static const unsigned int DATA_AT = FEC_AT + ZT_PROTO_VERB_EXT_FRAME_LEN_BOND_FEC + 6 + 6 + 2;
+	static const double SEND_INTERVAL = 0.1; // ms between frames
+	static const double RTO = 200.0; // ms before an unrepaired loss is retransmitted
+	static const double linkLatency[2] = { 20.0,45.0 }; // DSL, LTE
+	static const double linkLoss[2] = { 0.01,0.03 };
+
+	const MAC m(0x32,0x11,0x22,0x33,0x44,0x55);
+	const unsigned int adaptive = (unsigned int)std::max((float)ZT_BOND_FEC_MIN_GROUP,std::min((float)ZT_BOND_FEC_MAX_GROUP,ZT_BOND_FEC_GROUP_LOSS / (float)linkLoss[1]));
+	const unsigned int groupSizes[3] = { 0,adaptive,ZT_BOND_FEC_MAX_GROUP };
+
+	std::cout << "[fec] Benchmarking goodput and tail latency over " << linkLatency[0] << "ms/" << (linkLoss[0] * 100.0) << "% and " << linkLatency[1] << "ms/" << (linkLoss[1] * 100.0) << "% links (" << FRAMES << " frames)..." << std::endl;
+	for(unsigned int g=0;g<4;++g) {
+		const unsigned int groupSize = (g < 3) ? groupSizes[g] : 0;
+		const bool broadcast = (g == 3);
+		uint64_t prng = 0x1234567ULL;
+		std::vector<_FecSimPacket> wire;
+		std::vector<double> sent(FRAMES),delivered(FRAMES,-1.0);
+		unsigned int packetsSent = 0,link = 0;
+		Fec::Encoder enc;
+
+		for(unsigned int f=0;f<FRAMES;++f) {
+			const double now = (double)f * SEND_INTERVAL;
+			sent[f] = now;
+			Packet p(Address(),Address(),Packet::VERB_EXT_FRAME);
+			p.append((uint64_t)0x8056c2e21c000001ULL);
+			p.append((uint8_t)0x40);
+			p.append((uint32_t)0);
+			p.append((uint8_t)0);
+			m.appendTo(p);
+			m.appendTo(p);
+			p.append((uint16_t)0x0800);
+			p.append((uint32_t)f);
+			p.addSize(FRAME_LEN - 4);
+			bool parity = false;
+			if (groupSize)
+				parity = enc.add(p,FEC_AT,groupSize,(int64_t)now);
+			for(unsigned int c=0;c<((broadcast) ? 2 : 1);++c) {
+				_FecSimPacket sp;
+				sp.parity = false;
+				sp.frame = f;
+				sp.group = p.at<uint32_t>(ZT_PACKET_IDX_PAYLOAD + FEC_AT);
+				sp.index = p[ZT_PACKET_IDX_PAYLOAD + FEC_AT + 4];
+				sp.arrival = ((_fecSimRandom(prng) % 1000000) < (uint64_t)(linkLoss[link] * 1000000.0)) ? -1.0 : (now + linkLatency[link]);
+				sp.payload.resize(p.size() - ZT_PACKET_IDX_PAYLOAD);
+				memcpy(sp.payload.data(),reinterpret_cast<const uint8_t *>(p.data()) + ZT_PACKET_IDX_PAYLOAD,sp.payload.size());
+				wire.push_back(sp);
+				++packetsSent;
+				link ^= 1;
+			}
+			if (parity) {
+				Packet pp(Address(),Address(),Packet::VERB_BOND_PARITY);
+				enc.parity(pp);
+				_FecSimPacket sp;
+				sp.parity = true;
+				sp.frame = 0;
+				sp.group = pp.at<uint32_t>(ZT_PACKET_IDX_PAYLOAD);
+				sp.index = pp[ZT_PACKET_IDX_PAYLOAD + 4];
+				sp.arrival = ((_fecSimRandom(prng) % 1000000) < (uint64_t)(linkLoss[link] * 1000000.0)) ? -1.0 : (now + linkLatency[link]);
+				sp.payload.resize(pp.size() - (ZT_PACKET_IDX_PAYLOAD + 5));
+				memcpy(sp.payload.data(),reinterpret_cast<const uint8_t *>(pp.data()) + ZT_PACKET_IDX_PAYLOAD + 5,sp.payload.size());
+				wire.push_back(sp);
+				++packetsSent;
+				link ^= 1;
+			}
+		}
+
+		std::sort(wire.begin(),wire.end());
+		Fec::Decoder dec;
+		uint8_t out[ZT_FEC_MAX_BLOCK];
+		unsigned int outLen = 0;
+		for(std::vector<_FecSimPacket>::const_iterator w(wire.begin());w!=wire.end();++w) {
+			if (w->arrival < 0.0)
+				continue;
+			int r = 0;
+			if (w->parity) {
+				r = dec.parity(w->group,w->index,w->payload.data(),(unsigned int)w->payload.size(),out,outLen);
+			} else {
+				if (groupSize) {
+					r = dec.frame(w->group,w->index,w->payload.data(),(unsigned int)w->payload.size(),FEC_AT,out,outLen);
+					if (r < 0)
+						continue;
+				}
+				if (delivered[w->frame] < 0.0)
+					delivered[w->frame] = w->arrival;
+			}
+			if (r > 0) {
+				const unsigned int f = Utils::ntoh(*reinterpret_cast<const uint32_t *>(out + DATA_AT - ZT_PROTO_VERB_EXT_FRAME_LEN_BOND_FEC));
+				if ((f >= FRAMES)||(outLen != (DATA_AT - ZT_PROTO_VERB_EXT_FRAME_LEN_BOND_FEC + FRAME_LEN))||(out[ZT_FEC_FLAGS_OFFSET] != 0)||(delivered[f] >= 0.0)) {
+					std::cout << "[fec]   FAIL (bad frame rebuilt from parity)" << std::endl;
+					return -1;
+				}
+				delivered[f] = w->arrival;
+			}
+		}
+
+		unsigned int retransmits = 0;
+		std::vector<double> latency(FRAMES);
+		for(unsigned int f=0;f<FRAMES;++f) {
+			if (delivered[f] < 0.0) {
+				++retransmits;
+				++packetsSent;
+				delivered[f] = sent[f] + RTO + linkLatency[0];
+			}
+			latency[f] = delivered[f] - sent[f];
+		}
+		std::sort(latency.begin(),latency.end());
+		if ((g == 1)&&(retransmits * 4 > (unsigned int)((linkLoss[0] + linkLoss[1]) * 0.5 * (double)FRAMES))) {
+			std::cout << "[fec]   FAIL (parity repaired too few losses: " << retransmits << " retransmits)" << std::endl;
+			return -1;
+		}
+		std::cout << "[fec]   ";
+		if (broadcast)
+			std::cout << "broadcast:  ";
+		else if (!groupSize)
+			std::cout << "stripe:     ";
+		else std::cout << "fec k=" << groupSize << ((groupSize < 10) ? ":    " : ":   ");
+		std::cout << "goodput " << ((double)FRAMES * 100.0 / (double)packetsSent) << "% of packets sent, " << retransmits << " retransmits, latency p50 " << latency[FRAMES / 2] << "ms p99 " << latency[(FRAMES * 99) / 100] << "ms p99.9 " << latency[(FRAMES * 999) / 1000] << "ms" << std::endl;
+	}
+
+	return 0;
+}
+
+static unsigned long _countMembers(DB &db,uint64_t nwid,unsigned long &authorized)
+{
+	nlohmann::json network;
+	std::vector<nlohmann::json> members;
+	authorized = 0;
+	db.get(nwid,network,members);
+	for(std::vector<nlohmann::json>::iterator m(members.begin());m!=members.end();++m) {
+		if (OSUtils::jsonBool((*m)["authorized"],false))
+			++authorized;
+	}
+	return (unsigned long)members.size();
+}
+
+static int testLogDB()
+{
+	static const unsigned long MEMBERS = 10000;
+	static const uint64_t NWID = 0xabcdef0123000001ULL;
+	const std::string dir("selftest-logdb.d");
+	const std::string logPath(dir + ZT_PATH_SEPARATOR_S "controller.log");
+	char tmp[64];
+	unsigned long count,authorized;
+
+	OSUtils::rmDashRf(dir.c_str());
+
+	std::cout << "[logdb] Benchmarking FileDB vs. LogDB with " << MEMBERS << " members..." << std::endl;
+	nlohmann::json network;
+	network["id"] = Utils::hex(NWID,tmp);
+	network["nwid"] = network["id"];
+	DB::initNetwork(network);
+	std::vector<nlohmann::json> members(MEMBERS);
+	for(unsigned long i=0;i<MEMBERS;++i) {
+		nlohmann::json &m = members[i];
+		OSUtils::ztsnprintf(tmp,sizeof(tmp),"%.10llx",(unsigned long long)(0x1000000000ULL + i));
+		m["id"] = tmp;
+		m["nwid"] = network["id"];
+		DB::initMember(m);
+		m["authorized"] = true;
+	}
+
+	int64_t start = OSUtils::now();
+	{
+		FileDB db(dir.c_str());
+		db.save(network,false);
+		for(unsigned long i=0;i<MEMBERS;++i)
+			db.save(members[i],false);
+	}
+	const int64_t fileSave = OSUtils::now() - start;
+	start = OSUtils::now();
+	{
+		FileDB db(dir.c_str());
+		count = _countMembers(db,NWID,authorized);
+	}
+	const int64_t fileLoad = OSUtils::now() - start;
+	std::cout << "[logdb]   FileDB: " << ((double)MEMBERS * 1000.0 / (double)std::max(fileSave,(int64_t)1)) << " saves/sec, startup " << fileLoad << "ms" << std::endl;
+
+	std::cout << "[logdb] Testing recovery from an interrupted import... ";
+	{
+		// A crash part way through an import leaves a partial temporary log
+		const std::string partial("ZTLOGDB1\0\0\x01\x00junk",16);
+		OSUtils::writeFile((logPath + ".tmp").c_str(),partial.data(),(unsigned int)partial.length());
+		if (OSUtils::fileExists(logPath.c_str())) {
+			std::cout << "FAIL (log exists before import)" << std::endl;
+			return -1;
+		}
+		LogDB db(dir.c_str());
+		count = _countMembers(db,NWID,authorized);
+	}
+	if ((count != MEMBERS)||(authorized != MEMBERS)||(OSUtils::fileExists((logPath + ".tmp").c_str()))) {
+		std::cout << "FAIL (" << count << " members, " << authorized << " authorized)" << std::endl;
+		return -1;
+	}
+	OSUtils::rm(logPath.c_str());
+	std::cout << "PASS" << std::endl;
+
+	std::cout << "[logdb] Testing import of FileDB records... ";
+	start = OSUtils::now();
+	{
+		LogDB db(dir.c_str());
+		count = _countMembers(db,NWID,authorized);
+	}
+	const int64_t importTime = OSUtils::now() - start;
+	if ((count != MEMBERS)||(authorized != MEMBERS)) {
+		std::cout << "FAIL (" << count << " members, " << authorized << " authorized)" << std::endl;
+		return -1;
+	}
+	std::cout << "PASS (" << importTime << "ms)" << std::endl;
+
+	std::cout << "[logdb] Testing saves, reload and compaction... ";
+	uint64_t appended = 0,live,compactedSize = 0;
+	int64_t logSave;
+	{
+		LogDB db(dir.c_str());
+		start = OSUtils::now();
+		for(int pass=0;pass<3;++pass) {
+			for(unsigned long i=0;i<MEMBERS;++i) {
+				members[i]["authorized"] = ((pass & 1) != 0);
+				db.save(members[i],false);
+				appended += OSUtils::jsonDump(members[i],-1).length();
+			}
+		}
+		logSave = OSUtils::now() - start;
+		// Without compaction the log would hold the import plus all three passes
+		live = (appended / 3) + (MEMBERS * 64);
+		for(int i=0;i<50;++i) {
+			compactedSize = db.logSize();
+			if (compactedSize <= (live * ZT_LOGDB_COMPACT_RATIO))
+				break;
+			Thread::sleep(ZT_LOGDB_SYNC_INTERVAL);
+		}
+	}
+	start = OSUtils::now();
+	{
+		LogDB db(dir.c_str());
+		count = _countMembers(db,NWID,authorized);
+	}
+	const int64_t logLoad = OSUtils::now() - start;
+	if ((count != MEMBERS)||(authorized != 0)) {
+		std::cout << "FAIL (" << count << " members, " << authorized << " authorized after reload)" << std::endl;
+		return -1;
+	}
+	if (compactedSize > (live * ZT_LOGDB_COMPACT_RATIO)) {
+		std::cout << "FAIL (log not compacted: " << appended << " bytes appended, " << compactedSize << " bytes on disk)" << std::endl;
+		return -1;
+	}
+	std::cout << "PASS (" << appended << " bytes appended, " << compactedSize << " bytes on disk)" << std::endl;
+	std::cout << "[logdb]   LogDB: " << ((double)(MEMBERS * 3) * 1000.0 / (double)std::max(logSave,(int64_t)1)) << " saves/sec, startup " << logLoad << "ms" << std::endl;
+
+	std::cout << "[logdb] Testing recovery from a torn write... ";
+	{
+		LogDB db(dir.c_str());
+		members[0]["authorized"] = true;
+		db.save(members[0],false);
+		db.eraseMember(NWID,0x1000000001ULL);
+		members[2]["authorized"] = true;
+		db.save(members[2],false);
+	}
+	std::string buf;
+	OSUtils::readFile(logPath.c_str(),buf);
+	OSUtils::writeFile(logPath.c_str(),buf.data(),(unsigned int)buf.length() - 7);
+	{
+		LogDB db(dir.c_str());
+		count = _countMembers(db,NWID,authorized);
+		if ((count != (MEMBERS - 1))||(authorized != 1)) {
+			std::cout << "FAIL (" << count << " members, " << authorized << " authorized)" << std::endl;
+			return -1;
+		}
+		db.save(members[2],false);
+	}
+	{
+		LogDB db(dir.c_str());
+		count = _countMembers(db,NWID,authorized);
+		if ((count != (MEMBERS - 1))||(authorized != 2)) {
+			std::cout << "FAIL (" << count << " members, " << authorized << " authorized after resave)" << std::endl;
+			return -1;
+		}
+	}
+	std::cout << "PASS" << std::endl;
+
+	std::cout << "[logdb] Testing paged member listing... ";
+	{
+		LogDB db(dir.c_str());
+		std::vector<nlohmann::json> page;
+		uint64_t after = 0;
+		unsigned long pages = 0;
+		bool more = true,ordered = true;
+		count = 0;
+		while (more) {
+			page.clear();
+			db.memberPage(NWID,after,1000,DB::MemberFilter(),page,more);
+			for(std::vector<nlohmann::json>::iterator m(page.begin());m!=page.end();++m) {
+				const uint64_t id = Utils::hexStrToU64(OSUtils::jsonString((*m)["id"],"").c_str());
+				if (id <= after)
+					ordered = false;
+				after = id;
+			}
+			count += (unsigned long)page.size();
+			++pages;
+		}
+		if ((count != (MEMBERS - 1))||(pages != (((MEMBERS - 1) + 999) / 1000))||(!ordered)) {
+			std::cout << "FAIL (" << count << " members in " << pages << " pages" << (ordered ? "" : ", out of order") << ")" << std::endl;
+			return -1;
+		}
+		page.clear();
+		db.memberPage(NWID,0,1000,[](const nlohmann::json &m) { return m.value("authorized",false); },page,more);
+		if ((page.size() != 2)||(more)) {
+			std::cout << "FAIL (" << page.size() << " authorized members listed)" << std::endl;
+			return -1;
+		}
+	}
+	std::cout << "PASS" << std::endl;
+
+	OSUtils::rmDashRf(dir.c_str());
+	return 0;
+}
+
 static int testOther()
 {
 	char buf[1024];
@@ -681,6 +1282,73 @@ static int testOther()
 	std::cout << " " << InetAddress("").toString(buf);
 	std::cout << std::endl;
 
+	std::cout << "[other] Testing Ewma... "; std::cout.flush();
+	{
+		Ewma<32> e;
+		e.push(10.0f);
+		if ((e.mean() != 10.0f)||(e.variance() != 0.0f)||(e.peak() != 10.0f)) {
+			std::cout << "FAIL (first sample)" << std::endl;
+			return -1;
+		}
+		for(int i=0;i<1000;++i)
+			e.push((i & 1) ? 12.0f : 8.0f);
+		if ((fabsf(e.mean() - 10.0f) > 0.2f)||(fabsf(e.stddev() - 2.0f) > 0.2f)||(e.peak() < 12.0f)||(e.count() != 32)) {
+			std::cout << "FAIL (mean " << e.mean() << " stddev " << e.stddev() << ")" << std::endl;
+			return -1;
+		}
+		for(int i=0;i<200;++i)
+			e.push(0.0f);
+		if ((e.mean() > 0.01f)||(e.peak() > 0.1f)) {
+			std::cout << "FAIL (decay)" << std::endl;
+			return -1;
+		}
+		std::cout << "PASS" << std::endl;
+	}
+
+	std::cout << "[other] Testing Flow hashing... "; std::cout.flush();
+	{
+		uint8_t a[64],b[64];
+		memset(a,0,sizeof(a));
+		a[0] = 0x45; a[9] = 0x06; // IPv4 TCP
+		a[12] = 10; a[13] = 1; a[14] = 2; a[15] = 3;
+		a[16] = 192; a[17] = 168; a[18] = 7; a[19] = 9;
+		a[20] = 0xc3; a[21] = 0x50; a[22] = 0x14; a[23] = 0x51;
+		memcpy(b,a,sizeof(b));
+		memcpy(b + 12,a + 16,4); memcpy(b + 16,a + 12,4);
+		memcpy(b + 20,a + 22,2); memcpy(b + 22,a + 20,2);
+		const int32_t fwd = Flow::hashFrame(0x0800,a,sizeof(a));
+		if ((fwd == ZT_QOS_NO_FLOW)||(fwd < 0)||(fwd != Flow::hashFrame(0x0800,b,sizeof(b)))) {
+			std::cout << "FAIL (IPv4 not symmetric)" << std::endl;
+			return -1;
+		}
+		b[23] ^= 1;
+		if (fwd == Flow::hashFrame(0x0800,b,sizeof(b))) {
+			std::cout << "FAIL (IPv4 port ignored)" << std::endl;
+			return -1;
+		}
+		a[9] = 0x01; // ICMP
+		if (Flow::hashFrame(0x0800,a,sizeof(a)) != ZT_QOS_NO_FLOW) {
+			std::cout << "FAIL (ICMP has a flow)" << std::endl;
+			return -1;
+		}
+		memset(a,0,sizeof(a));
+		a[0] = 0x60; a[6] = 0x11; // IPv6 UDP
+		for(int i=0;i<16;++i) {
+			a[8 + i] = (uint8_t)(0x20 + i);
+			a[24 + i] = (uint8_t)(0xf0 - i);
+		}
+		a[40] = 0x12; a[41] = 0x34; a[42] = 0x00; a[43] = 0x35;
+		memcpy(b,a,sizeof(b));
+		memcpy(b + 8,a + 24,16); memcpy(b + 24,a + 8,16);
+		memcpy(b + 40,a + 42,2); memcpy(b + 42,a + 40,2);
+		const int32_t fwd6 = Flow::hashFrame(0x86dd,a,sizeof(a));
+		if ((fwd6 == ZT_QOS_NO_FLOW)||(fwd6 != Flow::hashFrame(0x86dd,b,sizeof(b)))) {
+			std::cout << "FAIL (IPv6 not symmetric)" << std::endl;
+			return -1;
+		}
+		std::cout << "PASS" << std::endl;
+	}
+
 #if 0
 	std::cout << "[other] Testing Hashtable... "; std::cout.flush();
 	{
@@ -1111,6 +1779,11 @@ int main(int argc,char **argv)
 	r |= testOther();
 	r |= testCrypto();
 	r |= testPacket();
+	r |= testMulticastTree();
+	r |= testResequencer();
+	r |= testAqm();
+	r |= testFec();
+	r |= testLogDB();
 	r |= testIdentity();
 	r |= testCertificate();
 	r |= testPhy();
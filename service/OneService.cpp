@@ -24,6 +24,7 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <functional>
 
 #include "../version.h"
 #include "../include/ZeroTierOne.h"
@@ -133,6 +134,9 @@ using json = nlohmann::json;
 // Maximum write buffer size for outgoing TCP connections (sanity limit)
 #define ZT_TCP_MAX_WRITEQ_SIZE 33554432
 
+// Streamed HTTP response bodies are pulled from their source while less than this is waiting to be sent
+#define ZT_HTTP_STREAM_BUFFER_SIZE 131072
+
 // TCP activity timeout
 #define ZT_TCP_ACTIVITY_TIMEOUT 60000
 
@@ -313,12 +317,42 @@ static void _bondToJson(nlohmann::json &pj, SharedPtr<Bond> &bond)
 	pj["failoverInterval"] = bond->getFailoverInterval();
 	pj["downDelay"] = bond->getDownDelay();
 	pj["upDelay"] = bond->getUpDelay();
+	pj["livenessInterval"] = bond->livenessInterval();
+	pj["livenessMultiplier"] = bond->livenessMultiplier();
 	if (bondingPolicy == ZT_BONDING_POLICY_BALANCE_RR) {
 		pj["packetsPerLink"] = bond->getPacketsPerLink();
 	}
 	if (bondingPolicy == ZT_BONDING_POLICY_ACTIVE_BACKUP) {
 		pj["linkSelectMethod"] = bond->getLinkSelectMethod();
 	}
+	if ((bondingPolicy == ZT_BONDING_POLICY_BALANCE_RR)||(bondingPolicy == ZT_BONDING_POLICY_BALANCE_AWARE)) {
+		const Resequencer::Counters rc(bond->resequenceCounters());
+		nlohmann::json rj;
+		rj["enabled"] = bond->resequencing();
+		rj["timeout"] = bond->resequenceTimeout();
+		rj["inOrder"] = rc.inOrder;
+		rj["reordered"] = rc.reordered;
+		rj["lateReleases"] = rc.lateReleases;
+		rj["late"] = rc.late;
+		rj["duplicates"] = rc.duplicates;
+		rj["maxDepth"] = rc.maxDepth;
+		pj["resequence"] = rj;
+	}
+	if ((bondingPolicy == ZT_BONDING_POLICY_BALANCE_RR)||(bondingPolicy == ZT_BONDING_POLICY_BALANCE_XOR)||(bondingPolicy == ZT_BONDING_POLICY_BALANCE_AWARE)) {
+		const Fec::Decoder::Counters fc(bond->fecCounters());
+		nlohmann::json fj;
+		fj["enabled"] = bond->fec();
+		fj["groupSize"] = bond->fecGroupSize();
+		fj["paritySent"] = bond->fecParitySent();
+		fj["parityReceived"] = fc.parity;
+		fj["recovered"] = fc.recovered;
+		fj["duplicates"] = fc.duplicates;
+		pj["fec"] = fj;
+	}
+	if ((bondingPolicy == ZT_BONDING_POLICY_BALANCE_RR)||(bondingPolicy == ZT_BONDING_POLICY_BALANCE_XOR)||(bondingPolicy == ZT_BONDING_POLICY_BALANCE_AWARE)) {
+		pj["capacityProbing"] = bond->capacityProbing();
+		pj["pacing"] = bond->pacing();
+	}
 
 	nlohmann::json pa = nlohmann::json::array();
 	std::vector< SharedPtr<Path> > paths = bond->getPeer()->paths(now);
@@ -336,13 +370,45 @@ static void _bondToJson(nlohmann::json &pj, SharedPtr<Bond> &bond)
 		j["latencyVariance"] = paths[i]->latencyVariance();
 		j["packetLossRatio"] = paths[i]->packetLossRatio();
 		j["packetErrorRatio"] = paths[i]->packetErrorRatio();
-		j["givenLinkSpeed"] = 1000;
+		j["givenLinkSpeed"] = bond->getLink(paths[i])->speed();
+		j["throughputMean"] = paths[i]->throughputMean();
+		j["throughputMax"] = paths[i]->throughputMax();
+		j["probedCapacity"] = paths[i]->probedCapacity();
+		j["capacity"] = paths[i]->capacity();
+		j["paceRate"] = paths[i]->paceRate();
 		j["allocation"] = paths[i]->allocation();
+		j["livenessMonitored"] = paths[i]->livenessMonitored();
+		j["livenessDown"] = paths[i]->livenessDown();
 		pa.push_back(j);
 	}
 	pj["links"] = pa;
 }
 
+static void _bondEventsToJson(nlohmann::json &pj, SharedPtr<Bond> &bond, uint32_t since)
+{
+	std::vector<Bond::Event> events;
+	pj["newest"] = bond->events(since,events);
+
+	nlohmann::json ea = nlohmann::json::array();
+	for(std::vector<Bond::Event>::const_iterator e(events.begin());e!=events.end();++e) {
+		nlohmann::json j;
+		j["seq"] = e->seq;
+		j["timestamp"] = e->timestamp;
+		j["type"] = Bond::eventTypeName(e->type);
+		if (e->flowId != ZT_QOS_NO_FLOW) {
+			j["flowId"] = e->flowId;
+		}
+		nlohmann::json args = nlohmann::json::array();
+		for(unsigned int k=0;k<3;++k) {
+			args.push_back(e->args[k]);
+		}
+		j["args"] = args;
+		j["message"] = bond->eventToString(*e);
+		ea.push_back(j);
+	}
+	pj["events"] = ea;
+}
+
 static void _moonToJson(nlohmann::json &mj,const World &world)
 {
 	char tmp[4096];
@@ -442,6 +508,9 @@ struct TcpConnection
 	std::string readq;
 	std::string writeq;
 	Mutex writeq_m;
+
+	// Rest of an inbound HTTP request's response, sent with chunked encoding as writeq drains
+	std::function<bool (std::string &)> responseStream;
 };
 
 struct OneServiceIncomingPacket
@@ -1165,7 +1234,8 @@ public:
 		const std::map<std::string,std::string> &headers,
 		const std::string &body,
 		std::string &responseBody,
-		std::string &responseContentType)
+		std::string &responseContentType,
+		std::function<bool (std::string &)> &responseStream)
 	{
 		char tmp[256];
 		unsigned int scode = 404;
@@ -1258,6 +1328,16 @@ public:
 										scode = 400;
 									}
 								}
+								if (ps[1] == "events") {
+									SharedPtr<Bond> bond = _node->bondController()->getBondByPeerId(id);
+									if (bond) {
+										std::map<std::string,std::string>::const_iterator since(urlArgs.find("since"));
+										_bondEventsToJson(res,bond,(since != urlArgs.end()) ? (uint32_t)Utils::strToU64(since->second.c_str()) : 0);
+										scode = 200;
+									} else {
+										scode = 404;
+									}
+								}
 								if (ps[1] == "flows") {
 									fprintf(stderr, "displaying flows\n");
 								}
@@ -1284,6 +1364,18 @@ public:
 					res["version"] = tmp;
 					res["clock"] = OSUtils::now();
 
+					ZT_PendingQueueStats pq;
+					_node->pendingQueueStats(&pq);
+					json &pqj = res["pendingQueues"];
+					pqj["txQueued"] = pq.txQueued;
+					pqj["txDropped"] = pq.txDropped;
+					pqj["txPending"] = pq.txPending;
+					pqj["txPendingBytes"] = pq.txPendingBytes;
+					pqj["txPaced"] = pq.txPaced;
+					pqj["txPacedDropped"] = pq.txPacedDropped;
+					pqj["rxQueued"] = pq.rxQueued;
+					pqj["rxDropped"] = pq.rxDropped;
+
 					{
 						Mutex::Lock _l(_localConfig_m);
 						res["config"] = _localConfig;
@@ -1379,6 +1471,36 @@ public:
 								}
 							}
 
+						} else if ((ps.size() == 3)&&(ps[2] == "qos")) {
+							// Return per-bucket QoS scheduler statistics for a network
+
+							const uint64_t wantnw = Utils::hexStrToU64(ps[1].c_str());
+							for(unsigned long i=0;i<nws->networkCount;++i) {
+								if (nws->networks[i].nwid == wantnw) {
+									res = nlohmann::json::array();
+									ZT_QoSStats *qs = _node->qosStats(wantnw);
+									if (qs) {
+										for(unsigned long b=0;b<qs->bucketCount;++b) {
+											const ZT_QoSBucketStats &bs = qs->buckets[b];
+											nlohmann::json bj;
+											bj["bucket"] = bs.bucket;
+											bj["enqueued"] = bs.enqueued;
+											bj["sent"] = bs.sent;
+											bj["codelDrops"] = bs.codelDrops;
+											bj["overflowDrops"] = bs.overflowDrops;
+											bj["meanDelay"] = (bs.sent) ? (bs.totalDelay / bs.sent) : 0;
+											bj["maxDelay"] = bs.maxDelay;
+											bj["backlogPackets"] = bs.backlogPackets;
+											bj["backlogBytes"] = bs.backlogBytes;
+											res.push_back(bj);
+										}
+										_node->freeQueryResult((void *)qs);
+									}
+									scode = 200;
+									break;
+								}
+							}
+
 						} else scode = 404;
 						_node->freeQueryResult((void *)nws);
 					} else scode = 500;
@@ -1442,7 +1564,7 @@ public:
 					} else scode = 500;
 				} else {
 					if (_controller) {
-						scode = _controller->handleControlPlaneHttpGET(std::vector<std::string>(ps.begin()+1,ps.end()),urlArgs,headers,body,responseBody,responseContentType);
+						scode = _controller->handleControlPlaneHttpGET(std::vector<std::string>(ps.begin()+1,ps.end()),urlArgs,headers,body,responseBody,responseContentType,responseStream);
 					} else scode = 404;
 				}
 
@@ -1593,7 +1715,7 @@ public:
 			scode = 400;
 		}
 
-		if (responseBody.length() == 0) {
+		if ((responseBody.length() == 0)&&(!responseStream)) {
 			if ((res.is_object())||(res.is_array()))
 				responseBody = OSUtils::jsonDump(res);
 			else responseBody = "{}";
@@ -1604,7 +1726,16 @@ public:
 		// Also double-check isAuth since forbidding this without auth feels safer.
 		std::map<std::string,std::string>::const_iterator jsonp(urlArgs.find("jsonp"));
 		if ((isAuth)&&(jsonp != urlArgs.end())&&(responseContentType == "application/json")) {
-			if (responseBody.length() > 0)
+			if (responseStream) {
+				responseBody = jsonp->second + "(" + responseBody;
+				const std::function<bool (std::string &)> stream(responseStream);
+				responseStream = [stream](std::string &part) -> bool {
+					if (stream(part))
+						return true;
+					part.append(");");
+					return false;
+				};
+			} else if (responseBody.length() > 0)
 				responseBody = jsonp->second + "(" + responseBody + ");";
 			else responseBody = jsonp->second + "(null);";
 			responseContentType = "application/javascript";
@@ -1745,6 +1876,11 @@ public:
 				newTemplateBond->setFlowRebalanceStrategy(OSUtils::jsonInt(customPolicy["flowRebalanceStrategy"],(uint64_t)0));
 				newTemplateBond->setFailoverInterval(OSUtils::jsonInt(customPolicy["failoverInterval"],(uint64_t)0));
 				newTemplateBond->setPacketsPerLink(OSUtils::jsonInt(customPolicy["packetsPerLink"],-1));
+				newTemplateBond->setResequencing(OSUtils::jsonBool(customPolicy["resequence"],false));
+				newTemplateBond->setFec(OSUtils::jsonBool(customPolicy["fec"],false));
+				newTemplateBond->setCapacityProbing(OSUtils::jsonBool(customPolicy["capacityProbes"],false));
+				newTemplateBond->setPacing(OSUtils::jsonBool(customPolicy["pacing"],false));
+				newTemplateBond->setLiveness((int)OSUtils::jsonInt(customPolicy["livenessInterval"],0),(unsigned int)OSUtils::jsonInt(customPolicy["livenessMultiplier"],ZT_BOND_LIVENESS_DEFAULT_MULTIPLIER));
 
 				std::string linkMonitorStrategyStr(OSUtils::jsonString(customPolicy["linkMonitorStrategy"],""));
 				uint8_t linkMonitorStrategy = ZT_MULTIPATH_SLAVE_MONITOR_STRATEGY_DEFAULT;
@@ -2327,15 +2463,19 @@ public:
 		bool closeit = false;
 		{
 			Mutex::Lock _l(tc->writeq_m);
+			while ((tc->responseStream)&&(tc->writeq.length() < ZT_HTTP_STREAM_BUFFER_SIZE))
+				_pullResponseStream(tc);
 			if (tc->writeq.length() > 0) {
 				long sent = (long)_phy.streamSend(sock,tc->writeq.data(),(unsigned long)tc->writeq.length(),true);
 				if (sent > 0) {
 					if ((unsigned long)sent >= (unsigned long)tc->writeq.length()) {
 						tc->writeq.clear();
-						_phy.setNotifyWritable(sock,false);
+						if (!tc->responseStream) {
+							_phy.setNotifyWritable(sock,false);
 
-						if (tc->type == TcpConnection::TCP_HTTP_INCOMING)
-							closeit = true; // HTTP keep alive not supported
+							if (tc->type == TcpConnection::TCP_HTTP_INCOMING)
+								closeit = true; // HTTP keep alive not supported
+						}
 					} else {
 						tc->writeq.erase(tc->writeq.begin(),tc->writeq.begin() + sent);
 					}
@@ -2952,7 +3092,12 @@ public:
 
 	inline void tapFrameHandler(uint64_t nwid, const MAC& from, const MAC& to, unsigned int etherType, unsigned int vlanId, const void* data, unsigned int len)
 	{
+		const int64_t dl = _nextBackgroundTaskDeadline;
 		_node->processVirtualNetworkFrame((void*)0, OSUtils::now(), nwid, from.toInt(), to.toInt(), etherType, vlanId, data, len, &_nextBackgroundTaskDeadline);
+		if (_nextBackgroundTaskDeadline < dl) {
+			// Frames are being paced and the main loop may be sleeping past the new deadline
+			_phy.whack();
+		}
 	}
 
 	inline void onHttpRequestToServer(TcpConnection* tc)
@@ -2965,8 +3110,9 @@ public:
 		// Note that we check allowed IP ranges when HTTP connections are first detected in
 		// phyOnTcpData(). If we made it here the source IP is okay.
 
+		std::function<bool (std::string &)> stream;
 		try {
-			scode = handleControlPlaneHttpRequest(tc->remoteAddr, tc->parser.method, tc->url, tc->headers, tc->readq, data, contentType);
+			scode = handleControlPlaneHttpRequest(tc->remoteAddr, tc->parser.method, tc->url, tc->headers, tc->readq, data, contentType, stream);
 		}
 		catch (std::exception& exc) {
 			fprintf(stderr, "WARNING: unexpected exception processing control HTTP request: %s" ZT_EOL_S, exc.what());
@@ -2990,12 +3136,24 @@ public:
 		default: scodestr = "Error"; break;
 		}
 
-		OSUtils::ztsnprintf(tmpn, sizeof(tmpn), "HTTP/1.1 %.3u %s\r\nCache-Control: no-cache\r\nPragma: no-cache\r\nContent-Type: %s\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n",
-			scode,
-			scodestr,
-			contentType.c_str(),
-			(unsigned long)data.length());
-		{
+		if (stream) {
+			// Bodies too large to build up front are sent in chunks as they are produced
+			OSUtils::ztsnprintf(tmpn, sizeof(tmpn), "HTTP/1.1 %.3u %s\r\nCache-Control: no-cache\r\nPragma: no-cache\r\nContent-Type: %s\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n",
+				scode,
+				scodestr,
+				contentType.c_str());
+			Mutex::Lock _l(tc->writeq_m);
+			tc->writeq = tmpn;
+			if (tc->parser.method != HTTP_HEAD) {
+				_appendChunk(tc->writeq, data);
+				tc->responseStream = stream;
+			}
+		} else {
+			OSUtils::ztsnprintf(tmpn, sizeof(tmpn), "HTTP/1.1 %.3u %s\r\nCache-Control: no-cache\r\nPragma: no-cache\r\nContent-Type: %s\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n",
+				scode,
+				scodestr,
+				contentType.c_str(),
+				(unsigned long)data.length());
 			Mutex::Lock _l(tc->writeq_m);
 			tc->writeq = tmpn;
 			if (tc->parser.method != HTTP_HEAD)
@@ -3005,6 +3163,37 @@ public:
 		_phy.setNotifyWritable(tc->sock, true);
 	}
 
+	// Append a part of a chunked HTTP body, skipping empty parts since a zero length chunk ends the body
+	static inline void _appendChunk(std::string &writeq, const std::string &part)
+	{
+		if (part.length() > 0) {
+			char tmp[32];
+			OSUtils::ztsnprintf(tmp, sizeof(tmp), "%lx\r\n", (unsigned long)part.length());
+			writeq.append(tmp);
+			writeq.append(part);
+			writeq.append("\r\n");
+		}
+	}
+
+	// Move the next part of a streamed response into writeq, ending the body after the last one (writeq_m must be locked)
+	inline void _pullResponseStream(TcpConnection* tc)
+	{
+		std::string part;
+		bool more = false;
+		try {
+			more = tc->responseStream(part);
+		} catch ( ... ) {
+			// The status line has already gone out, so all we can do is end the body early
+			fprintf(stderr, "WARNING: unexpected exception streaming control HTTP response" ZT_EOL_S);
+			more = false;
+		}
+		_appendChunk(tc->writeq, part);
+		if (!more) {
+			tc->writeq.append("0\r\n\r\n");
+			tc->responseStream = std::function<bool (std::string &)>();
+		}
+	}
+
 	inline void onHttpResponseFromClient(TcpConnection* tc)
 	{
 		_phy.close(tc->sock);